@@ -0,0 +1,328 @@
+/****************************************************/
+/* File: gencmin.c                                  */
+/* Generator of synthetic C- programs for           */
+/* benchmarking the C- compiler                     */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every generated loop runs this many times */
+enum
+{
+  LOOP_COUNT = 3,
+  TABLE_SIZE = 64,
+  MAX_EXPRESSION_DEPTH = 3
+};
+
+static int functions = 10;   /* number of functions besides main */
+static int statements = 20;  /* statements in each function body */
+static int depth = 2;        /* deepest nesting of if and while */
+static int identifiers = 8;  /* globals, and locals per function */
+static unsigned int seed = 1;
+
+static int current;   /* index of the function being generated */
+static int callMade;  /* the current function already calls another */
+static int indent;
+
+/* Function nextRandom returns a number in [0, n) from
+ * a generator that gives the same program on every
+ * host for the same seed */
+static int nextRandom(int n)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (int)((seed >> 16) % (unsigned int)n);
+}
+
+/* Procedure name prints prefix followed by index
+ * written in letters, since C- identifiers have no
+ * digits. No prefix used starts a reserved word */
+static void name(const char *prefix, int index)
+{
+  char letters[16];
+  int n = 0;
+  do
+  {
+    letters[n++] = (char)('a' + index % 26);
+    index /= 26;
+  } while (index);
+  printf("%s", prefix);
+  while (n)
+    putchar(letters[--n]);
+}
+
+static void newline(void)
+{
+  putchar('\n');
+  for (int i = 0; i < indent; ++i)
+    printf("  ");
+}
+
+/* Procedure variable prints a variable readable in
+ * the current function: a local, a parameter or a
+ * global */
+static void variable(void)
+{
+  int kind = nextRandom(4);
+  if (kind == 0)
+    name("g", nextRandom(identifiers));
+  else if (kind == 1)
+    printf(nextRandom(2) ? "p" : "q");
+  else
+    name("x", nextRandom(identifiers));
+}
+
+static void expression(int level)
+{
+  int kind = level >= MAX_EXPRESSION_DEPTH ? nextRandom(3) : nextRandom(8);
+  switch (kind)
+  {
+  case 0:
+    printf("%d", nextRandom(100));
+    break;
+  case 1:
+    printf("tab[%d]", nextRandom(TABLE_SIZE));
+    break;
+  case 2:
+    variable();
+    break;
+  case 3:
+  case 4:
+    printf("(");
+    expression(level + 1);
+    printf(nextRandom(2) ? " + " : " - ");
+    expression(level + 1);
+    printf(")");
+    break;
+  case 5:
+    expression(level + 1);
+    printf(" * ");
+    expression(level + 1);
+    break;
+  case 6:
+    printf("(");
+    expression(level + 1);
+    printf(") / %d", 1 + nextRandom(9));
+    break;
+  default:
+    variable();
+    printf(" + %d", nextRandom(10));
+    break;
+  }
+}
+
+static void condition(void)
+{
+  static const char *const relations[] = {"<", "<=", ">", ">=", "==", "!="};
+  expression(1);
+  printf(" %s ", relations[nextRandom(6)]);
+  expression(1);
+}
+
+static void block(int count, int level);
+
+/* Procedure statement prints one statement, using up
+ * to count statements for the blocks nested in it.
+ * Returns the number of statements used */
+static int statement(int count, int level)
+{
+  int kind = nextRandom(10);
+  if (kind < 2 && level < depth && count > 2)
+  { /* if statement */
+    int inner = 1 + nextRandom(count - 1);
+    newline();
+    printf("if (");
+    condition();
+    printf(")");
+    block(inner / 2 + 1, level + 1);
+    newline();
+    printf("else");
+    block(inner - inner / 2, level + 1);
+    return inner + 1;
+  }
+  if (kind < 4 && level < depth && count > 2)
+  { /* while loop with a counter of its own */
+    int inner = 1 + nextRandom(count - 1);
+    newline();
+    name("k", level);
+    printf(" = 0;");
+    newline();
+    printf("while (");
+    name("k", level);
+    printf(" < %d)", LOOP_COUNT);
+    newline();
+    printf("{");
+    ++indent;
+    block(inner, level + 1);
+    newline();
+    name("k", level);
+    printf(" = ");
+    name("k", level);
+    printf(" + 1;");
+    --indent;
+    newline();
+    printf("}");
+    return inner + 1;
+  }
+  if (kind == 4 && level == 0 && current > 0 && !callMade)
+  { /* one call per function, outside loops, so the
+     * number of calls stays linear */
+    callMade = 1;
+    newline();
+    name("x", nextRandom(identifiers));
+    printf(" = ");
+    name("f", nextRandom(current));
+    printf("(");
+    expression(1);
+    printf(", ");
+    expression(1);
+    printf(");");
+    return 1;
+  }
+  newline();
+  if (kind == 5)
+  {
+    if (level > 0)
+    {
+      printf("tab[");
+      name("k", level - 1);
+      printf(" * %d]", TABLE_SIZE / LOOP_COUNT);
+    }
+    else
+      printf("tab[%d]", nextRandom(TABLE_SIZE));
+  }
+  else if (nextRandom(3) == 0)
+    name("g", nextRandom(identifiers));
+  else
+    name("x", nextRandom(identifiers));
+  printf(" = ");
+  expression(0);
+  printf(";");
+  return 1;
+}
+
+static void block(int count, int level)
+{
+  newline();
+  printf("{");
+  ++indent;
+  while (count > 0)
+    count -= statement(count, level);
+  --indent;
+  newline();
+  printf("}");
+}
+
+static void locals(void)
+{
+  for (int i = 0; i < identifiers; ++i)
+  {
+    newline();
+    printf("int ");
+    name("x", i);
+    printf(";");
+  }
+  for (int i = 0; i < depth; ++i)
+  {
+    newline();
+    printf("int ");
+    name("k", i);
+    printf(";");
+  }
+  for (int i = 0; i < identifiers; ++i)
+  {
+    newline();
+    name("x", i);
+    printf(" = p + %d;", i);
+  }
+  for (int i = 0; i < depth; ++i)
+  { /* also indexes tab in the blocks nested in loop i */
+    newline();
+    name("k", i);
+    printf(" = 0;");
+  }
+}
+
+static void function(void)
+{
+  int count = statements;
+  callMade = 0;
+  printf("\nint ");
+  name("f", current);
+  printf("(int p, int q)\n{");
+  indent = 1;
+  locals();
+  while (count > 0)
+    count -= statement(count, 0);
+  newline();
+  printf("return ");
+  expression(1);
+  printf(";\n}\n");
+  indent = 0;
+}
+
+static int number(const char *option, const char *value, int lowest)
+{
+  char *end;
+  long n = value ? strtol(value, &end, 10) : 0;
+  if (value == NULL || *end != '\0' || n < lowest || n > 1000000)
+  {
+    fprintf(stderr, "gencmin: invalid value for %s\n", option);
+    exit(1);
+  }
+  return (int)n;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: gencmin [-f functions] [-s statements] [-d depth] [-i identifiers] [-r seed]\n");
+  fprintf(stderr, "writes a C- program of the given size to stdout\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; i += 2)
+  {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!strcmp(argv[i], "-f"))
+      functions = number(argv[i], value, 0);
+    else if (!strcmp(argv[i], "-s"))
+      statements = number(argv[i], value, 1);
+    else if (!strcmp(argv[i], "-d"))
+      depth = number(argv[i], value, 0);
+    else if (!strcmp(argv[i], "-i"))
+      identifiers = number(argv[i], value, 1);
+    else if (!strcmp(argv[i], "-r"))
+      seed = (unsigned int)number(argv[i], value, 0);
+    else
+      usage();
+  }
+  printf("/* Generated by gencmin -f %d -s %d -d %d -i %d -r %u */\n",
+         functions, statements, depth, identifiers, seed);
+  printf("\nint tab[%d];\n", TABLE_SIZE);
+  for (int i = 0; i < identifiers; ++i)
+  {
+    printf("int ");
+    name("g", i);
+    printf(";\n");
+  }
+  for (current = 0; current < functions; ++current)
+    function();
+
+  /* main reads one number, so nothing folds away,
+   * calls every function and prints a checksum */
+  printf("\nvoid main(void)\n{\n  int p; int sum;\n  p = input();\n  sum = 0;");
+  indent = 1;
+  for (int i = 0; i < functions; ++i)
+  {
+    newline();
+    printf("sum = sum + ");
+    name("f", i);
+    printf("(p + %d, sum);", i);
+  }
+  printf("\n  output(sum);\n}\n");
+  return 0;
+}
@@ -0,0 +1,420 @@
+/****************************************************/
+/* File: micro.c                                    */
+/* Microbenchmarks of the components of the         */
+/* C- compiler: scanner, symbol table, syntax tree  */
+/* construction and code emission                   */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <time.h>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "symtab.h"
+#include "code.h"
+
+/* The compiler's globals, normally allocated in
+ * main.c, which is not linked in */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+FILE *code;
+
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = FALSE;
+int TraceCode = FALSE;
+int TraceOptimize = FALSE;
+int TraceSSA = FALSE;
+int TimeReport = FALSE;
+int ReportJSON = FALSE;
+int PerfCounters = FALSE;
+int TimeTrace = FALSE;
+
+int InlineFunctions = TRUE;
+int InlineLimit = 40;
+int MoveLoopInvariants = TRUE;
+int OptimizeTailCalls = TRUE;
+int PropagateConstants = TRUE;
+int NumberValues = TRUE;
+int BoundsCheck = FALSE;
+
+int BufferOutput = TRUE;
+int BatchInput = FALSE;
+int Simulate = FALSE;
+int SimStats = FALSE;
+int Profile = FALSE;
+
+int Error = FALSE;
+
+/* Implemented in lex.yy.c */
+void yyrestart(FILE *input);
+
+static int repetitions = 10;
+static long iterations = 100000; /* operations of one repetition */
+static int scopeDepth = 8;
+static int symbolCount = 64;     /* symbols declared per scope */
+static int collisionPercent = 0; /* of symbols sharing one bucket */
+
+/* A fixed program text for the scanner, repeated to
+ * fill the buffer */
+static const char scanText[] =
+    "/* insertion sort of an array read from the input */\n"
+    "int data[100];\n"
+    "int count;\n"
+    "void sort(int a[], int n)\n"
+    "{\n"
+    "  int i; int j; int key;\n"
+    "  i = 1;\n"
+    "  while (i < n)\n"
+    "  {\n"
+    "    key = a[i];\n"
+    "    j = i - 1;\n"
+    "    while (a[j] > key) /* shift right */\n"
+    "    {\n"
+    "      a[j + 1] = a[j];\n"
+    "      j = j - 1;\n"
+    "    }\n"
+    "    a[j + 1] = key;\n"
+    "    i = i + 1;\n"
+    "  }\n"
+    "}\n"
+    "int checksum(int a[], int n)\n"
+    "{\n"
+    "  int sum; sum = 0;\n"
+    "  while (n > 0) { n = n - 1; sum = sum * 31 + a[n]; }\n"
+    "  return sum / 7 != 12345;\n"
+    "}\n";
+
+#define SCAN_BUFFER_SIZE 65536
+
+static char *scanBuffer;
+static size_t scanLength;
+static char **names;
+static TreeNode **declarations;
+static TreeNode **uses;
+
+static double nanoseconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Procedure makeName writes index in letters, as
+ * C- identifiers have no digits */
+static void makeName(char *name, int index)
+{
+  char letters[16];
+  int n = 0;
+  do
+  {
+    letters[n++] = (char)('a' + index % 26);
+    index /= 26;
+  } while (index);
+  name[0] = 'v';
+  for (int i = 0; i < n; ++i)
+    name[i + 1] = letters[n - 1 - i];
+  name[n + 1] = '\0';
+}
+
+/* Procedure makeNames picks symbolCount names. The
+ * given percentage of them share one bucket; the
+ * others get a bucket of their own while there are
+ * free buckets left */
+static void makeNames(void)
+{
+  int colliding = symbolCount * collisionPercent / 100;
+  int used[HASHTABLE_SIZE] = {0};
+  int distinct = 0;
+  int shared = -1;
+  int made = 0;
+  names = malloc(sizeof(char *) * symbolCount);
+  for (int candidate = 0; made < symbolCount; ++candidate)
+  {
+    char name[16];
+    int bucket;
+    makeName(name, candidate);
+    bucket = symbolBucket(name);
+    if (shared < 0)
+      shared = bucket;
+    if (made < colliding)
+    {
+      if (bucket != shared)
+        continue;
+    }
+    else if (colliding > 0 && bucket == shared)
+      continue;
+    else if (used[bucket] && distinct < HASHTABLE_SIZE - (colliding > 0))
+      continue;
+    if (!used[bucket]++)
+      ++distinct;
+    names[made] = malloc(strlen(name) + 1);
+    strcpy(names[made++], name);
+  }
+}
+
+/* Nodes made here are not kept by addPtr, so they
+ * outlive the destroyPtr between repetitions */
+static TreeNode *newNode(NodeKind kind, const char *name, int line)
+{
+  TreeNode *t = calloc(1, sizeof(TreeNode));
+  t->nodekind = kind;
+  if (kind == DeclK)
+    t->kind.decl = VarDeclK;
+  else
+    t->kind.exp = VarK;
+  t->attr.name = (char *)name;
+  t->lineno = line;
+  return t;
+}
+
+static void makeDeclarations(void)
+{
+  declarations = malloc(sizeof(TreeNode *) * symbolCount);
+  uses = malloc(sizeof(TreeNode *) * symbolCount);
+  for (int i = 0; i < symbolCount; ++i)
+  {
+    declarations[i] = newNode(DeclK, names[i], 1);
+    uses[i] = newNode(ExpK, names[i], 2);
+  }
+}
+
+/* Each benchmark runs one repetition of about
+ * iterations operations and returns how many */
+typedef long (*Benchmark)(void);
+
+static long benchScan(void)
+{
+  long tokens = 0;
+  while (tokens < iterations)
+  {
+    source = fmemopen(scanBuffer, scanLength, "r");
+    yyrestart(source);
+    lineno = 0;
+    while (getToken() != ENDFILE)
+      ++tokens;
+    fclose(source);
+  }
+  return tokens;
+}
+
+/* Symbols are declared in the innermost of
+ * scopeDepth scopes, and the scopes closed again */
+static long benchInsert(void)
+{
+  long inserted = 0;
+  while (inserted < iterations)
+  {
+    initSymTab();
+    for (int d = 1; d < scopeDepth; ++d)
+      incrementScope();
+    for (int i = 0; i < symbolCount; ++i)
+      registerSymbol(declarations[i], Local, FALSE, Integer);
+    inserted += symbolCount;
+    for (int d = 0; d < scopeDepth; ++d)
+      decrementScope();
+  }
+  return inserted;
+}
+
+/* Symbols declared in the global scope are looked
+ * up from the innermost of scopeDepth scopes, so
+ * every lookup searches all of them. All uses are
+ * on one line, so the line lists stay short. */
+static void setupLookup(void)
+{
+  initSymTab();
+  for (int i = 0; i < symbolCount; ++i)
+    registerSymbol(declarations[i], Global, FALSE, Integer);
+  for (int d = 1; d < scopeDepth; ++d)
+    incrementScope();
+}
+
+static void teardownLookup(void)
+{
+  for (int d = 0; d < scopeDepth; ++d)
+    decrementScope();
+  destroyPtr();
+}
+
+static long benchLookup(void)
+{
+  long lookups = 0;
+  while (lookups < iterations)
+  {
+    for (int i = 0; i < symbolCount; ++i)
+      lookupSymbol(uses[i]);
+    lookups += symbolCount;
+  }
+  return lookups;
+}
+
+static long benchNodes(void)
+{
+  long count;
+  for (count = 0; count < iterations; count += 4)
+  {
+    newStmtNode(CompoundK);
+    newExpNode(OpK);
+    newExpNode(ConstK);
+    newDeclNode(VarDeclK);
+  }
+  return count;
+}
+
+static long benchEmit(void)
+{
+  long count;
+  for (count = 0; count < iterations; count += 8)
+  {
+    emitRegAddr("lw", "$t0", NULL, -12, "$fp");
+    emitRegAddr("lw", "$t1", "_data", 0, "$t2");
+    emitRegRegReg("addu", "$t0", "$t0", "$t1");
+    emitRegRegImm("sll", "$t2", "$t0", 2);
+    emitRegImm("li", "$v0", 12345);
+    emitRegRegLabel("blt", "$t0", "$t1", 42);
+    emitLabel("j", 17);
+    emitCode("syscall");
+  }
+  return count;
+}
+
+/* setup and teardown run around all repetitions,
+ * reset after each one, outside the timing */
+typedef struct
+{
+  const char *name;
+  const char *description;
+  Benchmark run;
+  void (*setup)(void);
+  void (*reset)(void);
+  void (*teardown)(void);
+} Entry;
+
+static const Entry benchmarks[] = {
+    {"scan", "getToken over a program in memory (per token)", benchScan, NULL, NULL, NULL},
+    {"insert", "registerSymbol in the innermost of -d scopes", benchInsert, NULL, destroyPtr, NULL},
+    {"lookup", "lookupSymbol of globals from -d scopes deep", benchLookup, setupLookup, NULL, teardownLookup},
+    {"nodes", "newStmtNode, newExpNode and newDeclNode", benchNodes, NULL, destroyPtr, NULL},
+    {"emit", "emit* functions of code.c to /dev/null", benchEmit, NULL, NULL, NULL},
+};
+
+#define BENCHMARK_COUNT (int)(sizeof benchmarks / sizeof benchmarks[0])
+
+/* Procedure measure runs a benchmark once to warm
+ * up, then repetitions times, and prints the mean,
+ * standard deviation and range of ns/op */
+static void measure(const Entry *e)
+{
+  double sum = 0.0, squares = 0.0, least = 0.0, most = 0.0;
+  if (e->setup)
+    e->setup();
+  for (int r = -1; r < repetitions; ++r)
+  {
+    double start = nanoseconds();
+    long ops = e->run();
+    double perOp = (nanoseconds() - start) / (double)ops;
+    if (e->reset)
+      e->reset();
+    if (r < 0)
+      continue; /* warming up */
+    sum += perOp;
+    squares += perOp * perOp;
+    if (r == 0 || perOp < least)
+      least = perOp;
+    if (r == 0 || perOp > most)
+      most = perOp;
+  }
+  if (e->teardown)
+    e->teardown();
+  {
+    double mean = sum / repetitions;
+    double variance = squares / repetitions - mean * mean;
+    double deviation = variance > 0.0 ? sqrt(variance) : 0.0;
+    printf("%-8s %10.2f %9.2f %6.1f%% %10.2f %10.2f\n", e->name, mean, deviation,
+           mean > 0.0 ? deviation * 100.0 / mean : 0.0, least, most);
+  }
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: micro [-r repetitions] [-n operations] [-d depth] [-s symbols] [-c collision%%] [name...]\n");
+  fprintf(stderr, "benchmarks:\n");
+  for (int i = 0; i < BENCHMARK_COUNT; ++i)
+    fprintf(stderr, "  %-8s %s\n", benchmarks[i].name, benchmarks[i].description);
+  exit(1);
+}
+
+static int option(const char *value, int lowest, int highest)
+{
+  char *end;
+  long n = value ? strtol(value, &end, 10) : 0;
+  if (value == NULL || *end != '\0' || n < lowest || n > highest)
+    usage();
+  return (int)n;
+}
+
+int main(int argc, char *argv[])
+{
+  int i = 1;
+  int selected = 0;
+  for (; i < argc && argv[i][0] == '-'; i += 2)
+  {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!strcmp(argv[i], "-r"))
+      repetitions = option(value, 1, 1000);
+    else if (!strcmp(argv[i], "-n"))
+      iterations = option(value, 1, 100000000);
+    else if (!strcmp(argv[i], "-d"))
+      scopeDepth = option(value, 1, 1000);
+    else if (!strcmp(argv[i], "-s"))
+      symbolCount = option(value, 1, 100000);
+    else if (!strcmp(argv[i], "-c"))
+      collisionPercent = option(value, 0, 100);
+    else
+      usage();
+  }
+  for (int a = i; a < argc; ++a)
+  {
+    int known = FALSE;
+    for (int b = 0; b < BENCHMARK_COUNT; ++b)
+      known = known || !strcmp(argv[a], benchmarks[b].name);
+    if (!known)
+    {
+      fprintf(stderr, "micro: unknown benchmark %s\n", argv[a]);
+      usage();
+    }
+  }
+  listing = stdout;
+  code = fopen("/dev/null", "w");
+  scanBuffer = malloc(SCAN_BUFFER_SIZE);
+  while (scanLength + sizeof scanText - 1 <= SCAN_BUFFER_SIZE)
+  {
+    memcpy(scanBuffer + scanLength, scanText, sizeof scanText - 1);
+    scanLength += sizeof scanText - 1;
+  }
+  makeNames();
+  makeDeclarations();
+
+  printf("%ld operations x %d repetitions, %d scopes, %d symbols, %d%% colliding\n",
+         iterations, repetitions, scopeDepth, symbolCount, collisionPercent);
+  printf("%-8s %10s %9s %7s %10s %10s\n", "name", "ns/op", "stddev", "", "min", "max");
+  for (int b = 0; b < BENCHMARK_COUNT; ++b)
+  {
+    int wanted = i == argc;
+    for (int a = i; a < argc; ++a)
+      if (!strcmp(argv[a], benchmarks[b].name))
+        wanted = TRUE;
+    if (wanted)
+    {
+      measure(&benchmarks[b]);
+      ++selected;
+    }
+  }
+  fclose(code);
+  return selected ? 0 : 1;
+}
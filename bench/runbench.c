@@ -0,0 +1,613 @@
+/****************************************************/
+/* File: runbench.c                                 */
+/* Benchmark runner for the C- compiler             */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAX_PROGRAMS 256
+#define NAME_SIZE 64
+
+/* What is measured for one program. The compile
+ * time is the least processor time, user and
+ * system, of the runs, which other processes on the
+ * host disturb less than the wall time. The memory
+ * is the largest resident set of the compiler */
+typedef struct
+{
+  char name[NAME_SIZE];
+  const char *source;
+  double compileMs;
+  long rssKb;
+  long tmBytes;
+  unsigned long long instructions;
+  unsigned long long cycles;
+} Result;
+
+static const char *compiler = "../src/project4_17";
+static const char *reference = NULL; /* compiler timed on the same host */
+static const char *baselineFile = "baseline.txt";
+static int runs = 5;
+static double tolerance = 15.0; /* percent allowed on time and memory */
+static int update = 0;
+static int showPhases = 0;
+static int perfCounters = 0;
+static int interpreters = 0;
+static int checks = 0;
+
+/* Differences below these are noise of process
+ * startup whatever the tolerance */
+#define TIME_NOISE_MS 5.0
+#define RSS_NOISE_KB 512
+
+static Result results[MAX_PROGRAMS];
+static int resultCount;
+static Result baseline[MAX_PROGRAMS];
+static int baselineCount;
+static Result references[MAX_PROGRAMS];
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Function spawn runs argv with its standard input
+ * read from input and its standard output and error
+ * sent to the given descriptors, or discarded for
+ * -1. Returns the exit status, or -1 if the program
+ * could not be run or was killed */
+static int spawn(char *const argv[], const char *input, int out, int err, struct rusage *usage)
+{
+  int status;
+  pid_t pid = fork();
+  if (pid < 0)
+    return -1;
+  if (pid == 0)
+  {
+    int in = open(input ? input : "/dev/null", O_RDONLY);
+    int null = open("/dev/null", O_WRONLY);
+    if (in < 0 || null < 0)
+      _exit(127);
+    dup2(in, 0);
+    dup2(out >= 0 ? out : null, 1);
+    dup2(err >= 0 ? err : null, 2);
+    execv(argv[0], argv);
+    _exit(127);
+  }
+  if (wait4(pid, &status, 0, usage) < 0 || !WIFEXITED(status))
+    return -1;
+  return WEXITSTATUS(status);
+}
+
+/* Procedure baseName copies the file name of path,
+ * without directories and extension, to name */
+static void baseName(const char *path, char *name)
+{
+  const char *slash = strrchr(path, '/');
+  const char *start = slash ? slash + 1 : path;
+  const char *dot = strrchr(start, '.');
+  size_t length = dot ? (size_t)(dot - start) : strlen(start);
+  if (length >= NAME_SIZE)
+    length = NAME_SIZE - 1;
+  memcpy(name, start, length);
+  name[length] = '\0';
+}
+
+/* Function replaceExtension returns a new string of
+ * path with its extension replaced by extension */
+static char *replaceExtension(const char *path, const char *extension)
+{
+  const char *slash = strrchr(path, '/');
+  const char *dot = strrchr(slash ? slash : path, '.');
+  size_t length = dot ? (size_t)(dot - path) : strlen(path);
+  char *result = malloc(length + strlen(extension) + 1);
+  memcpy(result, path, length);
+  strcpy(result + length, extension);
+  return result;
+}
+
+/* Function compileOnce compiles source with program
+ * and keeps the time if it is the fastest so far */
+static int compileOnce(const char *program, const char *source, Result *r)
+{
+  char *argv[] = {(char *)program, (char *)source, NULL};
+  struct rusage usage;
+  double elapsed;
+  if (spawn(argv, NULL, -1, -1, &usage) != 0)
+  {
+    fprintf(stderr, "runbench: %s does not compile with %s\n", source, program);
+    return 0;
+  }
+  elapsed = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+  if (r->compileMs < 0 || elapsed < r->compileMs)
+    r->compileMs = elapsed;
+  if (usage.ru_maxrss > r->rssKb)
+    r->rssKb = usage.ru_maxrss;
+  return 1;
+}
+
+/* Function compile compiles source runs times. With
+ * a reference compiler, host is given its times, its
+ * runs taking turns with those of the compiler so
+ * that both see the same load of the host */
+static int compile(const char *source, Result *r, Result *host)
+{
+  r->compileMs = -1;
+  r->rssKb = 0;
+  if (host)
+  {
+    host->compileMs = -1;
+    host->rssKb = 0;
+  }
+  for (int i = 0; i < runs; ++i)
+    if ((host && !compileOnce(reference, source, host)) || !compileOnce(compiler, source, r))
+      return 0;
+  return 1;
+}
+
+/* Function simulate runs the compiled program in the
+ * simulator and reads the counts it reports */
+static int simulate(const char *codefile, const char *input, Result *r)
+{
+  char *argv[] = {(char *)compiler, "--sim-stats", (char *)codefile, NULL};
+  char line[256];
+  FILE *stats = tmpfile();
+  int status;
+  if (stats == NULL)
+    return 0;
+  status = spawn(argv, input, -1, fileno(stats), NULL);
+  rewind(stats);
+  r->instructions = r->cycles = 0;
+  while (fgets(line, sizeof line, stats))
+  {
+    sscanf(line, "instructions: %llu", &r->instructions);
+    sscanf(line, "cycles: %llu", &r->cycles);
+  }
+  fclose(stats);
+  if (status != 0 || r->instructions == 0)
+  {
+    fprintf(stderr, "runbench: %s does not run\n", codefile);
+    return 0;
+  }
+  return 1;
+}
+
+/* Function jsonNumber finds "key": in line and
+ * reads the number after it. Returns 0 if absent */
+static int jsonNumber(const char *line, const char *key, double *value)
+{
+  char quoted[64];
+  const char *at;
+  snprintf(quoted, sizeof quoted, "\"%s\": ", key);
+  at = strstr(line, quoted);
+  return at && sscanf(at + strlen(quoted), "%lf", value) == 1;
+}
+
+/* Procedure printPhases compiles source once more
+ * with -ftime-report=json and prints the wall time
+ * of every phase that took any. With perfCounters
+ * it prints a row of hardware counts per phase */
+static void printPhases(const char *source, const char *name)
+{
+  static const char *const counters[] = {"cycles", "instructions", "branch_misses", "llc_misses"};
+  char *argv[] = {(char *)compiler, "-ftime-report=json", perfCounters ? "-fperf-counters" : (char *)source,
+                  (char *)source, NULL};
+  char line[1024];
+  FILE *report = tmpfile();
+  if (report == NULL)
+    return;
+  if (!perfCounters)
+    argv[3] = NULL;
+  if (spawn(argv, NULL, -1, fileno(report), NULL) == 0)
+  {
+    rewind(report);
+    printf("%-22s", name);
+    while (fgets(line, sizeof line, report))
+    {
+      char phase[64], reason[128];
+      double wall, count;
+      if (sscanf(line, " \"hardware_counters\": \"%127[^\"]\"", reason) == 1)
+        printf("\n  hardware counters %s", reason);
+      if (sscanf(line, " {\"name\": \"%63[^\"]\"", phase) != 1 || !jsonNumber(line, "wall_ms", &wall))
+        continue;
+      if (!perfCounters)
+      {
+        if (wall >= 0.0005)
+          printf(" %s %.3f,", phase, wall);
+        continue;
+      }
+      printf("\n  %-20s %10.3f", phase, wall);
+      for (int c = 0; c < 4; ++c)
+      {
+        if (jsonNumber(line, counters[c], &count))
+          printf(" %14.0f", count);
+        else
+          printf(" %14s", "-");
+      }
+    }
+    printf("\n");
+  }
+  fclose(report);
+}
+
+static int measure(const char *source, Result *r, Result *host)
+{
+  char *codefile = replaceExtension(source, ".tm");
+  char *input = replaceExtension(source, ".in");
+  struct stat st;
+  int ok;
+  baseName(source, r->name);
+  r->source = source;
+  if (access(input, R_OK) != 0)
+  {
+    free(input);
+    input = NULL;
+  }
+  ok = compile(source, r, host) && stat(codefile, &st) == 0;
+  if (ok)
+  {
+    r->tmBytes = (long)st.st_size;
+    ok = simulate(codefile, input, r);
+  }
+  free(codefile);
+  free(input);
+  return ok;
+}
+
+/* Function timeRun runs argv with input runs times
+ * and returns the fastest wall time in ms, or -1 if
+ * it could not be run. The output of the first run
+ * is written to output */
+static double timeRun(char *const argv[], const char *input, FILE *output)
+{
+  double best = -1;
+  for (int i = 0; i < runs; ++i)
+  {
+    double start = now(), elapsed;
+    if (spawn(argv, input, i == 0 ? fileno(output) : -1, -1, NULL) < 0)
+      return -1;
+    elapsed = now() - start;
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+/* Function sameContents returns 1 if the two files
+ * hold the same bytes */
+static int sameContents(FILE *a, FILE *b)
+{
+  int c;
+  rewind(a);
+  rewind(b);
+  while ((c = getc(a)) == getc(b))
+    if (c == EOF)
+      return 1;
+  return 0;
+}
+
+/* Function compareInterpreters compiles every
+ * program to SPIM code and to bytecode and prints
+ * the fastest wall time of running each in the MIPS
+ * simulator and in the bytecode interpreter, which
+ * includes starting the process and loading the
+ * code. Returns the number of programs that failed
+ * or printed differently */
+static int compareInterpreters(char *const sources[], int count)
+{
+  int failures = 0;
+  printf("%-22s %12s %12s %8s\n", "name", "sim_ms", "bytecode_ms", "speedup");
+  for (int i = 0; i < count; ++i)
+  {
+    char name[NAME_SIZE];
+    char *codefile = replaceExtension(sources[i], ".tm");
+    char *bytecode = replaceExtension(sources[i], ".bc");
+    char *input = replaceExtension(sources[i], ".in");
+    char *toSPIM[] = {(char *)compiler, sources[i], NULL};
+    char *toBytecode[] = {(char *)compiler, "--target=bytecode", sources[i], NULL};
+    char *simulate[] = {(char *)compiler, "--sim", codefile, NULL};
+    char *interpret[] = {(char *)compiler, "--run-bytecode", bytecode, NULL};
+    FILE *simOutput = tmpfile(), *bytecodeOutput = tmpfile();
+    double simMs = -1, bytecodeMs = -1;
+    baseName(sources[i], name);
+    if (access(input, R_OK) != 0)
+    {
+      free(input);
+      input = NULL;
+    }
+    if (simOutput && bytecodeOutput && spawn(toSPIM, NULL, -1, -1, NULL) == 0 &&
+        spawn(toBytecode, NULL, -1, -1, NULL) == 0)
+    {
+      simMs = timeRun(simulate, input, simOutput);
+      bytecodeMs = timeRun(interpret, input, bytecodeOutput);
+    }
+    if (simMs < 0 || bytecodeMs < 0)
+    {
+      fprintf(stderr, "runbench: %s does not run\n", sources[i]);
+      ++failures;
+    }
+    else if (!sameContents(simOutput, bytecodeOutput))
+    {
+      printf("%-22s %12.2f %12.2f %8s\n", name, simMs, bytecodeMs, "differs");
+      ++failures;
+    }
+    else
+      printf("%-22s %12.2f %12.2f %7.2fx\n", name, simMs, bytecodeMs, simMs / bytecodeMs);
+    if (simOutput)
+      fclose(simOutput);
+    if (bytecodeOutput)
+      fclose(bytecodeOutput);
+    free(codefile);
+    free(bytecode);
+    free(input);
+  }
+  return failures;
+}
+
+/* The flags every regression program is compiled
+ * with, one set per line, and the ways it is run */
+static const char *const checkFlags[][3] = {
+    {NULL},
+    {"-fno-inline", NULL},
+    {"-fno-move-loop-invariants", NULL},
+    {"-fno-optimize-sibling-calls", NULL},
+    {"-fno-sccp", "-fno-gvn", NULL},
+    {"-fno-share-stack-slots", NULL},
+    {"-fno-small-data", NULL},
+    {"-finline-limit=200", NULL},
+    {"-fbounds-check", NULL},
+    {"-fno-inline", "-fbounds-check", NULL}};
+static const char *const checkBackends[] = {
+    "--sim", "--run-bytecode",
+#if defined(__x86_64__) && defined(__linux__)
+    "--run",
+#endif
+};
+
+/* Function checkPrograms runs every program with
+ * every backend and flag set, and compares what it
+ * prints with the .expected file next to it. The
+ * program must exit with status 0. Returns the
+ * number of runs that failed or printed differently */
+static int checkPrograms(char *const sources[], int count)
+{
+  int failures = 0, total = 0;
+  for (int i = 0; i < count; ++i)
+  {
+    char name[NAME_SIZE];
+    char *expected = replaceExtension(sources[i], ".expected");
+    char *input = replaceExtension(sources[i], ".in");
+    FILE *want = fopen(expected, "r");
+    baseName(sources[i], name);
+    if (access(input, R_OK) != 0)
+    {
+      free(input);
+      input = NULL;
+    }
+    if (want == NULL)
+    {
+      fprintf(stderr, "runbench: %s not found\n", expected);
+      ++failures;
+    }
+    for (size_t b = 0; want && b < sizeof checkBackends / sizeof checkBackends[0]; ++b)
+      for (size_t f = 0; f < sizeof checkFlags / sizeof checkFlags[0]; ++f)
+      {
+        char *argv[6] = {(char *)compiler, (char *)checkBackends[b]};
+        char flags[128] = "";
+        int n = 2, status;
+        FILE *got = tmpfile();
+        for (int k = 0; checkFlags[f][k]; ++k)
+        {
+          argv[n++] = (char *)checkFlags[f][k];
+          strcat(flags, " ");
+          strcat(flags, checkFlags[f][k]);
+        }
+        argv[n++] = sources[i];
+        argv[n] = NULL;
+        ++total;
+        status = got ? spawn(argv, input, fileno(got), -1, NULL) : -1;
+        if (status != 0 || !sameContents(got, want))
+        {
+          printf("%-22s %s%s: %s\n", name, checkBackends[b], flags, status != 0 ? "fails" : "differs");
+          ++failures;
+        }
+        if (got)
+          fclose(got);
+      }
+    if (want)
+      fclose(want);
+    free(expected);
+    free(input);
+  }
+  printf("%d of %d runs of %d programs failed\n", failures, total, count);
+  return failures;
+}
+
+static void readBaseline(void)
+{
+  FILE *f = fopen(baselineFile, "r");
+  char line[256];
+  if (f == NULL)
+    return;
+  while (fgets(line, sizeof line, f) && baselineCount < MAX_PROGRAMS)
+  {
+    Result *b = &baseline[baselineCount];
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%63s %lf %ld %ld %llu %llu", b->name, &b->compileMs, &b->rssKb,
+               &b->tmBytes, &b->instructions, &b->cycles) == 6)
+      ++baselineCount;
+  }
+  fclose(f);
+}
+
+static int writeBaseline(void)
+{
+  FILE *f = fopen(baselineFile, "w");
+  if (f == NULL)
+  {
+    fprintf(stderr, "runbench: unable to open %s\n", baselineFile);
+    return 0;
+  }
+  fprintf(f, "# %-20s %10s %8s %8s %14s %14s\n", "name", "compile_ms", "rss_kb", "tm_bytes", "instructions", "cycles");
+  for (int i = 0; i < resultCount; ++i)
+  {
+    Result *r = &results[i];
+    fprintf(f, "%-22s %10.2f %8ld %8ld %14llu %14llu\n", r->name, r->compileMs, r->rssKb,
+            r->tmBytes, r->instructions, r->cycles);
+  }
+  fclose(f);
+  return 1;
+}
+
+static Result *findBaseline(const char *name)
+{
+  for (int i = 0; i < baselineCount; ++i)
+    if (!strcmp(baseline[i].name, name))
+      return &baseline[i];
+  return NULL;
+}
+
+static double change(double now, double before)
+{
+  return before > 0 ? (now - before) * 100.0 / before : 0.0;
+}
+
+/* Function compare prints every result next to its
+ * baseline. The code size and the counts of the
+ * simulator are exact, so any increase of those is a
+ * regression. Time and memory depend on the host, so
+ * they are only compared with the reference compiler
+ * run on the same host, and allowed to exceed it by
+ * the tolerance. Without a reference they are shown
+ * against the baseline but never a regression.
+ * Returns the number of regressions */
+static int compare(void)
+{
+  int regressions = 0;
+  printf("%-22s %12s %10s %10s %10s %9s %10s %14s %10s\n", "name", "compile_ms", "", "rss_kb", "",
+         "tm_bytes", "", "instructions", "");
+  for (int i = 0; i < resultCount; ++i)
+  {
+    Result *r = &results[i], *b = findBaseline(r->name), *host = reference ? &references[i] : b;
+    const char *flags[4] = {"  ", "  ", "  ", "  "};
+    if (b == NULL)
+    {
+      printf("%-22s %12.2f %10s %10ld %10s %9ld %10s %14llu %10s\n", r->name, r->compileMs, "new",
+             r->rssKb, "", r->tmBytes, "", r->instructions, "");
+      continue;
+    }
+    if (reference && change(r->compileMs, host->compileMs) > tolerance &&
+        r->compileMs - host->compileMs > TIME_NOISE_MS)
+      flags[0] = " !";
+    if (reference && change((double)r->rssKb, (double)host->rssKb) > tolerance &&
+        r->rssKb - host->rssKb > RSS_NOISE_KB)
+      flags[1] = " !";
+    if (r->tmBytes > b->tmBytes)
+      flags[2] = " !";
+    if (r->instructions > b->instructions || r->cycles > b->cycles)
+      flags[3] = " !";
+    for (int f = 0; f < 4; ++f)
+      if (flags[f][1] == '!')
+        ++regressions;
+    printf("%-22s %12.2f %+7.1f%%%s %10ld %+7.1f%%%s %9ld %+7.1f%%%s %14llu %+7.1f%%%s\n", r->name,
+           r->compileMs, change(r->compileMs, host->compileMs), flags[0],
+           r->rssKb, change((double)r->rssKb, (double)host->rssKb), flags[1],
+           r->tmBytes, change((double)r->tmBytes, (double)b->tmBytes), flags[2],
+           r->instructions, change((double)r->instructions, (double)b->instructions), flags[3]);
+  }
+  if (reference)
+    printf("\ncompile_ms and rss_kb against %s\n", reference);
+  if (regressions)
+    printf("\n%d regressions against %s (marked !)\n", regressions, baselineFile);
+  return regressions;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: runbench [-c compiler] [-r reference] [-b baseline] [-n runs] [-t tolerance] [-p] [-P] [-u] [-i] [-x] program.cmin...\n");
+  fprintf(stderr, "  -r  compare compile time and memory with the reference compiler\n");
+  fprintf(stderr, "  -p  print the time of each compiler phase\n");
+  fprintf(stderr, "  -P  print the hardware counters of each compiler phase\n");
+  fprintf(stderr, "  -u  write the results as the new baseline\n");
+  fprintf(stderr, "  -i  only compare the run time in the simulator and the bytecode interpreter\n");
+  fprintf(stderr, "  -x  only check the output of the programs against their .expected files\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int failed = 0;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    if (!strcmp(argv[i], "-u"))
+      update = 1;
+    else if (!strcmp(argv[i], "-p"))
+      showPhases = 1;
+    else if (!strcmp(argv[i], "-P"))
+      showPhases = perfCounters = 1;
+    else if (!strcmp(argv[i], "-i"))
+      interpreters = 1;
+    else if (!strcmp(argv[i], "-x"))
+      checks = 1;
+    else if (i + 1 >= argc)
+      usage();
+    else if (!strcmp(argv[i], "-c"))
+      compiler = argv[++i];
+    else if (!strcmp(argv[i], "-r"))
+      reference = argv[++i];
+    else if (!strcmp(argv[i], "-b"))
+      baselineFile = argv[++i];
+    else if (!strcmp(argv[i], "-n") && (runs = atoi(argv[++i])) > 0)
+      ;
+    else if (!strcmp(argv[i], "-t"))
+      tolerance = atof(argv[++i]);
+    else
+      usage();
+  }
+  if (i == argc)
+    usage();
+  if (interpreters)
+    return compareInterpreters(argv + i, argc - i) ? 1 : 0;
+  if (checks)
+    return checkPrograms(argv + i, argc - i) ? 1 : 0;
+  for (; i < argc && resultCount < MAX_PROGRAMS; ++i)
+  {
+    if (measure(argv[i], &results[resultCount], reference ? &references[resultCount] : NULL))
+      ++resultCount;
+    else
+      failed = 1;
+  }
+  if (showPhases)
+  {
+    if (perfCounters)
+      printf("Phases: %-13s %10s %14s %14s %14s %14s\n", "", "wall ms", "cycles", "instructions",
+             "branch misses", "LLC misses");
+    else
+      printf("Wall time of the phases in ms:\n");
+    for (int r = 0; r < resultCount; ++r)
+      printPhases(results[r].source, results[r].name);
+    printf("\n");
+  }
+  if (update)
+    return writeBaseline() && !failed ? 0 : 1;
+  readBaseline();
+  return compare() || failed ? 1 : 0;
+}
@@ -10,6 +10,7 @@
 #include "globals.h"
 #include "symtab.h"
 #include "analyze.h"
+#include "timeline.h"
 
 /* Returns the minimum of two arguments */
 static int min(int a, int b)
@@ -120,6 +121,9 @@ static void insertNode(TreeNode *t)
         insertNode(t->child[0]); /* This takes care of arguments */
         --flag_callArguments;
         break;
+      case InlineK: /* inlining and loop optimization run after analysis */
+      case TempK:
+        break;
       }
       break;
     case DeclK:
@@ -139,6 +143,7 @@ static void insertNode(TreeNode *t)
           node_currentFunction->symbol->memloc = min(node_currentFunction->symbol->memloc, t->symbol->memloc);
         break;
       case FunDeclK:
+        beginSpan("symbol table", t->attr.name);
         node_currentFunction = t;
         registerSymbol(t, Function, FALSE, t->child[0]->type);
         incrementScope();
@@ -151,6 +156,7 @@ static void insertNode(TreeNode *t)
         insertNode(t->child[2]); /* This child takes care of function body */
         decrementScope();
         node_currentFunction = NULL;
+        endSpan();
         break;
       }
     case TypeK:
@@ -406,6 +412,9 @@ void typeCheck(TreeNode *t)
         checkArguments(t->symbol->treeNode, t);
         t->type = t->symbol->treeNode->type;
         break;
+      case InlineK:
+      case TempK:
+        break;
       }
       break;
     case DeclK:
@@ -423,6 +432,7 @@ void typeCheck(TreeNode *t)
         typeCheck(t->child[1]);
         break;
       case FunDeclK:
+        beginSpan("type checking", t->attr.name);
         node_currentFunction = t;
         flag_functionReturned = FALSE;
         typeCheck(t->child[0]);
@@ -432,6 +442,7 @@ void typeCheck(TreeNode *t)
         if (!flag_functionReturned && t->type == Integer)
           semanticError(t, "An integer function does not have a return statement");
         node_currentFunction = NULL;
+        endSpan();
         break;
       }
     case TypeK:
@@ -0,0 +1,715 @@
+/****************************************************/
+/* File: bcgen.c                                    */
+/* The register bytecode generator                  */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <stdint.h>
+#include "globals.h"
+#include "cgen.h"
+#include "bcgen.h"
+#include "bytecode.h"
+#include "bounds.h"
+#include "phase.h"
+#include "timeline.h"
+
+#define getName(node) (node->symbol->treeNode->attr.name)
+
+/* Parameters beyond the registered ones are above the
+ * control link on MIPS, from offset 4 on */
+enum
+{
+  REGISTER_ARGUMENTS = 4
+};
+
+typedef struct
+{
+  BcOp op;
+  int operand[BC_MAX_OPERANDS];
+} Instruction;
+
+/* The instructions of the current function. Jumps
+ * hold a label number until the function is done */
+static Instruction *instructions;
+static int instructionCount;
+static int instructionCapacity;
+static int *labels;
+static int labelCount;
+static int labelCapacity;
+
+static int parameterCount;
+static int frameBottom;    /* memloc of the lowest local */
+static int firstTemporary; /* register of temporary 0 */
+static int top;            /* first free register */
+static int registers;      /* registers used by the function */
+static int inlineDepth;
+static int returnLabel;    /* end of the inlined body */
+static int inlineResult;   /* register of its value */
+
+/* Globals and functions by symbol: the address of a
+ * global, the index of a function */
+typedef struct
+{
+  BucketList symbol;
+  int value;
+} Binding;
+static Binding *bindings;
+static unsigned int bindingMask;
+
+static void gen(TreeNode *node);
+static int genExp(TreeNode *node, int target);
+
+static unsigned int bindingSlot(BucketList symbol)
+{
+  return (unsigned int)(((uintptr_t)symbol >> 4) * 2654435761u) & bindingMask;
+}
+
+static void bind(BucketList symbol, int value)
+{
+  unsigned int i = bindingSlot(symbol);
+  while (bindings[i].symbol)
+    i = (i + 1) & bindingMask;
+  bindings[i].symbol = symbol;
+  bindings[i].value = value;
+}
+
+static int boundValue(BucketList symbol)
+{
+  unsigned int i = bindingSlot(symbol);
+  while (bindings[i].symbol != symbol)
+    i = (i + 1) & bindingMask;
+  return bindings[i].value;
+}
+
+/* Procedure putNumber writes a number to the code
+ * file in the variable-length form of bytecode.h */
+static void putNumber(int value)
+{
+  unsigned int zigzag = ((unsigned int)value << 1) ^ (value < 0 ? ~0u : 0u);
+  while (zigzag >= 0x80)
+  {
+    fputc((int)(zigzag & 0x7f) | 0x80, code);
+    zigzag >>= 7;
+  }
+  fputc((int)zigzag, code);
+}
+
+static void emit(BcOp op, int a, int b, int c)
+{
+  if (instructionCount == instructionCapacity)
+  {
+    instructionCapacity = instructionCapacity ? 2 * instructionCapacity : 256;
+    instructions = realloc(instructions, sizeof(Instruction) * instructionCapacity);
+  }
+  instructions[instructionCount].op = op;
+  instructions[instructionCount].operand[0] = a;
+  instructions[instructionCount].operand[1] = b;
+  instructions[instructionCount].operand[2] = c;
+  ++instructionCount;
+  countEvent(CountInstructions);
+}
+
+/* Function newLabel returns a new label number of
+ * the current function */
+static int newLabel(void)
+{
+  if (labelCount == labelCapacity)
+  {
+    labelCapacity = labelCapacity ? 2 * labelCapacity : 64;
+    labels = realloc(labels, sizeof(int) * labelCapacity);
+  }
+  return labelCount++;
+}
+
+static void placeLabel(int label)
+{
+  labels[label] = instructionCount;
+}
+
+/* Function allocRegister returns a free register
+ * above those of variables and temporaries. The
+ * caller frees it by setting top back */
+static int allocRegister(void)
+{
+  int r = top++;
+  if (top > registers)
+    registers = top;
+  return r;
+}
+
+/* Function variableRegister returns the register of
+ * a local variable or parameter */
+static int variableRegister(BucketList symbol)
+{
+  if (symbol->symbol_class == Parameter && symbol->is_registered_argument)
+    return symbol->memloc;
+  if (symbol->memloc > 0) /* stacked parameter */
+    return symbol->memloc / WORD_SIZE + REGISTER_ARGUMENTS - 1;
+  return parameterCount + (symbol->memloc - frameBottom) / WORD_SIZE;
+}
+
+static int temporaryRegister(TreeNode *node)
+{
+  return firstTemporary + node->attr.val;
+}
+
+/* Function isConst returns TRUE if node is a constant */
+static int isConst(TreeNode *node)
+{
+  return node->nodekind == ExpK && node->kind.exp == ConstK;
+}
+
+/* Function isRelational returns TRUE if op compares
+ * its operands */
+static int isRelational(TokenType op)
+{
+  return op == LT || op == LTE || op == GT || op == GTE || op == EQ || op == NEQ;
+}
+
+/* Function relation returns the offset of op among
+ * the comparing instructions, which follow the order
+ * LT, LE, GT, GE, EQ, NE */
+static int relation(TokenType op)
+{
+  switch (op)
+  {
+  case LT:
+    return 0;
+  case LTE:
+    return 1;
+  case GT:
+    return 2;
+  case GTE:
+    return 3;
+  case EQ:
+    return 4;
+  default: /* NEQ */
+    return 5;
+  }
+}
+
+/* Function assignsVariable returns TRUE if node
+ * may assign a local variable or parameter, which
+ * lives in a register */
+static int assignsVariable(TreeNode *node)
+{
+  for (; node; node = node->sibling)
+  {
+    if (node->nodekind == ExpK && node->kind.exp == AssignK && node->child[0]->kind.exp == VarK &&
+        node->child[0]->symbol->symbol_class != Global)
+      return TRUE;
+    if (node->nodekind == ExpK && node->kind.exp == InlineK)
+      return TRUE;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      if (assignsVariable(node->child[i]))
+        return TRUE;
+  }
+  return FALSE;
+}
+
+/* Procedure genInto evaluates node into register r */
+static void genInto(TreeNode *node, int r)
+{
+  int value = genExp(node, r);
+  if (value != r)
+    emit(BC_MOV, r, value, 0);
+}
+
+/* Function genOperand evaluates node, the first
+ * operand of an instruction whose other operand is
+ * later. The register of a variable is copied if
+ * evaluating later may assign it */
+static int genOperand(TreeNode *node, TreeNode *later)
+{
+  int value = genExp(node, -1);
+  if (value < firstTemporary && later && assignsVariable(later))
+  {
+    int copy = allocRegister();
+    emit(BC_MOV, copy, value, 0);
+    return copy;
+  }
+  return value;
+}
+
+/* Function resultRegister returns target, or a new
+ * register if there is no target */
+static int resultRegister(int target)
+{
+  return target >= 0 ? target : allocRegister();
+}
+
+/* Function genArrayAddress returns a register
+ * holding the address of the array of node. Array
+ * parameters hold the address in their register */
+static int genArrayAddress(TreeNode *node, int target)
+{
+  BucketList symbol = node->symbol;
+  int r;
+  if (symbol->symbol_class == Parameter)
+    return variableRegister(symbol);
+  r = resultRegister(target);
+  if (symbol->symbol_class == Global)
+    emit(BC_LOADK, r, boundValue(symbol), 0);
+  else
+    emit(BC_ADDR, r, variableRegister(symbol), 0);
+  return r;
+}
+
+/* Procedure genBoundsCheck stops the program if
+ * register index is outside the accessed array. An
+ * array parameter is checked against its length */
+static void genBoundsCheck(TreeNode *access, int index)
+{
+  if (!BoundsCheck || !needsBoundsCheck(access))
+    return;
+  if (access->symbol->length)
+    emit(BC_CHECKR, index, variableRegister(access->symbol->length), access->lineno);
+  else
+    emit(BC_CHECK, index, access->symbol->size, access->lineno);
+}
+
+/* Procedure genElementAddress computes the address
+ * of the element accessed by node into register r,
+ * the temporary that keeps it */
+static void genElementAddress(TreeNode *node, int r)
+{
+  int mark = top;
+  int index = genExp(node->child[0], -1);
+  int base;
+  genBoundsCheck(node, index);
+  if (node->child[1]) /* base hoisted to a temporary */
+    base = temporaryRegister(node->child[1]);
+  else
+    base = genArrayAddress(node, -1);
+  emit(BC_ADD, r, base, index);
+  top = mark;
+}
+
+/* Function genElement loads the element accessed by
+ * node, with one indexed instruction unless the
+ * element address is kept in a temporary */
+static int genElement(TreeNode *node, int target)
+{
+  BucketList symbol = node->symbol;
+  int mark = top, index, r;
+  if (node->child[0] == NULL || node->child[2])
+  {
+    int address = temporaryRegister(node->child[2]);
+    if (node->child[0])
+      genElementAddress(node, address);
+    r = resultRegister(target);
+    emit(BC_LD, r, address, 0);
+    return r;
+  }
+  index = genExp(node->child[0], -1);
+  genBoundsCheck(node, index);
+  top = mark;
+  r = resultRegister(target);
+  if (node->child[1])
+    emit(BC_LDX, r, temporaryRegister(node->child[1]), index);
+  else if (symbol->symbol_class == Parameter)
+    emit(BC_LDX, r, variableRegister(symbol), index);
+  else if (symbol->symbol_class == Global)
+    emit(BC_LDXG, r, boundValue(symbol), index);
+  else
+    emit(BC_LDXL, r, variableRegister(symbol), index);
+  return r;
+}
+
+/* Function genAssign stores the value of the right
+ * hand side and returns its register. An element
+ * address is computed first, as the MIPS code
+ * generator does */
+static int genAssign(TreeNode *node)
+{
+  TreeNode *LHS = node->child[0], *RHS = node->child[1];
+  BucketList symbol = LHS->symbol;
+  int index, value;
+  if (LHS->kind.exp == VarK)
+  {
+    if (symbol->symbol_class != Global)
+    {
+      genInto(RHS, variableRegister(symbol));
+      return variableRegister(symbol);
+    }
+    value = genExp(RHS, -1);
+    emit(BC_STG, boundValue(symbol), value, 0);
+    return value;
+  }
+  if (LHS->child[0] == NULL || LHS->child[2])
+  {
+    int address = temporaryRegister(LHS->child[2]);
+    if (LHS->child[0])
+      genElementAddress(LHS, address);
+    value = genExp(RHS, -1);
+    emit(BC_ST, address, value, 0);
+    return value;
+  }
+  index = genOperand(LHS->child[0], RHS);
+  genBoundsCheck(LHS, index);
+  value = genExp(RHS, -1);
+  if (LHS->child[1])
+    emit(BC_STX, temporaryRegister(LHS->child[1]), index, value);
+  else if (symbol->symbol_class == Parameter)
+    emit(BC_STX, variableRegister(symbol), index, value);
+  else if (symbol->symbol_class == Global)
+    emit(BC_STXG, boundValue(symbol), index, value);
+  else
+    emit(BC_STXL, variableRegister(symbol), index, value);
+  return value;
+}
+
+/* Function genOp generates code for an operator.
+ * Additions, subtractions, multiplications and
+ * divisions by a constant take it as an operand */
+static int genOp(TreeNode *node, int target)
+{
+  static const BcOp arithmetic[] = {BC_ADD, BC_SUB, BC_MUL, BC_DIV};
+  TreeNode *left = node->child[0], *right = node->child[1];
+  TokenType op = node->attr.op;
+  int mark = top, a, b, r;
+  BcOp instruction;
+  if ((op == PLUS || op == TIMES) && isConst(left) && !isConst(right))
+  {
+    TreeNode *temp = left;
+    left = right;
+    right = temp;
+  }
+  if (isConst(right) && (op == PLUS || op == MINUS || op == TIMES ||
+                         (op == OVER && right->attr.val != 0 && right->attr.val != -1)))
+  {
+    int k = right->attr.val;
+    a = genExp(left, -1);
+    top = mark;
+    r = resultRegister(target);
+    if (op == MINUS)
+      emit(BC_ADDK, r, a, (int)(0u - (unsigned int)k));
+    else
+      emit(op == PLUS ? BC_ADDK : op == TIMES ? BC_MULK : BC_DIVK, r, a, k);
+    return r;
+  }
+  if (isRelational(op))
+    instruction = BC_LT + relation(op);
+  else
+    instruction = arithmetic[op == PLUS ? 0 : op == MINUS ? 1 : op == TIMES ? 2 : 3];
+  a = genOperand(left, right);
+  b = genExp(right, -1);
+  top = mark;
+  r = resultRegister(target);
+  emit(instruction, r, a, b);
+  return r;
+}
+
+/* Procedure genBranch generates code that jumps to
+ * label if the condition node is nonzero, or if it
+ * is zero when sense is FALSE. Comparisons jump on
+ * their operands directly, against a constant if
+ * one is */
+static void genBranch(TreeNode *node, int label, int sense)
+{
+  TreeNode *left = node->child[0], *right = node->child[1];
+  TokenType op = node->attr.op;
+  int mark = top, a;
+  if (node->kind.exp != OpK || !isRelational(op))
+  {
+    emit(sense ? BC_JNZ : BC_JZ, genExp(node, -1), label, 0);
+    top = mark;
+    return;
+  }
+  if (isConst(left) && !isConst(right))
+  { /* keep the constant on the right: c < x is x > c */
+    TreeNode *temp = left;
+    left = right;
+    right = temp;
+    op = op == LT ? GT : op == GT ? LT : op == LTE ? GTE : op == GTE ? LTE : op;
+  }
+  if (!sense)
+    op = op == LT ? GTE : op == GTE ? LT : op == LTE ? GT : op == GT ? LTE : op == EQ ? NEQ : EQ;
+  a = genOperand(left, right);
+  if (isConst(right))
+    emit(BC_JLTK + relation(op), a, right->attr.val, label);
+  else
+    emit(BC_JLT + relation(op), a, genExp(right, -1), label);
+  top = mark;
+}
+
+/* Function genArguments evaluates the arguments of
+ * the call node into consecutive new registers and
+ * returns the first. The first is an operand of the
+ * call, so it is a register of the frame even if the
+ * callee takes no arguments */
+static int genArguments(TreeNode *node)
+{
+  TreeNode *args;
+  int base = top, i;
+  top += node->symbol->size;
+  if (top > registers)
+    registers = top;
+  if (base >= registers)
+    registers = base + 1;
+  for (i = 0, args = node->child[0]; args; ++i, args = args->sibling)
+  {
+    genInto(args, base + i);
+    top = base + node->symbol->size;
+  }
+  return base;
+}
+
+/* Function genCall generates a call. The frame of
+ * the callee starts at the first argument, so the
+ * arguments become its parameters in place */
+static int genCall(TreeNode *node, int target)
+{
+  int base, r;
+  if (!strcmp("input", getName(node)))
+  {
+    r = resultRegister(target);
+    emit(BC_IN, r, 0, 0);
+    return r;
+  }
+  if (!strcmp("output", getName(node)))
+  {
+    r = genExp(node->child[0], -1);
+    emit(BC_OUT, r, 0, 0);
+    return r;
+  }
+  base = genArguments(node);
+  top = base;
+  r = resultRegister(target);
+  emit(BC_CALL, r, boundValue(node->symbol), base);
+  return r;
+}
+
+/* Function isTailCall returns TRUE if the returned
+ * expression node is a call that can reuse the frame
+ * of the current function. The callee gets all the
+ * registers it needs on entry, but no argument may
+ * point into the frame it overwrites */
+static int isTailCall(TreeNode *node)
+{
+  return OptimizeTailCalls && node->kind.exp == CallK && strcmp(getName(node), "input") &&
+         strcmp(getName(node), "output") && !passesFrameAddress(node);
+}
+
+/* Procedure genStmt generates code at a statement node */
+static void genStmt(TreeNode *node)
+{
+  switch (node->kind.stmt)
+  {
+  case CompoundK:
+    gen(node->child[1]);
+    break;
+  case SelectionK:
+  {
+    int followingLabel = newLabel();
+    if (node->child[2])
+    {
+      int elseLabel = newLabel();
+      genBranch(node->child[0], elseLabel, FALSE);
+      gen(node->child[1]);
+      emit(BC_JMP, followingLabel, 0, 0);
+      placeLabel(elseLabel);
+      gen(node->child[2]);
+    }
+    else
+    {
+      genBranch(node->child[0], followingLabel, FALSE);
+      gen(node->child[1]);
+    }
+    placeLabel(followingLabel);
+    break;
+  }
+  case IterationK:
+  { /* the condition is tested at the bottom, so
+     * that an iteration takes one branch */
+    int bodyLabel = newLabel();
+    int conditionLabel = newLabel();
+    gen(node->child[2]); /* preheader */
+    emit(BC_JMP, conditionLabel, 0, 0);
+    placeLabel(bodyLabel);
+    gen(node->child[1]);
+    placeLabel(conditionLabel);
+    genBranch(node->child[0], bodyLabel, TRUE);
+    break;
+  }
+  case ReturnK:
+    if (inlineDepth)
+    {
+      genInto(node->child[0], inlineResult);
+      emit(BC_JMP, returnLabel, 0, 0);
+    }
+    else if (isTailCall(node->child[0]))
+      emit(BC_TAILCALL, boundValue(node->child[0]->symbol), genArguments(node->child[0]), 0);
+    else
+      emit(BC_RET, genExp(node->child[0], -1), 0, 0);
+    break;
+  }
+}
+
+/* Function genExp generates code at an expression
+ * node and returns the register of its value. The
+ * value is computed into target if it is not -1,
+ * but a variable or temporary is returned as it is */
+static int genExp(TreeNode *node, int target)
+{
+  int r;
+  switch (node->kind.exp)
+  {
+  case AssignK:
+    return genAssign(node);
+  case OpK:
+    return genOp(node, target);
+  case ConstK:
+    r = resultRegister(target);
+    emit(BC_LOADK, r, node->attr.val, 0);
+    return r;
+  case VarK:
+    if (node->symbol->is_array)
+      return genArrayAddress(node, target);
+    if (node->symbol->symbol_class != Global)
+      return variableRegister(node->symbol);
+    r = resultRegister(target);
+    emit(BC_LDG, r, boundValue(node->symbol), 0);
+    return r;
+  case ArrK:
+    return genElement(node, target);
+  case CallK:
+    return genCall(node, target);
+  case InlineK:
+  {
+    /* Store arguments to the parameter registers in
+     * this frame and run the copied body. Its return
+     * statements jump to the end of the body */
+    TreeNode *args, *params;
+    int savedReturnLabel = returnLabel, savedResult = inlineResult;
+    int mark = top;
+    for (args = node->child[0], params = node->child[2]; args; args = args->sibling, params = params->sibling)
+    {
+      genInto(args, variableRegister(params->symbol));
+      top = mark;
+    }
+    r = resultRegister(target);
+    returnLabel = newLabel();
+    inlineResult = r;
+    ++inlineDepth;
+    gen(node->child[1]);
+    --inlineDepth;
+    placeLabel(returnLabel);
+    returnLabel = savedReturnLabel;
+    inlineResult = savedResult;
+    return r;
+  }
+  case TempK:
+    if (node->child[0])
+      genInto(node->child[0], temporaryRegister(node));
+    return temporaryRegister(node);
+  }
+  return 0;
+}
+
+/* Procedure gen generates code for node and its
+ * siblings, freeing the registers of each */
+static void gen(TreeNode *node)
+{
+  for (; node; node = node->sibling)
+  {
+    int mark = top;
+    if (node->nodekind == StmtK)
+      genStmt(node);
+    else if (node->nodekind == ExpK)
+      genExp(node, -1);
+    top = mark;
+  }
+}
+
+/* Procedure writeFunction resolves the labels of
+ * the current function and writes it */
+static void writeFunction(void)
+{
+  putNumber(registers);
+  putNumber(parameterCount);
+  putNumber(instructionCount);
+  for (int i = 0; i < instructionCount; ++i)
+  {
+    const char *format = bcFormat(instructions[i].op);
+    putNumber(instructions[i].op);
+    for (int j = 0; format[j]; ++j)
+      putNumber(format[j] == 'L' ? labels[instructions[i].operand[j]] : instructions[i].operand[j]);
+  }
+}
+
+static void genFunDecl(TreeNode *node)
+{
+  long firstInstruction = eventCounts[CountInstructions];
+  beginSpan("code generation", getName(node));
+  parameterCount = node->symbol->size;
+  frameBottom = node->symbol->memloc;
+  firstTemporary = parameterCount + (-WORD_SIZE - frameBottom) / WORD_SIZE;
+  top = registers = firstTemporary + countTemporaries(node->child[2]);
+  instructionCount = labelCount = 0;
+  inlineDepth = 0;
+  gen(node->child[2]->child[1]);
+  if (registers == 0)
+    registers = 1;
+  emit(BC_RET, 0, 0, 0); /* falling off the end */
+  writeFunction();
+  endSpanWith("instructions", eventCounts[CountInstructions] - firstInstruction);
+}
+
+/**********************************************/
+/* the primary function of the code generator */
+/**********************************************/
+/* Procedure codeGenBytecode generates register
+ * bytecode to the code file
+ */
+void codeGenBytecode(TreeNode *syntaxTree, char *codefile)
+{
+  TreeNode *node;
+  int declarations = 0, globalWords = 0, functions = 0, mainIndex = 0;
+  unsigned int capacity = 16;
+  (void)codefile;
+  for (node = syntaxTree; node; node = node->sibling)
+    ++declarations;
+  while (capacity < 2u * declarations)
+    capacity *= 2;
+  bindings = calloc(capacity, sizeof(Binding));
+  bindingMask = capacity - 1;
+  for (node = syntaxTree; node; node = node->sibling)
+  {
+    if (node->nodekind != DeclK)
+      continue;
+    switch (node->kind.decl)
+    {
+    case VarDeclK:
+      bind(node->symbol, globalWords);
+      globalWords += 1;
+      break;
+    case ArrDeclK:
+      bind(node->symbol, globalWords);
+      globalWords += node->child[1]->attr.val;
+      break;
+    case FunDeclK:
+      if (!strcmp(getName(node), "main"))
+        mainIndex = functions;
+      bind(node->symbol, functions++);
+      break;
+    }
+  }
+  fwrite(BC_MAGIC, 1, BC_MAGIC_SIZE, code);
+  putNumber(BC_VERSION);
+  putNumber((BatchInput ? 0 : BC_FLAG_PROMPT) | (BufferOutput ? 0 : BC_FLAG_UNBUFFERED));
+  putNumber(globalWords);
+  putNumber(functions);
+  putNumber(mainIndex);
+  for (node = syntaxTree; node; node = node->sibling)
+    if (node->nodekind == DeclK && node->kind.decl == FunDeclK)
+      genFunDecl(node);
+  free(instructions);
+  free(labels);
+  free(bindings);
+  instructions = NULL;
+  labels = NULL;
+  bindings = NULL;
+  instructionCapacity = labelCapacity = 0;
+}
@@ -0,0 +1,19 @@
+/****************************************************/
+/* File: bcgen.h                                    */
+/* The register bytecode generator                  */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _BCGEN_H_
+#define _BCGEN_H_
+
+/* Procedure codeGenBytecode generates the register
+ * bytecode of bytecode.h to the code file, which
+ * must be open for binary output. The second
+ * parameter (codefile) is the file name of the code
+ * file
+ */
+void codeGenBytecode(TreeNode *syntaxTree, char *codefile);
+
+#endif
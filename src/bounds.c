@@ -0,0 +1,716 @@
+/****************************************************/
+/* File: bounds.c                                   */
+/* Range analysis for array bounds checking         */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <limits.h>
+#include <stdint.h>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "bounds.h"
+
+/* Loops are iterated this many times before
+ * growing bounds are widened to infinity */
+enum
+{
+  WIDEN_AFTER = 3
+};
+
+/* A range of integer values [lo, hi] */
+typedef struct
+{
+  long long lo, hi;
+} Range;
+
+static const Range fullRange = {INT_MIN, INT_MAX};
+
+/* Abstract state at a program point: a range for
+ * every tracked scalar and every temporary register */
+typedef struct
+{
+  int reachable;
+  Range range[];
+} * State;
+
+/* Scalars of the current function, indexed through
+ * an open-addressing hash table */
+static BucketList *varTable;
+static int *varIndex;
+static int varMask;
+static int varCount;
+static int stateSize; /* varCount + NUM_TEMPORARIES */
+
+/* Array accesses whose index may be out of range */
+static TreeNode **unsafeTable;
+static int unsafeMask;
+static int unsafeCount;
+
+/* Exit state of the inlined bodies being analyzed */
+static State inlineExit;
+static int inlineDepth;
+
+static int checksEmitted, checksEliminated;
+
+/**************************************************/
+/***********   Lengths of array params  ***********/
+/**************************************************/
+
+/* Function newLength returns a parameter holding the
+ * length of the array parameter param, to be
+ * declared right after it */
+static TreeNode *newLength(TreeNode *param)
+{
+  TreeNode *length = newParamNode(VarParamK);
+  BucketList symbol = malloc(sizeof(struct BucketListRec));
+  addPtr(symbol);
+  length->lineno = param->lineno;
+  length->type = Integer;
+  length->attr.name = malloc(strlen(param->attr.name) + 8);
+  addPtr(length->attr.name);
+  sprintf(length->attr.name, "%s.length", param->attr.name);
+  length->child[0] = newTypeNode(TypeGeneralK);
+  length->child[0]->type = Integer;
+  *symbol = *param->symbol;
+  symbol->lines = NULL;
+  symbol->is_array = FALSE;
+  symbol->treeNode = length;
+  symbol->next = NULL;
+  length->symbol = symbol;
+  param->symbol->length = symbol;
+  return length;
+}
+
+/* Procedure addLengths declares the length of each
+ * array parameter of function, and places the
+ * parameters again as analyze does */
+static void addLengths(TreeNode *function)
+{
+  BucketList f = function->symbol;
+  for (TreeNode *p = function->child[1]; p; p = p->sibling)
+    if (p->kind.param == ArrParamK)
+    {
+      TreeNode *length = newLength(p);
+      length->sibling = p->sibling;
+      p->sibling = length;
+      p = length;
+    }
+  f->size = 0;
+  for (TreeNode *p = function->child[1]; p; p = p->sibling)
+    if (p->kind.param != VoidParamK)
+    {
+      ++f->size;
+      p->symbol->is_registered_argument = f->size < 5;
+      p->symbol->memloc = f->size < 5 ? f->size - 1 : (f->size - 4) * WORD_SIZE;
+    }
+}
+
+/* Function lengthArgument returns the expression of
+ * the length of the array argument arg: its size,
+ * or the length passed with a parameter */
+static TreeNode *lengthArgument(TreeNode *arg)
+{
+  TreeNode *length;
+  if (arg->symbol->symbol_class == Parameter)
+  {
+    length = newExpNode(VarK);
+    length->symbol = arg->symbol->length;
+    length->attr.name = length->symbol->treeNode->attr.name;
+  }
+  else
+  {
+    length = newExpNode(ConstK);
+    length->attr.val = arg->symbol->size;
+  }
+  length->lineno = arg->lineno;
+  length->type = Integer;
+  return length;
+}
+
+/* Procedure addLengthArguments passes the length of
+ * every array argument of the calls in t and its
+ * siblings */
+static void addLengthArguments(TreeNode *t)
+{
+  for (; t; t = t->sibling)
+  {
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      addLengthArguments(t->child[i]);
+    if (t->nodekind == ExpK && t->kind.exp == CallK)
+    {
+      TreeNode *p = t->symbol->treeNode->child[1], *arg = t->child[0];
+      for (; p && arg; p = p->sibling, arg = arg->sibling)
+        if (p->kind.param == ArrParamK)
+        {
+          TreeNode *length = lengthArgument(arg);
+          length->sibling = arg->sibling;
+          arg->sibling = length;
+          arg = length;
+          p = p->sibling;
+        }
+    }
+  }
+}
+
+/* Procedure passArrayLengths gives every array
+ * parameter a parameter holding its length, which
+ * each call passes along with the array
+ */
+void passArrayLengths(TreeNode *syntaxTree)
+{
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+    if (t->nodekind == DeclK && t->kind.decl == FunDeclK)
+      addLengths(t);
+  addLengthArguments(syntaxTree);
+}
+
+/**************************************************/
+/***********   Ranges and states        ***********/
+/**************************************************/
+
+static Range makeRange(long long lo, long long hi)
+{
+  Range r;
+  if (lo < INT_MIN || hi > INT_MAX) /* may wrap around */
+    return fullRange;
+  r.lo = lo;
+  r.hi = hi;
+  return r;
+}
+
+static long long min4(long long a, long long b, long long c, long long d)
+{
+  long long m = a < b ? a : b;
+  m = m < c ? m : c;
+  return m < d ? m : d;
+}
+
+static long long max4(long long a, long long b, long long c, long long d)
+{
+  long long m = a > b ? a : b;
+  m = m > c ? m : c;
+  return m > d ? m : d;
+}
+
+/* Function opRange returns the range of a op b */
+static Range opRange(TokenType op, Range a, Range b)
+{
+  switch (op)
+  {
+  case PLUS:
+    return makeRange(a.lo + b.lo, a.hi + b.hi);
+  case MINUS:
+    return makeRange(a.lo - b.hi, a.hi - b.lo);
+  case TIMES:
+    return makeRange(min4(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi),
+                     max4(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi));
+  case OVER:
+    if (b.lo <= 0 && b.hi >= 0)
+      return fullRange;
+    return makeRange(min4(a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi),
+                     max4(a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi));
+  default: /* comparisons */
+    return makeRange(0, 1);
+  }
+}
+
+static State newState(void)
+{
+  State s = malloc(sizeof(*s) + sizeof(Range) * stateSize);
+  s->reachable = TRUE;
+  for (int i = 0; i < stateSize; ++i)
+    s->range[i] = fullRange;
+  return s;
+}
+
+static State copyState(State s)
+{
+  State copy = malloc(sizeof(*s) + sizeof(Range) * stateSize);
+  memcpy(copy, s, sizeof(*s) + sizeof(Range) * stateSize);
+  return copy;
+}
+
+static void assignState(State to, State from)
+{
+  memcpy(to, from, sizeof(*from) + sizeof(Range) * stateSize);
+}
+
+/* Procedure joinState widens to so that it also
+ * covers every value allowed by from */
+static void joinState(State to, State from)
+{
+  if (!from->reachable)
+    return;
+  if (!to->reachable)
+  {
+    assignState(to, from);
+    return;
+  }
+  for (int i = 0; i < stateSize; ++i)
+  {
+    if (from->range[i].lo < to->range[i].lo)
+      to->range[i].lo = from->range[i].lo;
+    if (from->range[i].hi > to->range[i].hi)
+      to->range[i].hi = from->range[i].hi;
+  }
+}
+
+static int sameState(State a, State b)
+{
+  if (a->reachable != b->reachable)
+    return FALSE;
+  if (!a->reachable)
+    return TRUE;
+  for (int i = 0; i < stateSize; ++i)
+    if (a->range[i].lo != b->range[i].lo || a->range[i].hi != b->range[i].hi)
+      return FALSE;
+  return TRUE;
+}
+
+/* Procedure widenState sets every bound of head
+ * that next pushes further out to infinity */
+static void widenState(State head, State next)
+{
+  if (!head->reachable)
+  {
+    assignState(head, next);
+    return;
+  }
+  for (int i = 0; i < stateSize; ++i)
+  {
+    if (next->range[i].lo < head->range[i].lo)
+      head->range[i].lo = INT_MIN;
+    if (next->range[i].hi > head->range[i].hi)
+      head->range[i].hi = INT_MAX;
+  }
+}
+
+/**************************************************/
+/***********   Tracked variables        ***********/
+/**************************************************/
+
+static int varSlot(BucketList symbol)
+{
+  int slot = (int)(((uintptr_t)symbol >> 4) & varMask);
+  while (varTable[slot] && varTable[slot] != symbol)
+    slot = (slot + 1) & varMask;
+  return slot;
+}
+
+static int isScalar(BucketList symbol)
+{
+  return symbol && !symbol->is_array && symbol->symbol_class != Global && symbol->symbol_class != Function;
+}
+
+/* Function collectVars enters the scalars of t and
+ * its siblings into the table, or only counts them
+ * if the table is not allocated yet */
+static int collectVars(TreeNode *t)
+{
+  int count = 0;
+  for (; t; t = t->sibling)
+  {
+    if ((t->nodekind == ExpK && t->kind.exp == VarK) ||
+        (t->nodekind == DeclK && t->kind.decl == VarDeclK) ||
+        (t->nodekind == ParamK && t->kind.param == VarParamK))
+    {
+      if (isScalar(t->symbol))
+      {
+        ++count;
+        if (varTable)
+        {
+          int slot = varSlot(t->symbol);
+          if (varTable[slot] == NULL)
+          {
+            varTable[slot] = t->symbol;
+            varIndex[slot] = varCount++;
+          }
+        }
+      }
+    }
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      count += collectVars(t->child[i]);
+  }
+  return count;
+}
+
+/* Function varOf returns the state index of the
+ * variable or temporary read by t, or -1 */
+static int varOf(TreeNode *t)
+{
+  if (t->nodekind != ExpK)
+    return -1;
+  if (t->kind.exp == TempK)
+    return varCount + t->attr.val;
+  if (t->kind.exp == VarK && isScalar(t->symbol))
+  {
+    int slot = varSlot(t->symbol);
+    return varTable[slot] ? varIndex[slot] : -1;
+  }
+  return -1;
+}
+
+/**************************************************/
+/***********   Array accesses           ***********/
+/**************************************************/
+
+static int unsafeSlot(TreeNode *access)
+{
+  int slot = (int)(((uintptr_t)access >> 4) & unsafeMask);
+  while (unsafeTable[slot] && unsafeTable[slot] != access)
+    slot = (slot + 1) & unsafeMask;
+  return slot;
+}
+
+static void markUnsafe(TreeNode *access)
+{
+  int slot;
+  if (2 * (unsafeCount + 1) > unsafeMask + 1)
+  { /* grow the table */
+    TreeNode **old = unsafeTable;
+    int oldSize = unsafeMask + 1;
+    unsafeMask = 2 * oldSize - 1;
+    unsafeTable = calloc(unsafeMask + 1, sizeof(TreeNode *));
+    for (int i = 0; i < oldSize; ++i)
+      if (old[i])
+        unsafeTable[unsafeSlot(old[i])] = old[i];
+    free(old);
+  }
+  slot = unsafeSlot(access);
+  if (unsafeTable[slot] == NULL)
+  {
+    unsafeTable[slot] = access;
+    ++unsafeCount;
+  }
+}
+
+/* Procedure checkAccess records the access as unsafe
+ * if its index may fall outside the array. An array
+ * parameter is at least as long as the smallest
+ * value its length may have. States only grow while
+ * a loop is iterated, so an access unsafe in any
+ * visit is unsafe at the fixed point */
+static void checkAccess(TreeNode *access, Range index, State s)
+{
+  BucketList array = access->symbol;
+  long long size = array->size;
+  if (array->symbol_class == Parameter)
+  {
+    int slot = array->length ? varSlot(array->length) : 0;
+    size = array->length && varTable[slot] ? s->range[varIndex[slot]].lo : 0;
+  }
+  if (index.lo < 0 || index.hi >= size)
+    markUnsafe(access);
+}
+
+/**************************************************/
+/***********   Abstract interpretation  ***********/
+/**************************************************/
+
+static void execList(TreeNode *t, State s);
+
+/* Function evalExp returns the range of expression t
+ * and applies its assignments to state s */
+static Range evalExp(TreeNode *t, State s)
+{
+  Range r;
+  int var;
+  switch (t->kind.exp)
+  {
+  case ConstK:
+    return makeRange(t->attr.val, t->attr.val);
+  case VarK:
+  case TempK:
+    if (t->kind.exp == TempK && t->child[0])
+    { /* temporary set in a preheader */
+      r = evalExp(t->child[0], s);
+      s->range[varCount + t->attr.val] = r;
+      return r;
+    }
+    var = varOf(t);
+    return var >= 0 ? s->range[var] : fullRange;
+  case OpK:
+  {
+    Range a = evalExp(t->child[0], s);
+    Range b = evalExp(t->child[1], s);
+    return opRange(t->attr.op, a, b);
+  }
+  case ArrK:
+    if (t->child[0]) /* else the address was checked when first computed */
+      checkAccess(t, evalExp(t->child[0], s), s);
+    return fullRange;
+  case AssignK:
+    if (t->child[0]->kind.exp == ArrK && t->child[0]->child[0])
+      checkAccess(t->child[0], evalExp(t->child[0]->child[0], s), s);
+    r = evalExp(t->child[1], s);
+    if ((var = varOf(t->child[0])) >= 0)
+      s->range[var] = r;
+    return r;
+  case CallK: /* calls cannot change the locals of this frame */
+    for (TreeNode *arg = t->child[0]; arg; arg = arg->sibling)
+      evalExp(arg, s);
+    return fullRange;
+  case InlineK:
+  {
+    State savedExit = inlineExit;
+    TreeNode *arg, *param;
+    for (arg = t->child[0], param = t->child[2]; arg; arg = arg->sibling, param = param->sibling)
+    {
+      r = evalExp(arg, s);
+      if (param->kind.param == VarParamK && isScalar(param->symbol))
+      {
+        int slot = varSlot(param->symbol);
+        if (varTable[slot])
+          s->range[varIndex[slot]] = r;
+      }
+    }
+    inlineExit = newState();
+    inlineExit->reachable = FALSE;
+    ++inlineDepth;
+    execList(t->child[1], s);
+    --inlineDepth;
+    joinState(s, inlineExit);
+    free(inlineExit);
+    inlineExit = savedExit;
+    return fullRange;
+  }
+  }
+  return fullRange;
+}
+
+/* Procedure narrow narrows the variable of t in
+ * state s to the values satisfying t op r */
+static void narrow(TreeNode *t, TokenType op, Range r, State s)
+{
+  int var = varOf(t);
+  Range *v;
+  if (var < 0)
+    return;
+  v = &s->range[var];
+  switch (op)
+  {
+  case LT:
+    if (r.hi - 1 < v->hi)
+      v->hi = r.hi - 1;
+    break;
+  case LTE:
+    if (r.hi < v->hi)
+      v->hi = r.hi;
+    break;
+  case GT:
+    if (r.lo + 1 > v->lo)
+      v->lo = r.lo + 1;
+    break;
+  case GTE:
+    if (r.lo > v->lo)
+      v->lo = r.lo;
+    break;
+  case EQ:
+    if (r.lo > v->lo)
+      v->lo = r.lo;
+    if (r.hi < v->hi)
+      v->hi = r.hi;
+    break;
+  case NEQ:
+    if (r.lo == r.hi && r.lo == v->lo)
+      ++v->lo;
+    else if (r.lo == r.hi && r.lo == v->hi)
+      --v->hi;
+    break;
+  }
+  if (v->lo > v->hi)
+    s->reachable = FALSE;
+}
+
+/* Function assigns returns TRUE if evaluating t
+ * or its siblings may assign a variable */
+static int assigns(TreeNode *t)
+{
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == ExpK && (t->kind.exp == AssignK || t->kind.exp == InlineK))
+      return TRUE;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      if (assigns(t->child[i]))
+        return TRUE;
+  }
+  return FALSE;
+}
+
+/* Procedure refine narrows state s, in which the
+ * condition t was just evaluated, to the states
+ * where t is true (or false if truth is FALSE) */
+static void refine(TreeNode *t, int truth, State s)
+{
+  static const TokenType negated[][2] = {{LT, GTE}, {LTE, GT}, {GT, LTE}, {GTE, LT}, {EQ, NEQ}, {NEQ, EQ}};
+  static const TokenType mirrored[][2] = {{LT, GT}, {LTE, GTE}, {GT, LT}, {GTE, LTE}, {EQ, EQ}, {NEQ, NEQ}};
+  TokenType op, mirror = NEQ;
+  State probe;
+  Range left, right;
+  if (!s->reachable || assigns(t))
+    return;
+  if (t->kind.exp != OpK)
+  { /* plain value: nonzero when true */
+    narrow(t, truth ? NEQ : EQ, makeRange(0, 0), s);
+    return;
+  }
+  op = t->attr.op;
+  if (op == PLUS || op == MINUS || op == TIMES || op == OVER)
+    return;
+  if (!truth)
+    for (int i = 0; i < 6; ++i)
+      if (negated[i][0] == t->attr.op)
+        op = negated[i][1];
+  for (int i = 0; i < 6; ++i)
+    if (mirrored[i][0] == op)
+      mirror = mirrored[i][1];
+  /* operand ranges, without repeating side effects */
+  probe = copyState(s);
+  left = evalExp(t->child[0], probe);
+  right = evalExp(t->child[1], probe);
+  free(probe);
+  narrow(t->child[0], op, right, s);
+  if (s->reachable)
+    narrow(t->child[1], mirror, left, s);
+}
+
+/* Procedure execStmt applies statement t to state s */
+static void execStmt(TreeNode *t, State s)
+{
+  if (!s->reachable)
+    return;
+  if (t->nodekind == ExpK)
+  {
+    evalExp(t, s);
+    return;
+  }
+  if (t->nodekind != StmtK)
+    return;
+  switch (t->kind.stmt)
+  {
+  case CompoundK:
+    execList(t->child[1], s);
+    break;
+  case SelectionK:
+  {
+    State other;
+    evalExp(t->child[0], s);
+    other = copyState(s);
+    refine(t->child[0], TRUE, s);
+    execList(t->child[1], s);
+    refine(t->child[0], FALSE, other);
+    execList(t->child[2], other);
+    joinState(s, other);
+    free(other);
+    break;
+  }
+  case IterationK:
+  {
+    State head, next;
+    execList(t->child[2], s); /* preheader */
+    head = copyState(s);
+    next = newState();
+    for (int iteration = 0;; ++iteration)
+    {
+      assignState(next, head);
+      evalExp(t->child[0], next);
+      refine(t->child[0], TRUE, next);
+      execList(t->child[1], next);
+      joinState(next, head);
+      if (sameState(next, head))
+        break;
+      if (iteration >= WIDEN_AFTER)
+        widenState(head, next);
+      else
+        assignState(head, next);
+    }
+    assignState(s, head);
+    evalExp(t->child[0], s);
+    refine(t->child[0], FALSE, s);
+    free(head);
+    free(next);
+    break;
+  }
+  case ReturnK:
+    evalExp(t->child[0], s);
+    if (inlineDepth)
+      joinState(inlineExit, s);
+    s->reachable = FALSE;
+    break;
+  }
+}
+
+static void execList(TreeNode *t, State s)
+{
+  for (; t; t = t->sibling)
+    execStmt(t, s);
+}
+
+/* Procedure analyzeFunction runs the analysis over
+ * the body of one function */
+static void analyzeFunction(TreeNode *function)
+{
+  int count = collectVars(function->child[1]) + collectVars(function->child[2]);
+  int size = 4;
+  State s;
+  while (size < 2 * count)
+    size *= 2;
+  varMask = size - 1;
+  varTable = calloc(size, sizeof(BucketList));
+  varIndex = calloc(size, sizeof(int));
+  varCount = 0;
+  collectVars(function->child[1]);
+  collectVars(function->child[2]);
+  stateSize = varCount + NUM_TEMPORARIES;
+  s = newState(); /* parameters and locals may hold anything */
+  execList(function->child[2], s);
+  free(s);
+  free(varTable);
+  free(varIndex);
+  varTable = NULL;
+  varIndex = NULL;
+}
+
+/* Procedure analyzeBounds computes the range of
+ * values each scalar variable may hold, and finds
+ * the array accesses whose index may be out of range
+ */
+void analyzeBounds(TreeNode *syntaxTree)
+{
+  free(unsafeTable);
+  unsafeMask = 63;
+  unsafeTable = calloc(unsafeMask + 1, sizeof(TreeNode *));
+  unsafeCount = 0;
+  checksEmitted = checksEliminated = 0;
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+    if (t->nodekind == DeclK && t->kind.decl == FunDeclK)
+      analyzeFunction(t);
+}
+
+/* Function needsBoundsCheck returns TRUE if the
+ * index of the array access must be checked
+ */
+int needsBoundsCheck(TreeNode *access)
+{
+  if (unsafeTable && unsafeTable[unsafeSlot(access)])
+  {
+    ++checksEmitted;
+    return TRUE;
+  }
+  ++checksEliminated;
+  return FALSE;
+}
+
+/* Procedure reportBoundsChecks prints how many
+ * checks were emitted and eliminated
+ */
+void reportBoundsChecks(void)
+{
+  if (TraceOptimize)
+    fprintf(listing, "Bounds checks: %d emitted, %d eliminated by range analysis\n", checksEmitted,
+            checksEliminated);
+  free(unsafeTable);
+  unsafeTable = NULL;
+}
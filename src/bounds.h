@@ -0,0 +1,38 @@
+/****************************************************/
+/* File: bounds.h                                   */
+/* Range analysis for array bounds checking         */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _BOUNDS_H_
+#define _BOUNDS_H_
+
+#include "globals.h"
+
+/* Procedure passArrayLengths gives every array
+ * parameter a parameter holding its length, which
+ * each call passes along with the array
+ */
+void passArrayLengths(TreeNode *syntaxTree);
+
+/* Procedure analyzeBounds computes the range of
+ * values each scalar variable may hold, and finds
+ * the array accesses whose index may be out of range
+ */
+void analyzeBounds(TreeNode *syntaxTree);
+
+/* Function needsBoundsCheck returns TRUE if the
+ * index of the array access (an ArrK node) must be
+ * checked at run time. An array parameter is
+ * checked against its length parameter.
+ */
+int needsBoundsCheck(TreeNode *access);
+
+/* Procedure reportBoundsChecks prints how many
+ * checks were emitted and eliminated to the
+ * listing file, if TraceOptimize is set
+ */
+void reportBoundsChecks(void);
+
+#endif
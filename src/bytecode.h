@@ -0,0 +1,118 @@
+/****************************************************/
+/* File: bytecode.h                                 */
+/* The register bytecode written by bcgen.c and     */
+/* run by interp.c for the C- compiler              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _BYTECODE_H_
+#define _BYTECODE_H_
+
+/* A bytecode file starts with BC_MAGIC. Every number
+ * after it is a variable-length integer: seven bits
+ * a byte, low bits first, the top bit set on all
+ * bytes but the last, of the value zigzag encoded so
+ * that small negative numbers stay short. In order:
+ *   version, flags, words of globals, functions,
+ *   index of main,
+ *   for each function: registers, parameters and
+ *   instructions, followed by the instructions
+ * An instruction is its opcode and the operands of
+ * its format. Jump targets are instruction indices
+ * within the function */
+#define BC_MAGIC "CMBC"
+#define BC_MAGIC_SIZE 4
+
+enum
+{
+  BC_VERSION = 1,
+  BC_FLAG_PROMPT = 1,    /* input() prints the prompt */
+  BC_FLAG_UNBUFFERED = 2 /* output() is not buffered */
+};
+
+/* Memory is an array of words: the globals from
+ * address 0, then the stack. Registers are the words
+ * of the frame of the running function, starting at
+ * its parameters, then its local variables, then the
+ * temporaries of the optimizer and the registers of
+ * expressions. A call places the frame of the callee
+ * at the first register of the arguments */
+enum
+{
+  BC_STACK_WORDS = 0x00400000 /* 16MB, as much as SPIM */
+};
+
+/* The instructions with the formats of their
+ * operands. R is a register, K a constant, G the
+ * address of a global, L a jump target and F the
+ * index of a function. The compare-and-branch,
+ * constant and indexed forms are superinstructions
+ * for what the tree makes of loops and arrays */
+#define BC_OPS(X)                                                               \
+  X(MOV, "RR")      /* a = b */                                                 \
+  X(LOADK, "RK")    /* a = k */                                                 \
+  X(LDG, "RG")      /* a = mem[g] */                                            \
+  X(STG, "GR")      /* mem[g] = b */                                            \
+  X(ADDR, "RR")     /* a = address of register b */                             \
+  X(ADD, "RRR")     /* a = b + c */                                             \
+  X(SUB, "RRR")     /* a = b - c */                                             \
+  X(MUL, "RRR")     /* a = b * c */                                             \
+  X(DIV, "RRR")     /* a = b / c, b * c if c is 0 or -1 */                      \
+  X(ADDK, "RRK")    /* a = b + k */                                             \
+  X(MULK, "RRK")    /* a = b * k */                                             \
+  X(DIVK, "RRK")    /* a = b / k, k neither 0 nor -1 */                         \
+  X(LT, "RRR")      /* a = b < c */                                             \
+  X(LE, "RRR")                                                                  \
+  X(GT, "RRR")                                                                  \
+  X(GE, "RRR")                                                                  \
+  X(EQ, "RRR")                                                                  \
+  X(NE, "RRR")                                                                  \
+  X(JMP, "L")       /* jump to l */                                             \
+  X(JZ, "RL")       /* jump to l if a is 0 */                                   \
+  X(JNZ, "RL")      /* jump to l if a is not 0 */                               \
+  X(JLT, "RRL")     /* jump to l if a < b */                                    \
+  X(JLE, "RRL")                                                                 \
+  X(JGT, "RRL")                                                                 \
+  X(JGE, "RRL")                                                                 \
+  X(JEQ, "RRL")                                                                 \
+  X(JNE, "RRL")                                                                 \
+  X(JLTK, "RKL")    /* jump to l if a < k */                                    \
+  X(JLEK, "RKL")                                                                \
+  X(JGTK, "RKL")                                                                \
+  X(JGEK, "RKL")                                                                \
+  X(JEQK, "RKL")                                                                \
+  X(JNEK, "RKL")                                                                \
+  X(LD, "RR")       /* a = mem[b] */                                            \
+  X(ST, "RR")       /* mem[a] = b */                                            \
+  X(LDX, "RRR")     /* a = mem[b + c] */                                        \
+  X(STX, "RRR")     /* mem[a + b] = c */                                        \
+  X(LDXL, "RRR")    /* a = register b + c, an element of a local array */       \
+  X(STXL, "RRR")    /* register a + b = c */                                    \
+  X(LDXG, "RGR")    /* a = mem[g + c] */                                        \
+  X(STXG, "GRR")    /* mem[g + b] = c */                                        \
+  X(CHECK, "RKK")   /* stop if a is not below k, the size, at line k */         \
+  X(CHECKR, "RRK")  /* stop if a is not below b, the length, at line k */       \
+  X(CALL, "RFR")    /* a = f with arguments from register c */                  \
+  X(TAILCALL, "FR") /* f with arguments from register b, in this frame */       \
+  X(RET, "R")       /* return a */                                              \
+  X(IN, "R")        /* a = input() */                                           \
+  X(OUT, "R")       /* output(a) */
+
+#define BC_ENUM(name, format) BC_##name,
+typedef enum
+{
+  BC_OPS(BC_ENUM)
+      BC_COUNT
+} BcOp;
+#undef BC_ENUM
+
+enum
+{
+  BC_MAX_OPERANDS = 3
+};
+
+/* Function bcFormat returns the operand formats of
+ * op, one letter an operand */
+const char *bcFormat(BcOp op);
+
+#endif
@@ -12,12 +12,18 @@
 #include "code.h"
 #include "cgen.h"
 #include "util.h"
+#include "bounds.h"
+#include "profile.h"
+#include "phase.h"
+#include "timeline.h"
 
 /* prototypes for code generation functions */
 static void cgen(TreeNode *node);
 static void cgenStmt(TreeNode *node);
 static void cgenExp(TreeNode *node);
 static void cgenOp(TreeNode *node);
+static void cgenOpGeneric(TreeNode *node);
+static void cgenBranch(TreeNode *node, int label, int sense);
 static void cgenAssign(TreeNode *node);
 static void cgenCompound(TreeNode *node);
 static void cgenPop(const char *reg);
@@ -25,11 +31,101 @@ static void cgenPush(const char *reg);
 static void cgenPrintString(const char *symbol);
 static int getLabel(void);
 static void cgenArrayAddress(TreeNode *node);
+static void cgenArrayBase(TreeNode *node);
+static void cgenKeepAddress(TreeNode *node);
+static void scanReferences(TreeNode *node);
+static int isLiveAfterCall(TreeNode *call, int reg);
+static int argumentsAreDirect(TreeNode *args);
+static int isTailCall(TreeNode *node);
+static void cgenTailCall(TreeNode *node);
+static void cgenEpilogue(void);
+static void cgenMultiplyConst(int multiplier);
+static void cgenDivideConst(int divisor);
+static void cgenBoundsCheck(TreeNode *access);
+static void cgenBoundsTraps(void);
+static void cgenRuntime(void);
+static void cgenStoreBytes(const char *bytes);
+static void cgenLine(int lineno);
+static void cgenProfileCounters(void);
+static void cgenCount(TreeNode *node, int counter);
+static void cgenSmallData(TreeNode *syntaxTree);
+static int isSmallData(TreeNode *decl);
 #define getName(node) (node->symbol->treeNode->attr.name)
 
 static int returnLabel; /* return label used in a function */
 
+/* Registered parameters of the function being
+ * generated, and the calls made by it. A parameter
+ * must be saved around a call if it is referenced
+ * at or after the threshold of the call */
+static TreeNode *currentFunction;
+static int lastReference[4];
+typedef struct
+{
+  TreeNode *call;
+  int threshold;
+} CallSite;
+static CallSite *callSites;
+static int callSiteCount, callSiteCursor;
+static int sequence;  /* position in evaluation order */
+static int loopStart; /* position of the outermost loop, or -1 */
+
+static int bodyLabel;       /* start of the body, after the prologue */
+static int frameTemporaries; /* temporaries saved in the frame */
+static int inlineDepth;     /* number of inlined bodies being generated */
+static int lastLine;        /* source line of the last line table entry */
+
+/* Failed bounds checks branch to a stub that loads
+ * the line number and jumps to _boundsError. Stubs
+ * are emitted once control no longer falls through */
+typedef struct
+{
+  int label;
+  int lineno;
+} BoundsTrap;
+static BoundsTrap *boundsTraps;
+static int boundsTrapCount;
+
+/* Global variables that may go to the small data
+ * area, with their estimated number of accesses */
+typedef struct
+{
+  TreeNode *decl;
+  long long accesses;
+  int small; /* declared by .extern, reached from $gp */
+} GlobalUse;
+static GlobalUse *globalUses;
+static int globalUseCount;
+
+/* SPIM reaches SMALL_DATA_SIZE bytes from $gp with
+ * a 16-bit offset. Without a profile, a reference in
+ * a loop is taken for LOOP_WEIGHT references */
+enum
+{
+  SMALL_DATA_SIZE = 65536,
+  LOOP_WEIGHT = 10,
+  MAX_WEIGHT = 1000000000
+};
+
+/* Size of the output buffer of the runtime library.
+ * It is flushed before an output finds fewer than
+ * OUTPUT_RESERVE bytes left: enough for the longest
+ * line, an input prompt and the terminating null */
+enum
+{
+  OUTPUT_BUFFER_SIZE = 4096,
+  OUTPUT_RESERVE = 28
+};
+
+/* Multiplication by a constant whose non-adjacent form
+ * has more nonzero digits than this uses mul */
+enum
+{
+  MAX_MULTIPLY_TERMS = 3
+};
+
 const char *const argumentRegisters[] = {"$a0", "$a1", "$a2", "$a3"};
+const char *const temporaryRegisters[NUM_TEMPORARIES] = {"$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7"};
 
 /* Procedure cgenStmt generates code at a statement node */
 static void cgenStmt(TreeNode *node)
@@ -43,19 +139,34 @@ static void cgenStmt(TreeNode *node)
   {
     int followingLabel = getLabel();
     emitComment("->selection");
-    cgenExp(node->child[0]);
-    if (node->child[2])
+    if (node->child[2] && profileCount(node, PROFILE_THEN) > profileCount(node, PROFILE_ELSE))
+    { /* The then arm ran more often: it goes last, to
+       * fall through to the following code, and the
+       * else arm jumps over it */
+      int thenLabel = getLabel();
+      cgenBranch(node->child[0], thenLabel, TRUE);
+      cgenCount(node, PROFILE_ELSE);
+      cgen(node->child[2]);
+      emitLabel("b", followingLabel);
+      emitLabelNum(thenLabel);
+      cgenCount(node, PROFILE_THEN);
+      cgen(node->child[1]);
+    }
+    else if (node->child[2])
     { /* Has else statement */
       int elseLabel = getLabel();
-      emitRegLabel("beqz", "$v0", elseLabel);
+      cgenBranch(node->child[0], elseLabel, FALSE);
+      cgenCount(node, PROFILE_THEN);
       cgen(node->child[1]);
       emitLabel("b", followingLabel);
       emitLabelNum(elseLabel);
+      cgenCount(node, PROFILE_ELSE);
       cgen(node->child[2]);
     }
     else
     { /* No else statement */
-      emitRegLabel("beqz", "$v0", followingLabel);
+      cgenBranch(node->child[0], followingLabel, FALSE);
+      cgenCount(node, PROFILE_THEN);
       cgen(node->child[1]);
     }
     emitLabelNum(followingLabel);
@@ -66,19 +177,46 @@ static void cgenStmt(TreeNode *node)
   {
     int conditionLabel = getLabel();
     int followingLabel = getLabel();
+    long long body = profileCount(node, PROFILE_BODY);
     emitComment("->iteration");
-    emitLabelNum(conditionLabel);
-    cgenExp(node->child[0]);
-    emitRegLabel("beqz", "$v0", followingLabel);
-    cgen(node->child[1]);
-    emitLabel("b", conditionLabel);
+    cgenCount(node, PROFILE_ENTRIES);
+    if (node->child[2])
+    { /* Preheader: values invariant in the loop */
+      emitComment("preheader");
+      cgen(node->child[2]);
+    }
+    if (body > 0 && body >= profileCount(node, PROFILE_ENTRIES))
+    { /* The body ran at least once per entry: test the
+       * condition at the bottom, so that each iteration
+       * takes a single branch */
+      int bodyStart = getLabel();
+      emitLabel("b", conditionLabel);
+      emitLabelNum(bodyStart);
+      cgenCount(node, PROFILE_BODY);
+      cgen(node->child[1]);
+      emitLabelNum(conditionLabel);
+      cgenBranch(node->child[0], bodyStart, TRUE);
+    }
+    else
+    {
+      emitLabelNum(conditionLabel);
+      cgenBranch(node->child[0], followingLabel, FALSE);
+      cgenCount(node, PROFILE_BODY);
+      cgen(node->child[1]);
+      emitLabel("b", conditionLabel);
+    }
     emitLabelNum(followingLabel);
     emitComment("<-iteration");
     break;
   }
   case ReturnK:
-    cgenExp(node->child[0]);
-    emitLabel("j", returnLabel);
+    if (isTailCall(node->child[0]))
+      cgenTailCall(node->child[0]);
+    else
+    {
+      cgenExp(node->child[0]);
+      emitLabel("j", returnLabel);
+    }
     break;
   }
 } /* cgenStmt */
@@ -87,6 +225,7 @@ static void cgenStmt(TreeNode *node)
  * Value of expression will be in $v0 */
 static void cgenExp(TreeNode *node)
 {
+  cgenLine(node->lineno);
   switch (node->kind.exp)
   {
   case AssignK:
@@ -147,12 +286,19 @@ static void cgenExp(TreeNode *node)
     }
     break;
   case ArrK:
-    cgenArrayAddress(node);
+    if (node->child[0] == NULL)
+    { /* element address kept in a temporary */
+      emitRegAddr("lw", "$v0", NULL, 0, temporaryRegisters[node->child[2]->attr.val]);
+      break;
+    }
+    cgenArrayBase(node);
     cgenPush("$v0");
     cgenExp(node->child[0]);
+    cgenBoundsCheck(node);
     cgenPop("$t0"); /* array base: $t0, index: $v0 */
-    emitRegRegImm("mul", "$v0", "$v0", WORD_SIZE);
+    emitRegRegImm("sll", "$v0", "$v0", WORD_SHIFT);
     emitRegRegReg("addu", "$v0", "$v0", "$t0");
+    cgenKeepAddress(node);
     emitRegAddr("lw", "$v0", NULL, 0, "$v0");
     break;
   case CallK:
@@ -160,15 +306,28 @@ static void cgenExp(TreeNode *node)
     {
       /* Read integer from stdin to $v0 */
       emitComment("->call \'input\'");
-      cgenPrintString("_inputStr");
-      emitRegImm("li", "$v0", 5); /* syscall #5: read int */
-      emitCode("syscall");
+      if (!BatchInput && BufferOutput)
+        emitReg("jal", "_rt_input"); /* prompt and flush in one syscall */
+      else
+      {
+        if (!BatchInput)
+          cgenPrintString("_inputStr");
+        emitRegImm("li", "$v0", 5); /* syscall #5: read int */
+        emitCode("syscall");
+      }
       emitComment("<-call \'input\'");
     }
     else if (!strcmp("output", getName(node)))
     {
       /* Print integer from $v0 to stdout */
       emitComment("->call \'output\'");
+      if (BufferOutput)
+      {
+        cgenExp(node->child[0]);
+        emitReg("jal", "_rt_output");
+        emitComment("<-call \'output\'");
+        break;
+      }
       cgenPush("$v0");
       cgenPush("$a0");
       cgenExp(node->child[0]); /* evaluate parameter */
@@ -183,42 +342,81 @@ static void cgenExp(TreeNode *node)
     }
     else
     {
-      /* Calling sequence */
+      /* Calling sequence. Argument registers are not
+       * preserved by the callee, so the caller saves the
+       * ones it still reads after the call */
       TreeNode *params;
-      int i;
+      int i, saved[4], savedCount = 0;
+      int registered = node->symbol->size < 4 ? node->symbol->size : 4;
+      int stacked = node->symbol->size - registered;
+      int direct = argumentsAreDirect(node->child[0]);
       emitComment("->call function");
-      /* Save registered arguments of current function */
-      for (i = 0; i < 4 && i < node->symbol->size; ++i)
-        cgenPush(argumentRegisters[i]);
-      /* Push arguments to stack */
-      if (node->symbol->size > 4)
-        emitRegRegImm("subu", "$sp", "$sp", WORD_SIZE * (node->symbol->size - 4));
+      cgenCount(node, PROFILE_CALLS);
+      for (i = 0; i < 4; ++i)
+        if (isLiveAfterCall(node, i))
+        {
+          cgenPush(argumentRegisters[i]);
+          saved[savedCount++] = i;
+        }
+      if (stacked)
+        emitRegRegImm("subu", "$sp", "$sp", WORD_SIZE * stacked);
       for (i = 0, params = node->child[0]; params; ++i, params = params->sibling)
       {
         cgenExp(params);
-        if (i < 4) /* registered arguments */
+        if (i < 4 && direct) /* straight into the argument register */
+          emitRegReg("move", argumentRegisters[i], "$v0");
+        else if (i < 4)
           cgenPush("$v0");
-        else /* stacked arguments */
-          emitRegAddr("sw", "$v0", NULL, WORD_SIZE * (i - 4), "$sp");
+        else /* stacked arguments, above the registered ones still pushed */
+          emitRegAddr("sw", "$v0", NULL, WORD_SIZE * (i - 4 + (direct ? 0 : 4)), "$sp");
       }
-      for (i = 3; i >= 0; --i) /* Push registered arguments */
-        if (i < node->symbol->size)
-          cgenPop(argumentRegisters[i]);
-      cgenPush("$fp");                        /* control link */
-      emitRegReg("move", "$fp", "$sp");       /* new frame pointer */
-      cgenPush("$ra");                        /* save return address */
-      emitReg("jal", getName(node));          /* Jump to procedure */
-      emitRegRegImm("subu", "$sp", "$fp", 4); /* pop arguments from stack */
-      cgenPop("$ra");                         /* restore return address */
-      cgenPop("$fp");                         /* restore frame pointer */
-      if (node->symbol->size > 4)
-        emitRegRegImm("addu", "$sp", "$sp", WORD_SIZE * (node->symbol->size - 4));
-      for (i = 3; i >= 0; --i) /* Restore registered arguments */
-        if (i < node->symbol->size)
+      if (!direct)
+        for (i = registered - 1; i >= 0; --i)
           cgenPop(argumentRegisters[i]);
+      emitReg("jal", getName(node)); /* Jump to procedure */
+      if (stacked)
+        emitRegRegImm("addu", "$sp", "$sp", WORD_SIZE * stacked);
+      while (savedCount)
+        cgenPop(argumentRegisters[saved[--savedCount]]);
       emitComment("<-call function");
     }
     break;
+  case InlineK:
+  {
+    /* Store arguments to the parameter slots in this
+     * frame and run the copied body. Its return
+     * statements jump to the end of the body */
+    TreeNode *args, *params;
+    int savedReturnLabel = returnLabel;
+    char *buff = malloc(strlen(getName(node)) + 12);
+    sprintf(buff, "->inline %s", getName(node));
+    emitComment(buff);
+    cgenCount(node, PROFILE_CALLS);
+    for (args = node->child[0], params = node->child[2]; args; args = args->sibling, params = params->sibling)
+    {
+      cgenExp(args);
+      emitRegAddr("sw", "$v0", NULL, params->symbol->memloc, "$fp");
+    }
+    returnLabel = getLabel();
+    ++inlineDepth;
+    cgen(node->child[1]);
+    --inlineDepth;
+    emitLabelNum(returnLabel);
+    returnLabel = savedReturnLabel;
+    sprintf(buff, "<-inline %s", getName(node));
+    emitComment(buff);
+    free(buff);
+    break;
+  }
+  case TempK:
+    if (node->child[0])
+    { /* Set temporary, and leave the value in $v0 */
+      cgenExp(node->child[0]);
+      emitRegReg("move", temporaryRegisters[node->attr.val], "$v0");
+    }
+    else
+      emitRegReg("move", "$v0", temporaryRegisters[node->attr.val]);
+    break;
   }
 } /* cgenExp */
 
@@ -244,6 +442,34 @@ static void cgenOp(TreeNode *node)
   char *buff = malloc(15);
   sprintf(buff, "->operator %s", getOp(node->attr.op));
   emitComment(buff);
+  /* Multiplication and division by a constant
+   * need no second operand register */
+  if (node->attr.op == TIMES && node->child[1]->nodekind == ExpK && node->child[1]->kind.exp == ConstK)
+  {
+    cgenExp(node->child[0]);
+    cgenMultiplyConst(node->child[1]->attr.val);
+  }
+  else if (node->attr.op == TIMES && node->child[0]->nodekind == ExpK && node->child[0]->kind.exp == ConstK)
+  {
+    cgenExp(node->child[1]);
+    cgenMultiplyConst(node->child[0]->attr.val);
+  }
+  else if (node->attr.op == OVER && node->child[1]->nodekind == ExpK && node->child[1]->kind.exp == ConstK && node->child[1]->attr.val != 0)
+  {
+    cgenExp(node->child[0]);
+    cgenDivideConst(node->child[1]->attr.val);
+  }
+  else
+    cgenOpGeneric(node);
+  sprintf(buff, "<-operator %s", getOp(node->attr.op));
+  emitComment(buff);
+  free(buff);
+} /* cgenOp */
+
+/* Procedure cgenOpGeneric generates code
+ * for an operator on two evaluated operands */
+static void cgenOpGeneric(TreeNode *node)
+{
   cgenExp(node->child[0]); /* Operand 1 */
   cgenPush("$v0");
   cgenExp(node->child[1]); /* Operand 2 */
@@ -261,10 +487,8 @@ static void cgenOp(TreeNode *node)
     emitRegRegReg("mul", "$v0", "$t0", "$t1");
     break;
   case OVER:
-    emitReg("mflo", "$t3");
     emitRegReg("div", "$t0", "$t1");
     emitReg("mflo", "$v0");
-    emitReg("mtlo", "$t3");
     break;
   case LT:
     emitRegRegReg("slt", "$v0", "$t0", "$t1");
@@ -285,10 +509,238 @@ static void cgenOp(TreeNode *node)
     emitRegRegReg("sne", "$v0", "$t0", "$t1");
     break;
   }
-  sprintf(buff, "<-operator %s", getOp(node->attr.op));
-  emitComment(buff);
-  free(buff);
-} /* cgenOp */
+} /* cgenOpGeneric */
+
+/* Function isLeaf returns TRUE if evaluating node
+ * leaves every register but $v0 and $t0 untouched */
+static int isLeaf(TreeNode *node)
+{
+  return node->kind.exp == ConstK || node->kind.exp == VarK || (node->kind.exp == TempK && !node->child[0]);
+}
+
+/* Procedure cgenBranch generates code that jumps
+ * to label if the truth of the condition node is
+ * sense: if it is zero for FALSE, nonzero for TRUE.
+ * For a relational operator the branch compares
+ * the operands directly, without computing 0 or 1 */
+static void cgenBranch(TreeNode *node, int label, int sense)
+{
+  TreeNode *left = node->child[0], *right = node->child[1];
+  TokenType op = node->attr.op;
+  const char *branch, *zeroBranch;
+  if (node->kind.exp != OpK || op == PLUS || op == MINUS || op == TIMES || op == OVER)
+  {
+    cgenExp(node);
+    emitRegLabel(sense ? "bnez" : "beqz", "$v0", label);
+    return;
+  }
+  if (left->kind.exp == ConstK && right->kind.exp != ConstK)
+  { /* keep the constant on the right: c < x is x > c */
+    TreeNode *temp = left;
+    left = right;
+    right = temp;
+    op = op == LT ? GT : op == GT ? LT : op == LTE ? GTE : op == GTE ? LTE : op;
+  }
+  if (sense) /* taken when the comparison holds: when its negation fails */
+    op = op == LT ? GTE : op == GTE ? LT : op == GT ? LTE : op == LTE ? GT : op == EQ ? NEQ : EQ;
+  switch (op)
+  { /* branches taken when the comparison fails */
+  case LT:
+    branch = "bge";
+    zeroBranch = "bgez";
+    break;
+  case LTE:
+    branch = "bgt";
+    zeroBranch = "bgtz";
+    break;
+  case GT:
+    branch = "ble";
+    zeroBranch = "blez";
+    break;
+  case GTE:
+    branch = "blt";
+    zeroBranch = "bltz";
+    break;
+  case EQ:
+    branch = "bne";
+    zeroBranch = "bnez";
+    break;
+  default: /* NEQ */
+    branch = "beq";
+    zeroBranch = "beqz";
+    break;
+  }
+  emitComment("->condition");
+  cgenExp(left);
+  if (right->kind.exp == ConstK && right->attr.val == 0)
+    emitRegLabel(zeroBranch, "$v0", label);
+  else if (right->kind.exp == ConstK && right->attr.val >= -32768 && right->attr.val <= 32767)
+    emitRegImmLabel(branch, "$v0", right->attr.val, label);
+  else if (isLeaf(right))
+  {
+    emitRegReg("move", "$t1", "$v0");
+    cgenExp(right);
+    emitRegRegLabel(branch, "$t1", "$v0", label);
+  }
+  else
+  {
+    cgenPush("$v0");
+    cgenExp(right);
+    cgenPop("$t0");
+    emitRegRegLabel(branch, "$t0", "$v0", label);
+  }
+  emitComment("<-condition");
+} /* cgenBranch */
+
+/* Procedure cgenMultiplyConst generates code
+ * to multiply $v0 by a constant in place.
+ * The multiplier is written in non-adjacent form
+ * (digits -1, 0, 1) and the product built from
+ * shifts, additions and subtractions.
+ * Multipliers with too many nonzero digits
+ * fall back to the mul instruction */
+static void cgenMultiplyConst(int multiplier)
+{
+  int digits[33]; /* NAF digits, least significant first */
+  int nonzero = 0;
+  int top, k;
+  long long rest;
+  int negative = multiplier < 0;
+
+  if (multiplier == 0)
+  {
+    emitRegImm("li", "$v0", 0);
+    return;
+  }
+  rest = negative ? -(long long)multiplier : multiplier;
+  for (k = 0; rest; ++k)
+  {
+    if (rest & 1)
+    {
+      digits[k] = 2 - (int)(rest & 3); /* 1 if rest = 1 (mod 4), -1 if 3 (mod 4) */
+      rest -= digits[k];
+      ++nonzero;
+    }
+    else
+      digits[k] = 0;
+    rest >>= 1;
+  }
+  top = k - 1;
+  if (nonzero > MAX_MULTIPLY_TERMS)
+  {
+    emitRegRegImm("mul", "$v0", "$v0", multiplier);
+    return;
+  }
+
+  if (nonzero == 1)
+  { /* power of two */
+    if (top)
+      emitRegRegImm("sll", "$v0", "$v0", top);
+  }
+  else
+  { /* accumulate in $t0, highest digit (always +1) first */
+    int remaining = nonzero - 1;
+    emitRegRegImm("sll", "$t0", "$v0", top);
+    for (k = top - 1; k >= 0; --k)
+    {
+      const char *term = "$v0";
+      if (!digits[k])
+        continue;
+      if (k)
+      {
+        emitRegRegImm("sll", "$t1", "$v0", k);
+        term = "$t1";
+      }
+      --remaining;
+      emitRegRegReg(digits[k] > 0 ? "addu" : "subu", remaining ? "$t0" : "$v0", "$t0", term);
+    }
+  }
+  if (negative)
+    emitRegReg("negu", "$v0", "$v0");
+} /* cgenMultiplyConst */
+
+/* Function magicDivisor computes the multiplier
+ * and shift amount for signed division by a
+ * constant d, where |d| is not a power of two.
+ * See Warren, Hacker's Delight, Figure 10-1 */
+int magicDivisor(int d, int *shift)
+{
+  const unsigned int two31 = 0x80000000u;
+  unsigned int ad = d < 0 ? 0u - (unsigned int)d : (unsigned int)d;
+  unsigned int t = two31 + ((unsigned int)d >> 31);
+  unsigned int anc = t - 1 - t % ad; /* absolute value of nc */
+  unsigned int q1 = two31 / anc, r1 = two31 - q1 * anc;
+  unsigned int q2 = two31 / ad, r2 = two31 - q2 * ad;
+  unsigned int delta;
+  int p = 31;
+  do
+  {
+    ++p;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc)
+    {
+      ++q1;
+      r1 -= anc;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad)
+    {
+      ++q2;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+  *shift = p - 32;
+  return (int)(d < 0 ? 0u - (q2 + 1) : q2 + 1);
+} /* magicDivisor */
+
+/* Procedure cgenDivideConst generates code
+ * to divide $v0 by a nonzero constant in place,
+ * truncating toward zero like div does */
+static void cgenDivideConst(int divisor)
+{
+  unsigned int magnitude = divisor < 0 ? 0u - (unsigned int)divisor : (unsigned int)divisor;
+  if (magnitude == 1)
+  {
+    if (divisor < 0)
+      emitRegReg("negu", "$v0", "$v0");
+  }
+  else if (!(magnitude & (magnitude - 1)))
+  { /* power of two: add 2^k - 1 to negative dividends before shifting */
+    int k = 0;
+    while ((1u << k) != magnitude)
+      ++k;
+    if (k == 1)
+      emitRegRegImm("srl", "$t0", "$v0", 31);
+    else
+    {
+      emitRegRegImm("sra", "$t0", "$v0", 31);
+      emitRegRegImm("srl", "$t0", "$t0", 32 - k);
+    }
+    emitRegRegReg("addu", "$t0", "$v0", "$t0");
+    emitRegRegImm("sra", "$v0", "$t0", k);
+    if (divisor < 0)
+      emitRegReg("negu", "$v0", "$v0");
+  }
+  else
+  { /* multiply by magic number, keep the high word */
+    int shift;
+    int magic = magicDivisor(divisor, &shift);
+    emitRegImm("li", "$t0", magic);
+    emitRegReg("mult", "$v0", "$t0");
+    emitReg("mfhi", "$t0");
+    if (divisor > 0 && magic < 0)
+      emitRegRegReg("addu", "$t0", "$t0", "$v0");
+    else if (divisor < 0 && magic > 0)
+      emitRegRegReg("subu", "$t0", "$t0", "$v0");
+    if (shift)
+      emitRegRegImm("sra", "$t0", "$t0", shift);
+    emitRegRegImm("srl", "$t1", "$t0", 31); /* round toward zero */
+    emitRegRegReg("addu", "$v0", "$t0", "$t1");
+  }
+} /* cgenDivideConst */
 
 /* Procedure cgenAssign generates code
  * to assign value of RHS
@@ -297,19 +749,37 @@ static void cgenAssign(TreeNode *node)
 {
   TreeNode *LHS = node->child[0];
   emitComment("->Assign");
+  if (LHS->kind.exp == ArrK && LHS->child[0] == NULL)
+  { /* element address kept in a temporary */
+    cgenExp(node->child[1]);
+    emitRegAddr("sw", "$v0", NULL, 0, temporaryRegisters[LHS->child[2]->attr.val]);
+    emitComment("<-Assign");
+    return;
+  }
+  if (LHS->symbol->symbol_class == Global && LHS->kind.exp == VarK)
+  { /* Global Variable: stored by its label */
+    cgenExp(node->child[1]);
+    emitRegAddr("sw", "$v0", getName(LHS), 0, NULL);
+    emitComment("<-Assign");
+    return;
+  }
   /* Calculate address of LHS and save to $v0 */
   if (LHS->symbol->symbol_class == Global)
-  { /* Global Variable/Array assignment */
-    if (LHS->kind.exp == VarK)
-      /* Global Variable */
-      emitRegAddr("la", "$v0", getName(LHS), 0, NULL);
-    else if (LHS->kind.exp == ArrK)
+  { /* Global Array assignment */
+    if (LHS->kind.exp == ArrK)
     { /* Global Array */
       /* evaluate array index */
       cgenExp(LHS->child[0]);
-      emitRegRegImm("mul", "$v0", "$v0", WORD_SIZE);
-      emitRegAddr("la", "$t0", getName(LHS), 0, NULL);
-      emitRegRegReg("addu", "$v0", "$v0", "$t0");
+      cgenBoundsCheck(LHS);
+      emitRegRegImm("sll", "$v0", "$v0", WORD_SHIFT);
+      if (LHS->child[1])
+        emitRegRegReg("addu", "$v0", "$v0", temporaryRegisters[LHS->child[1]->attr.val]);
+      else
+      {
+        emitRegAddr("la", "$t0", getName(LHS), 0, NULL);
+        emitRegRegReg("addu", "$v0", "$v0", "$t0");
+      }
+      cgenKeepAddress(LHS);
     }
   }
   else /* Local Variable/Array assignment */
@@ -325,13 +795,15 @@ static void cgenAssign(TreeNode *node)
     }
     else /* Local Array */
     {
-      cgenArrayAddress(LHS); /* Array address in $v0  */
+      cgenArrayBase(LHS); /* Array address in $v0  */
       cgenPush("$v0");
 
       cgenExp(LHS->child[0]); /* index in $v0 */
+      cgenBoundsCheck(LHS);
       cgenPop("$t0");
-      emitRegRegImm("mul", "$v0", "$v0", WORD_SIZE);
+      emitRegRegImm("sll", "$v0", "$v0", WORD_SHIFT);
       emitRegRegReg("addu", "$v0", "$t0", "$v0");
+      cgenKeepAddress(LHS);
     }
   }
   cgenPush("$v0"); /* Save LHS address to stack*/
@@ -359,6 +831,8 @@ static void cgen(TreeNode *node)
 {
   if (node != NULL)
   {
+    if (node->nodekind == StmtK || node->nodekind == ExpK)
+      cgenLine(node->lineno);
     switch (node->nodekind)
     {
     case StmtK:
@@ -407,6 +881,17 @@ static void cgenIOStrings(void)
   emitCode("_inputStr:  .asciiz \"input: \"");
   emitCode("_outputStr: .asciiz \"output: \"");
   emitCode("_newline:   .asciiz \"\\n\"");
+  if (BoundsCheck)
+    emitCode("_boundsStr: .asciiz \"error: array index out of bounds at line \"");
+  if (BufferOutput)
+  {
+    char buff[40];
+    emitCode(".align 2");
+    emitCode(SmallData ? ".extern _rt_len 4" : "_rt_len:    .word 0");
+    emitCode("_rt_powers: .word 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000");
+    sprintf(buff, "_rt_buf:    .space %d", OUTPUT_BUFFER_SIZE);
+    emitCode(buff);
+  }
 }
 
 /* Procedure cgenGlobalVarDecl generates code for
@@ -432,10 +917,25 @@ static void cgenGlobalVarDecl(const char *name, int size)
   free(buff);
 }
 
+/* Procedure cgenEpilogue generates code to restore
+ * the registers saved by the current function and
+ * pop its frame, leaving $sp where the caller had it */
+static void cgenEpilogue(void)
+{
+  for (int i = 0; i < frameTemporaries; ++i)
+    emitRegAddr("lw", temporaryRegisters[i], NULL, currentFunction->symbol->memloc - WORD_SIZE * (i + 1), "$fp");
+  emitRegAddr("lw", "$ra", NULL, -WORD_SIZE, "$fp");
+  emitRegRegImm("addu", "$sp", "$fp", WORD_SIZE);
+  emitRegAddr("lw", "$fp", NULL, 0, "$fp");
+}
+
 static void cgenFunDecl(TreeNode *node)
 {
+  int i;
+  long firstInstruction = eventCounts[CountInstructions];
   /* Function Preamble */
   char *buff = malloc(strlen(getName(node)) + 37);
+  beginSpan("code generation", getName(node));
   sprintf(buff, "->function \'%s\'", getName(node));
   emitComment(buff);
   if (globalEmitMode != TEXT)
@@ -444,10 +944,14 @@ static void cgenFunDecl(TreeNode *node)
     emitCode(".text");
   }
 
+  currentFunction = node;
+  lastLine = -1;
   if (!strcmp(getName(node), "main"))
   {
     emitCode(".globl main");
     emitCode("main:");
+    cgenLine(node->lineno);
+    cgenCount(node, PROFILE_ENTRIES);
     /* set frame pointer */
     emitRegReg("move", "$fp", "$sp");
   }
@@ -455,64 +959,228 @@ static void cgenFunDecl(TreeNode *node)
   { /* only for non-main */
     returnLabel = getLabel();
     emitLabelStr(getName(node));
+    cgenLine(node->lineno);
+    cgenCount(node, PROFILE_ENTRIES);
     emitComment("entry routine");
+    /* stacked arguments start at $sp: control link
+     * and return address go right below them */
+    emitRegAddr("sw", "$fp", NULL, -WORD_SIZE, "$sp");
+    emitRegAddr("sw", "$ra", NULL, -2 * WORD_SIZE, "$sp");
+    emitRegRegImm("subu", "$fp", "$sp", WORD_SIZE);
   }
-  /* reserve space for local variables */
-  emitRegRegImm("subu", "$sp", "$fp", -node->symbol->memloc);
+  callSiteCount = callSiteCursor = 0;
+  sequence = 0;
+  loopStart = -1;
+  for (i = 0; i < 4; ++i)
+    lastReference[i] = -1;
+  scanReferences(node->child[2]);
+  /* reserve space for local variables, and below them
+   * for the temporaries the caller expects preserved */
+  frameTemporaries = strcmp(getName(node), "main") ? countTemporaries(node->child[2]) : 0;
+  emitRegRegImm("subu", "$sp", "$fp", -node->symbol->memloc + WORD_SIZE * frameTemporaries);
+  for (i = 0; i < frameTemporaries; ++i)
+    emitRegAddr("sw", temporaryRegisters[i], NULL, node->symbol->memloc - WORD_SIZE * (i + 1), "$fp");
+  bodyLabel = getLabel();
+  emitLabelNum(bodyLabel);
   cgenCompound(node->child[2]); /* run the body code */
   if (strcmp(getName(node), "main"))
   { /* only for non-main */
     emitComment("exit routine");
     if (node->type == Integer)
       emitLabelNum(returnLabel);
-
+    cgenEpilogue();
     emitReg("jr", "$ra");
+    cgenBoundsTraps();
     sprintf(buff, "<-function \'%s\'", getName(node));
     emitComment(buff);
     returnLabel = -1;
   }
   free(buff);
+  endSpanWith("instructions", eventCounts[CountInstructions] - firstInstruction);
+}
+
+/* Procedure nameGlobals adds an underbar in front
+ * of global symbols. This is to keep symbols from
+ * colliding with MIPS operators. All are renamed
+ * before any function is generated, as functions
+ * may be generated out of order
+ */
+static void nameGlobals(TreeNode *node)
+{
+  for (; node != NULL; node = node->sibling)
+    if (node->nodekind == DeclK && strcmp(node->symbol->treeNode->attr.name, "main") != 0)
+    {
+      int length = strlen(node->symbol->treeNode->attr.name);
+      char *buff = malloc(length + 2);
+      buff[0] = '_';
+      for (int i = 0; i < length; ++i)
+        buff[i + 1] = node->symbol->treeNode->attr.name[i];
+      buff[length + 1] = '\0';
+      node->symbol->treeNode->attr.name = buff;
+      addPtr(buff);
+    }
+}
+
+/* Function isHotterFunction orders functions for
+ * the layout: never entered first, then the others
+ * by decreasing entries, and main last, since it
+ * falls through to the exit routine */
+static int isHotterFunction(TreeNode *a, TreeNode *b)
+{
+  long long x = profileCount(a, PROFILE_ENTRIES), y = profileCount(b, PROFILE_ENTRIES);
+  if (!strcmp(getName(b), "main") || !strcmp(getName(a), "main"))
+    return !strcmp(getName(b), "main");
+  if (x == 0 || y == 0)
+    return x == 0 && y != 0;
+  return x > y;
 }
 
 /* Procedure cgenGlobal generates code for
- * the global scope
+ * the global scope. With a profile, functions are
+ * generated after the variables, in the order of
+ * isHotterFunction
  */
 static void cgenGlobal(TreeNode *node)
 {
-  if (node != NULL)
-  {
+  TreeNode **functions = NULL;
+  int functionCount = 0, i;
+  for (; node != NULL; node = node->sibling)
     if (node->nodekind == DeclK)
-    {
-      /* Add underbar in front of global symbols.
-       * This is to keep symbols from colliding with MIPS operators */
-      if (strcmp(node->symbol->treeNode->attr.name, "main") != 0)
-      {
-        int length = strlen(node->symbol->treeNode->attr.name);
-        char *buff = malloc(length + 2);
-        buff[0] = '_';
-        for (int i = 0; i < length; ++i)
-          buff[i + 1] = node->symbol->treeNode->attr.name[i];
-        buff[length + 1] = '\0';
-        node->symbol->treeNode->attr.name = buff;
-        addPtr(buff);
-      }
       switch (node->kind.decl)
       {
       case VarDeclK:
-        cgenGlobalVarDecl(getName(node), WORD_SIZE);
+        if (!isSmallData(node))
+          cgenGlobalVarDecl(getName(node), WORD_SIZE);
         break;
       case ArrDeclK:
-        cgenGlobalVarDecl(getName(node), WORD_SIZE * node->child[1]->attr.val);
+        if (!isSmallData(node))
+          cgenGlobalVarDecl(getName(node), WORD_SIZE * node->child[1]->attr.val);
         break;
       case FunDeclK:
-        cgenFunDecl(node);
+        if (profileCount(node, PROFILE_ENTRIES) < 0)
+        {
+          cgenFunDecl(node);
+          break;
+        }
+        /* insertion keeps equally hot functions in order */
+        functions = realloc(functions, sizeof(TreeNode *) * (functionCount + 1));
+        for (i = functionCount++; i > 0 && isHotterFunction(node, functions[i - 1]); --i)
+          functions[i] = functions[i - 1];
+        functions[i] = node;
         break;
       }
+  for (i = 0; i < functionCount; ++i)
+    cgenFunDecl(functions[i]);
+  free(functions);
+}
+
+/* Procedure countAccesses adds weight, or the count
+ * of the profile, to the accesses of the globals
+ * referenced in t and its siblings */
+static void countAccesses(TreeNode *t, long long weight)
+{
+  for (; t != NULL; t = t->sibling)
+  {
+    if (t->nodekind == StmtK && t->kind.stmt == IterationK)
+    {
+      long long body = profileCount(t, PROFILE_BODY);
+      if (body < 0)
+        body = weight < MAX_WEIGHT ? weight * LOOP_WEIGHT : weight;
+      countAccesses(t->child[2], weight); /* preheader runs once */
+      countAccesses(t->child[0], body);
+      countAccesses(t->child[1], body);
+      continue;
+    }
+    if (t->nodekind == StmtK && t->kind.stmt == SelectionK && profileCount(t, PROFILE_THEN) >= 0)
+    {
+      countAccesses(t->child[0], weight);
+      countAccesses(t->child[1], profileCount(t, PROFILE_THEN));
+      countAccesses(t->child[2], profileCount(t, PROFILE_ELSE));
+      continue;
     }
-    cgenGlobal(node->sibling);
+    if (t->nodekind == ExpK && (t->kind.exp == VarK || t->kind.exp == ArrK) && t->symbol &&
+        t->symbol->symbol_class == Global)
+      for (int i = 0; i < globalUseCount; ++i)
+        if (globalUses[i].decl->symbol == t->symbol)
+          globalUses[i].accesses += weight;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      countAccesses(t->child[i], weight);
   }
 }
 
+/* The most accessed globals come first, then the
+ * ones declared first */
+static int compareGlobalUses(const void *a, const void *b)
+{
+  const GlobalUse *x = a, *y = b;
+  if (x->accesses != y->accesses)
+    return x->accesses < y->accesses ? 1 : -1;
+  return x->decl->lineno - y->decl->lineno;
+}
+
+/* Procedure cgenSmallData declares the global
+ * variables of at most SmallDataLimit bytes with
+ * .extern, from the most accessed down until the
+ * small data area is full. SPIM then addresses them
+ * from $gp, so that a load, a store or an la of one
+ * is a single instruction instead of two
+ */
+static void cgenSmallData(TreeNode *syntaxTree)
+{
+  int bytes = BufferOutput ? WORD_SIZE : 0; /* _rt_len */
+  int smallCount = 0;
+  for (TreeNode *node = syntaxTree; node != NULL; node = node->sibling)
+    if (node->nodekind == DeclK && (node->kind.decl == VarDeclK || node->kind.decl == ArrDeclK))
+    {
+      int size = node->kind.decl == ArrDeclK ? WORD_SIZE * node->child[1]->attr.val : WORD_SIZE;
+      if (size > SmallDataLimit)
+        continue;
+      globalUses = realloc(globalUses, sizeof(GlobalUse) * (globalUseCount + 1));
+      globalUses[globalUseCount].decl = node;
+      globalUses[globalUseCount].accesses = 0;
+      globalUses[globalUseCount].small = FALSE;
+      ++globalUseCount;
+    }
+  if (globalUseCount == 0)
+    return;
+  for (TreeNode *node = syntaxTree; node != NULL; node = node->sibling)
+    if (node->nodekind == DeclK && node->kind.decl == FunDeclK)
+    {
+      long long entries = profileCount(node, PROFILE_ENTRIES);
+      countAccesses(node->child[2], entries >= 0 ? entries : 1);
+    }
+  qsort(globalUses, globalUseCount, sizeof(GlobalUse), compareGlobalUses);
+  emitComment("small data, addressed from $gp");
+  for (int i = 0; i < globalUseCount; ++i)
+  {
+    TreeNode *decl = globalUses[i].decl;
+    int size = decl->kind.decl == ArrDeclK ? WORD_SIZE * decl->child[1]->attr.val : WORD_SIZE;
+    char *buff;
+    if (bytes + size > SMALL_DATA_SIZE)
+      continue;
+    buff = malloc(strlen(getName(decl)) + 32);
+    sprintf(buff, ".extern %s %d", getName(decl), size);
+    emitCode(buff);
+    free(buff);
+    globalUses[i].small = TRUE;
+    bytes += size;
+    ++smallCount;
+  }
+  if (TraceOptimize)
+    fprintf(listing, "Small data: %d of %d small global variables in %d bytes from $gp\n", smallCount, globalUseCount,
+            bytes);
+}
+
+/* Function isSmallData returns TRUE if the global
+ * variable declared by decl is in the small data */
+static int isSmallData(TreeNode *decl)
+{
+  for (int i = 0; i < globalUseCount; ++i)
+    if (globalUses[i].decl == decl)
+      return globalUses[i].small;
+  return FALSE;
+}
+
 /* Procedure getLabel returns a new label number */
 static int getLabel(void)
 {
@@ -544,6 +1212,240 @@ static void cgenArrayAddress(TreeNode *node)
   }
 }
 
+/* Procedure cgenKeepAddress copies the element
+ * address in $v0 to the temporary of the access,
+ * if later accesses to the element read it there
+ */
+static void cgenKeepAddress(TreeNode *node)
+{
+  if (node->child[2])
+    emitRegReg("move", temporaryRegisters[node->child[2]->attr.val], "$v0");
+}
+
+/* Generates code to calculate address of the
+ * array indexed by node and store it at $v0,
+ * reading it from a temporary if it was hoisted */
+static void cgenArrayBase(TreeNode *node)
+{
+  if (node->child[1])
+    cgenExp(node->child[1]);
+  else
+    cgenArrayAddress(node);
+}
+
+/* Function countTemporaries returns the number of
+ * temporary registers used in node and its siblings */
+int countTemporaries(TreeNode *node)
+{
+  int count = 0;
+  for (; node; node = node->sibling)
+  {
+    if (node->nodekind == ExpK && node->kind.exp == TempK && node->attr.val >= count)
+      count = node->attr.val + 1;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+    {
+      int childCount = countTemporaries(node->child[i]);
+      if (childCount > count)
+        count = childCount;
+    }
+  }
+  return count;
+}
+
+/* Function isFrameAddress returns TRUE if the
+ * argument t may be the address of an array in the
+ * frame: a local array, or a parameter of an inlined
+ * body, which may hold one. A temporary read keeps
+ * the symbol of the expression hoisted into it */
+static int isFrameAddress(TreeNode *t)
+{
+  BucketList symbol = t->symbol;
+  if (t->kind.exp == TempK && t->child[0])
+    return isFrameAddress(t->child[0]);
+  if ((t->kind.exp != VarK && t->kind.exp != TempK) || symbol == NULL || !symbol->is_array)
+    return FALSE;
+  return symbol->symbol_class == Local ||
+         (symbol->symbol_class == Parameter && !symbol->is_registered_argument && symbol->memloc < 0);
+}
+
+int passesFrameAddress(TreeNode *call)
+{
+  for (TreeNode *args = call->child[0]; args; args = args->sibling)
+    if (args->nodekind == ExpK && isFrameAddress(args))
+      return TRUE;
+  return FALSE;
+}
+
+/* Function isRegisteredParameter returns TRUE if
+ * node reads or writes a parameter of the current
+ * function kept in an argument register */
+static int isRegisteredParameter(TreeNode *node)
+{
+  return node->nodekind == ExpK && (node->kind.exp == VarK || node->kind.exp == ArrK) &&
+         node->symbol->symbol_class == Parameter && node->symbol->is_registered_argument;
+}
+
+/* Function checkedLength returns the registered
+ * parameter holding the length node is checked
+ * against, if node is such an array access, or NULL */
+static BucketList checkedLength(TreeNode *node)
+{
+  BucketList length;
+  if (!BoundsCheck || node->nodekind != ExpK || node->kind.exp != ArrK || node->child[0] == NULL)
+    return NULL;
+  length = node->symbol->length;
+  return length && length->is_registered_argument ? length : NULL;
+}
+
+/* Procedure scanReferences numbers node and its
+ * siblings in evaluation order, recording the last
+ * reference to each registered parameter and the
+ * threshold of each call. A parameter referenced
+ * anywhere in a loop around the call is live after
+ * it, since the loop may run again */
+static void scanReferences(TreeNode *node)
+{
+  for (; node; node = node->sibling)
+  {
+    if (node->nodekind == StmtK && node->kind.stmt == IterationK)
+    {
+      int outermost = loopStart < 0;
+      scanReferences(node->child[2]); /* preheader runs once */
+      if (outermost)
+        loopStart = sequence;
+      scanReferences(node->child[0]);
+      scanReferences(node->child[1]);
+      if (outermost)
+        loopStart = -1;
+      continue;
+    }
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      scanReferences(node->child[i]);
+    ++sequence;
+    if (isRegisteredParameter(node))
+      lastReference[node->symbol->memloc] = sequence;
+    else if (node->nodekind == ExpK && node->kind.exp == CallK)
+    {
+      callSites = realloc(callSites, sizeof(CallSite) * (callSiteCount + 1));
+      callSites[callSiteCount].call = node;
+      callSites[callSiteCount].threshold = loopStart >= 0 ? loopStart : sequence + 1;
+      ++callSiteCount;
+    }
+    if (checkedLength(node))
+      lastReference[checkedLength(node)->memloc] = sequence;
+  }
+}
+
+/* Function isLiveAfterCall returns TRUE if argument
+ * register reg holds a parameter of the current
+ * function that is read again after call */
+static int isLiveAfterCall(TreeNode *call, int reg)
+{
+  if (reg >= currentFunction->symbol->size || lastReference[reg] < 0)
+    return FALSE;
+  /* calls are generated in about the order they were scanned */
+  for (int i = 0; i < callSiteCount; ++i)
+  {
+    CallSite *site = &callSites[(callSiteCursor + i) % callSiteCount];
+    if (site->call == call)
+    {
+      callSiteCursor = (callSiteCursor + i + 1) % callSiteCount;
+      return lastReference[reg] >= site->threshold;
+    }
+  }
+  return TRUE;
+}
+
+/* Function readsArgumentRegister returns TRUE if
+ * evaluating node reads an argument register below
+ * limit, or calls a function that may change them */
+static int readsArgumentRegister(TreeNode *node, int limit)
+{
+  for (; node; node = node->sibling)
+  {
+    if (isRegisteredParameter(node) && node->symbol->memloc < limit)
+      return TRUE;
+    if (checkedLength(node) && checkedLength(node)->memloc < limit)
+      return TRUE;
+    if (node->nodekind == ExpK && node->kind.exp == CallK &&
+        strcmp(getName(node), "input") && strcmp(getName(node), "output"))
+      return TRUE;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      if (readsArgumentRegister(node->child[i], limit))
+        return TRUE;
+  }
+  return FALSE;
+}
+
+/* Function argumentsAreDirect returns TRUE if each
+ * argument can be evaluated straight into its
+ * register: no argument makes a call, and none reads
+ * a register already set for an earlier argument */
+static int argumentsAreDirect(TreeNode *args)
+{
+  for (int i = 0; args; ++i, args = args->sibling)
+    if (readsArgumentRegister(args, i < 4 ? i : 4))
+      return FALSE;
+  return TRUE;
+}
+
+/* Function isTailCall returns TRUE if the returned
+ * expression node is a call that can reuse the frame
+ * of the current function. The stacked arguments of
+ * the callee must fit where those of the current
+ * function were passed, and no argument may point
+ * into the frame being reused */
+static int isTailCall(TreeNode *node)
+{
+  if (!OptimizeTailCalls || inlineDepth || node->kind.exp != CallK ||
+      !strcmp(getName(node), "input") || !strcmp(getName(node), "output") || passesFrameAddress(node))
+    return FALSE;
+  return node->symbol == currentFunction->symbol || node->symbol->size <= 4 ||
+         node->symbol->size <= currentFunction->symbol->size;
+}
+
+/* Procedure cgenTailCall generates a call in return
+ * position. All arguments are evaluated before any
+ * parameter is overwritten. A function calling itself
+ * jumps back to the start of its body; other calls
+ * pop the current frame and jump to the callee, which
+ * returns straight to our caller */
+static void cgenTailCall(TreeNode *node)
+{
+  TreeNode *args;
+  int i, count = node->symbol->size;
+  int direct = count <= 4 && argumentsAreDirect(node->child[0]);
+  emitComment("->tail call");
+  cgenCount(node, PROFILE_CALLS);
+  for (i = 0, args = node->child[0]; args; ++i, args = args->sibling)
+  {
+    cgenExp(args);
+    if (direct)
+      emitRegReg("move", argumentRegisters[i], "$v0");
+    else
+      cgenPush("$v0");
+  }
+  if (!direct)
+  {
+    for (i = count - 1; i >= 0; --i)
+      if (i < 4)
+        cgenPop(argumentRegisters[i]);
+      else
+      { /* stacked parameters live above the control link */
+        cgenPop("$v0");
+        emitRegAddr("sw", "$v0", NULL, WORD_SIZE * (i - 3), "$fp");
+      }
+  }
+  if (node->symbol == currentFunction->symbol)
+    emitLabel("j", bodyLabel);
+  else
+  {
+    cgenEpilogue();
+    emitReg("j", getName(node));
+  }
+  emitComment("<-tail call");
+} /* cgenTailCall */
+
 /**********************************************/
 /* the primary function of the code generator */
 /**********************************************/
@@ -561,9 +1463,248 @@ void codeGen(TreeNode *syntaxTree, char *codefile)
   emitComment(s);
   free(s);
   cgenIOStrings();
+  if (ProfileGenerate)
+    cgenProfileCounters();
+  nameGlobals(syntaxTree);
+  if (SmallData)
+    cgenSmallData(syntaxTree);
   cgenGlobal(syntaxTree);
   /* Exit routine. */
   emitComment("End of execution.");
+  if (BufferOutput)
+    emitReg("jal", "_rt_flush");
   emitRegImm("li", "$v0", 10); /* syscall #10: exit */
   emitCode("syscall");
+  if (BoundsCheck)
+  {
+    cgenBoundsTraps();
+    emitComment("Array index out of bounds: line number in $a0");
+    emitLabelStr("_boundsError");
+    if (BufferOutput)
+      emitReg("jal", "_rt_flush");
+    emitRegReg("move", "$t0", "$a0");
+    emitRegImm("li", "$v0", 4); /* syscall #4: print string */
+    emitRegAddr("la", "$a0", "_boundsStr", 0, NULL);
+    emitCode("syscall");
+    emitRegImm("li", "$v0", 1); /* syscall #1: print int */
+    emitRegReg("move", "$a0", "$t0");
+    emitCode("syscall");
+    emitRegImm("li", "$v0", 4); /* syscall #4: print string */
+    emitRegAddr("la", "$a0", "_newline", 0, NULL);
+    emitCode("syscall");
+    emitRegImm("li", "$v0", 17); /* syscall #17: exit with status */
+    emitRegImm("li", "$a0", 1);
+    emitCode("syscall");
+  }
+  if (BufferOutput)
+    cgenRuntime();
+  free(boundsTraps);
+  boundsTraps = NULL;
+  boundsTrapCount = 0;
+  free(globalUses);
+  globalUses = NULL;
+  globalUseCount = 0;
+}
+
+/* Procedure cgenBoundsCheck branches to a trap stub
+ * if the index in $v0 is outside the accessed array.
+ * A negative index compares as a large unsigned one,
+ * so a single bgeu covers both ends of the range.
+ * An array parameter is checked against its length
+ */
+static void cgenBoundsCheck(TreeNode *access)
+{
+  BucketList length = access->symbol->length;
+  int label;
+  if (!BoundsCheck || !needsBoundsCheck(access))
+    return;
+  label = getLabel();
+  if (length && length->is_registered_argument)
+    emitRegRegLabel("bgeu", "$v0", argumentRegisters[length->memloc], label);
+  else if (length)
+  {
+    emitRegAddr("lw", "$t1", NULL, length->memloc, "$fp");
+    emitRegRegLabel("bgeu", "$v0", "$t1", label);
+  }
+  else if (access->symbol->size <= 0x7fff)
+    emitRegImmLabel("bgeu", "$v0", access->symbol->size, label);
+  else
+  {
+    emitRegImm("li", "$t1", access->symbol->size);
+    emitRegRegLabel("bgeu", "$v0", "$t1", label);
+  }
+  boundsTraps = realloc(boundsTraps, sizeof(BoundsTrap) * (boundsTrapCount + 1));
+  boundsTraps[boundsTrapCount].label = label;
+  boundsTraps[boundsTrapCount].lineno = access->lineno;
+  ++boundsTrapCount;
+}
+
+/* Procedure cgenBoundsTraps emits the stubs of the
+ * bounds checks generated since the last call
+ */
+static void cgenBoundsTraps(void)
+{
+  int i;
+  for (i = 0; i < boundsTrapCount; ++i)
+  {
+    emitLabelNum(boundsTraps[i].label);
+    emitRegImm("li", "$a0", boundsTraps[i].lineno);
+    emitReg("j", "_boundsError");
+  }
+  boundsTrapCount = 0;
+}
+
+/* Procedure cgenStoreBytes generates code to store
+ * the characters of bytes at $t0 and advance $t0
+ * past them. $t1 is used as scratch
+ */
+static void cgenStoreBytes(const char *bytes)
+{
+  int i;
+  for (i = 0; bytes[i]; ++i)
+  {
+    if (i == 0 || bytes[i] != bytes[i - 1])
+      emitRegImm("li", "$t1", bytes[i]);
+    emitRegAddr("sb", "$t1", NULL, i, "$t0");
+  }
+  emitRegRegImm("addu", "$t0", "$t0", i);
+}
+
+/* Procedure cgenRuntime generates the routines of
+ * the runtime library for buffered output. Lines
+ * printed by output() are formatted into _rt_buf,
+ * which is written with a single print string
+ * syscall when it is nearly full, before input()
+ * reads, and on exit. The routines are called with
+ * jal and change only $v0, $ra and $t0-$t5.
+ */
+static void cgenRuntime(void)
+{
+  int room = getLabel(), positive = getLabel(), count = getLabel();
+  int digits = getLabel(), digit = getLabel(), empty = getLabel();
+
+  emitComment("Flush the output buffer");
+  emitLabelStr("_rt_flush");
+  emitRegAddr("lw", "$t1", "_rt_len", 0, NULL);
+  emitRegLabel("beqz", "$t1", empty);
+  emitRegAddr("sw", "$zero", "_rt_len", 0, NULL);
+  emitRegAddr("la", "$t0", "_rt_buf", 0, NULL);
+  emitRegRegReg("addu", "$t1", "$t0", "$t1");
+  emitRegAddr("sb", "$zero", NULL, 0, "$t1");
+  emitRegReg("move", "$t1", "$a0");
+  emitRegReg("move", "$a0", "$t0");
+  emitRegImm("li", "$v0", 4); /* syscall #4: print string */
+  emitCode("syscall");
+  emitRegReg("move", "$a0", "$t1");
+  emitLabelNum(empty);
+  emitReg("jr", "$ra");
+
+  emitComment("Print the integer in $v0");
+  emitLabelStr("_rt_output");
+  emitRegReg("move", "$t2", "$v0");
+  emitRegAddr("lw", "$t1", "_rt_len", 0, NULL);
+  emitRegImmLabel("ble", "$t1", OUTPUT_BUFFER_SIZE - OUTPUT_RESERVE, room);
+  emitRegReg("move", "$t3", "$ra");
+  emitReg("jal", "_rt_flush");
+  emitRegReg("move", "$ra", "$t3");
+  emitRegImm("li", "$t1", 0);
+  emitLabelNum(room);
+  emitRegAddr("la", "$t0", "_rt_buf", 0, NULL);
+  emitRegRegReg("addu", "$t0", "$t0", "$t1");
+  cgenStoreBytes("output: ");
+  emitRegLabel("bgez", "$t2", positive);
+  cgenStoreBytes("-");
+  emitRegReg("negu", "$t2", "$t2"); /* unsigned from here on */
+  emitLabelNum(positive);
+  /* count the digits against the powers of ten */
+  emitRegImm("li", "$t3", 1);
+  emitRegAddr("la", "$t4", "_rt_powers", 0, NULL);
+  emitLabelNum(count);
+  emitRegAddr("lw", "$t1", NULL, 0, "$t4");
+  emitRegRegLabel("bltu", "$t2", "$t1", digits);
+  emitRegRegImm("addu", "$t3", "$t3", 1);
+  emitRegRegImm("addu", "$t4", "$t4", WORD_SIZE);
+  emitRegImmLabel("blt", "$t3", 10, count);
+  emitLabelNum(digits);
+  /* write the digits backwards from the end, dividing
+   * by 10 as a multiplication by 2^35 / 10 rounded up */
+  emitRegRegReg("addu", "$t0", "$t0", "$t3");
+  emitRegReg("move", "$t3", "$t0");
+  emitRegImm("li", "$t4", (int)0xcccccccdu);
+  emitLabelNum(digit);
+  emitRegReg("multu", "$t2", "$t4");
+  emitReg("mfhi", "$t1");
+  emitRegRegImm("srl", "$t1", "$t1", 3); /* quotient */
+  emitRegRegImm("sll", "$t5", "$t1", 2);
+  emitRegRegReg("addu", "$t5", "$t5", "$t1");
+  emitRegRegImm("sll", "$t5", "$t5", 1);
+  emitRegRegReg("subu", "$t5", "$t2", "$t5"); /* remainder */
+  emitRegRegImm("addu", "$t5", "$t5", '0');
+  emitRegRegImm("addu", "$t3", "$t3", -1);
+  emitRegAddr("sb", "$t5", NULL, 0, "$t3");
+  emitRegReg("move", "$t2", "$t1");
+  emitRegLabel("bnez", "$t2", digit);
+  cgenStoreBytes("\n");
+  emitRegAddr("la", "$t1", "_rt_buf", 0, NULL);
+  emitRegRegReg("subu", "$t0", "$t0", "$t1");
+  emitRegAddr("sw", "$t0", "_rt_len", 0, NULL);
+  emitReg("jr", "$ra");
+
+  if (!BatchInput)
+  {
+    emitComment("Prompt, and read an integer to $v0");
+    emitLabelStr("_rt_input");
+    emitRegAddr("lw", "$t1", "_rt_len", 0, NULL);
+    emitRegAddr("la", "$t0", "_rt_buf", 0, NULL);
+    emitRegRegReg("addu", "$t0", "$t0", "$t1");
+    cgenStoreBytes("input: ");
+    emitRegAddr("la", "$t1", "_rt_buf", 0, NULL);
+    emitRegRegReg("subu", "$t0", "$t0", "$t1");
+    emitRegAddr("sw", "$t0", "_rt_len", 0, NULL);
+    emitRegReg("move", "$t2", "$ra");
+    emitReg("jal", "_rt_flush");
+    emitRegImm("li", "$v0", 5); /* syscall #5: read int */
+    emitCode("syscall");
+    emitReg("jr", "$t2");
+  }
+}
+
+/* Procedure cgenLine adds a line table entry for
+ * the profiler when code for another source line
+ * of the current function starts */
+static void cgenLine(int lineno)
+{
+  const char *name = getName(currentFunction);
+  if (!Profile || lineno == lastLine)
+    return;
+  emitLine(lineno, name[0] == '_' ? name + 1 : name);
+  lastLine = lineno;
+}
+
+/* Procedure cgenProfileCounters generates the
+ * counters of -fprofile-generate, after the number
+ * of counters and the checksum of their sites */
+static void cgenProfileCounters(void)
+{
+  char buff[80];
+  emitComment("profile counters");
+  emitCode(".align 2");
+  sprintf(buff, "%s: .word %d, %u", PROFILE_SYMBOL, profileSites(), profileChecksum());
+  emitCode(buff);
+  sprintf(buff, ".space %d", WORD_SIZE * profileSites());
+  emitCode(buff);
+}
+
+/* Procedure cgenCount generates code to increment
+ * the given profile counter of node. It changes
+ * only $t8, which no other code uses */
+static void cgenCount(TreeNode *node, int counter)
+{
+  int offset;
+  if (!ProfileGenerate || node->site < 0)
+    return;
+  offset = WORD_SIZE * (PROFILE_HEADER_WORDS + node->site + counter);
+  emitRegAddr("lw", "$t8", PROFILE_SYMBOL, offset, NULL);
+  emitRegRegImm("addu", "$t8", "$t8", 1);
+  emitRegAddr("sw", "$t8", PROFILE_SYMBOL, offset, NULL);
 }
@@ -18,4 +18,21 @@
  */
 void codeGen(TreeNode *syntaxTree, char *codefile);
 
+/* Function countTemporaries returns the number of
+ * temporary registers used in node and its siblings
+ */
+int countTemporaries(TreeNode *node);
+
+/* Function passesFrameAddress returns TRUE if the
+ * call may pass the address of an array in the
+ * frame of the caller, so it cannot be a tail call
+ */
+int passesFrameAddress(TreeNode *call);
+
+/* Function magicDivisor computes the multiplier
+ * and shift amount for signed division by a
+ * constant d, where |d| is not a power of two
+ */
+int magicDivisor(int d, int *shift);
+
 #endif
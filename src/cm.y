@@ -11,6 +11,7 @@
 
 #include "util.h"
 #include "parse.h"
+#include "phase.h"
 
 #define YYSTYPE TreeNode *
 
@@ -374,8 +375,12 @@ int yyerror(char * message)
  * compatible with ealier versions of the TINY scanner
  */
 static int yylex(void)
-{ 
-  return getToken();
+{ TokenType token;
+  startPhase(PhaseScan);
+  token = getToken();
+  endPhase();
+  countEvent(CountTokens);
+  return token;
 }
 
 TreeNode * parse(void)
@@ -10,6 +10,7 @@
 #include "globals.h"
 #include "code.h"
 #include "util.h"
+#include "phase.h"
 
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
@@ -23,6 +24,8 @@ void emitComment(const char *c)
 /* Procedure emitCode prints a code line */
 void emitCode(const char *codeLine)
 {
+  if (codeLine[0] != '.' && strchr(codeLine, ':') == NULL)
+    countEvent(CountInstructions); /* not a directive or label */
   fprintf(code, "%s\n", codeLine);
 }
 
@@ -31,6 +34,7 @@ void emitCode(const char *codeLine)
  */
 void emitRegImm(const char *op, const char *reg, int imm)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s %d\n", op, reg, imm);
 }
 
@@ -39,6 +43,7 @@ void emitRegImm(const char *op, const char *reg, int imm)
  */
 void emitRegAddr(const char *op, const char *reg1, const char *symbol, int imm, const char *reg2)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s ", op, reg1);
   if (!symbol && !imm && reg2)
     fprintf(code, "(%s)\n", reg2);
@@ -59,6 +64,7 @@ void emitRegAddr(const char *op, const char *reg1, const char *symbol, int imm,
  */
 void emitRegRegImm(const char *op, const char *reg1, const char *reg2, int imm)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s %s %d\n", op, reg1, reg2, imm);
 }
 
@@ -67,6 +73,7 @@ void emitRegRegImm(const char *op, const char *reg1, const char *reg2, int imm)
  */
 void emitReg(const char *op, const char *reg)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s\n", op, reg);
 }
 
@@ -74,6 +81,7 @@ void emitReg(const char *op, const char *reg)
  * that takes two registers */
 void emitRegReg(const char *op, const char *reg1, const char *reg2)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s %s\n", op, reg1, reg2);
 }
 
@@ -81,6 +89,7 @@ void emitRegReg(const char *op, const char *reg1, const char *reg2)
  * that takes three registers */
 void emitRegRegReg(const char *op, const char *reg1, const char *reg2, const char *reg3)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s %s %s\n", op, reg1, reg2, reg3);
 }
 
@@ -88,6 +97,7 @@ void emitRegRegReg(const char *op, const char *reg1, const char *reg2, const cha
  * that takes one label number */
 void emitLabel(const char *op, int label)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s L%d\n", op, label);
 }
 
@@ -95,9 +105,26 @@ void emitLabel(const char *op, int label)
  * that takes one register and one label */
 void emitRegLabel(const char *op, const char *reg, int label)
 {
+  countEvent(CountInstructions);
   fprintf(code, "%s %s L%d\n", op, reg, label);
 }
 
+/* Procedure emitRegRegLabel prints a code line
+ * that takes two registers and one label */
+void emitRegRegLabel(const char *op, const char *reg1, const char *reg2, int label)
+{
+  countEvent(CountInstructions);
+  fprintf(code, "%s %s %s L%d\n", op, reg1, reg2, label);
+}
+
+/* Procedure emitRegImmLabel prints a code line
+ * that takes one register, one immediate and one label */
+void emitRegImmLabel(const char *op, const char *reg, int imm, int label)
+{
+  countEvent(CountInstructions);
+  fprintf(code, "%s %s %d L%d\n", op, reg, imm, label);
+}
+
 /* Procedure emitLabel prints a code line
  * that indicates a label */
 void emitLabelNum(int label)
@@ -111,3 +138,12 @@ void emitLabelStr(const char *symbol)
 {
   fprintf(code, "%s:\n", symbol);
 }
+
+/* Procedure emitLine prints a line table entry:
+ * the code that follows was generated from the
+ * given source line of the given function.
+ * SPIM reads it as a comment */
+void emitLine(int lineno, const char *function)
+{
+  fprintf(code, "#.loc %d %s\n", lineno, function);
+}
@@ -64,4 +64,17 @@ void emitLabelStr(const char *symbol);
  * that takes one register and one label */
 void emitRegLabel(const char *op, const char *reg, int label);
 
+/* Procedure emitRegRegLabel prints a code line
+ * that takes two registers and one label */
+void emitRegRegLabel(const char *op, const char *reg1, const char *reg2, int label);
+
+/* Procedure emitRegImmLabel prints a code line
+ * that takes one register, one immediate and one label */
+void emitRegImmLabel(const char *op, const char *reg, int imm, int label);
+
+/* Procedure emitLine prints a line table entry:
+ * the code that follows was generated from the
+ * given source line of the given function */
+void emitLine(int lineno, const char *function);
+
 #endif
@@ -0,0 +1,566 @@
+/****************************************************/
+/* File: deadcode.c                                 */
+/* Unreachable code and dead store elimination      */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <limits.h>
+#include <stdint.h>
+#include "globals.h"
+#include "util.h"
+#include "deadcode.h"
+
+/* removal statistics for the diagnostics */
+static int unreachableStatements, unreachableNodes;
+static int constantBranches, constantBranchNodes;
+static int deadStores, deadStoreNodes;
+
+/* Function countTree returns the number of nodes
+ * in the subtree rooted at t, excluding its siblings */
+static int countTree(TreeNode *t)
+{
+  int count = 0;
+  if (t == NULL)
+    return 0;
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    for (TreeNode *c = t->child[i]; c; c = c->sibling)
+      count += countTree(c);
+  return count + 1;
+}
+
+/* Function countList returns the number of nodes
+ * in t and all of its siblings */
+static int countList(TreeNode *t)
+{
+  int count = 0;
+  for (; t; t = t->sibling)
+    count += countTree(t);
+  return count;
+}
+
+/* Function constantValue evaluates an expression
+ * built only from constants and operators.
+ * Returns FALSE if t is not such an expression */
+static int constantValue(TreeNode *t, int *value)
+{
+  int left, right;
+  if (t == NULL || t->nodekind != ExpK)
+    return FALSE;
+  if (t->kind.exp == ConstK)
+  {
+    *value = t->attr.val;
+    return TRUE;
+  }
+  if (t->kind.exp != OpK || !constantValue(t->child[0], &left) || !constantValue(t->child[1], &right))
+    return FALSE;
+  switch (t->attr.op)
+  {
+  case PLUS:
+    *value = (int)((unsigned int)left + (unsigned int)right);
+    break;
+  case MINUS:
+    *value = (int)((unsigned int)left - (unsigned int)right);
+    break;
+  case TIMES:
+    *value = (int)((unsigned int)left * (unsigned int)right);
+    break;
+  case OVER:
+    if (right == 0 || (right == -1 && left == INT_MIN))
+      return FALSE;
+    *value = left / right;
+    break;
+  case LT:
+    *value = left < right;
+    break;
+  case LTE:
+    *value = left <= right;
+    break;
+  case GT:
+    *value = left > right;
+    break;
+  case GTE:
+    *value = left >= right;
+    break;
+  case EQ:
+    *value = left == right;
+    break;
+  case NEQ:
+    *value = left != right;
+    break;
+  default:
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**************************************************/
+/***********   Constant conditions      ***********/
+/**************************************************/
+
+/* Procedure pruneList replaces selection statements
+ * with a constant condition by the arm taken and
+ * removes loops whose condition is constant zero.
+ * link points to the first statement of the list */
+static void pruneList(TreeNode **link)
+{
+  while (*link)
+  {
+    TreeNode *t = *link;
+    int value;
+    if (t->nodekind == StmtK)
+    {
+      switch (t->kind.stmt)
+      {
+      case CompoundK:
+        pruneList(&t->child[1]);
+        break;
+      case SelectionK:
+        pruneList(&t->child[1]);
+        pruneList(&t->child[2]);
+        if (constantValue(t->child[0], &value))
+        {
+          TreeNode *taken = value ? t->child[1] : t->child[2];
+          ++constantBranches;
+          constantBranchNodes += countTree(t) - countList(taken);
+          if (taken == NULL)
+          {
+            *link = t->sibling;
+            continue;
+          }
+          taken->sibling = t->sibling;
+          *link = t = taken;
+        }
+        break;
+      case IterationK:
+        pruneList(&t->child[1]);
+        if (constantValue(t->child[0], &value) && !value)
+        {
+          ++constantBranches;
+          constantBranchNodes += countTree(t);
+          *link = t->sibling;
+          continue;
+        }
+        break;
+      case ReturnK:
+        break;
+      }
+    }
+    link = &t->sibling;
+  }
+}
+
+/**************************************************/
+/***********   Unreachable statements   ***********/
+/**************************************************/
+
+static int reachStmt(TreeNode *t);
+
+/* Function reachList returns TRUE if control can
+ * reach the end of the statement list. Statements
+ * after one that cannot complete are removed */
+static int reachList(TreeNode *list)
+{
+  for (TreeNode *t = list; t; t = t->sibling)
+    if (!reachStmt(t))
+    {
+      if (t->sibling)
+      {
+        for (TreeNode *s = t->sibling; s; s = s->sibling)
+          ++unreachableStatements;
+        unreachableNodes += countList(t->sibling);
+        t->sibling = NULL;
+      }
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/* Function reachStmt returns TRUE if control can
+ * continue after the statement t */
+static int reachStmt(TreeNode *t)
+{
+  int value;
+  if (t->nodekind != StmtK)
+    return TRUE;
+  switch (t->kind.stmt)
+  {
+  case CompoundK:
+    return reachList(t->child[1]);
+  case SelectionK:
+  {
+    int thenReached = reachList(t->child[1]);
+    int elseReached = reachList(t->child[2]);
+    return thenReached || elseReached;
+  }
+  case IterationK:
+    reachList(t->child[1]);
+    /* without break statements, while with a nonzero constant never ends */
+    return !(constantValue(t->child[0], &value) && value);
+  case ReturnK:
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**************************************************/
+/***********   Dead stores              ***********/
+/**************************************************/
+
+/* Liveness is tracked for scalar locals and parameters.
+ * Each gets an index into a bit set; the symbols are
+ * found through a small open-addressing hash table */
+static BucketList *trackedTable;
+static int *trackedIndex;
+static int trackedMask;
+static int trackedCount;
+static int setWords;
+
+typedef unsigned int *Set;
+
+static Set newSet(void)
+{
+  return calloc(setWords, sizeof(unsigned int));
+}
+
+static int inSet(Set s, int i)
+{
+  return (s[i / 32] >> (i % 32)) & 1;
+}
+
+static void addToSet(Set s, int i)
+{
+  s[i / 32] |= 1u << (i % 32);
+}
+
+static int trackedSlot(BucketList symbol)
+{
+  int slot = (int)(((uintptr_t)symbol >> 4) & trackedMask);
+  while (trackedTable[slot] && trackedTable[slot] != symbol)
+    slot = (slot + 1) & trackedMask;
+  return slot;
+}
+
+/* Returns the index of symbol, or -1 if it is not tracked */
+static int symbolIndex(BucketList symbol)
+{
+  int slot;
+  if (symbol == NULL || trackedTable == NULL)
+    return -1;
+  slot = trackedSlot(symbol);
+  return trackedTable[slot] ? trackedIndex[slot] : -1;
+}
+
+static void trackSymbol(BucketList symbol)
+{
+  int slot = trackedSlot(symbol);
+  if (trackedTable[slot] == NULL)
+  {
+    trackedTable[slot] = symbol;
+    trackedIndex[slot] = trackedCount++;
+  }
+}
+
+/* Function collectTracked returns the number of scalars
+ * declared in the list t and the statements nested in it.
+ * Unless counting, the scalars are also entered into
+ * the tracked symbol table */
+static int collectTracked(TreeNode *t, int counting)
+{
+  int count = 0;
+  for (; t; t = t->sibling)
+  {
+    if ((t->nodekind == ParamK && t->kind.param == VarParamK) ||
+        (t->nodekind == DeclK && t->kind.decl == VarDeclK))
+    {
+      ++count;
+      if (!counting)
+        trackSymbol(t->symbol);
+    }
+    else if (t->nodekind == StmtK) /* nested compound statements declare more locals */
+      for (int i = 0; i < MAXCHILDREN; ++i)
+        count += collectTracked(t->child[i], counting);
+  }
+  return count;
+}
+
+/* Procedure trackFunction numbers the scalars of a function */
+static void trackFunction(TreeNode *function)
+{
+  int count = collectTracked(function->child[1], TRUE) +
+              collectTracked(function->child[2], TRUE);
+  int size = 4;
+  while (size < 2 * count)
+    size *= 2;
+  trackedMask = size - 1;
+  trackedTable = calloc(size, sizeof(BucketList));
+  trackedIndex = calloc(size, sizeof(int));
+  trackedCount = 0;
+  collectTracked(function->child[1], FALSE);
+  collectTracked(function->child[2], FALSE);
+  setWords = (trackedCount + 31) / 32 + 1;
+}
+
+static void untrackFunction(void)
+{
+  free(trackedTable);
+  free(trackedIndex);
+  trackedTable = NULL;
+  trackedIndex = NULL;
+}
+
+static void summarizeStmt(TreeNode *t, Set gen, Set kill);
+
+/* Procedure summarizeExp appends the expression t to
+ * the summary (gen, kill) of code executed before it.
+ * gen holds variables read before being written,
+ * kill holds variables written. Operands are visited
+ * in the order cgen evaluates them */
+static void summarizeExp(TreeNode *t, Set gen, Set kill)
+{
+  int index;
+  if (t == NULL)
+    return;
+  switch (t->kind.exp)
+  {
+  case AssignK:
+    if (t->child[0]->kind.exp == ArrK)
+      summarizeExp(t->child[0]->child[0], gen, kill);
+    summarizeExp(t->child[1], gen, kill);
+    if (t->child[0]->kind.exp == VarK && (index = symbolIndex(t->child[0]->symbol)) >= 0)
+      addToSet(kill, index);
+    break;
+  case OpK:
+    summarizeExp(t->child[0], gen, kill);
+    summarizeExp(t->child[1], gen, kill);
+    break;
+  case ConstK:
+  case TempK:
+    break;
+  case VarK:
+    if ((index = symbolIndex(t->symbol)) >= 0 && !inSet(kill, index))
+      addToSet(gen, index);
+    break;
+  case ArrK:
+    summarizeExp(t->child[0], gen, kill);
+    break;
+  case CallK:
+  case InlineK: /* an inlined body only uses its own renamed variables */
+    for (TreeNode *arg = t->child[0]; arg; arg = arg->sibling)
+      summarizeExp(arg, gen, kill);
+    break;
+  }
+}
+
+/* Procedure summarizeList appends a statement list */
+static void summarizeList(TreeNode *t, Set gen, Set kill)
+{
+  for (; t; t = t->sibling)
+    summarizeStmt(t, gen, kill);
+}
+
+/* Procedure summarizeStmt appends the statement t to
+ * the summary (gen, kill) of code executed before it */
+static void summarizeStmt(TreeNode *t, Set gen, Set kill)
+{
+  if (t->nodekind == ExpK)
+  {
+    summarizeExp(t, gen, kill);
+    return;
+  }
+  if (t->nodekind != StmtK)
+    return;
+  switch (t->kind.stmt)
+  {
+  case CompoundK:
+    summarizeList(t->child[1], gen, kill);
+    break;
+  case SelectionK:
+  {
+    Set thenGen = newSet(), thenKill = newSet();
+    Set elseGen = newSet(), elseKill = newSet();
+    summarizeExp(t->child[0], gen, kill);
+    summarizeList(t->child[1], thenGen, thenKill);
+    summarizeList(t->child[2], elseGen, elseKill);
+    for (int i = 0; i < setWords; ++i)
+    {
+      gen[i] |= (thenGen[i] | elseGen[i]) & ~kill[i];
+      kill[i] |= thenKill[i] & elseKill[i];
+    }
+    free(thenGen);
+    free(thenKill);
+    free(elseGen);
+    free(elseKill);
+    break;
+  }
+  case IterationK:
+  { /* the body may run zero times, so it kills nothing */
+    Set bodyGen = newSet(), bodyKill = newSet();
+    summarizeExp(t->child[0], gen, kill);
+    summarizeList(t->child[1], bodyGen, bodyKill);
+    for (int i = 0; i < setWords; ++i)
+      gen[i] |= bodyGen[i] & ~kill[i];
+    free(bodyGen);
+    free(bodyKill);
+    break;
+  }
+  case ReturnK:
+    summarizeExp(t->child[0], gen, kill);
+    for (int i = 0; i < setWords; ++i)
+      kill[i] = ~0u;
+    break;
+  }
+}
+
+/* Procedure liveBefore turns live, the set of variables
+ * live after statement t, into the set live before it */
+static void liveBefore(TreeNode *t, Set live)
+{
+  Set gen = newSet(), kill = newSet();
+  summarizeStmt(t, gen, kill);
+  for (int i = 0; i < setWords; ++i)
+    live[i] = gen[i] | (live[i] & ~kill[i]);
+  free(gen);
+  free(kill);
+}
+
+/* Function hasSideEffect returns TRUE if evaluating
+ * t calls a function or assigns a variable */
+static int hasSideEffect(TreeNode *t)
+{
+  if (t == NULL)
+    return FALSE;
+  if (t->nodekind == ExpK && (t->kind.exp == CallK || t->kind.exp == InlineK || t->kind.exp == AssignK))
+    return TRUE;
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    for (TreeNode *c = t->child[i]; c; c = c->sibling)
+      if (hasSideEffect(c))
+        return TRUE;
+  return FALSE;
+}
+
+static int sweepList(TreeNode **link, Set liveOut);
+
+/* Function sweepStmt removes dead stores inside t given
+ * the variables live after it. Returns TRUE if t itself
+ * is a dead store and should be removed */
+static int sweepStmt(TreeNode *t, Set liveOut, int *changed)
+{
+  if (t->nodekind == ExpK)
+  {
+    int index;
+    return t->kind.exp == AssignK && t->child[0]->kind.exp == VarK &&
+           (index = symbolIndex(t->child[0]->symbol)) >= 0 &&
+           !inSet(liveOut, index) && !hasSideEffect(t->child[1]);
+  }
+  if (t->nodekind != StmtK)
+    return FALSE;
+  switch (t->kind.stmt)
+  {
+  case CompoundK:
+    *changed |= sweepList(&t->child[1], liveOut);
+    break;
+  case SelectionK:
+    *changed |= sweepList(&t->child[1], liveOut);
+    *changed |= sweepList(&t->child[2], liveOut);
+    break;
+  case IterationK:
+  { /* the body is followed by the loop itself */
+    Set head = newSet();
+    memcpy(head, liveOut, sizeof(unsigned int) * setWords);
+    liveBefore(t, head);
+    *changed |= sweepList(&t->child[1], head);
+    free(head);
+    break;
+  }
+  case ReturnK:
+    break;
+  }
+  return FALSE;
+}
+
+/* Function sweepList removes dead stores from the
+ * statement list at *link, given the variables live
+ * after it. Returns TRUE if anything was removed */
+static int sweepList(TreeNode **link, Set liveOut)
+{
+  int count = 0, changed = FALSE;
+  TreeNode **stmts;
+  Set live;
+  for (TreeNode *t = *link; t; t = t->sibling)
+    ++count;
+  if (count == 0)
+    return FALSE;
+  stmts = malloc(sizeof(TreeNode *) * count);
+  count = 0;
+  for (TreeNode *t = *link; t; t = t->sibling)
+    stmts[count++] = t;
+  live = newSet();
+  memcpy(live, liveOut, sizeof(unsigned int) * setWords);
+  for (int i = count - 1; i >= 0; --i)
+  {
+    if (sweepStmt(stmts[i], live, &changed))
+    {
+      ++deadStores;
+      deadStoreNodes += countTree(stmts[i]);
+      stmts[i] = NULL;
+      changed = TRUE;
+    }
+    else
+      liveBefore(stmts[i], live);
+  }
+  /* relink the remaining statements */
+  for (int i = 0; i < count; ++i)
+    if (stmts[i])
+    {
+      *link = stmts[i];
+      link = &stmts[i]->sibling;
+    }
+  *link = NULL;
+  free(live);
+  free(stmts);
+  return changed;
+}
+
+/* Procedure eliminateDeadStores removes assignments
+ * to scalars of the function that are never read */
+static void eliminateDeadStores(TreeNode *function)
+{
+  Set liveOut;
+  trackFunction(function);
+  liveOut = newSet(); /* nothing local is live after return */
+  while (sweepList(&function->child[2]->child[1], liveOut))
+    ;
+  free(liveOut);
+  untrackFunction();
+}
+
+/* Procedure eliminateDeadCode removes statements
+ * that follow a return, branches and loops whose
+ * condition is a constant, and assignments to
+ * local variables that are never read again.
+ * Counts of removed nodes are printed to the
+ * listing file if TraceOptimize is set.
+ */
+void eliminateDeadCode(TreeNode *syntaxTree)
+{
+  unreachableStatements = unreachableNodes = 0;
+  constantBranches = constantBranchNodes = 0;
+  deadStores = deadStoreNodes = 0;
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+  {
+    if (t->nodekind != DeclK || t->kind.decl != FunDeclK)
+      continue;
+    pruneList(&t->child[2]->child[1]);
+    reachList(t->child[2]->child[1]);
+    eliminateDeadStores(t);
+  }
+  if (TraceOptimize)
+  {
+    fprintf(listing, "Dead code elimination:\n");
+    fprintf(listing, "  unreachable statements: %d (%d nodes)\n", unreachableStatements, unreachableNodes);
+    fprintf(listing, "  constant conditions:    %d (%d nodes)\n", constantBranches, constantBranchNodes);
+    fprintf(listing, "  dead stores:            %d (%d nodes)\n", deadStores, deadStoreNodes);
+    fprintf(listing, "  total nodes removed:    %d\n", unreachableNodes + constantBranchNodes + deadStoreNodes);
+  }
+}
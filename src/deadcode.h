@@ -0,0 +1,22 @@
+/****************************************************/
+/* File: deadcode.h                                 */
+/* Unreachable code and dead store elimination      */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _DEADCODE_H_
+#define _DEADCODE_H_
+
+#include "globals.h"
+
+/* Procedure eliminateDeadCode removes statements
+ * that follow a return, branches and loops whose
+ * condition is a constant, and assignments to
+ * local variables that are never read again.
+ * Counts of removed nodes are printed to the
+ * listing file if TraceOptimize is set.
+ */
+void eliminateDeadCode(TreeNode *syntaxTree);
+
+#endif
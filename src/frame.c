@@ -0,0 +1,285 @@
+/****************************************************/
+/* File: frame.c                                    */
+/* Stack slot sharing by the lifetimes of locals    */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "frame.h"
+
+/* A variable kept in the frame, and the positions
+ * in evaluation order between which it is live.
+ * first > last if it is never referenced */
+typedef struct
+{
+  BucketList symbol;
+  int words; /* size in the frame */
+  int first, last;
+  int word; /* first word given, counted down from the top of the locals */
+} Slot;
+
+/* The positions a loop spans: a variable referenced
+ * in it may be live around its back edge */
+typedef struct
+{
+  int start, end;
+} LoopSpan;
+
+static Slot *slots;
+static int slotCount;
+static LoopSpan *loops;
+static int loopCount;
+static int position; /* in evaluation order */
+
+static int framesBefore, framesAfter, shrunkFrames, functionCount;
+
+/* Function isSlot returns TRUE if symbol is kept in
+ * a slot of the frame below the frame pointer:
+ * locals, and parameters of inlined bodies */
+static int isSlot(BucketList symbol)
+{
+  return symbol->symbol_class == Local ||
+         (symbol->symbol_class == Parameter && !symbol->is_registered_argument && symbol->memloc < 0);
+}
+
+/* Function slotOf returns the slot of symbol, adding
+ * it the first time */
+static Slot *slotOf(BucketList symbol)
+{
+  for (int i = slotCount - 1; i >= 0; --i)
+    if (slots[i].symbol == symbol)
+      return &slots[i];
+  slots = realloc(slots, sizeof(Slot) * (slotCount + 1));
+  slots[slotCount].symbol = symbol;
+  slots[slotCount].words = symbol->symbol_class == Local && symbol->is_array ? symbol->size : 1;
+  slots[slotCount].first = INT_MAX;
+  slots[slotCount].last = INT_MIN;
+  slots[slotCount].word = 0;
+  return &slots[slotCount++];
+}
+
+/* Procedure touch makes symbol live from start to
+ * end, if it is kept in the frame */
+static void touch(BucketList symbol, int start, int end)
+{
+  Slot *slot;
+  if (symbol == NULL || !isSlot(symbol))
+    return;
+  slot = slotOf(symbol);
+  if (start < slot->first)
+    slot->first = start;
+  if (end > slot->last)
+    slot->last = end;
+}
+
+static void walkStmts(TreeNode *t);
+
+/* Procedure walkInlines walks the bodies inlined in
+ * the expression t. The parameters of a body are
+ * stored while the arguments are evaluated, so they
+ * are live from start, the start of the whole
+ * expression */
+static void walkInlines(TreeNode *t, int start)
+{
+  if (t->nodekind == ExpK && t->kind.exp == InlineK)
+  {
+    for (TreeNode *a = t->child[0]; a; a = a->sibling)
+      walkInlines(a, start);
+    for (TreeNode *p = t->child[2]; p; p = p->sibling)
+      touch(p->symbol, start, start);
+    walkStmts(t->child[1]);
+    return;
+  }
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    for (TreeNode *c = t->child[i]; c; c = c->sibling)
+      walkInlines(c, start);
+}
+
+/* Procedure touchReferences makes the variables of
+ * the expression t live from start to end, leaving
+ * out inlined bodies */
+static void touchReferences(TreeNode *t, int start, int end)
+{
+  if (t->nodekind != ExpK)
+    return;
+  if (t->kind.exp == VarK || t->kind.exp == ArrK)
+    touch(t->symbol, start, end);
+  if (t->kind.exp == ArrK) /* read by its bounds check */
+    touch(t->symbol->length, start, end);
+  for (int i = 0; i < MAXCHILDREN; ++i)
+  {
+    if (t->kind.exp == InlineK && i > 0)
+      break;
+    for (TreeNode *c = t->child[i]; c; c = c->sibling)
+      touchReferences(c, start, end);
+  }
+}
+
+/* Procedure walkExp numbers a whole expression. The
+ * order in which its operands are evaluated is left
+ * to the code generator, so its variables are live
+ * during all of it */
+static void walkExp(TreeNode *t)
+{
+  int start = ++position;
+  walkInlines(t, start);
+  touchReferences(t, start, ++position);
+}
+
+/* Procedure walkStmts numbers the statements t and
+ * its siblings in evaluation order */
+static void walkStmts(TreeNode *t)
+{
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == ExpK)
+    {
+      walkExp(t);
+      continue;
+    }
+    if (t->nodekind != StmtK)
+      continue;
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+      for (TreeNode *d = t->child[0]; d; d = d->sibling)
+        if (d->nodekind == DeclK && d->symbol && isSlot(d->symbol))
+          slotOf(d->symbol);
+      walkStmts(t->child[1]);
+      break;
+    case SelectionK:
+      walkExp(t->child[0]);
+      walkStmts(t->child[1]);
+      walkStmts(t->child[2]);
+      break;
+    case IterationK:
+    {
+      LoopSpan span;
+      int preheader = position + 1;
+      for (TreeNode *p = t->child[2]; p; p = p->sibling)
+        walkExp(p); /* preheader, run once */
+      span.start = ++position;
+      walkExp(t->child[0]);
+      walkStmts(t->child[1]);
+      span.end = ++position;
+      /* the temporaries set in the preheader are read
+       * in the whole loop, and may hold the address of
+       * an array referenced nowhere else */
+      for (TreeNode *p = t->child[2]; p; p = p->sibling)
+        touchReferences(p, preheader, span.end);
+      loops = realloc(loops, sizeof(LoopSpan) * (loopCount + 1));
+      loops[loopCount++] = span;
+      break;
+    }
+    case ReturnK:
+      if (t->child[0])
+        walkExp(t->child[0]);
+      break;
+    }
+  }
+}
+
+/* Procedure extendOverLoops makes a variable live
+ * in a loop live in all of it. Inner loops end
+ * first, so a variable extended over one is then
+ * extended over the loops around it */
+static void extendOverLoops(void)
+{
+  for (int l = 0; l < loopCount; ++l)
+    for (int i = 0; i < slotCount; ++i)
+      if (slots[i].first <= loops[l].end && slots[i].last >= loops[l].start)
+      {
+        if (loops[l].start < slots[i].first)
+          slots[i].first = loops[l].start;
+        if (loops[l].end > slots[i].last)
+          slots[i].last = loops[l].end;
+      }
+}
+
+/* Function interferes returns TRUE if the two slots
+ * are live at the same time */
+static int interferes(const Slot *a, const Slot *b)
+{
+  return a->first <= a->last && b->first <= b->last && a->first <= b->last && b->first <= a->last;
+}
+
+/* Larger slots are placed first, then the ones
+ * live earlier */
+static int compareSlots(const void *x, const void *y)
+{
+  const Slot *a = x, *b = y;
+  if (a->words != b->words)
+    return b->words - a->words;
+  return a->first < b->first ? -1 : a->first > b->first;
+}
+
+/* Procedure placeSlots gives each slot the lowest
+ * words not taken by a slot interfering with it,
+ * and sets the new offsets. Returns the words used */
+static int placeSlots(void)
+{
+  int used = 0;
+  if (slotCount > 1)
+    qsort(slots, slotCount, sizeof(Slot), compareSlots);
+  for (int i = 0; i < slotCount; ++i)
+  {
+    int moved = TRUE;
+    slots[i].word = 0;
+    while (moved)
+    {
+      moved = FALSE;
+      for (int j = 0; j < i; ++j)
+        if (interferes(&slots[i], &slots[j]) && slots[i].word < slots[j].word + slots[j].words &&
+            slots[j].word < slots[i].word + slots[i].words)
+        {
+          slots[i].word = slots[j].word + slots[j].words;
+          moved = TRUE;
+        }
+    }
+    if (slots[i].word + slots[i].words > used)
+      used = slots[i].word + slots[i].words;
+    /* an array starts at its lowest address */
+    slots[i].symbol->memloc = -2 * WORD_SIZE - WORD_SIZE * (slots[i].word + slots[i].words - 1);
+  }
+  return used;
+}
+
+/* Procedure layoutFunction packs the frame of the
+ * function declared by t */
+static void layoutFunction(TreeNode *t)
+{
+  int before = -t->symbol->memloc, after;
+  slotCount = loopCount = position = 0;
+  walkStmts(t->child[2]);
+  extendOverLoops();
+  after = WORD_SIZE + WORD_SIZE * placeSlots();
+  t->symbol->memloc = -after;
+  framesBefore += before;
+  framesAfter += after;
+  ++functionCount;
+  if (after < before)
+  {
+    ++shrunkFrames;
+    if (TraceOptimize)
+      fprintf(listing, "  %s: frame of %d bytes packed into %d\n", t->attr.name, before, after);
+  }
+}
+
+void layoutFrames(TreeNode *syntaxTree)
+{
+  framesBefore = framesAfter = shrunkFrames = functionCount = 0;
+  if (TraceOptimize)
+    fprintf(listing, "Stack slot sharing:\n");
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+    if (t->nodekind == DeclK && t->kind.decl == FunDeclK)
+      layoutFunction(t);
+  if (TraceOptimize)
+    fprintf(listing, "  %d of %d frames shrunk, from %d to %d bytes in all\n", shrunkFrames, functionCount,
+            framesBefore, framesAfter);
+  free(slots);
+  free(loops);
+  slots = NULL;
+  loops = NULL;
+}
@@ -0,0 +1,24 @@
+/****************************************************/
+/* File: frame.h                                    */
+/* Stack slot sharing by the lifetimes of locals    */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include "globals.h"
+
+/* Procedure layoutFrames gives local variables, and
+ * the parameters of inlined bodies, new offsets in
+ * the frame of their function, so that variables
+ * never live at the same time share their slots.
+ * The frame of each function shrinks to the slots
+ * used. It must run after the tree is optimized.
+ * The frame sizes before and after are printed to
+ * the listing file if TraceOptimize is set.
+ */
+void layoutFrames(TreeNode *syntaxTree);
+
+#endif
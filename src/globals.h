@@ -40,7 +40,9 @@ typedef struct SymbolTableRec *SymbolTable;
 
 enum
 {
-   WORD_SIZE = 4
+   WORD_SIZE = 4,
+   WORD_SHIFT = 2, /* log2(WORD_SIZE) */
+   NUM_TEMPORARIES = 8 /* $s0-$s7 */
 };
 
 /* MAXRESERVED = the number of reserved words */
@@ -95,6 +97,8 @@ typedef enum
    VarK,
    ArrK,
    CallK,
+   InlineK, /* call replaced by the callee body */
+   TempK    /* value kept in a temporary register */
 } ExpKind;
 typedef enum
 {
@@ -153,6 +157,7 @@ typedef struct treeNode
    } attr;
    ExpType type;      /* for type checking of exps */
    BucketList symbol; /* for symbol declaration & reference  */
+   int site;          /* first profile counter, or -1 */
 } TreeNode;
 
 /* SIZE is the size of the hash table */
@@ -192,6 +197,10 @@ typedef struct BucketListRec
    * - global/local array: array size
    * - function: number of parameters */
    int size;
+   /* BucketList length
+   * - array parameter: the parameter holding the
+   *   length of the array, with -fbounds-check */
+   struct BucketListRec *length;
 
    TreeNode *treeNode;
    struct BucketListRec *next;
@@ -237,6 +246,207 @@ extern int TraceAnalyze;
  */
 extern int TraceCode;
 
+/* TraceOptimize = TRUE causes the optimization
+ * passes to report what they changed to the
+ * listing file
+ */
+extern int TraceOptimize;
+
+/* TraceSSA = TRUE causes the SSA form of every
+ * function, annotated with the results of constant
+ * propagation and value numbering, to be printed
+ * to the listing file
+ */
+extern int TraceSSA;
+
+/* TimeReport = TRUE causes the time, memory and
+ * counts of every phase to be printed to stderr
+ * after the code is generated
+ */
+extern int TimeReport;
+
+/* ReportJSON = TRUE causes that report to be
+ * printed as JSON
+ */
+extern int ReportJSON;
+
+/* PerfCounters = TRUE adds the cycles, instructions,
+ * branch misses and last level cache misses of
+ * every phase to that report, if the system lets
+ * the compiler read the hardware counters. They
+ * count user mode only, so reading them on every
+ * token adds to the times but not to the counts
+ */
+extern int PerfCounters;
+
+/* TimeTrace = TRUE causes the phases, and each
+ * function in symbol table construction, type
+ * checking and code generation, to be written as a
+ * timeline to <file>.trace.json
+ */
+extern int TimeTrace;
+
+/**************************************************/
+/***********   Flags for optimization  ************/
+/**************************************************/
+
+/* InlineFunctions = TRUE causes calls to small
+ * non-recursive functions to be inlined
+ */
+extern int InlineFunctions;
+
+/* InlineLimit is the largest number of syntax tree
+ * nodes in the body of a function to be inlined
+ */
+extern int InlineLimit;
+
+/* MoveLoopInvariants = TRUE causes expressions that
+ * do not change inside a loop to be computed once
+ * before the loop
+ */
+extern int MoveLoopInvariants;
+
+/* OptimizeTailCalls = TRUE causes calls in return
+ * statements to reuse the frame of the caller
+ */
+extern int OptimizeTailCalls;
+
+/* PropagateConstants = TRUE causes expressions and
+ * branch conditions that have the same value on
+ * every execution to be replaced by constants
+ */
+extern int PropagateConstants;
+
+/* NumberValues = TRUE causes an expression whose
+ * value was already computed on every path to it
+ * to be read from a temporary register instead
+ */
+extern int NumberValues;
+
+/* BoundsCheck = TRUE causes array indices to be
+ * checked at run time, except where range analysis
+ * proves the index is inside the array
+ */
+extern int BoundsCheck;
+
+/* ShareStackSlots = TRUE causes local variables
+ * that are never live at the same time to share
+ * their slots in the frame
+ */
+extern int ShareStackSlots;
+
+/* SmallData = TRUE causes global variables of at
+ * most SmallDataLimit bytes to be declared with
+ * .extern, so that SPIM addresses them from $gp.
+ * The most accessed ones are placed first
+ */
+extern int SmallData;
+extern int SmallDataLimit;
+
+/* ProfileGenerate = TRUE causes the code to count
+ * function entries, calls, branch arms and loop
+ * iterations. The simulator adds the counts to
+ * <file>.prof when the program exits
+ */
+extern int ProfileGenerate;
+
+/* ProfileUse = TRUE causes <file>.prof to guide
+ * branch layout, function order, inlining and the
+ * loops given temporary registers
+ */
+extern int ProfileUse;
+
+/**************************************************/
+/***********   Flags for the runtime   ************/
+/**************************************************/
+
+/* BufferOutput = TRUE causes output() to format
+ * integers into a buffer that is printed with one
+ * syscall when full, before input() and on exit
+ */
+extern int BufferOutput;
+
+/* BatchInput = TRUE causes input() to read without
+ * printing the "input: " prompt
+ */
+extern int BatchInput;
+
+/* Simulate = TRUE causes the code file to be run
+ * by the built-in MIPS simulator after it is
+ * generated. A .tm or .tmb file given instead of a
+ * source file is run without compiling
+ */
+extern int Simulate;
+
+/* SimStats = TRUE causes the simulator to print
+ * the instructions, cycles, loads, stores, calls
+ * and syscalls executed to stderr
+ */
+extern int SimStats;
+
+/* Profile = TRUE causes the code generator to
+ * write a line table into the code file, and the
+ * simulator to count instructions, calls and
+ * memory accesses per function and source line
+ */
+extern int Profile;
+
+/**************************************************/
+/***********   Flags for the target    ************/
+/**************************************************/
+
+/* TargetX86 = TRUE causes x86-64 assembly to be
+ * generated to <file>.s instead of SPIM code, and
+ * linked with the runtime library into the native
+ * executable <file>
+ */
+extern int TargetX86;
+
+/* RunJIT = TRUE causes the x86-64 code to be
+ * assembled into memory and run in the compiler
+ * process instead of being written to a file
+ */
+extern int RunJIT;
+
+/* TargetBytecode = TRUE causes register bytecode
+ * to be generated to <file>.bc instead of SPIM code
+ */
+extern int TargetBytecode;
+
+/* RunBytecode = TRUE causes the bytecode to be run
+ * by the interpreter after it is generated. A .bc
+ * file given instead of a source file is run
+ * without compiling
+ */
+extern int RunBytecode;
+
+/* WriteImage = TRUE causes the SPIM code to be
+ * assembled into a binary image, <file>.tmb, which
+ * the simulator runs without parsing
+ */
+extern int WriteImage;
+
+/* ImageOnly = TRUE keeps the binary image but not
+ * the text code file
+ */
+extern int ImageOnly;
+
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error;
+
+/* The heap is used through these, which keep the
+ * bytes in use by each phase when TimeReport is
+ * set. They are implemented in phase.c
+ */
+void *phaseMalloc(size_t size);
+void *phaseCalloc(size_t count, size_t size);
+void *phaseRealloc(void *ptr, size_t size);
+void phaseFree(void *ptr);
+
+#ifndef NO_ALLOCATION_HOOKS
+#define malloc(size) phaseMalloc(size)
+#define calloc(count, size) phaseCalloc(count, size)
+#define realloc(ptr, size) phaseRealloc(ptr, size)
+#define free(ptr) phaseFree(ptr)
+#endif
 #endif
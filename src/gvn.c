@@ -0,0 +1,182 @@
+/****************************************************/
+/* File: gvn.c                                      */
+/* Global value numbering                           */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <stdint.h>
+#include "globals.h"
+#include "gvn.h"
+
+/* What an instruction computes, in terms of the
+ * numbers of its operands */
+typedef enum
+{
+  ConstValue,
+  BinaryValue,
+  LoadValue,
+  PhiValue
+} ValueKind;
+
+typedef struct
+{
+  IrInstr *instr; /* first instruction with this value */
+  ValueKind kind;
+  TokenType op;
+  int constant;
+  IrInstr *left, *right; /* memory and index of a load */
+  BucketList symbol;
+} Value;
+
+static Value *valueTable;
+static int valueMask;
+
+static IrInstr *numberOf(IrInstr *i)
+{
+  return i ? i->number : NULL;
+}
+
+/* Function makeValue describes what i computes.
+ * Returns FALSE if i is the only instruction that
+ * can compute its value */
+static int makeValue(IrInstr *i, Value *v)
+{
+  v->instr = i;
+  v->op = i->op;
+  v->left = v->right = NULL;
+  v->symbol = NULL;
+  if (i->opcode == IrConst || i->lattice == LatticeConst)
+  {
+    v->kind = ConstValue;
+    v->constant = i->opcode == IrConst ? i->value : i->constant;
+    return TRUE;
+  }
+  switch (i->opcode)
+  {
+  case IrBinary:
+  {
+    IrInstr *left = numberOf(i->operands[0]), *right = numberOf(i->operands[1]), *swap;
+    TokenType op = i->op;
+    if (op == GT || op == GTE)
+    { /* a > b is b < a */
+      swap = left;
+      left = right;
+      right = swap;
+      op = op == GT ? LT : LTE;
+    }
+    else if ((op == PLUS || op == TIMES || op == EQ || op == NEQ) && left->id > right->id)
+    {
+      swap = left;
+      left = right;
+      right = swap;
+    }
+    v->kind = BinaryValue;
+    v->op = op;
+    v->left = left;
+    v->right = right;
+    return TRUE;
+  }
+  case IrLoad:
+    v->kind = LoadValue;
+    v->symbol = i->symbol;
+    v->left = numberOf(i->operands[0]);
+    v->right = i->operandCount > 1 ? numberOf(i->operands[1]) : NULL;
+    return TRUE;
+  case IrPhi:
+    v->kind = PhiValue;
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+static unsigned int hashValue(Value *v)
+{
+  unsigned int h = (unsigned int)v->kind * 31u;
+  switch (v->kind)
+  {
+  case ConstValue:
+    h += (unsigned int)v->constant;
+    break;
+  case PhiValue:
+    h += (unsigned int)v->instr->block->id;
+    for (int p = 0; p < v->instr->operandCount; ++p)
+      h = h * 31u + (unsigned int)numberOf(v->instr->operands[p])->id;
+    break;
+  default:
+    h += (unsigned int)v->op;
+    h = h * 31u + (unsigned int)((uintptr_t)v->symbol >> 4);
+    h = h * 31u + (unsigned int)(v->left ? v->left->id : -1);
+    h = h * 31u + (unsigned int)(v->right ? v->right->id : -1);
+    break;
+  }
+  return h * 2654435761u;
+}
+
+static int sameValue(Value *a, Value *b)
+{
+  if (a->kind != b->kind)
+    return FALSE;
+  switch (a->kind)
+  {
+  case ConstValue:
+    return a->constant == b->constant;
+  case PhiValue:
+    if (a->instr->block != b->instr->block)
+      return FALSE;
+    for (int p = 0; p < a->instr->operandCount; ++p)
+      if (numberOf(a->instr->operands[p]) != numberOf(b->instr->operands[p]))
+        return FALSE;
+    return TRUE;
+  default:
+    return a->op == b->op && a->symbol == b->symbol && a->left == b->left && a->right == b->right;
+  }
+}
+
+/* Procedure numberInstr finds the first instruction
+ * computing the same value as i, or enters i */
+static void numberInstr(IrInstr *i)
+{
+  Value v;
+  int slot;
+  if (i->lattice == LatticeTop || !makeValue(i, &v))
+    return;
+  slot = (int)(hashValue(&v) & (unsigned int)valueMask);
+  while (valueTable[slot].instr)
+  {
+    if (sameValue(&valueTable[slot], &v))
+    {
+      i->number = valueTable[slot].instr;
+      return;
+    }
+    slot = (slot + 1) & valueMask;
+  }
+  valueTable[slot] = v;
+}
+
+/* Blocks are visited in reverse postorder, so the
+ * operands of an instruction are numbered before
+ * it, except for phi operands along loop back edges.
+ * Those keep their own number, which is safe but
+ * misses values congruent only through the loop. */
+void numberValues(IrFunction *f)
+{
+  int size = 16;
+  while (size < 2 * f->instrCount)
+    size *= 2;
+  valueMask = size - 1;
+  valueTable = calloc(size, sizeof(Value));
+  for (int b = 0; b < f->orderCount; ++b)
+  {
+    IrBlock *block = f->order[b];
+    if (!block->executable)
+      continue;
+    for (IrInstr *i = block->phis; i; i = i->next)
+      numberInstr(i);
+    for (IrInstr *i = block->first; i; i = i->next)
+      numberInstr(i);
+  }
+  free(valueTable);
+  valueTable = NULL;
+}
@@ -0,0 +1,22 @@
+/****************************************************/
+/* File: gvn.h                                      */
+/* Global value numbering                           */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _GVN_H_
+#define _GVN_H_
+
+#include "ssa.h"
+
+/* Procedure numberValues gives the same number to
+ * instructions that always compute the same value:
+ * equal constants, the same operation on values of
+ * the same numbers, loads of the same element from
+ * the same memory, and phis of the same block
+ * merging the same numbers.
+ */
+void numberValues(IrFunction *f);
+
+#endif
@@ -0,0 +1,248 @@
+/****************************************************/
+/* File: inline.c                                   */
+/* Inlining of small functions                      */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "profile.h"
+#include "inline.h"
+
+/* With a profile, hot calls inline functions this
+ * many times larger than InlineLimit */
+enum
+{
+  HOT_INLINE_FACTOR = 4
+};
+
+/* The list of symbols of the callee renamed into
+ * the frame of the caller at one call site */
+typedef struct RenameRec
+{
+  BucketList from;
+  BucketList to;
+  struct RenameRec *next;
+} * RenameList;
+
+static RenameList renames;
+static BucketList caller;      /* function the calls are expanded into */
+static const char *calleeName; /* function being expanded */
+static int inlinedCalls;
+static int coldCalls; /* calls not inlined as the profile shows them unused */
+
+/* Function countTree returns the number of nodes
+ * in the subtree rooted at t and its siblings */
+static int countTree(TreeNode *t)
+{
+  int count = 0;
+  for (; t; t = t->sibling)
+  {
+    ++count;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      count += countTree(t->child[i]);
+  }
+  return count;
+}
+
+/* Function hasSymbol returns TRUE if the symbol
+ * field of t was set by the analyzer */
+static int hasSymbol(TreeNode *t)
+{
+  switch (t->nodekind)
+  {
+  case ExpK:
+    return t->kind.exp == VarK || t->kind.exp == ArrK || t->kind.exp == CallK || t->kind.exp == InlineK;
+  case DeclK:
+    return TRUE;
+  case ParamK:
+    return t->kind.param != VoidParamK;
+  default:
+    return FALSE;
+  }
+}
+
+/* Function callsFunction returns TRUE if t or one
+ * of its siblings contains a call to function */
+static int callsFunction(TreeNode *t, BucketList function)
+{
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == ExpK && (t->kind.exp == CallK || t->kind.exp == InlineK) && t->symbol == function)
+      return TRUE;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      if (callsFunction(t->child[i], function))
+        return TRUE;
+  }
+  return FALSE;
+}
+
+/* Function isInlinable returns TRUE if the call
+ * may be replaced by the body of the function. It
+ * must be small: with a profile, calls never made
+ * are left alone, and hot calls made more often than
+ * the caller is entered, from a loop, take larger
+ * bodies.
+ * Functions must be declared before use in C-, so
+ * the only recursion possible is a function calling
+ * itself */
+static int isInlinable(TreeNode *call)
+{
+  BucketList function = call->symbol;
+  TreeNode *decl = function->treeNode;
+  long long calls = profileCount(call, PROFILE_CALLS);
+  int hot = isHotCount(calls) && calls > profileCount(caller->treeNode, PROFILE_ENTRIES);
+  int limit = hot ? InlineLimit * HOT_INLINE_FACTOR : InlineLimit;
+  if (!strcmp(decl->attr.name, "input") || !strcmp(decl->attr.name, "output") || !strcmp(decl->attr.name, "main"))
+    return FALSE;
+  if (countTree(decl->child[2]) > limit || callsFunction(decl->child[2], function))
+    return FALSE;
+  if (calls == 0)
+  {
+    ++coldCalls;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Function renameSymbol returns the symbol standing
+ * for the callee symbol at the current call site.
+ * Parameters and locals of the callee get a fresh
+ * slot in the frame of the caller; parameters are
+ * always kept in memory there */
+static BucketList renameSymbol(BucketList symbol)
+{
+  RenameList r;
+  BucketList copy;
+  TreeNode *decl;
+  if (symbol->symbol_class == Global || symbol->symbol_class == Function)
+    return symbol;
+  for (r = renames; r; r = r->next)
+    if (r->from == symbol)
+      return r->to;
+
+  copy = malloc(sizeof(struct BucketListRec));
+  addPtr(copy);
+  *copy = *symbol;
+  copy->next = NULL;
+  copy->is_registered_argument = FALSE;
+  if (symbol->is_array && symbol->symbol_class == Local)
+    caller->memloc -= WORD_SIZE * symbol->size;
+  else
+    caller->memloc -= WORD_SIZE;
+  copy->memloc = caller->memloc;
+  if (symbol->length)
+    copy->length = renameSymbol(symbol->length);
+
+  /* declaration node carrying the new name for comments */
+  decl = malloc(sizeof(TreeNode));
+  addPtr(decl);
+  *decl = *symbol->treeNode;
+  decl->sibling = NULL;
+  decl->symbol = copy;
+  decl->attr.name = malloc(strlen(calleeName) + strlen(symbol->treeNode->attr.name) + 2);
+  addPtr(decl->attr.name);
+  sprintf(decl->attr.name, "%s.%s", calleeName, symbol->treeNode->attr.name);
+  copy->treeNode = decl;
+
+  r = malloc(sizeof(struct RenameRec));
+  addPtr(r);
+  r->from = symbol;
+  r->to = copy;
+  r->next = renames;
+  renames = r;
+  return copy;
+}
+
+static TreeNode *cloneList(TreeNode *t);
+
+/* Function cloneNode copies the subtree rooted at t,
+ * excluding siblings, renaming symbols of the callee */
+static TreeNode *cloneNode(TreeNode *t)
+{
+  TreeNode *copy = malloc(sizeof(TreeNode));
+  addPtr(copy);
+  *copy = *t;
+  copy->sibling = NULL;
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    copy->child[i] = cloneList(t->child[i]);
+  if (hasSymbol(t))
+    copy->symbol = renameSymbol(t->symbol);
+  return copy;
+}
+
+/* Function cloneList copies t and its siblings */
+static TreeNode *cloneList(TreeNode *t)
+{
+  TreeNode *head = NULL, **tail = &head;
+  for (; t; t = t->sibling)
+  {
+    *tail = cloneNode(t);
+    tail = &(*tail)->sibling;
+  }
+  return head;
+}
+
+/* Procedure expandCall turns the call node into an
+ * inlined call. child[0] keeps the arguments, child[1]
+ * is a copy of the callee body and child[2] the list
+ * of parameters the arguments are stored to */
+static void expandCall(TreeNode *call)
+{
+  TreeNode *callee = call->symbol->treeNode;
+  TreeNode *params = NULL, **tail = &params;
+  renames = NULL;
+  calleeName = callee->attr.name;
+  for (TreeNode *p = callee->child[1]; p; p = p->sibling)
+    if (p->kind.param != VoidParamK)
+    {
+      *tail = cloneNode(p);
+      tail = &(*tail)->sibling;
+    }
+  call->child[1] = cloneNode(callee->child[2]);
+  call->child[2] = params;
+  call->kind.exp = InlineK;
+  ++inlinedCalls;
+  if (TraceOptimize)
+    fprintf(listing, "  inlined %s into %s at line %d\n", calleeName, caller->treeNode->attr.name, call->lineno);
+}
+
+/* Procedure expandList inlines calls in t and its
+ * siblings. Arguments are expanded before the call
+ * containing them; copied bodies were already
+ * expanded when their own function was visited */
+static void expandList(TreeNode *t)
+{
+  for (; t; t = t->sibling)
+  {
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      expandList(t->child[i]);
+    if (t->nodekind == ExpK && t->kind.exp == CallK && isInlinable(t))
+      expandCall(t);
+  }
+}
+
+/* Procedure inlineFunctions replaces calls to small
+ * non-recursive functions by a copy of their body.
+ * Functions are visited in declaration order, so
+ * every callee already had its own calls inlined.
+ */
+void inlineFunctions(TreeNode *syntaxTree)
+{
+  inlinedCalls = coldCalls = 0;
+  if (TraceOptimize)
+    fprintf(listing, "Inlining functions of at most %d nodes:\n", InlineLimit);
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+    if (t->nodekind == DeclK && t->kind.decl == FunDeclK)
+    {
+      caller = t->symbol;
+      expandList(t->child[2]);
+    }
+  if (TraceOptimize)
+  {
+    fprintf(listing, "  %d calls inlined\n", inlinedCalls);
+    if (coldCalls)
+      fprintf(listing, "  %d calls never made left out of line\n", coldCalls);
+  }
+}
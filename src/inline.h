@@ -0,0 +1,23 @@
+/****************************************************/
+/* File: inline.h                                   */
+/* Inlining of small functions                      */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _INLINE_H_
+#define _INLINE_H_
+
+#include "globals.h"
+
+/* Procedure inlineFunctions replaces calls to small
+ * non-recursive functions by a copy of their body.
+ * A function is small if its body has at most
+ * InlineLimit nodes, or a few times more for calls
+ * the profile shows hot; calls it shows never made
+ * are not inlined. Inlined calls are printed to
+ * the listing file if TraceOptimize is set.
+ */
+void inlineFunctions(TreeNode *syntaxTree);
+
+#endif
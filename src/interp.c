@@ -0,0 +1,614 @@
+/****************************************************/
+/* File: interp.c                                   */
+/* The register bytecode interpreter                */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <time.h>
+#include "globals.h"
+#include "bytecode.h"
+#include "interp.h"
+
+#define BC_FORMAT(name, format) format,
+static const char *const formats[BC_COUNT] = {BC_OPS(BC_FORMAT)};
+#undef BC_FORMAT
+
+/* Function bcFormat returns the operand formats of
+ * op, one letter an operand */
+const char *bcFormat(BcOp op)
+{
+  return formats[op];
+}
+
+/* Decoded instruction. Jump targets are indices
+ * into the code of all functions */
+typedef struct
+{
+  int op;
+  int a, b, c;
+} BcInst;
+
+typedef struct
+{
+  int entry;
+  int registers;
+  int parameters;
+  int count;
+} BcFunction;
+
+/* Return point of a call */
+typedef struct
+{
+  const BcInst *ip;
+  int32_t *fp;
+  int result;
+} BcFrame;
+
+static unsigned char *file;
+static size_t fileSize, filePosition;
+
+static int flags;
+static int globalWords;
+static int functionCount;
+static int mainIndex;
+static BcFunction *functions;
+static BcInst *program;
+static int programSize;
+
+static double milliseconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Function readNumber reads a variable-length
+ * number. Returns FALSE at the end of the file or
+ * if it does not fit in an int */
+static int readNumber(int *value)
+{
+  unsigned int zigzag = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    unsigned int byte;
+    if (filePosition == fileSize)
+      return FALSE;
+    byte = file[filePosition++];
+    if (shift == 28 && byte > 0x0f)
+      return FALSE;
+    zigzag |= (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      *value = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* Function readRange reads a number and checks it
+ * is in [low, high] */
+static int readRange(int *value, int low, int high)
+{
+  return readNumber(value) && *value >= low && *value <= high;
+}
+
+/* Function readFile reads the whole code file into
+ * memory. Returns FALSE if it cannot be read */
+static int readFile(const char *codefile)
+{
+  FILE *f = fopen(codefile, "rb");
+  size_t capacity = 4096, n;
+  if (f == NULL)
+    return FALSE;
+  file = malloc(capacity);
+  fileSize = 0;
+  while ((n = fread(file + fileSize, 1, capacity - fileSize, f)) > 0)
+  {
+    fileSize += n;
+    if (fileSize == capacity)
+    {
+      capacity *= 2;
+      file = realloc(file, capacity);
+    }
+  }
+  fclose(f);
+  filePosition = 0;
+  return TRUE;
+}
+
+/* Function readFunction reads a function and its
+ * instructions, checking every operand but the
+ * callees of calls. Returns FALSE if it is invalid */
+static int readFunction(BcFunction *f)
+{
+  int last = -1;
+  if (!readRange(&f->registers, 1, BC_STACK_WORDS) || !readRange(&f->parameters, 0, f->registers) ||
+      !readRange(&f->count, 1, (int)(fileSize - filePosition)))
+    return FALSE;
+  f->entry = programSize;
+  program = realloc(program, sizeof(BcInst) * (programSize + f->count));
+  for (int i = 0; i < f->count; ++i)
+  {
+    BcInst *inst = &program[programSize + i];
+    int operands[BC_MAX_OPERANDS] = {0, 0, 0};
+    const char *format;
+    if (!readRange(&inst->op, 0, BC_COUNT - 1))
+      return FALSE;
+    format = formats[inst->op];
+    for (int j = 0; format[j]; ++j)
+    {
+      int *operand = &operands[j];
+      switch (format[j])
+      {
+      case 'R':
+        if (!readRange(operand, 0, f->registers - 1))
+          return FALSE;
+        break;
+      case 'G':
+        if (!readRange(operand, 0, globalWords - 1))
+          return FALSE;
+        break;
+      case 'L':
+        if (!readRange(operand, 0, f->count - 1))
+          return FALSE;
+        *operand += f->entry;
+        break;
+      case 'F':
+        if (!readRange(operand, 0, functionCount - 1))
+          return FALSE;
+        break;
+      default:
+        if (!readNumber(operand))
+          return FALSE;
+        break;
+      }
+    }
+    inst->a = operands[0];
+    inst->b = operands[1];
+    inst->c = operands[2];
+    if (inst->op == BC_DIVK && (inst->c == 0 || inst->c == -1))
+      return FALSE;
+    last = inst->op;
+  }
+  programSize += f->count;
+  /* the code of a function cannot run into the next */
+  return last == BC_JMP || last == BC_RET || last == BC_TAILCALL;
+}
+
+/* Function load reads the code file and checks that
+ * the program it holds cannot go outside its code
+ * and registers. Returns FALSE if it is invalid */
+static int load(const char *codefile)
+{
+  int version;
+  if (!readFile(codefile))
+  {
+    fprintf(stderr, "Unable to open %s\n", codefile);
+    return FALSE;
+  }
+  if (fileSize < BC_MAGIC_SIZE || memcmp(file, BC_MAGIC, BC_MAGIC_SIZE))
+  {
+    fprintf(stderr, "%s is not a bytecode file\n", codefile);
+    return FALSE;
+  }
+  filePosition = BC_MAGIC_SIZE;
+  if (!readNumber(&version) || version != BC_VERSION)
+  {
+    fprintf(stderr, "%s is of another bytecode version\n", codefile);
+    return FALSE;
+  }
+  if (!readNumber(&flags) || !readRange(&globalWords, 0, BC_STACK_WORDS) ||
+      !readRange(&functionCount, 1, (int)(fileSize - filePosition)) ||
+      !readRange(&mainIndex, 0, functionCount - 1))
+  {
+    fprintf(stderr, "%s is not a valid bytecode file\n", codefile);
+    return FALSE;
+  }
+  functions = malloc(sizeof(BcFunction) * functionCount);
+  programSize = 0;
+  for (int i = 0; i < functionCount; ++i)
+  {
+    if (!readFunction(&functions[i]))
+    {
+      fprintf(stderr, "%s is not a valid bytecode file\n", codefile);
+      return FALSE;
+    }
+  }
+  /* the arguments of a call are registers of the caller */
+  for (int i = 0; i < functionCount; ++i)
+  {
+    const BcFunction *f = &functions[i];
+    for (int j = f->entry; j < f->entry + f->count; ++j)
+    {
+      const BcInst *inst = &program[j];
+      if ((inst->op == BC_CALL && inst->c + functions[inst->b].parameters > f->registers) ||
+          (inst->op == BC_TAILCALL && inst->b + functions[inst->a].parameters > f->registers))
+      {
+        fprintf(stderr, "%s is not a valid bytecode file\n", codefile);
+        return FALSE;
+      }
+    }
+  }
+  if (functions[mainIndex].parameters != 0)
+  {
+    fprintf(stderr, "%s is not a valid bytecode file\n", codefile);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void runtimeError(const char *message, int index)
+{
+  fflush(stdout);
+  fprintf(stderr, "Exception at instruction %d: %s\n", index, message);
+}
+
+/* Runs main. Returns the exit status of the program. */
+static int run(void)
+{
+  const uint32_t words = (uint32_t)globalWords + BC_STACK_WORDS;
+  int32_t *const memory = calloc(words, sizeof(int32_t));
+  int32_t *const end = memory + words;
+  int32_t *fp = memory + globalWords;
+  const BcInst *const start = program;
+  const BcInst *ip = program + functions[mainIndex].entry;
+  const int prompt = flags & BC_FLAG_PROMPT;
+  BcFrame *frames = NULL;
+  int depth = 0, frameCapacity = 0;
+  int status = 0;
+  uint32_t address;
+  const char *fault = NULL;
+
+  if (fp + functions[mainIndex].registers > end)
+  {
+    fault = "stack overflow";
+    goto done;
+  }
+
+#define R(field) fp[ip->field]
+#if defined(__GNUC__)
+/* Threaded dispatch: every handler jumps straight
+ * to the handler of the next instruction */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define BC_LABEL(name, format) &&L_##name,
+  static const void *const handlers[BC_COUNT] = {BC_OPS(BC_LABEL)};
+#undef BC_LABEL
+#define CASE(name) L_##name:
+#define NEXT goto *handlers[ip->op]
+#define LOOP_BEGIN NEXT;
+#define LOOP_END
+#else
+#define CASE(name) case BC_##name:
+#define NEXT continue
+#define LOOP_BEGIN  \
+  for (;;)          \
+  {                 \
+    switch (ip->op) \
+    {
+#define LOOP_END \
+  }              \
+  }
+#endif
+#define ARITHMETIC(op)                                    \
+  do                                                      \
+  {                                                       \
+    R(a) = (int32_t)((uint32_t)R(b) op(uint32_t) R(c));   \
+    ++ip;                                                 \
+  } while (0)
+#define COMPARE(op)      \
+  do                     \
+  {                      \
+    R(a) = R(b) op R(c); \
+    ++ip;                \
+  } while (0)
+#define BRANCH(cond)      \
+  do                      \
+  {                       \
+    if (cond)             \
+      ip = start + ip->c; \
+    else                  \
+      ++ip;               \
+  } while (0)
+#define CHECK_ADDRESS(base, index, what)            \
+  do                                                \
+  {                                                 \
+    address = (uint32_t)(base) + (uint32_t)(index); \
+    if (address >= words)                           \
+    {                                               \
+      fault = "bad address in " what;               \
+      goto done;                                    \
+    }                                               \
+  } while (0)
+#define ENTER(callee, frame)                  \
+  do                                          \
+  {                                           \
+    const BcFunction *f = &functions[callee]; \
+    if ((frame) + f->registers > end)         \
+    {                                         \
+      fault = "stack overflow";               \
+      goto done;                              \
+    }                                         \
+    fp = (frame);                             \
+    ip = start + f->entry;                    \
+  } while (0)
+
+  LOOP_BEGIN
+  CASE(MOV)
+  R(a) = R(b);
+  ++ip;
+  NEXT;
+  CASE(LOADK)
+  R(a) = ip->b;
+  ++ip;
+  NEXT;
+  CASE(LDG)
+  R(a) = memory[ip->b];
+  ++ip;
+  NEXT;
+  CASE(STG)
+  memory[ip->a] = R(b);
+  ++ip;
+  NEXT;
+  CASE(ADDR)
+  R(a) = (int32_t)(fp - memory) + ip->b;
+  ++ip;
+  NEXT;
+  CASE(ADD)
+  ARITHMETIC(+);
+  NEXT;
+  CASE(SUB)
+  ARITHMETIC(-);
+  NEXT;
+  CASE(MUL)
+  ARITHMETIC(*);
+  NEXT;
+  CASE(DIV)
+  {
+    int32_t divisor = R(c);
+    if ((uint32_t)divisor + 1u <= 1u) /* 0 or -1 */
+      R(a) = (int32_t)((uint32_t)R(b) * (uint32_t)divisor);
+    else
+      R(a) = R(b) / divisor;
+    ++ip;
+    NEXT;
+  }
+  CASE(ADDK)
+  R(a) = (int32_t)((uint32_t)R(b) + (uint32_t)ip->c);
+  ++ip;
+  NEXT;
+  CASE(MULK)
+  R(a) = (int32_t)((uint32_t)R(b) * (uint32_t)ip->c);
+  ++ip;
+  NEXT;
+  CASE(DIVK)
+  R(a) = R(b) / ip->c;
+  ++ip;
+  NEXT;
+  CASE(LT)
+  COMPARE(<);
+  NEXT;
+  CASE(LE)
+  COMPARE(<=);
+  NEXT;
+  CASE(GT)
+  COMPARE(>);
+  NEXT;
+  CASE(GE)
+  COMPARE(>=);
+  NEXT;
+  CASE(EQ)
+  COMPARE(==);
+  NEXT;
+  CASE(NE)
+  COMPARE(!=);
+  NEXT;
+  CASE(JMP)
+  ip = start + ip->a;
+  NEXT;
+  CASE(JZ)
+  ip = R(a) == 0 ? start + ip->b : ip + 1;
+  NEXT;
+  CASE(JNZ)
+  ip = R(a) != 0 ? start + ip->b : ip + 1;
+  NEXT;
+  CASE(JLT)
+  BRANCH(R(a) < R(b));
+  NEXT;
+  CASE(JLE)
+  BRANCH(R(a) <= R(b));
+  NEXT;
+  CASE(JGT)
+  BRANCH(R(a) > R(b));
+  NEXT;
+  CASE(JGE)
+  BRANCH(R(a) >= R(b));
+  NEXT;
+  CASE(JEQ)
+  BRANCH(R(a) == R(b));
+  NEXT;
+  CASE(JNE)
+  BRANCH(R(a) != R(b));
+  NEXT;
+  CASE(JLTK)
+  BRANCH(R(a) < ip->b);
+  NEXT;
+  CASE(JLEK)
+  BRANCH(R(a) <= ip->b);
+  NEXT;
+  CASE(JGTK)
+  BRANCH(R(a) > ip->b);
+  NEXT;
+  CASE(JGEK)
+  BRANCH(R(a) >= ip->b);
+  NEXT;
+  CASE(JEQK)
+  BRANCH(R(a) == ip->b);
+  NEXT;
+  CASE(JNEK)
+  BRANCH(R(a) != ip->b);
+  NEXT;
+  CASE(LD)
+  CHECK_ADDRESS(R(b), 0, "read");
+  R(a) = memory[address];
+  ++ip;
+  NEXT;
+  CASE(ST)
+  CHECK_ADDRESS(R(a), 0, "write");
+  memory[address] = R(b);
+  ++ip;
+  NEXT;
+  CASE(LDX)
+  CHECK_ADDRESS(R(b), R(c), "read");
+  R(a) = memory[address];
+  ++ip;
+  NEXT;
+  CASE(STX)
+  CHECK_ADDRESS(R(a), R(b), "write");
+  memory[address] = R(c);
+  ++ip;
+  NEXT;
+  CASE(LDXL)
+  CHECK_ADDRESS((fp - memory) + ip->b, R(c), "read");
+  R(a) = memory[address];
+  ++ip;
+  NEXT;
+  CASE(STXL)
+  CHECK_ADDRESS((fp - memory) + ip->a, R(b), "write");
+  memory[address] = R(c);
+  ++ip;
+  NEXT;
+  CASE(LDXG)
+  CHECK_ADDRESS(ip->b, R(c), "read");
+  R(a) = memory[address];
+  ++ip;
+  NEXT;
+  CASE(STXG)
+  CHECK_ADDRESS(ip->a, R(b), "write");
+  memory[address] = R(c);
+  ++ip;
+  NEXT;
+  CASE(CHECK)
+  if ((uint32_t)R(a) >= (uint32_t)ip->b)
+  {
+    printf("error: array index out of bounds at line %d\n", ip->c);
+    status = 1;
+    goto done;
+  }
+  ++ip;
+  NEXT;
+  CASE(CHECKR)
+  if ((uint32_t)R(a) >= (uint32_t)R(b))
+  {
+    printf("error: array index out of bounds at line %d\n", ip->c);
+    status = 1;
+    goto done;
+  }
+  ++ip;
+  NEXT;
+  CASE(CALL)
+  if (depth == frameCapacity)
+  {
+    if (depth == BC_STACK_WORDS)
+    {
+      fault = "stack overflow";
+      goto done;
+    }
+    frameCapacity = frameCapacity ? 2 * frameCapacity : 1024;
+    frames = realloc(frames, sizeof(BcFrame) * frameCapacity);
+  }
+  frames[depth].ip = ip + 1;
+  frames[depth].fp = fp;
+  frames[depth].result = ip->a;
+  ++depth;
+  ENTER(ip->b, fp + ip->c);
+  NEXT;
+  CASE(TAILCALL)
+  {
+    const int32_t *args = fp + ip->b;
+    for (int i = 0; i < functions[ip->a].parameters; ++i)
+      fp[i] = args[i];
+    ENTER(ip->a, fp);
+    NEXT;
+  }
+  CASE(RET)
+  {
+    int32_t value = R(a);
+    if (depth == 0)
+      goto done;
+    --depth;
+    fp = frames[depth].fp;
+    ip = frames[depth].ip;
+    fp[frames[depth].result] = value;
+    NEXT;
+  }
+  CASE(IN)
+  if (prompt)
+    fputs("input: ", stdout);
+  fflush(stdout);
+  if (scanf("%d", &R(a)) != 1)
+    R(a) = 0;
+  ++ip;
+  NEXT;
+  CASE(OUT)
+  printf("output: %d\n", R(a));
+  ++ip;
+  NEXT;
+  LOOP_END
+
+done:
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+#undef R
+#undef CASE
+#undef NEXT
+#undef LOOP_BEGIN
+#undef LOOP_END
+#undef ARITHMETIC
+#undef COMPARE
+#undef BRANCH
+#undef CHECK_ADDRESS
+#undef ENTER
+  if (fault)
+  {
+    runtimeError(fault, (int)(ip - start));
+    status = 1;
+  }
+  free(frames);
+  free(memory);
+  return status;
+}
+
+/* Function runBytecode loads the bytecode file and
+ * runs it. Program input is read from stdin and
+ * program output written to stdout; the time taken
+ * to load and run is printed to stderr.
+ * Returns 0 on normal exit, 1 on error.
+ */
+int runBytecode(const char *codefile)
+{
+  int status = 1;
+  double begin = milliseconds(), loaded;
+  if (load(codefile))
+  {
+    loaded = milliseconds();
+    if (flags & BC_FLAG_UNBUFFERED)
+      setvbuf(stdout, NULL, _IONBF, 0);
+    status = run();
+    fflush(stdout);
+    fprintf(stderr, "bytecode: loaded in %.3f ms, ran in %.3f ms\n", loaded - begin, milliseconds() - loaded);
+  }
+  free(file);
+  free(functions);
+  free(program);
+  file = NULL;
+  functions = NULL;
+  program = NULL;
+  return status;
+}
@@ -0,0 +1,20 @@
+/****************************************************/
+/* File: interp.h                                   */
+/* The register bytecode interpreter                */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _INTERP_H_
+#define _INTERP_H_
+
+/* Function runBytecode loads the bytecode file
+ * written by codeGenBytecode and runs it. Program
+ * input is read from stdin and program output
+ * written to stdout; the time taken to load and run
+ * is printed to stderr.
+ * Returns 0 on normal exit, 1 on error.
+ */
+int runBytecode(const char *codefile);
+
+#endif
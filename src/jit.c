@@ -0,0 +1,823 @@
+/****************************************************/
+/* File: jit.c                                      */
+/* In-process execution of C- programs for --run    */
+/* The x86-64 code of x86gen.c is written to memory,*/
+/* assembled into an executable buffer and called   */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _DEFAULT_SOURCE
+
+/* the code buffer is allocated by the C library */
+#define NO_ALLOCATION_HOOKS
+
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "globals.h"
+#include "jit.h"
+
+/**************************************************/
+/***********   Runtime                  ***********/
+/**************************************************/
+
+/* A failed bounds check or a fault ends the
+ * program, but not the compiler running it */
+static sigjmp_buf programExit;
+
+/* The program runs on a stack of its own, as large
+ * as the one of native programs in runtime.c. Faults
+ * are handled on another one, since the program's
+ * may be full */
+enum
+{
+  PROGRAM_STACK_SIZE = 0x08000000,
+  SIGNAL_STACK_SIZE = 0x00010000
+};
+
+static int (*program)(void);
+static int programStatus;
+static ucontext_t compilerContext, programContext;
+
+static int jitInput(int prompt)
+{
+  int value;
+  if (prompt)
+  {
+    fputs("input: ", stdout);
+    fflush(stdout);
+  }
+  if (scanf("%d", &value) != 1)
+    value = 0;
+  return value;
+}
+
+static void jitOutput(int value)
+{
+  printf("output: %d\n", value);
+}
+
+static void jitUnbuffered(void)
+{
+  setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+static void jitBoundsError(int lineno)
+{
+  printf("error: array index out of bounds at line %d\n", lineno);
+  siglongjmp(programExit, 1);
+}
+
+/* Procedure programFault ends a program that made
+ * an access outside its memory */
+static void programFault(int signal)
+{
+  static const char message[] = "jit: program faulted\n";
+  (void)signal;
+  if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0)
+    ; /* nothing more to do about it */
+  siglongjmp(programExit, 1);
+}
+
+/* The routines called by the generated code by the
+ * names of runtime.c. Each gets a stub after the
+ * code that jumps to its absolute address */
+static const struct
+{
+  const char *name;
+  void (*address)(void);
+} runtimeRoutines[] = {
+    {"rtInput", (void (*)(void))jitInput},
+    {"rtOutput", (void (*)(void))jitOutput},
+    {"rtUnbuffered", jitUnbuffered},
+    {"rtBoundsError", (void (*)(void))jitBoundsError}};
+
+enum
+{
+  RUNTIME_ROUTINES = sizeof(runtimeRoutines) / sizeof(runtimeRoutines[0]),
+  STUB_SIZE = 13 /* movabsq $address, %r11; jmp *%r11 */
+};
+
+/**************************************************/
+/***********   Assembler                ***********/
+/**************************************************/
+
+enum
+{
+  SYMTAB_SIZE = 1021,
+  MAXOPERANDS = 3,
+  MAXINSTRUCTION = 16,
+  REG_RIP = 16
+};
+
+typedef enum
+{
+  OprReg,
+  OprImm,
+  OprMem, /* [disp|symbol](base[,index[,scale]]) */
+  OprSym  /* label or function */
+} OperandKind;
+
+typedef struct
+{
+  OperandKind kind;
+  int reg;   /* register, or base register of OprMem */
+  int size;  /* 8, 32 or 64 bits, for OprReg */
+  int index; /* -1 if absent */
+  int scale;
+  long imm; /* immediate or displacement */
+  const char *symbol;
+} Operand;
+
+typedef enum
+{
+  SectionText,
+  SectionData
+} Section;
+
+typedef struct SymbolRec
+{
+  char *name;
+  Section section;
+  long offset;
+  struct SymbolRec *next;
+} * Symbol;
+
+/* A 32-bit field to fill with the distance from the
+ * end of its instruction to a symbol */
+typedef struct
+{
+  long position;
+  long end;
+  const char *symbol;
+} Fixup;
+
+static Symbol symbols[SYMTAB_SIZE];
+static unsigned char *text;
+static long textSize, textCapacity;
+static long dataSize;
+static Fixup *fixups;
+static int fixupCount, fixupCapacity;
+static int assembleFailed;
+
+/* The code file written to memory by x86gen.c */
+static char *codeText;
+static size_t codeLength;
+
+/* the hash function which returns a number in [0, SYMTAB_SIZE) */
+static int symHash(const char *key)
+{
+  unsigned int temp = 0;
+  while (*key)
+    temp = (temp << 4) + (unsigned char)*key++;
+  return temp % SYMTAB_SIZE;
+}
+
+static Symbol findSymbol(const char *name)
+{
+  Symbol s = symbols[symHash(name)];
+  while (s && strcmp(s->name, name))
+    s = s->next;
+  return s;
+}
+
+static void defineSymbol(const char *name, Section section, long offset)
+{
+  int h = symHash(name);
+  Symbol s = malloc(sizeof(struct SymbolRec));
+  s->name = malloc(strlen(name) + 1);
+  strcpy(s->name, name);
+  s->section = section;
+  s->offset = offset;
+  s->next = symbols[h];
+  symbols[h] = s;
+}
+
+static void destroySymbols(void)
+{
+  for (int i = 0; i < SYMTAB_SIZE; ++i)
+    while (symbols[i])
+    {
+      Symbol s = symbols[i];
+      symbols[i] = s->next;
+      free(s->name);
+      free(s);
+    }
+}
+
+static void assembleError(const char *message, const char *detail)
+{
+  fprintf(stderr, "jit: %s: %s\n", message, detail);
+  assembleFailed = TRUE;
+}
+
+/* Function parseRegister returns the number of the
+ * register named s, and its size in bits, or -1 */
+static int parseRegister(const char *s, int *size)
+{
+  static const char *const quads[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                      "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+  static const char *const longs[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                      "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+  static const char *const bytes[] = {"al", "cl", "dl", "bl"};
+  for (int i = 0; i < 16; ++i)
+  {
+    if (!strcmp(s, quads[i]))
+    {
+      *size = 64;
+      return i;
+    }
+    if (!strcmp(s, longs[i]))
+    {
+      *size = 32;
+      return i;
+    }
+    if (i < 4 && !strcmp(s, bytes[i]))
+    {
+      *size = 8;
+      return i;
+    }
+  }
+  if (!strcmp(s, "rip"))
+  {
+    *size = 64;
+    return REG_RIP;
+  }
+  return -1;
+}
+
+/* Function parseOperand fills op from the text of
+ * one operand. Returns FALSE if it is malformed */
+static int parseOperand(char *s, Operand *op)
+{
+  char *paren;
+  op->index = -1;
+  op->scale = 1;
+  op->imm = 0;
+  op->symbol = NULL;
+  if (s[0] == '%')
+  {
+    op->kind = OprReg;
+    op->reg = parseRegister(s + 1, &op->size);
+    return op->reg >= 0 && op->reg != REG_RIP;
+  }
+  if (s[0] == '$')
+  {
+    char *end;
+    op->kind = OprImm;
+    op->imm = strtol(s + 1, &end, 10);
+    return *end == '\0' && end != s + 1;
+  }
+  paren = strchr(s, '(');
+  if (paren == NULL)
+  {
+    op->kind = OprSym;
+    op->symbol = s;
+    return s[0] != '\0';
+  }
+  op->kind = OprMem;
+  *paren = '\0';
+  if (s[0] == '-' || isdigit((unsigned char)s[0]))
+    op->imm = strtol(s, NULL, 10);
+  else if (s[0])
+    op->symbol = s;
+  s = paren + 1;
+  if (s[0] != '%')
+    return FALSE;
+  {
+    char *comma = strchr(s, ',');
+    char *close = strchr(s, ')');
+    int size;
+    if (close == NULL)
+      return FALSE;
+    *close = '\0';
+    if (comma)
+      *comma = '\0';
+    op->reg = parseRegister(s + 1, &size);
+    if (op->reg < 0)
+      return FALSE;
+    if (comma)
+    {
+      char *scale = strchr(comma + 1, ',');
+      if (scale)
+      {
+        *scale = '\0';
+        op->scale = atoi(scale + 1);
+      }
+      if (comma[1] != '%' || (op->index = parseRegister(comma + 2, &size)) < 0)
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static void appendText(const unsigned char *bytes, int length)
+{
+  if (textSize + length > textCapacity)
+  {
+    textCapacity = textCapacity ? textCapacity * 2 : 4096;
+    text = realloc(text, textCapacity);
+  }
+  memcpy(text + textSize, bytes, length);
+  textSize += length;
+}
+
+static void addFixup(long position, long end, const char *symbol)
+{
+  if (fixupCount == fixupCapacity)
+  {
+    fixupCapacity = fixupCapacity ? fixupCapacity * 2 : 256;
+    fixups = realloc(fixups, sizeof(Fixup) * fixupCapacity);
+  }
+  fixups[fixupCount].position = position;
+  fixups[fixupCount].end = end;
+  /* the symbol lives in the code text until it is freed */
+  fixups[fixupCount].symbol = symbol;
+  ++fixupCount;
+}
+
+/* One instruction being encoded */
+typedef struct
+{
+  unsigned char bytes[MAXINSTRUCTION];
+  int length;
+  int fixupAt; /* position of a rip-relative field, or -1 */
+  const char *symbol;
+} Encoding;
+
+static void putByte(Encoding *e, int byte)
+{
+  e->bytes[e->length++] = (unsigned char)byte;
+}
+
+static void putLong(Encoding *e, long value)
+{
+  for (int i = 0; i < 4; ++i)
+    putByte(e, (int)((unsigned long)value >> (8 * i)) & 0xff);
+}
+
+static int fitsByte(long value)
+{
+  return value >= -128 && value <= 127;
+}
+
+/* Procedure encodeModRM appends the prefix, opcode
+ * (one byte, or two if it starts with 0x0f) and
+ * the ModRM, SIB and displacement bytes addressing
+ * rm, with regField in the reg field */
+static void encodeModRM(Encoding *e, int wide, int opcode, int regField, const Operand *rm)
+{
+  int rex = (wide ? 8 : 0) | (regField >= 8 ? 4 : 0);
+  int base = rm->reg;
+  if (rm->kind == OprMem && rm->index >= 0 && rm->index >= 8)
+    rex |= 2;
+  if (base >= 8 && base != REG_RIP)
+    rex |= 1;
+  if (rex)
+    putByte(e, 0x40 | rex);
+  if (opcode > 0xff)
+    putByte(e, opcode >> 8);
+  putByte(e, opcode & 0xff);
+  regField &= 7;
+  if (rm->kind == OprReg)
+  {
+    putByte(e, 0xc0 | regField << 3 | (base & 7));
+    return;
+  }
+  if (base == REG_RIP)
+  {
+    putByte(e, regField << 3 | 5);
+    e->fixupAt = e->length;
+    e->symbol = rm->symbol;
+    putLong(e, 0);
+    return;
+  }
+  {
+    int mod = rm->imm == 0 && (base & 7) != 5 ? 0 : fitsByte(rm->imm) ? 1 : 2;
+    int scaleBits = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0;
+    if (rm->index >= 0 || (base & 7) == 4)
+    {
+      putByte(e, mod << 6 | regField << 3 | 4);
+      putByte(e, scaleBits << 6 | ((rm->index >= 0 ? rm->index : 4) & 7) << 3 | (base & 7));
+    }
+    else
+      putByte(e, mod << 6 | regField << 3 | (base & 7));
+    if (mod == 1)
+      putByte(e, (int)rm->imm & 0xff);
+    else if (mod == 2)
+      putLong(e, rm->imm);
+  }
+}
+
+/* Function conditionCode returns the number of a
+ * condition code suffix, or -1 */
+static int conditionCode(const char *suffix)
+{
+  static const char *const names[] = {"o", "no", "b", "ae", "e", "ne", "be", "a",
+                                      "s", "ns", "p", "np", "l", "ge", "le", "g"};
+  for (int i = 0; i < 16; ++i)
+    if (!strcmp(suffix, names[i]))
+      return i;
+  return -1;
+}
+
+/* Two-operand arithmetic: the ModRM extension of
+ * the immediate forms, and the opcodes storing to
+ * r/m and loading from r/m */
+static const struct
+{
+  const char *name;
+  int extension, toRM, fromRM;
+} arithmetic[] = {{"add", 0, 0x01, 0x03}, {"and", 4, 0x21, 0x23}, {"sub", 5, 0x29, 0x2b}, {"xor", 6, 0x31, 0x33}, {"cmp", 7, 0x39, 0x3b}};
+
+/* Function encode encodes one instruction. Returns
+ * FALSE if it is not one x86gen.c generates */
+static int encode(Encoding *e, const char *m, int n, Operand *ops)
+{
+  size_t length = strlen(m);
+  int wide = m[length - 1] == 'q';
+  Operand *src = &ops[0], *dst = &ops[n - 1];
+  e->length = 0;
+  e->fixupAt = -1;
+  if (n == 0)
+  {
+    if (!strcmp(m, "leave"))
+      putByte(e, 0xc9);
+    else if (!strcmp(m, "ret"))
+      putByte(e, 0xc3);
+    else if (!strcmp(m, "cltd"))
+      putByte(e, 0x99);
+    else
+      return FALSE;
+    return TRUE;
+  }
+  if (n == 1 && src->kind == OprSym)
+  { /* jumps and calls, always with a 32-bit offset */
+    int cc = m[0] == 'j' ? conditionCode(m + 1) : -1;
+    if (!strcmp(m, "jmp"))
+      putByte(e, 0xe9);
+    else if (!strcmp(m, "call"))
+      putByte(e, 0xe8);
+    else if (cc >= 0)
+    {
+      putByte(e, 0x0f);
+      putByte(e, 0x80 + cc);
+    }
+    else
+      return FALSE;
+    e->fixupAt = e->length;
+    e->symbol = src->symbol;
+    putLong(e, 0);
+    return TRUE;
+  }
+  if (n == 1 && src->kind == OprReg)
+  {
+    if (!strcmp(m, "pushq") || !strcmp(m, "popq"))
+    {
+      if (src->reg >= 8)
+        putByte(e, 0x41);
+      putByte(e, (m[1] == 'u' ? 0x50 : 0x58) + (src->reg & 7));
+    }
+    else if (!strcmp(m, "negl"))
+      encodeModRM(e, FALSE, 0xf7, 3, src);
+    else if (!strcmp(m, "idivl"))
+      encodeModRM(e, FALSE, 0xf7, 7, src);
+    else if (!strncmp(m, "set", 3) && conditionCode(m + 3) >= 0)
+      encodeModRM(e, FALSE, 0x0f90 + conditionCode(m + 3), 0, src);
+    else
+      return FALSE;
+    return TRUE;
+  }
+  if (n == 3)
+  { /* imul $imm, r/m, reg */
+    if (strncmp(m, "imul", 4) || src->kind != OprImm || dst->kind != OprReg)
+      return FALSE;
+    encodeModRM(e, wide, fitsByte(src->imm) ? 0x6b : 0x69, dst->reg, &ops[1]);
+    if (fitsByte(src->imm))
+      putByte(e, (int)src->imm & 0xff);
+    else
+      putLong(e, src->imm);
+    return TRUE;
+  }
+  if (n != 2)
+    return FALSE;
+  for (size_t i = 0; i < sizeof(arithmetic) / sizeof(arithmetic[0]); ++i)
+    if (length == 4 && !strncmp(m, arithmetic[i].name, 3))
+    {
+      if (src->kind == OprImm)
+      {
+        encodeModRM(e, wide, fitsByte(src->imm) ? 0x83 : 0x81, arithmetic[i].extension, dst);
+        if (fitsByte(src->imm))
+          putByte(e, (int)src->imm & 0xff);
+        else
+          putLong(e, src->imm);
+      }
+      else if (src->kind == OprReg)
+        encodeModRM(e, wide, arithmetic[i].toRM, src->reg, dst);
+      else if (dst->kind == OprReg)
+        encodeModRM(e, wide, arithmetic[i].fromRM, dst->reg, src);
+      else
+        return FALSE;
+      return TRUE;
+    }
+  if (!strcmp(m, "movl") || !strcmp(m, "movq"))
+  {
+    if (src->kind == OprImm && dst->kind == OprReg && !wide)
+    {
+      if (dst->reg >= 8)
+        putByte(e, 0x41);
+      putByte(e, 0xb8 + (dst->reg & 7));
+      putLong(e, src->imm);
+    }
+    else if (src->kind == OprImm)
+    {
+      encodeModRM(e, wide, 0xc7, 0, dst);
+      putLong(e, src->imm);
+    }
+    else if (src->kind == OprReg)
+      encodeModRM(e, wide, 0x89, src->reg, dst);
+    else if (dst->kind == OprReg)
+      encodeModRM(e, wide, 0x8b, dst->reg, src);
+    else
+      return FALSE;
+  }
+  else if (dst->kind != OprReg)
+    return FALSE;
+  else if (!strcmp(m, "leaq") || !strcmp(m, "leal"))
+    encodeModRM(e, wide, 0x8d, dst->reg, src);
+  else if (!strcmp(m, "movslq"))
+    encodeModRM(e, TRUE, 0x63, dst->reg, src);
+  else if (!strcmp(m, "movzbl"))
+    encodeModRM(e, FALSE, 0x0fb6, dst->reg, src);
+  else if (!strcmp(m, "testl"))
+    encodeModRM(e, FALSE, 0x85, src->reg, dst);
+  else if (!strncmp(m, "imul", 4) && src->kind == OprImm)
+    return encode(e, m, 3, (Operand[]){*src, *dst, *dst});
+  else if (!strncmp(m, "imul", 4))
+    encodeModRM(e, wide, 0x0faf, dst->reg, src);
+  else if (src->kind == OprImm && (!strncmp(m, "sal", 3) || !strncmp(m, "shr", 3) || !strncmp(m, "sar", 3)))
+  {
+    encodeModRM(e, wide, 0xc1, m[1] == 'a' ? (m[2] == 'l' ? 4 : 7) : 5, dst);
+    putByte(e, (int)src->imm & 0xff);
+  }
+  else
+    return FALSE;
+  return TRUE;
+}
+
+/* Procedure assembleLine assembles one line of the
+ * code text, which it may modify */
+static void assembleLine(char *line, Section *section)
+{
+  char *m, *rest, *operand;
+  Operand ops[MAXOPERANDS];
+  int n = 0, depth = 0;
+  Encoding e;
+  while (isspace((unsigned char)*line))
+    ++line;
+  if (line[0] == '\0' || line[0] == '#')
+    return;
+  rest = line + strlen(line);
+  while (rest > line && isspace((unsigned char)rest[-1]))
+    *--rest = '\0';
+  if (rest[-1] == ':')
+  {
+    rest[-1] = '\0';
+    defineSymbol(line, *section, *section == SectionText ? textSize : dataSize);
+    return;
+  }
+  m = line;
+  for (rest = line; *rest && !isspace((unsigned char)*rest); ++rest)
+    ;
+  if (*rest)
+    *rest++ = '\0';
+  if (m[0] == '.')
+  {
+    long value = strtol(rest, NULL, 10);
+    if (!strcmp(m, ".text"))
+      *section = SectionText;
+    else if (!strcmp(m, ".bss"))
+      *section = SectionData;
+    else if (!strcmp(m, ".zero"))
+      dataSize += value;
+    else if (!strcmp(m, ".p2align") && *section == SectionData)
+      dataSize = (dataSize + (1L << value) - 1) & -(1L << value);
+    else if (!strcmp(m, ".p2align"))
+      while (textSize & ((1L << value) - 1))
+        appendText((const unsigned char *)"\x90", 1);
+    return; /* other directives only matter to the linker */
+  }
+  /* split the operands at commas outside parentheses */
+  while (isspace((unsigned char)*rest))
+    ++rest;
+  for (operand = rest; *rest; ++rest)
+  {
+    if (*rest == '(')
+      ++depth;
+    else if (*rest == ')')
+      --depth;
+    else if (*rest == ',' && depth == 0)
+    {
+      *rest = '\0';
+      if (n == MAXOPERANDS || !parseOperand(operand, &ops[n++]))
+        break;
+      operand = rest + 1;
+      while (isspace((unsigned char)*operand))
+        ++operand;
+    }
+  }
+  if (*operand && (n == MAXOPERANDS || !parseOperand(operand, &ops[n++])))
+  {
+    assembleError("bad operand", operand);
+    return;
+  }
+  if (!encode(&e, m, n, ops))
+  {
+    assembleError("unknown instruction", m);
+    return;
+  }
+  if (e.fixupAt >= 0)
+    addFixup(textSize + e.fixupAt, textSize + e.length, e.symbol);
+  appendText(e.bytes, e.length);
+}
+
+/* Procedure appendStubs appends the stubs through
+ * which the code calls the runtime routines */
+static void appendStubs(void)
+{
+  for (int i = 0; i < RUNTIME_ROUTINES; ++i)
+  {
+    unsigned char stub[STUB_SIZE] = {0x49, 0xbb, 0, 0, 0, 0, 0, 0, 0, 0, 0x41, 0xff, 0xe3};
+    uintptr_t address = (uintptr_t)runtimeRoutines[i].address;
+    memcpy(stub + 2, &address, sizeof(address));
+    defineSymbol(runtimeRoutines[i].name, SectionText, textSize);
+    appendText(stub, STUB_SIZE);
+  }
+}
+
+/* Function load maps the assembled code and data,
+ * with the data right after the code so that both
+ * are within reach of 32-bit offsets, and resolves
+ * the fixups. A guard page after the data makes
+ * stores running past it fault. Returns the mapping,
+ * or NULL */
+static unsigned char *load(size_t *size, long *dataStart)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  unsigned char *memory;
+  *dataStart = (textSize + page - 1) / page * page;
+  *size = *dataStart + (dataSize + page - 1) / page * page + page;
+  memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+  {
+    perror("jit: mmap");
+    return NULL;
+  }
+  memcpy(memory, text, textSize);
+  for (int i = 0; i < fixupCount; ++i)
+  {
+    Symbol s = findSymbol(fixups[i].symbol);
+    int32_t distance;
+    if (s == NULL)
+    {
+      assembleError("undefined symbol", fixups[i].symbol);
+      continue;
+    }
+    distance = (int32_t)((s->section == SectionText ? s->offset : *dataStart + s->offset) - fixups[i].end);
+    memcpy(memory + fixups[i].position, &distance, sizeof(distance));
+  }
+  if (assembleFailed || mprotect(memory, *dataStart, PROT_READ | PROT_EXEC) != 0 ||
+      mprotect(memory + *size - page, page, PROT_NONE) != 0)
+  {
+    if (!assembleFailed)
+      perror("jit: mprotect");
+    munmap(memory, *size);
+    return NULL;
+  }
+  return memory;
+}
+
+static double milliseconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void enterProgram(void)
+{
+  programStatus = program();
+}
+
+/* Function runProgram calls the program on a stack
+ * of PROGRAM_STACK_SIZE bytes, under a guard page,
+ * with SIGSEGV and SIGBUS caught. Returns its
+ * status, or 1 if it failed */
+static int runProgram(void)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  size_t size = page + PROGRAM_STACK_SIZE + SIGNAL_STACK_SIZE;
+  unsigned char *stack;
+  stack_t signalStack, savedStack;
+  struct sigaction action, savedSegv, savedBus;
+  int status;
+  stack = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED || mprotect(stack + page, size - page, PROT_READ | PROT_WRITE) != 0)
+  {
+    perror("jit: stack");
+    if (stack != MAP_FAILED)
+      munmap(stack, size);
+    return 1;
+  }
+  signalStack.ss_sp = stack + page + PROGRAM_STACK_SIZE;
+  signalStack.ss_size = SIGNAL_STACK_SIZE;
+  signalStack.ss_flags = 0;
+  sigaltstack(&signalStack, &savedStack);
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = programFault;
+  action.sa_flags = SA_ONSTACK;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGSEGV, &action, &savedSegv);
+  sigaction(SIGBUS, &action, &savedBus);
+  getcontext(&programContext);
+  programContext.uc_stack.ss_sp = stack + page;
+  programContext.uc_stack.ss_size = PROGRAM_STACK_SIZE;
+  programContext.uc_link = &compilerContext;
+  makecontext(&programContext, enterProgram, 0);
+  if (sigsetjmp(programExit, 1) == 0)
+  {
+    swapcontext(&compilerContext, &programContext);
+    status = programStatus;
+  }
+  else
+    status = 1;
+  sigaction(SIGSEGV, &savedSegv, NULL);
+  sigaction(SIGBUS, &savedBus, NULL);
+  sigaltstack(&savedStack, NULL);
+  munmap(stack, size);
+  return status;
+}
+
+/**************************************************/
+/***********   Interface                ***********/
+/**************************************************/
+
+FILE *openJITBuffer(void)
+{
+  return open_memstream(&codeText, &codeLength);
+}
+
+int runJIT(void)
+{
+  Section section = SectionText;
+  double start = milliseconds(), loaded;
+  unsigned char *memory;
+  size_t size;
+  long dataStart;
+  int status = 1;
+  char *line = codeText, *end;
+  textSize = dataSize = 0;
+  fixupCount = 0;
+  assembleFailed = FALSE;
+  for (; line && *line; line = end)
+  {
+    end = strchr(line, '\n');
+    if (end)
+      *end++ = '\0';
+    else
+      end = line + strlen(line);
+    assembleLine(line, &section);
+  }
+  appendStubs();
+  memory = assembleFailed ? NULL : load(&size, &dataStart);
+  loaded = milliseconds();
+  if (memory)
+  {
+    Symbol entry = findSymbol("cm.main");
+    if (entry == NULL)
+      fprintf(stderr, "jit: no main\n");
+    else
+    {
+      void *address = memory + entry->offset;
+      memcpy(&program, &address, sizeof(program));
+      fflush(stdout);
+      status = runProgram();
+      fflush(stdout);
+      fprintf(stderr, "jit: assembled in %.3f ms, ran in %.3f ms\n", loaded - start, milliseconds() - loaded);
+    }
+    munmap(memory, size);
+  }
+  destroySymbols();
+  free(text);
+  free(fixups);
+  free(codeText);
+  text = NULL;
+  fixups = NULL;
+  codeText = NULL;
+  textCapacity = fixupCapacity = 0;
+  return status;
+}
@@ -0,0 +1,26 @@
+/****************************************************/
+/* File: jit.h                                      */
+/* In-process execution of C- programs for --run    */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+/* Function openJITBuffer returns a stream that
+ * keeps the code written to it in memory, to be
+ * used as the code file of codeGenX86
+ */
+FILE *openJITBuffer(void);
+
+/* Function runJIT assembles the code written to
+ * that stream, once it is closed, into executable
+ * memory and calls main. Program input is read from
+ * stdin and output written to stdout; the time
+ * taken to assemble and run is printed to stderr.
+ * Returns the exit status of the program.
+ */
+int runJIT(void);
+
+#endif
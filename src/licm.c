@@ -0,0 +1,360 @@
+/****************************************************/
+/* File: licm.c                                     */
+/* Loop-invariant code motion                       */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "profile.h"
+#include "licm.h"
+
+/* A loop being optimized: what its condition and
+ * body may write, and the temporaries it owns */
+typedef struct
+{
+  TreeNode *node;         /* IterationK node */
+  BucketList *assigned;   /* scalars assigned in the loop */
+  int assignedCount;
+  BucketList *stored;     /* arrays stored to in the loop */
+  int storedCount;
+  int calls;              /* TRUE if a function is called */
+  int firstTemp, nextTemp; /* temporaries [firstTemp, nextTemp) */
+} LoopInfo;
+
+static int hoistedExpressions;
+static int optimizedLoops;
+static int coldLoops;
+
+static void addSymbol(BucketList **list, int *count, BucketList symbol)
+{
+  for (int i = 0; i < *count; ++i)
+    if ((*list)[i] == symbol)
+      return;
+  *list = realloc(*list, sizeof(BucketList) * (*count + 1));
+  (*list)[(*count)++] = symbol;
+}
+
+static int hasSymbol(BucketList *list, int count, BucketList symbol)
+{
+  for (int i = 0; i < count; ++i)
+    if (list[i] == symbol)
+      return TRUE;
+  return FALSE;
+}
+
+static int isBuiltin(BucketList function)
+{
+  return !strcmp(function->treeNode->attr.name, "input") || !strcmp(function->treeNode->attr.name, "output");
+}
+
+/* Procedure storeArguments records the arrays passed
+ * in args as stored: the callee, or the inlined body
+ * through its parameters, may write to them */
+static void storeArguments(TreeNode *args, LoopInfo *loop)
+{
+  for (; args; args = args->sibling)
+    if (args->nodekind == ExpK && args->kind.exp == VarK && args->symbol->is_array)
+      addSymbol(&loop->stored, &loop->storedCount, args->symbol);
+}
+
+/* Procedure scanLoop records the variables written
+ * by t and its siblings into loop */
+static void scanLoop(TreeNode *t, LoopInfo *loop)
+{
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == ExpK)
+      switch (t->kind.exp)
+      {
+      case AssignK:
+        if (t->child[0]->kind.exp == VarK)
+          addSymbol(&loop->assigned, &loop->assignedCount, t->child[0]->symbol);
+        else
+          addSymbol(&loop->stored, &loop->storedCount, t->child[0]->symbol);
+        break;
+      case CallK:
+        if (!isBuiltin(t->symbol))
+          loop->calls = TRUE;
+        storeArguments(t->child[0], loop);
+        break;
+      case InlineK: /* arguments are stored to the parameters */
+        storeArguments(t->child[0], loop);
+        for (TreeNode *p = t->child[2]; p; p = p->sibling)
+          addSymbol(&loop->assigned, &loop->assignedCount, p->symbol);
+        break;
+      default:
+        break;
+      }
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      scanLoop(t->child[i], loop);
+  }
+}
+
+/* Function mayAlias returns TRUE if stores to array a
+ * may change elements of array b. Array parameters
+ * may refer to any array except the locals of the
+ * current activation */
+static int mayAlias(BucketList a, BucketList b)
+{
+  if (a == b)
+    return TRUE;
+  if (a->symbol_class == Parameter)
+    return b->symbol_class != Local;
+  if (b->symbol_class == Parameter)
+    return a->symbol_class != Local;
+  return FALSE;
+}
+
+/* Function isInvariant returns TRUE if expression t
+ * has the same value in every iteration of the loop.
+ * Array elements are only considered when loads
+ * is set, since a hoisted load is executed even if
+ * the loop never would have */
+static int isInvariant(TreeNode *t, LoopInfo *loop, int loads)
+{
+  switch (t->kind.exp)
+  {
+  case ConstK:
+  case TempK:
+    return TRUE;
+  case VarK:
+    /* parameters of inlined calls are assigned, arrays included */
+    if (hasSymbol(loop->assigned, loop->assignedCount, t->symbol))
+      return FALSE;
+    return t->symbol->is_array || t->symbol->symbol_class != Global || !loop->calls;
+  case OpK:
+    return isInvariant(t->child[0], loop, loads) && isInvariant(t->child[1], loop, loads);
+  case ArrK:
+    if (!loads || !isInvariant(t->child[0], loop, loads))
+      return FALSE;
+    if (loop->calls && t->symbol->symbol_class != Local)
+      return FALSE;
+    for (int i = 0; i < loop->storedCount; ++i)
+      if (mayAlias(loop->stored[i], t->symbol))
+        return FALSE;
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+/* Function isCheapBase returns TRUE if the address
+ * of an array is already held in a register */
+static int isCheapBase(BucketList array)
+{
+  return array->symbol_class == Parameter && array->is_registered_argument;
+}
+
+/* Function isWorthHoisting returns TRUE if computing
+ * t takes more than the single move that reads
+ * a temporary */
+static int isWorthHoisting(TreeNode *t)
+{
+  switch (t->kind.exp)
+  {
+  case OpK:
+  case ArrK:
+    return TRUE;
+  case VarK:
+    return !(t->symbol->symbol_class == Parameter && t->symbol->is_registered_argument);
+  default:
+    return FALSE;
+  }
+}
+
+/* Function sameExp returns TRUE if expressions
+ * a and b compute the same value */
+static int sameExp(TreeNode *a, TreeNode *b)
+{
+  if (a->kind.exp != b->kind.exp)
+    return FALSE;
+  switch (a->kind.exp)
+  {
+  case ConstK:
+  case TempK:
+    return a->attr.val == b->attr.val;
+  case VarK:
+    return a->symbol == b->symbol;
+  case OpK:
+    return a->attr.op == b->attr.op && sameExp(a->child[0], b->child[0]) && sameExp(a->child[1], b->child[1]);
+  case ArrK:
+    return a->symbol == b->symbol && sameExp(a->child[0], b->child[0]);
+  default:
+    return FALSE;
+  }
+}
+
+/* Function temporaryFor returns the temporary that
+ * holds the value of t in the loop, adding it to
+ * the preheader if needed. Returns -1 if all
+ * temporaries are taken */
+static int temporaryFor(TreeNode *t, LoopInfo *loop)
+{
+  TreeNode *def, **tail = &loop->node->child[2];
+  for (; *tail; tail = &(*tail)->sibling)
+    if (sameExp((*tail)->child[0], t))
+      return (*tail)->attr.val;
+  if (loop->nextTemp >= NUM_TEMPORARIES)
+    return -1;
+  def = newExpNode(TempK);
+  def->lineno = t->lineno;
+  def->type = t->type;
+  def->attr.val = loop->nextTemp++;
+  def->child[0] = t;
+  *tail = def;
+  ++hoistedExpressions;
+  return def->attr.val;
+}
+
+/* Function hoist replaces expression t by a read of
+ * a temporary set in the preheader. The original
+ * node is kept in place so its parent is untouched */
+static int hoist(TreeNode *t, LoopInfo *loop)
+{
+  TreeNode *copy = newExpNode(t->kind.exp);
+  int temp;
+  *copy = *t;
+  copy->sibling = NULL;
+  if ((temp = temporaryFor(copy, loop)) < 0)
+    return FALSE;
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    t->child[i] = NULL;
+  t->kind.exp = TempK;
+  t->attr.val = temp;
+  return TRUE;
+}
+
+/* Procedure hoistBase keeps the address of the array
+ * indexed by t in a temporary */
+static void hoistBase(TreeNode *t, LoopInfo *loop)
+{
+  TreeNode *base;
+  int temp;
+  if (t->child[1] || isCheapBase(t->symbol) || hasSymbol(loop->assigned, loop->assignedCount, t->symbol))
+    return;
+  base = newExpNode(VarK);
+  base->lineno = t->lineno;
+  base->attr.name = t->attr.name;
+  base->symbol = t->symbol;
+  base->type = t->type;
+  if ((temp = temporaryFor(base, loop)) >= 0)
+  {
+    t->child[1] = newExpNode(TempK);
+    t->child[1]->lineno = t->lineno;
+    t->child[1]->attr.val = temp;
+  }
+}
+
+static void hoistList(TreeNode *t, LoopInfo *loop, int loads);
+
+/* Procedure hoistExp hoists the largest invariant
+ * subexpressions of t */
+static void hoistExp(TreeNode *t, LoopInfo *loop, int loads)
+{
+  if (isInvariant(t, loop, loads) && isWorthHoisting(t) && hoist(t, loop))
+    return;
+  switch (t->kind.exp)
+  {
+  case AssignK:
+    if (t->child[0]->kind.exp == ArrK)
+    {
+      hoistBase(t->child[0], loop);
+      hoistList(t->child[0]->child[0], loop, loads);
+    }
+    hoistList(t->child[1], loop, loads);
+    break;
+  case ArrK:
+    hoistBase(t, loop);
+    hoistList(t->child[0], loop, loads);
+    break;
+  case InlineK: /* parameters are stored to, not read */
+    hoistList(t->child[0], loop, loads);
+    hoistList(t->child[1], loop, FALSE);
+    break;
+  default:
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      hoistList(t->child[i], loop, loads);
+    break;
+  }
+}
+
+/* Procedure hoistList hoists invariant expressions
+ * of the loop out of t and its siblings */
+static void hoistList(TreeNode *t, LoopInfo *loop, int loads)
+{
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == ExpK)
+      hoistExp(t, loop, loads);
+    else if (t->nodekind == StmtK)
+      for (int i = 0; i < MAXCHILDREN; ++i)
+        hoistList(t->child[i], loop, FALSE);
+  }
+}
+
+static void optimizeList(TreeNode *t, int firstTemp);
+
+/* Procedure optimizeLoop hoists the invariants of
+ * the loop t, then of the loops nested in it. A
+ * loop the profile shows never running its body is
+ * left as it is: a temporary costs a register saved
+ * by the function, better given to a loop that runs
+ */
+static void optimizeLoop(TreeNode *t, int firstTemp)
+{
+  LoopInfo loop = {t, NULL, 0, NULL, 0, FALSE, firstTemp, firstTemp};
+  if (profileCount(t, PROFILE_BODY) == 0)
+  {
+    ++coldLoops;
+    return;
+  }
+  scanLoop(t->child[0], &loop);
+  scanLoop(t->child[1], &loop);
+  /* the condition runs at least once, so its loads are safe */
+  hoistList(t->child[0], &loop, TRUE);
+  hoistList(t->child[1], &loop, FALSE);
+  if (loop.nextTemp > loop.firstTemp)
+    ++optimizedLoops;
+  free(loop.assigned);
+  free(loop.stored);
+  optimizeList(t->child[0], loop.nextTemp);
+  optimizeList(t->child[1], loop.nextTemp);
+}
+
+/* Procedure optimizeList visits the loops in t and
+ * its siblings. Temporaries from firstTemp on are
+ * free; sibling loops reuse the same temporaries */
+static void optimizeList(TreeNode *t, int firstTemp)
+{
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == StmtK && t->kind.stmt == IterationK)
+    {
+      optimizeLoop(t, firstTemp);
+      continue;
+    }
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      optimizeList(t->child[i], firstTemp);
+  }
+}
+
+/* Procedure moveLoopInvariants hoists expressions
+ * whose value does not change inside a while loop
+ * into the preheader of the loop.
+ */
+void moveLoopInvariants(TreeNode *syntaxTree)
+{
+  hoistedExpressions = optimizedLoops = coldLoops = 0;
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+    if (t->nodekind == DeclK && t->kind.decl == FunDeclK)
+      optimizeList(t->child[2], 0);
+  if (TraceOptimize)
+  {
+    fprintf(listing, "Loop-invariant code motion: %d expressions hoisted from %d loops\n", hoistedExpressions, optimizedLoops);
+    if (coldLoops)
+      fprintf(listing, "  %d loops never run left alone\n", coldLoops);
+  }
+}
@@ -0,0 +1,22 @@
+/****************************************************/
+/* File: licm.h                                     */
+/* Loop-invariant code motion                       */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _LICM_H_
+#define _LICM_H_
+
+#include "globals.h"
+
+/* Procedure moveLoopInvariants hoists expressions
+ * whose value does not change inside a while loop
+ * into the preheader of the loop, keeping their
+ * values in the temporary registers $s0-$s7.
+ * Hoisted expressions are counted in the listing
+ * file if TraceOptimize is set.
+ */
+void moveLoopInvariants(TreeNode *syntaxTree);
+
+#endif
@@ -8,6 +8,10 @@
 
 #include "globals.h"
 #include "util.h"
+#include "sim.h"
+#include "phase.h"
+#include "timeline.h"
+#include "interp.h"
 #include <assert.h>
 
 /* set NO_PARSE to TRUE to get a scanner-only compiler */
@@ -27,8 +31,18 @@
 #if !NO_ANALYZE
 #include "symtab.h"
 #include "analyze.h"
+#include "deadcode.h"
+#include "inline.h"
+#include "licm.h"
+#include "midend.h"
+#include "bounds.h"
+#include "frame.h"
+#include "profile.h"
 #if !NO_CODE
 #include "cgen.h"
+#include "x86gen.h"
+#include "jit.h"
+#include "bcgen.h"
 #endif
 #endif
 #endif
@@ -44,6 +58,41 @@ int TraceScan = FALSE;
 int TraceParse = FALSE;
 int TraceAnalyze = FALSE;
 int TraceCode = FALSE;
+int TraceOptimize = FALSE;
+int TraceSSA = FALSE;
+int TimeReport = FALSE;
+int ReportJSON = FALSE;
+int PerfCounters = FALSE;
+int TimeTrace = FALSE;
+
+/* allocate and set optimization flags */
+int InlineFunctions = TRUE;
+int InlineLimit = 40;
+int MoveLoopInvariants = TRUE;
+int OptimizeTailCalls = TRUE;
+int PropagateConstants = TRUE;
+int NumberValues = TRUE;
+int BoundsCheck = FALSE;
+int ShareStackSlots = TRUE;
+int SmallData = TRUE;
+int SmallDataLimit = 1024;
+int ProfileGenerate = FALSE;
+int ProfileUse = FALSE;
+
+/* allocate and set runtime library flags */
+int BufferOutput = TRUE;
+int BatchInput = FALSE;
+int Simulate = FALSE;
+int SimStats = FALSE;
+int Profile = FALSE;
+
+/* allocate and set target flags */
+int TargetX86 = FALSE;
+int RunJIT = FALSE;
+int TargetBytecode = FALSE;
+int RunBytecode = FALSE;
+int WriteImage = FALSE;
+int ImageOnly = FALSE;
 
 int Error = FALSE;
 
@@ -52,6 +101,170 @@ static void cleanup(void)
   yylex_destroy();
   destroyPtr();
 }
+
+static void usage(const char *program)
+{
+  fprintf(stderr, "usage: %s [options] <filename>\n", program);
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -fopt-info          report what the optimizations changed\n");
+  fprintf(stderr, "  -finline            inline small non-recursive functions (default)\n");
+  fprintf(stderr, "  -fno-inline         do not inline functions\n");
+  fprintf(stderr, "  -finline-limit=<n>  inline functions of at most n syntax tree nodes\n");
+  fprintf(stderr, "  -fmove-loop-invariants, -fno-move-loop-invariants\n");
+  fprintf(stderr, "                      compute loop invariants once before the loop (default)\n");
+  fprintf(stderr, "  -foptimize-sibling-calls, -fno-optimize-sibling-calls\n");
+  fprintf(stderr, "                      reuse the frame for calls in return statements (default)\n");
+  fprintf(stderr, "  -fsccp, -fno-sccp   propagate constants through the SSA form (default)\n");
+  fprintf(stderr, "  -fgvn, -fno-gvn     reuse values computed earlier (default)\n");
+  fprintf(stderr, "  -fdump-ssa          print the SSA form of every function\n");
+  fprintf(stderr, "  -ftime-report       print the time and memory used by each phase\n");
+  fprintf(stderr, "  -ftime-report=json  print that report as JSON\n");
+  fprintf(stderr, "  -fperf-counters     add hardware counters of each phase to the report\n");
+  fprintf(stderr, "  -ftime-trace        write a timeline of the phases and functions to\n");
+  fprintf(stderr, "                      <file>.trace.json for chrome://tracing\n");
+  fprintf(stderr, "  -fbounds-check      trap on array indices out of bounds\n");
+  fprintf(stderr, "  -fno-bounds-check   do not check array indices (default)\n");
+  fprintf(stderr, "  -fshare-stack-slots, -fno-share-stack-slots\n");
+  fprintf(stderr, "                      let locals never live at once share slots (default)\n");
+  fprintf(stderr, "  -fsmall-data, -fno-small-data\n");
+  fprintf(stderr, "                      address small globals from $gp, the most used\n");
+  fprintf(stderr, "                      first, with one instruction each (default)\n");
+  fprintf(stderr, "  -fsmall-data-limit=<n>\n");
+  fprintf(stderr, "                      put globals of at most n bytes there (default 1024)\n");
+  fprintf(stderr, "  -fprofile-generate  count branches, loops and calls; running the code\n");
+  fprintf(stderr, "                      in the simulator adds the counts to <file>.prof\n");
+  fprintf(stderr, "  -fprofile-use       lay out branches and functions, inline and keep\n");
+  fprintf(stderr, "                      loop invariants in registers as <file>.prof shows\n");
+  fprintf(stderr, "  -fbuffered-io       collect output in a buffer printed at once (default)\n");
+  fprintf(stderr, "  -fno-buffered-io    print every output with its own syscalls\n");
+  fprintf(stderr, "  -fbatch-input       read input without printing a prompt\n");
+  fprintf(stderr, "  --target=x86-64     generate x86-64 assembly to <file>.s and link it\n");
+  fprintf(stderr, "                      into the native executable <file>\n");
+  fprintf(stderr, "  --run               compile to x86-64 in memory and run it in-process\n");
+  fprintf(stderr, "  --target=bytecode   generate register bytecode to <file>.bc\n");
+  fprintf(stderr, "  --run-bytecode      run the bytecode in the interpreter; a .bc file is\n");
+  fprintf(stderr, "                      run without compiling\n");
+  fprintf(stderr, "  --target=mips       generate SPIM code to <file>.tm (default)\n");
+  fprintf(stderr, "  --image             also assemble the SPIM code into the binary image\n");
+  fprintf(stderr, "                      <file>.tmb\n");
+  fprintf(stderr, "  --image-only        write the binary image but not <file>.tm\n");
+  fprintf(stderr, "  --sim               run the code file in the built-in MIPS simulator;\n");
+  fprintf(stderr, "                      a .tm or .tmb file is run without compiling\n");
+  fprintf(stderr, "  --sim-stats         print execution counts of the simulated run\n");
+  fprintf(stderr, "  --profile           run in the simulator and report where the time goes,\n");
+  fprintf(stderr, "                      by function and source line; call stacks for\n");
+  fprintf(stderr, "                      flame graphs go to <file>.folded\n");
+  exit(1);
+}
+
+/* Function parseNumber returns the non-negative
+ * number following prefix in option, or exits */
+static int parseNumber(const char *program, const char *option, const char *prefix)
+{
+  char *end;
+  long value = strtol(option + strlen(prefix), &end, 10);
+  if (option[strlen(prefix)] == '\0' || *end != '\0' || value < 0 || value > 1000000)
+  {
+    fprintf(stderr, "invalid value in option %s\n", option);
+    usage(program);
+  }
+  return (int)value;
+}
+
+/* Procedure parseOption sets the flags for a
+ * single command line option */
+static void parseOption(const char *program, const char *option)
+{
+  if (!strcmp(option, "-fopt-info"))
+    TraceOptimize = TRUE;
+  else if (!strcmp(option, "-finline"))
+    InlineFunctions = TRUE;
+  else if (!strcmp(option, "-fno-inline"))
+    InlineFunctions = FALSE;
+  else if (!strcmp(option, "-fmove-loop-invariants"))
+    MoveLoopInvariants = TRUE;
+  else if (!strcmp(option, "-fno-move-loop-invariants"))
+    MoveLoopInvariants = FALSE;
+  else if (!strcmp(option, "-foptimize-sibling-calls"))
+    OptimizeTailCalls = TRUE;
+  else if (!strcmp(option, "-fno-optimize-sibling-calls"))
+    OptimizeTailCalls = FALSE;
+  else if (!strcmp(option, "-fsccp"))
+    PropagateConstants = TRUE;
+  else if (!strcmp(option, "-fno-sccp"))
+    PropagateConstants = FALSE;
+  else if (!strcmp(option, "-fgvn"))
+    NumberValues = TRUE;
+  else if (!strcmp(option, "-fno-gvn"))
+    NumberValues = FALSE;
+  else if (!strcmp(option, "-fdump-ssa"))
+    TraceSSA = TRUE;
+  else if (!strcmp(option, "-ftime-report"))
+    TimeReport = TRUE;
+  else if (!strcmp(option, "-ftime-report=json"))
+    TimeReport = ReportJSON = TRUE;
+  else if (!strcmp(option, "-fperf-counters"))
+    TimeReport = PerfCounters = TRUE;
+  else if (!strcmp(option, "-ftime-trace"))
+    TimeTrace = TRUE;
+  else if (!strcmp(option, "-fbounds-check"))
+    BoundsCheck = TRUE;
+  else if (!strcmp(option, "-fno-bounds-check"))
+    BoundsCheck = FALSE;
+  else if (!strcmp(option, "-fshare-stack-slots"))
+    ShareStackSlots = TRUE;
+  else if (!strcmp(option, "-fno-share-stack-slots"))
+    ShareStackSlots = FALSE;
+  else if (!strcmp(option, "-fsmall-data"))
+    SmallData = TRUE;
+  else if (!strcmp(option, "-fno-small-data"))
+    SmallData = FALSE;
+  else if (!strcmp(option, "-fprofile-generate"))
+    ProfileGenerate = TRUE;
+  else if (!strcmp(option, "-fprofile-use"))
+    ProfileUse = TRUE;
+  else if (!strcmp(option, "-fbuffered-io"))
+    BufferOutput = TRUE;
+  else if (!strcmp(option, "-fno-buffered-io"))
+    BufferOutput = FALSE;
+  else if (!strcmp(option, "-fbatch-input"))
+    BatchInput = TRUE;
+  else if (!strcmp(option, "--target=x86-64"))
+  {
+    TargetX86 = TRUE;
+    TargetBytecode = FALSE;
+  }
+  else if (!strcmp(option, "--run"))
+    RunJIT = TRUE;
+  else if (!strcmp(option, "--target=bytecode"))
+  {
+    TargetBytecode = TRUE;
+    TargetX86 = FALSE;
+  }
+  else if (!strcmp(option, "--run-bytecode"))
+    RunBytecode = TRUE;
+  else if (!strcmp(option, "--target=mips"))
+    TargetX86 = TargetBytecode = FALSE;
+  else if (!strcmp(option, "--image"))
+    WriteImage = TRUE;
+  else if (!strcmp(option, "--image-only"))
+    WriteImage = ImageOnly = TRUE;
+  else if (!strcmp(option, "--sim"))
+    Simulate = TRUE;
+  else if (!strcmp(option, "--sim-stats"))
+    Simulate = SimStats = TRUE;
+  else if (!strcmp(option, "--profile"))
+    Simulate = Profile = TRUE;
+  else if (!strncmp(option, "-finline-limit=", strlen("-finline-limit=")))
+    InlineLimit = parseNumber(program, option, "-finline-limit=");
+  else if (!strncmp(option, "-fsmall-data-limit=", strlen("-fsmall-data-limit=")))
+    SmallDataLimit = parseNumber(program, option, "-fsmall-data-limit=");
+  else
+  {
+    fprintf(stderr, "unknown option %s\n", option);
+    usage(program);
+  }
+}
 int main(int argc, char *argv[])
 {
   int i;
@@ -60,12 +273,53 @@ int main(int argc, char *argv[])
   TreeNode *mainNode;
 #endif
   char pgm[120]; /* source code file name */
-  if (argc != 2)
+  const char *filename = NULL;
+  int status = 0; /* exit status of the simulated program */
+  for (i = 1; i < argc; ++i)
   {
-    fprintf(stderr, "usage: %s <filename>\n", argv[0]);
-    exit(1);
+    if (argv[i][0] == '-')
+      parseOption(argv[0], argv[i]);
+    else if (filename == NULL)
+      filename = argv[i];
+    else
+      usage(argv[0]);
+  }
+  if (filename == NULL || strlen(filename) + 3 > sizeof(pgm))
+    usage(argv[0]);
+  if (RunJIT)
+    TargetX86 = TRUE;
+  if (RunBytecode)
+    TargetBytecode = TRUE;
+  if ((TargetX86 || TargetBytecode) && Simulate)
+  {
+    fprintf(stderr, "--sim, --sim-stats and --profile run MIPS code, not --target=x86-64, "
+                    "--target=bytecode, --run or --run-bytecode\n");
+    usage(argv[0]);
   }
-  strcpy(pgm, argv[1]);
+  if (TargetX86 && TargetBytecode)
+  {
+    fprintf(stderr, "--run-bytecode runs bytecode, not --target=x86-64 or --run\n");
+    usage(argv[0]);
+  }
+  if (ProfileGenerate && (TargetX86 || TargetBytecode))
+  {
+    fprintf(stderr, "-fprofile-generate counts in MIPS code, not --target=x86-64, "
+                    "--target=bytecode, --run or --run-bytecode\n");
+    usage(argv[0]);
+  }
+  if (WriteImage && (TargetX86 || TargetBytecode))
+  {
+    fprintf(stderr, "--image and --image-only assemble MIPS code, not --target=x86-64, "
+                    "--target=bytecode, --run or --run-bytecode\n");
+    usage(argv[0]);
+  }
+  if (Simulate && strlen(filename) > 3 && !strcmp(filename + strlen(filename) - 3, ".tm"))
+    return simulate(filename);
+  if (Simulate && strlen(filename) > 4 && !strcmp(filename + strlen(filename) - 4, ".tmb"))
+    return simulate(filename);
+  if (RunBytecode && strlen(filename) > 3 && !strcmp(filename + strlen(filename) - 3, ".bc"))
+    return runBytecode(filename);
+  strcpy(pgm, filename);
   if (strchr(pgm, '.') == NULL)
     strcat(pgm, ".c");
   source = fopen(pgm, "r");
@@ -83,10 +337,14 @@ int main(int argc, char *argv[])
     fputc('\n', listing);
   }
 #if NO_PARSE
+  startPhase(PhaseScan);
   while (getToken() != ENDFILE)
-    ;
+    countEvent(CountTokens);
+  endPhase();
 #else
+  startPhase(PhaseParse);
   syntaxTree = parse();
+  endPhase();
   if (TraceParse && !Error)
   {
     fprintf(listing, "Syntax tree:\n");
@@ -97,8 +355,10 @@ int main(int argc, char *argv[])
   {
     if (TraceAnalyze)
       fprintf(listing, "Building Symbol Tree..\n\n");
+    startPhase(PhaseSymtab);
     buildSymtab(syntaxTree);
     decrementScope(); /* Destroy the global scope */
+    endPhase();
     if (!Error && TraceAnalyze)
       fprintf(listing, "No error detected.\n");
   }
@@ -106,7 +366,9 @@ int main(int argc, char *argv[])
   {
     if (TraceAnalyze)
       fprintf(listing, "Performing Type Check..\n");
+    startPhase(PhaseTypeCheck);
     typeCheck(syntaxTree);
+    endPhase();
     if (!Error && TraceAnalyze)
       fprintf(listing, "No error detected.\n");
   }
@@ -114,13 +376,75 @@ int main(int argc, char *argv[])
   {
     if (TraceAnalyze)
       fprintf(listing, "Finding and checking main function..\n");
+    startPhase(PhaseMainCheck);
     mainNode = mainCheck(syntaxTree);
+    endPhase();
     if (!Error && TraceAnalyze)
     {
       fprintf(listing, "Function \'main\' found at line %d\n", mainNode->lineno);
       fprintf(listing, "No error detected.\n");
     }
   }
+  if (!Error && (ProfileGenerate || ProfileUse))
+  { /* sites are numbered before the tree changes */
+    startPhase(PhaseProfile);
+    numberProfileSites(syntaxTree);
+    if (ProfileUse)
+    {
+      int fnlen = getBaseIndex(pgm);
+      char *profilefile = malloc(fnlen + 6);
+      strncpy(profilefile, pgm, fnlen);
+      profilefile[fnlen] = '\0';
+      strcat(profilefile, ".prof");
+      readProfile(profilefile);
+      free(profilefile);
+    }
+    endPhase();
+  }
+  if (!Error && BoundsCheck)
+  {
+    startPhase(PhaseBounds);
+    passArrayLengths(syntaxTree);
+    endPhase();
+  }
+  if (!Error)
+  {
+    if (TraceOptimize)
+      fprintf(listing, "Eliminating dead code..\n");
+    startPhase(PhaseDeadCode);
+    eliminateDeadCode(syntaxTree);
+    endPhase();
+  }
+  if (!Error && InlineFunctions)
+  {
+    startPhase(PhaseInline);
+    inlineFunctions(syntaxTree);
+    endPhase();
+  }
+  if (!Error && MoveLoopInvariants)
+  {
+    startPhase(PhaseLoopInvariants);
+    moveLoopInvariants(syntaxTree);
+    endPhase();
+  }
+  if (!Error && (PropagateConstants || NumberValues || TraceSSA))
+  {
+    startPhase(PhaseSSA);
+    optimizeSSA(syntaxTree);
+    endPhase();
+  }
+  if (!Error && BoundsCheck)
+  {
+    startPhase(PhaseBounds);
+    analyzeBounds(syntaxTree);
+    endPhase();
+  }
+  if (!Error && ShareStackSlots)
+  {
+    startPhase(PhaseFrame);
+    layoutFrames(syntaxTree);
+    endPhase();
+  }
 #if !NO_CODE
   if (!Error)
   {
@@ -128,15 +452,64 @@ int main(int argc, char *argv[])
     int fnlen = getBaseIndex(pgm);
     codefile = malloc(fnlen + 5);
     strncpy(codefile, pgm, fnlen);
-    strcat(codefile, ".tm");
-    code = fopen(codefile, "w");
+    codefile[fnlen] = '\0';
+    strcat(codefile, TargetX86 ? ".s" : TargetBytecode ? ".bc" : ".tm");
+    code = RunJIT ? openJITBuffer() : fopen(codefile, TargetBytecode ? "wb" : "w");
     if (code == NULL)
     {
       printf("Unable to open %s\n", codefile);
       exit(1);
     }
-    codeGen(syntaxTree, codefile);
+    startPhase(PhaseCodeGen);
+    if (TargetX86)
+      codeGenX86(syntaxTree, codefile);
+    else if (TargetBytecode)
+      codeGenBytecode(syntaxTree, codefile);
+    else
+      codeGen(syntaxTree, codefile);
+    endPhase();
+    if (BoundsCheck)
+      reportBoundsChecks();
     fclose(code);
+    if (TimeReport)
+      reportPhases();
+    if (TimeTrace)
+    {
+      char *tracefile = malloc(fnlen + 12);
+      strncpy(tracefile, pgm, fnlen);
+      tracefile[fnlen] = '\0';
+      strcat(tracefile, ".trace.json");
+      writeTimeline(tracefile);
+      free(tracefile);
+    }
+    if (RunJIT)
+      status = runJIT();
+    else if (RunBytecode)
+      status = runBytecode(codefile);
+    else if (TargetX86)
+    { /* the executable is named after the source file */
+      char *program = malloc(fnlen + 1);
+      strncpy(program, pgm, fnlen);
+      program[fnlen] = '\0';
+      if (linkNative(codefile, program, argv[0]) != 0)
+        status = 1;
+      free(program);
+    }
+    else if (WriteImage)
+    { /* the image is named after the code file */
+      char *imagefile = malloc(fnlen + 5);
+      strcpy(imagefile, codefile);
+      strcat(imagefile, "b");
+      if (writeImage(codefile, imagefile) != 0)
+        status = 1;
+      else if (ImageOnly)
+        remove(codefile);
+      if (Simulate && status == 0)
+        status = simulate(imagefile);
+      free(imagefile);
+    }
+    if (Simulate && !WriteImage)
+      status = simulate(codefile);
     free(codefile);
   }
 #endif
@@ -145,5 +518,5 @@ int main(int argc, char *argv[])
   fclose(source);
   cleanup();
 
-  return Error;
+  return Error ? Error : status;
 }
@@ -0,0 +1,387 @@
+/****************************************************/
+/* File: midend.c                                   */
+/* Optimization of the functions in SSA form        */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <stdint.h>
+#include "globals.h"
+#include "parse.h"
+#include "ssa.h"
+#include "sccp.h"
+#include "gvn.h"
+#include "midend.h"
+
+/* An expression already computed, which a later
+ * expression with the same value number may read
+ * instead, once it is kept in a temporary. For the
+ * address of an array element, array is the array
+ * and number the value number of the index */
+typedef struct
+{
+  BucketList array; /* NULL for a value */
+  IrInstr *number;
+  TreeNode *node;
+  IrBlock *block;
+  int temp; /* -1 until the value is reused */
+  int next; /* previous leader of the same bucket */
+} Leader;
+
+static IrFunction *fn;
+static Leader *leaders;
+static int leaderCount;
+static int *leaderHead;
+static int leaderMask;
+static int nextTemp; /* first free temporary */
+
+static int foldedExpressions, foldedBranches;
+static int reusedExpressions, reuseTemporaries;
+static int reusedAddresses, addressTemporaries;
+
+/* Function firstFreeTemporary returns the first
+ * temporary not used by loop-invariant code motion */
+static int firstFreeTemporary(TreeNode *t)
+{
+  int first = 0;
+  for (; t; t = t->sibling)
+  {
+    if (t->nodekind == ExpK && t->kind.exp == TempK && t->attr.val >= first)
+      first = t->attr.val + 1;
+    for (int i = 0; i < MAXCHILDREN; ++i)
+    {
+      int childFirst = firstFreeTemporary(t->child[i]);
+      if (childFirst > first)
+        first = childFirst;
+    }
+  }
+  return first;
+}
+
+/* Function isPure returns TRUE if dropping the
+ * evaluation of t changes nothing but its value */
+static int isPure(TreeNode *t)
+{
+  switch (t->kind.exp)
+  {
+  case ConstK:
+  case VarK:
+    return TRUE;
+  case TempK:
+    return t->child[0] == NULL;
+  case OpK:
+    return isPure(t->child[0]) && isPure(t->child[1]);
+  case ArrK: /* no index if the address is read from a temporary */
+    return t->child[0] == NULL || isPure(t->child[0]);
+  default:
+    return FALSE;
+  }
+}
+
+/* Function constantOf returns TRUE if expression t
+ * has the same value on every execution */
+static int constantOf(TreeNode *t, int *value)
+{
+  IrExpression *e = expressionOf(fn, t);
+  if (e == NULL || e->value->lattice != LatticeConst)
+    return FALSE;
+  *value = e->value->constant;
+  return TRUE;
+}
+
+static void foldNode(TreeNode *t, int value)
+{
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    t->child[i] = NULL;
+  t->kind.exp = ConstK;
+  t->attr.val = value;
+  ++foldedExpressions;
+}
+
+/* Function isReusable returns TRUE if reading a
+ * temporary is cheaper than computing t again */
+static int isReusable(TreeNode *t)
+{
+  IrExpression *e;
+  if (t->kind.exp != OpK && t->kind.exp != ArrK)
+    return FALSE;
+  e = expressionOf(fn, t);
+  return e && e->value->lattice != LatticeConst;
+}
+
+static int leaderBucket(IrInstr *number)
+{
+  return (int)(((uintptr_t)number >> 4) & leaderMask);
+}
+
+static void addLeader(BucketList array, IrInstr *number, TreeNode *node, IrBlock *block)
+{
+  int bucket = leaderBucket(number);
+  leaders = realloc(leaders, sizeof(Leader) * (leaderCount + 1));
+  leaders[leaderCount].array = array;
+  leaders[leaderCount].number = number;
+  leaders[leaderCount].node = node;
+  leaders[leaderCount].block = block;
+  leaders[leaderCount].temp = -1;
+  leaders[leaderCount].next = leaderHead[bucket];
+  leaderHead[bucket] = leaderCount++;
+}
+
+/* Function findLeader returns the leader of the
+ * value or address that was evaluated on every path
+ * to block, or NULL */
+static Leader *findLeader(BucketList array, IrInstr *number, IrBlock *block)
+{
+  for (int l = leaderHead[leaderBucket(number)]; l >= 0; l = leaders[l].next)
+    if (leaders[l].array == array && leaders[l].number == number && dominates(leaders[l].block, block))
+      return &leaders[l];
+  return NULL;
+}
+
+/* Procedure offer makes expression t, whose subtree
+ * has been visited, available to later expressions */
+static void offer(TreeNode *t)
+{
+  IrExpression *e;
+  if (!isReusable(t))
+    return;
+  e = expressionOf(fn, t);
+  addLeader(NULL, e->value->number, t, e->block);
+}
+
+/* Function reuse replaces t by a read of the
+ * temporary holding an earlier expression of the
+ * same value, if one was evaluated on every path to
+ * t. That expression is changed to also set the
+ * temporary. Returns FALSE if there is none */
+static int reuse(TreeNode *t)
+{
+  IrExpression *e;
+  Leader *leader = NULL;
+  if (!isReusable(t) || !isPure(t))
+    return FALSE;
+  e = expressionOf(fn, t);
+  if ((leader = findLeader(NULL, e->value->number, e->block)) == NULL)
+    return FALSE;
+  if (leader->temp < 0)
+  {
+    TreeNode *copy;
+    if (nextTemp >= NUM_TEMPORARIES)
+      return FALSE;
+    leader->temp = nextTemp++;
+    ++reuseTemporaries;
+    copy = newExpNode(leader->node->kind.exp);
+    *copy = *leader->node;
+    copy->sibling = NULL;
+    leader->node->kind.exp = TempK;
+    leader->node->attr.val = leader->temp;
+    leader->node->child[0] = copy;
+    leader->node->child[1] = leader->node->child[2] = NULL;
+    for (int l = 0; l < leaderCount; ++l)
+      if (leaders[l].array && leaders[l].node == leader->node)
+        leaders[l].node = copy; /* the access moved into the copy */
+  }
+  for (int i = 0; i < MAXCHILDREN; ++i)
+    t->child[i] = NULL;
+  t->kind.exp = TempK;
+  t->attr.val = leader->temp;
+  ++reusedExpressions;
+  return TRUE;
+}
+
+static TreeNode *newTemporary(TreeNode *t, int temp)
+{
+  TreeNode *node = newExpNode(TempK);
+  node->lineno = t->lineno;
+  node->type = Integer;
+  node->attr.val = temp;
+  return node;
+}
+
+/* Procedure reuseAddress makes the array access t,
+ * whose index has been visited, read the element
+ * address from a temporary if an access to the
+ * same element of the array was evaluated on every
+ * path to it. The index is then not evaluated. */
+static void reuseAddress(TreeNode *t)
+{
+  IrExpression *index;
+  Leader *leader;
+  if (t->child[2] || (index = expressionOf(fn, t->child[0])) == NULL)
+    return;
+  leader = findLeader(t->symbol, index->value->number, index->block);
+  if (leader == NULL || !isPure(t->child[0]))
+  {
+    addLeader(t->symbol, index->value->number, t, index->block);
+    return;
+  }
+  if (leader->temp < 0)
+  {
+    if (nextTemp >= NUM_TEMPORARIES)
+      return;
+    leader->temp = nextTemp++;
+    leader->node->child[2] = newTemporary(leader->node, leader->temp);
+    ++addressTemporaries;
+  }
+  t->child[0] = NULL;
+  t->child[2] = newTemporary(t, leader->temp);
+  ++reusedAddresses;
+}
+
+static void rewriteList(TreeNode **link);
+
+/* Procedure rewriteExp folds and reuses the
+ * expressions of t in the order they are evaluated */
+static void rewriteExp(TreeNode *t)
+{
+  int value;
+  switch (t->kind.exp)
+  {
+  case ConstK:
+    break;
+  case VarK:
+    if (!t->symbol->is_array && constantOf(t, &value))
+      foldNode(t, value);
+    break;
+  case TempK:
+    if (t->child[0])
+      rewriteExp(t->child[0]);
+    else if (constantOf(t, &value))
+      foldNode(t, value);
+    break;
+  case OpK:
+    if (isPure(t) && constantOf(t, &value))
+      foldNode(t, value);
+    else if (!reuse(t))
+    {
+      rewriteExp(t->child[0]);
+      rewriteExp(t->child[1]);
+      offer(t);
+    }
+    break;
+  case ArrK:
+    if (!reuse(t))
+    {
+      rewriteExp(t->child[0]);
+      reuseAddress(t);
+      offer(t);
+    }
+    break;
+  case AssignK:
+    if (t->child[0]->kind.exp == ArrK)
+    {
+      rewriteExp(t->child[0]->child[0]);
+      reuseAddress(t->child[0]);
+    }
+    rewriteExp(t->child[1]);
+    break;
+  case CallK:
+    for (TreeNode *arg = t->child[0]; arg; arg = arg->sibling)
+      rewriteExp(arg);
+    break;
+  case InlineK:
+    for (TreeNode *arg = t->child[0]; arg; arg = arg->sibling)
+      rewriteExp(arg);
+    rewriteList(&t->child[1]);
+    break;
+  }
+}
+
+/* Procedure rewriteList rewrites the statements of
+ * a list, replacing selection statements with a
+ * constant condition by the arm taken and removing
+ * loops whose condition is never true */
+static void rewriteList(TreeNode **link)
+{
+  while (*link)
+  {
+    TreeNode *t = *link;
+    int value;
+    if (t->nodekind == ExpK)
+      rewriteExp(t);
+    else if (t->nodekind == StmtK)
+    {
+      switch (t->kind.stmt)
+      {
+      case CompoundK:
+        rewriteList(&t->child[1]);
+        break;
+      case SelectionK:
+        if (isPure(t->child[0]) && constantOf(t->child[0], &value))
+        {
+          TreeNode *taken = value ? t->child[1] : t->child[2];
+          ++foldedBranches;
+          if (taken == NULL)
+            *link = t->sibling;
+          else
+          {
+            taken->sibling = t->sibling;
+            *link = taken;
+          }
+          continue;
+        }
+        rewriteExp(t->child[0]);
+        rewriteList(&t->child[1]);
+        rewriteList(&t->child[2]);
+        break;
+      case IterationK:
+        if (isPure(t->child[0]) && constantOf(t->child[0], &value) && !value)
+        {
+          ++foldedBranches;
+          *link = t->sibling;
+          continue;
+        }
+        rewriteList(&t->child[2]);
+        rewriteExp(t->child[0]);
+        rewriteList(&t->child[1]);
+        break;
+      case ReturnK:
+        if (t->child[0])
+          rewriteExp(t->child[0]);
+        break;
+      }
+    }
+    link = &t->sibling;
+  }
+}
+
+void optimizeSSA(TreeNode *syntaxTree)
+{
+  foldedExpressions = foldedBranches = 0;
+  reusedExpressions = reuseTemporaries = 0;
+  reusedAddresses = addressTemporaries = 0;
+  for (TreeNode *t = syntaxTree; t; t = t->sibling)
+  {
+    int size = 16;
+    if (t->nodekind != DeclK || t->kind.decl != FunDeclK)
+      continue;
+    fn = buildSSA(t);
+    if (PropagateConstants)
+      propagateConstants(fn);
+    if (NumberValues)
+      numberValues(fn);
+    if (TraceSSA)
+      printSSA(fn);
+    while (size < fn->instrCount)
+      size *= 2;
+    leaderMask = size - 1;
+    leaderHead = malloc(sizeof(int) * size);
+    for (int i = 0; i < size; ++i)
+      leaderHead[i] = -1;
+    nextTemp = firstFreeTemporary(t->child[2]);
+    rewriteList(&t->child[2]);
+    free(leaders);
+    free(leaderHead);
+    leaders = NULL;
+    leaderHead = NULL;
+    leaderCount = 0;
+    freeSSA(fn);
+    fn = NULL;
+  }
+  if (TraceOptimize)
+  {
+    fprintf(listing, "Constant propagation: %d expressions and %d branches folded\n", foldedExpressions, foldedBranches);
+    fprintf(listing, "Value numbering: %d redundant expressions read from %d temporaries\n", reusedExpressions, reuseTemporaries);
+    fprintf(listing, "Array addresses: %d recomputations read from %d temporaries\n", reusedAddresses, addressTemporaries);
+  }
+}
@@ -0,0 +1,25 @@
+/****************************************************/
+/* File: midend.h                                   */
+/* Optimization of the functions in SSA form        */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _MIDEND_H_
+#define _MIDEND_H_
+
+#include "globals.h"
+
+/* Procedure optimizeSSA lowers every function to
+ * SSA form, runs constant propagation and value
+ * numbering on it, and writes the results back to
+ * the syntax tree for the code generator: constant
+ * expressions and branches are folded, and an
+ * expression computed again is read from the
+ * temporary register its first computation was
+ * kept in. So is the address of an array element
+ * accessed again with an index of the same value.
+ */
+void optimizeSSA(TreeNode *syntaxTree);
+
+#endif
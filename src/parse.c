@@ -7,6 +7,7 @@
 
 #include "parse.h"
 #include "util.h"
+#include "phase.h"
 
 /* Function newStmtNode creates a new statement
  * node for syntax tree construction
@@ -25,8 +26,10 @@ TreeNode *newStmtNode(StmtKind kind)
     t->nodekind = StmtK;
     t->kind.stmt = kind;
     t->lineno = lineno;
+    t->site = -1;
   }
   addPtr(t);
+  countEvent(CountNodes);
   return t;
 }
 
@@ -47,9 +50,11 @@ TreeNode *newExpNode(ExpKind kind)
     t->nodekind = ExpK;
     t->kind.exp = kind;
     t->lineno = lineno;
+    t->site = -1;
     t->type = Void;
   }
   addPtr(t);
+  countEvent(CountNodes);
   return t;
 }
 
@@ -70,9 +75,11 @@ TreeNode *newDeclNode(DeclKind kind)
     t->nodekind = DeclK;
     t->kind.decl = kind;
     t->lineno = lineno;
+    t->site = -1;
     t->symbol = NULL;
   }
   addPtr(t);
+  countEvent(CountNodes);
   return t;
 }
 
@@ -90,8 +97,10 @@ TreeNode *newTypeNode(TypeKind kind)
     t->nodekind = TypeK;
     t->kind.type = kind;
     t->lineno = lineno;
+    t->site = -1;
   }
   addPtr(t);
+  countEvent(CountNodes);
   return t;
 }
 
@@ -109,7 +118,9 @@ TreeNode *newParamNode(ParamKind kind)
     t->nodekind = ParamK;
     t->kind.param = kind;
     t->lineno = lineno;
+    t->site = -1;
   }
   addPtr(t);
+  countEvent(CountNodes);
   return t;
 }
@@ -0,0 +1,413 @@
+/****************************************************/
+/* File: phase.c                                    */
+/* Time and memory used by each compiler phase      */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#define NO_ALLOCATION_HOOKS /* this file implements them */
+
+#include <stddef.h>
+#include <time.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "globals.h"
+#include "phase.h"
+#include "timeline.h"
+
+/* Phases nest no deeper than scanning in parsing */
+#define MAX_PHASE_DEPTH 4
+
+static const char *const phaseNames[PHASE_COUNT] = {
+    "scanning", "parsing", "symbol table", "type checking", "main check",
+    "profile", "dead code", "inlining", "loop invariants", "SSA optimization",
+    "bounds analysis", "frame layout", "code generation"};
+
+static const char *const counterNames[COUNTER_COUNT] = {
+    "tokens", "ast_nodes", "symbols", "scopes", "instructions"};
+
+/* Hardware counters read for PerfCounters, in the
+ * order they are opened in one group */
+typedef enum
+{
+  HwCycles,
+  HwInstructions,
+  HwBranchMisses,
+  HwCacheMisses,
+  HW_COUNT
+} HwCounter;
+
+static const char *const hwNames[HW_COUNT] = {
+    "cycles", "instructions", "branch_misses", "llc_misses"};
+
+typedef struct
+{
+  double wall, cpu;   /* milliseconds */
+  size_t allocated;   /* bytes */
+  size_t freed;       /* bytes */
+  size_t peak;        /* most bytes in use at once */
+  unsigned long long hw[HW_COUNT];
+} PhaseStats;
+
+long eventCounts[COUNTER_COUNT];
+
+static PhaseStats stats[PHASE_COUNT];
+static Phase stack[MAX_PHASE_DEPTH];
+static int depth;
+
+static double lastWall;              /* time of the last phase switch */
+static double outerCpu;              /* CPU time when the outermost phase started */
+static double outerWall[PHASE_COUNT]; /* wall time of each phase then */
+
+static size_t liveBytes, peakBytes;
+
+static int hwOpened;                      /* opening was tried */
+static int hwGroup = -1;                  /* descriptor of the group leader */
+static int hwSlot[HW_COUNT];              /* position in the group, or -1 */
+static int hwInGroup;
+static unsigned long long hwLast[HW_COUNT]; /* values at the last switch */
+static const char *hwError;               /* why there are no counters */
+
+/* With TimeReport set, every block handed out by
+ * the hooks is preceded by its size, aligned for any
+ * type. Without it they are malloc and free, so the
+ * flag must not change once the heap is in use. */
+typedef union
+{
+  size_t size;
+  max_align_t align;
+} Header;
+
+static double readClock(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+#ifdef __linux__
+static int openCounter(unsigned long long config, int group)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.exclude_kernel = 1; /* so reading them costs no counts */
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+/* Procedure openCounters opens the hardware counters
+ * as one group, so they count over the same time.
+ * Without a leader there are no counters; a member
+ * the machine lacks is left out of the report */
+static void openCounters(void)
+{
+#ifdef __linux__
+  static const unsigned long long configs[HW_COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+  hwOpened = TRUE;
+  for (int c = 0; c < HW_COUNT; ++c)
+  {
+    int fd = openCounter(configs[c], hwGroup);
+    hwSlot[c] = -1;
+    if (fd < 0 && c == 0)
+    {
+      if (errno == EACCES || errno == EPERM)
+        hwError = "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+      else if (errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP)
+        hwError = "this machine has none";
+      else
+        hwError = strerror(errno);
+      return;
+    }
+    if (fd < 0)
+      continue;
+    if (c == 0)
+      hwGroup = fd;
+    hwSlot[c] = hwInGroup++;
+  }
+#else
+  hwOpened = TRUE;
+  hwError = "not supported on this system";
+#endif
+}
+
+/* Procedure chargeCounters adds the counts since the
+ * last switch to the innermost phase */
+static void chargeCounters(void)
+{
+#ifdef __linux__
+  unsigned long long values[1 + HW_COUNT];
+  if (hwGroup < 0 || read(hwGroup, values, sizeof values) < (ssize_t)(sizeof(values[0]) * (1 + hwInGroup)))
+    return;
+  for (int c = 0; c < HW_COUNT; ++c)
+  {
+    unsigned long long value;
+    if (hwSlot[c] < 0)
+      continue;
+    value = values[1 + hwSlot[c]];
+    if (depth > 0)
+      stats[stack[depth - 1]].hw[c] += value - hwLast[c];
+    hwLast[c] = value;
+  }
+#endif
+}
+
+/* Procedure chargeWall adds the time since the last
+ * switch to the innermost phase, and the hardware
+ * counts with PerfCounters */
+static void chargeWall(void)
+{
+  double now;
+  if (PerfCounters && !hwOpened)
+    openCounters();
+  now = readClock(CLOCK_MONOTONIC);
+  if (depth > 0)
+    stats[stack[depth - 1]].wall += now - lastWall;
+  lastWall = now;
+  if (PerfCounters)
+    chargeCounters();
+}
+
+void startPhase(Phase p)
+{
+  if (!(TimeReport || TimeTrace) || depth == MAX_PHASE_DEPTH)
+    return;
+  if (TimeReport)
+  {
+    chargeWall();
+    if (depth == 0)
+    {
+      outerCpu = readClock(CLOCK_PROCESS_CPUTIME_ID);
+      for (int i = 0; i < PHASE_COUNT; ++i)
+        outerWall[i] = stats[i].wall;
+    }
+    if (liveBytes > stats[p].peak)
+      stats[p].peak = liveBytes;
+  }
+  stack[depth++] = p;
+  if (p != PhaseScan)
+    beginSpan("phase", phaseNames[p]);
+}
+
+/* Reading the CPU clock is a system call, too slow
+ * to do on every token, so it is only read around
+ * the outermost phase. Its CPU time is split among
+ * the phases nested in it by their wall time. */
+void endPhase(void)
+{
+  if (depth == 0)
+    return;
+  if (stack[depth - 1] != PhaseScan)
+    endSpan();
+  if (!TimeReport)
+  {
+    --depth;
+    return;
+  }
+  chargeWall();
+  if (--depth == 0)
+  {
+    double cpu = readClock(CLOCK_PROCESS_CPUTIME_ID) - outerCpu;
+    double wall = 0.0;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+      wall += stats[i].wall - outerWall[i];
+    for (int i = 0; i < PHASE_COUNT; ++i)
+      if (wall > 0.0)
+        stats[i].cpu += cpu * (stats[i].wall - outerWall[i]) / wall;
+  }
+}
+
+static void allocated(size_t size)
+{
+  liveBytes += size;
+  if (liveBytes > peakBytes)
+    peakBytes = liveBytes;
+  if (depth > 0)
+  {
+    PhaseStats *s = &stats[stack[depth - 1]];
+    s->allocated += size;
+    if (liveBytes > s->peak)
+      s->peak = liveBytes;
+  }
+}
+
+static void freed(size_t size)
+{
+  liveBytes -= size;
+  if (depth > 0)
+    stats[stack[depth - 1]].freed += size;
+}
+
+void *phaseMalloc(size_t size)
+{
+  Header *h;
+  if (!TimeReport)
+    return malloc(size);
+  h = malloc(sizeof(Header) + size);
+  if (h == NULL)
+    return NULL;
+  h->size = size;
+  allocated(size);
+  return h + 1;
+}
+
+void *phaseCalloc(size_t count, size_t size)
+{
+  Header *h;
+  if (!TimeReport)
+    return calloc(count, size);
+  if (size && count > ((size_t)-1 - sizeof(Header)) / size)
+    return NULL;
+  h = calloc(1, sizeof(Header) + count * size);
+  if (h == NULL)
+    return NULL;
+  h->size = count * size;
+  allocated(h->size);
+  return h + 1;
+}
+
+void *phaseRealloc(void *ptr, size_t size)
+{
+  Header *h;
+  size_t old;
+  if (!TimeReport)
+    return realloc(ptr, size);
+  if (ptr == NULL)
+    return phaseMalloc(size);
+  h = (Header *)ptr - 1;
+  old = h->size;
+  h = realloc(h, sizeof(Header) + size);
+  if (h == NULL)
+    return NULL;
+  h->size = size;
+  freed(old);
+  allocated(size);
+  return h + 1;
+}
+
+void phaseFree(void *ptr)
+{
+  Header *h;
+  if (!TimeReport || ptr == NULL)
+  {
+    free(ptr);
+    return;
+  }
+  h = (Header *)ptr - 1;
+  freed(h->size);
+  free(h);
+}
+
+static double kilobytes(double bytes)
+{
+  return bytes / 1024.0;
+}
+
+static void printCounterTable(void)
+{
+  unsigned long long total[HW_COUNT] = {0};
+  if (hwError)
+  {
+    fprintf(stderr, "\nHardware counters unavailable: %s\n", hwError);
+    return;
+  }
+  fprintf(stderr, "\nHardware counters by phase (user mode):\n");
+  fprintf(stderr, "%-18s %14s %14s %6s %14s %14s\n", "phase", "cycles", "instructions", "IPC",
+          "branch misses", "LLC misses");
+  for (int i = 0; i <= PHASE_COUNT; ++i)
+  {
+    unsigned long long *hw = i < PHASE_COUNT ? stats[i].hw : total;
+    fprintf(stderr, "%-18s", i < PHASE_COUNT ? phaseNames[i] : "total");
+    for (int c = 0; c < HW_COUNT; ++c)
+    {
+      if (hwSlot[c] < 0)
+        fprintf(stderr, " %14s", "-");
+      else
+        fprintf(stderr, " %14llu", hw[c]);
+      if (c == HwInstructions)
+        fprintf(stderr, " %6.2f", hw[HwCycles] ? (double)hw[HwInstructions] / (double)hw[HwCycles] : 0.0);
+      if (i < PHASE_COUNT)
+        total[c] += hw[c];
+    }
+    fputc('\n', stderr);
+  }
+}
+
+static void printTable(void)
+{
+  double wall = 0.0, cpu = 0.0;
+  size_t allocatedBytes = 0, freedBytes = 0;
+  for (int i = 0; i < PHASE_COUNT; ++i)
+  {
+    wall += stats[i].wall;
+    cpu += stats[i].cpu;
+  }
+  fprintf(stderr, "\nTime and memory by phase:\n");
+  fprintf(stderr, "%-18s %10s %7s %10s %10s %10s\n", "phase", "wall ms", "%", "cpu ms", "peak KB", "net KB");
+  for (int i = 0; i < PHASE_COUNT; ++i)
+  {
+    PhaseStats *s = &stats[i];
+    allocatedBytes += s->allocated;
+    freedBytes += s->freed;
+    fprintf(stderr, "%-18s %10.3f %6.1f%% %10.3f %10.1f %10.1f\n", phaseNames[i], s->wall,
+            wall > 0.0 ? s->wall * 100.0 / wall : 0.0, s->cpu, kilobytes((double)s->peak),
+            kilobytes((double)s->allocated - (double)s->freed));
+  }
+  fprintf(stderr, "%-18s %10.3f %6.1f%% %10.3f %10.1f %10.1f\n", "total", wall, 100.0, cpu,
+          kilobytes((double)peakBytes), kilobytes((double)allocatedBytes - (double)freedBytes));
+  if (PerfCounters)
+    printCounterTable();
+  fprintf(stderr, "\nCounts:\n");
+  for (int c = 0; c < COUNTER_COUNT; ++c)
+    fprintf(stderr, "%-18s %10ld\n", counterNames[c], eventCounts[c]);
+}
+
+/* One phase per line, so the runner of the
+ * benchmarks can read it without a JSON parser */
+static void printJSON(void)
+{
+  double wall = 0.0, cpu = 0.0;
+  fprintf(stderr, "{\n  \"phases\": [\n");
+  for (int i = 0; i < PHASE_COUNT; ++i)
+  {
+    PhaseStats *s = &stats[i];
+    wall += s->wall;
+    cpu += s->cpu;
+    fprintf(stderr, "    {\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+                    "\"peak_bytes\": %zu, \"allocated_bytes\": %zu, \"freed_bytes\": %zu",
+            phaseNames[i], s->wall, s->cpu, s->peak, s->allocated, s->freed);
+    for (int c = 0; c < HW_COUNT; ++c)
+      if (PerfCounters && !hwError && hwSlot[c] >= 0)
+        fprintf(stderr, ", \"%s\": %llu", hwNames[c], s->hw[c]);
+    fprintf(stderr, "}%s\n", i + 1 < PHASE_COUNT ? "," : "");
+  }
+  fprintf(stderr, "  ],\n  \"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_bytes\": %zu},\n",
+          wall, cpu, peakBytes);
+  if (PerfCounters && hwError)
+    fprintf(stderr, "  \"hardware_counters\": \"unavailable: %s\",\n", hwError);
+  fprintf(stderr, "  \"counts\": {");
+  for (int c = 0; c < COUNTER_COUNT; ++c)
+    fprintf(stderr, "\"%s\": %ld%s", counterNames[c], eventCounts[c], c + 1 < COUNTER_COUNT ? ", " : "");
+  fprintf(stderr, "}\n}\n");
+}
+
+void reportPhases(void)
+{
+  if (ReportJSON)
+    printJSON();
+  else
+    printTable();
+}
@@ -0,0 +1,65 @@
+/****************************************************/
+/* File: phase.h                                    */
+/* Time and memory used by each compiler phase      */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _PHASE_H_
+#define _PHASE_H_
+
+#include "globals.h"
+
+typedef enum
+{
+  PhaseScan,
+  PhaseParse,
+  PhaseSymtab,
+  PhaseTypeCheck,
+  PhaseMainCheck,
+  PhaseProfile,
+  PhaseDeadCode,
+  PhaseInline,
+  PhaseLoopInvariants,
+  PhaseSSA,
+  PhaseBounds,
+  PhaseFrame,
+  PhaseCodeGen,
+  PHASE_COUNT
+} Phase;
+
+/* Events counted for the report, whether or not it
+ * is printed */
+typedef enum
+{
+  CountTokens,
+  CountNodes,
+  CountSymbols,
+  CountScopes,
+  CountInstructions,
+  COUNTER_COUNT
+} Counter;
+
+extern long eventCounts[COUNTER_COUNT];
+
+#define countEvent(counter) (++eventCounts[counter])
+
+/* Procedure startPhase charges the time and memory
+ * used from now on to phase p, until the matching
+ * endPhase. Phases nest: scanning runs inside
+ * parsing, and the time of the inner phase is not
+ * charged to the outer one. With TimeTrace set,
+ * every phase but scanning is also a span of the
+ * timeline. Both do nothing unless one is set.
+ */
+void startPhase(Phase p);
+void endPhase(void);
+
+/* Procedure reportPhases prints the wall and CPU
+ * time, the peak and net heap use of every phase,
+ * and the event counts to stderr, as a table or
+ * as JSON if ReportJSON is set
+ */
+void reportPhases(void);
+
+#endif
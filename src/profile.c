@@ -0,0 +1,188 @@
+/****************************************************/
+/* File: profile.c                                  */
+/* Execution counts for profile-guided optimization */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include "globals.h"
+#include "profile.h"
+
+/* The first line of a profile file, followed by one
+ * count per line */
+#define PROFILE_HEADER "C- profile %u %d\n"
+
+/* Per mille of all counted executions made by the
+ * hot counters */
+enum
+{
+  HOT_PERMILLE = 990
+};
+
+static int siteCount;
+static unsigned int checksum;
+static unsigned long long *counts; /* NULL without a profile */
+static unsigned long long hotThreshold;
+
+/* Procedure mix adds value to the checksum, by the
+ * FNV-1a hash of its bytes */
+static void mix(unsigned int value)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    checksum ^= (value >> (8 * i)) & 0xff;
+    checksum *= 16777619u;
+  }
+}
+
+/* Function countersOf returns the number of
+ * counters node t has */
+static int countersOf(TreeNode *t)
+{
+  switch (t->nodekind)
+  {
+  case DeclK:
+    return t->kind.decl == FunDeclK;
+  case StmtK:
+    return t->kind.stmt == SelectionK || t->kind.stmt == IterationK ? 2 : 0;
+  case ExpK:
+    return t->kind.exp == CallK && strcmp(t->attr.name, "input") && strcmp(t->attr.name, "output");
+  default:
+    return 0;
+  }
+}
+
+/* Procedure numberList numbers the sites in t and
+ * its siblings in preorder */
+static void numberList(TreeNode *t)
+{
+  for (; t; t = t->sibling)
+  {
+    int counters = countersOf(t);
+    if (counters)
+    {
+      t->site = siteCount;
+      siteCount += counters;
+      mix((unsigned int)t->nodekind << 8 | (unsigned int)t->kind.stmt);
+      mix((unsigned int)t->lineno);
+    }
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      numberList(t->child[i]);
+  }
+}
+
+void numberProfileSites(TreeNode *syntaxTree)
+{
+  siteCount = 0;
+  checksum = 2166136261u;
+  numberList(syntaxTree);
+  checksum &= 0x7fffffff; /* a positive .word */
+}
+
+int profileSites(void)
+{
+  return siteCount;
+}
+
+unsigned int profileChecksum(void)
+{
+  return checksum;
+}
+
+static int compareCounts(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Procedure findHotThreshold sets the smallest hot
+ * count: counts are taken from the largest down
+ * until they make HOT_PERMILLE of the total */
+static void findHotThreshold(void)
+{
+  unsigned long long *sorted = malloc(sizeof(unsigned long long) * siteCount + 1);
+  long double total = 0, sum = 0;
+  memcpy(sorted, counts, sizeof(unsigned long long) * siteCount);
+  qsort(sorted, siteCount, sizeof(unsigned long long), compareCounts);
+  for (int i = 0; i < siteCount; ++i)
+    total += sorted[i];
+  hotThreshold = 1;
+  for (int i = 0; i < siteCount && sorted[i] > 0; ++i)
+  {
+    hotThreshold = sorted[i];
+    sum += sorted[i];
+    if (sum * 1000 >= total * HOT_PERMILLE)
+      break;
+  }
+  free(sorted);
+}
+
+int readProfile(const char *profilefile)
+{
+  FILE *in = fopen(profilefile, "r");
+  unsigned int fileChecksum;
+  int sites, ok;
+  if (in == NULL)
+  {
+    fprintf(stderr, "warning: profile %s not found, compiling without it\n", profilefile);
+    return FALSE;
+  }
+  ok = fscanf(in, PROFILE_HEADER, &fileChecksum, &sites) == 2 && fileChecksum == checksum && sites == siteCount;
+  if (ok)
+  {
+    counts = calloc(siteCount + 1, sizeof(unsigned long long));
+    for (int i = 0; ok && i < siteCount; ++i)
+      ok = fscanf(in, "%llu", &counts[i]) == 1;
+  }
+  fclose(in);
+  if (!ok)
+  {
+    fprintf(stderr, "warning: profile %s was not made from this source, compiling without it\n", profilefile);
+    free(counts);
+    counts = NULL;
+    return FALSE;
+  }
+  findHotThreshold();
+  if (TraceOptimize)
+    fprintf(listing, "Profile %s: %d counters, hot from %llu\n", profilefile, siteCount, hotThreshold);
+  return TRUE;
+}
+
+void mergeProfile(const char *profilefile, unsigned int checksum, int sites, const unsigned int *counters)
+{
+  unsigned long long *merged = calloc(sites + 1, sizeof(unsigned long long));
+  unsigned int fileChecksum;
+  int fileSites;
+  FILE *file = fopen(profilefile, "r");
+  if (file)
+  { /* add the counts of earlier runs */
+    if (fscanf(file, PROFILE_HEADER, &fileChecksum, &fileSites) == 2 && fileChecksum == checksum && fileSites == sites)
+      for (int i = 0; i < sites && fscanf(file, "%llu", &merged[i]) == 1; ++i)
+        ;
+    fclose(file);
+  }
+  file = fopen(profilefile, "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Unable to open %s\n", profilefile);
+    free(merged);
+    return;
+  }
+  fprintf(file, PROFILE_HEADER, checksum, sites);
+  for (int i = 0; i < sites; ++i)
+    fprintf(file, "%llu\n", merged[i] + counters[i]);
+  fclose(file);
+  free(merged);
+}
+
+long long profileCount(const TreeNode *t, int counter)
+{
+  if (counts == NULL || t->site < 0)
+    return -1;
+  return (long long)counts[t->site + counter];
+}
+
+int isHotCount(long long count)
+{
+  return counts != NULL && count >= (long long)hotThreshold;
+}
@@ -0,0 +1,77 @@
+/****************************************************/
+/* File: profile.h                                  */
+/* Execution counts for profile-guided optimization */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "globals.h"
+
+/* The counters of a profiled node, from its site.
+ * A function counts its entries, a call the times
+ * it is made, a selection its then and else arms,
+ * and a loop its entries and the runs of its body */
+enum
+{
+  PROFILE_ENTRIES = 0,
+  PROFILE_CALLS = 0,
+  PROFILE_THEN = 0,
+  PROFILE_ELSE = 1,
+  PROFILE_BODY = 1
+};
+
+/* An instrumented program keeps its counters in the
+ * data word array PROFILE_SYMBOL: the number of
+ * counters, the checksum of the sites, then one
+ * word per counter */
+#define PROFILE_SYMBOL "_rt_profile"
+enum
+{
+  PROFILE_HEADER_WORDS = 2
+};
+
+/* Procedure numberProfileSites gives the nodes that
+ * are counted their first counter, in the order of
+ * the source, so that the same source numbers them
+ * alike in every compilation. It must run before
+ * the tree is optimized.
+ */
+void numberProfileSites(TreeNode *syntaxTree);
+
+/* Function profileSites returns the number of
+ * counters, and profileChecksum the checksum of the
+ * sites, given by numberProfileSites
+ */
+int profileSites(void);
+unsigned int profileChecksum(void);
+
+/* Function readProfile reads the counts written by
+ * an instrumented run of the same source. A missing
+ * or stale profile is reported and ignored.
+ * Returns TRUE if the counts were read.
+ */
+int readProfile(const char *profilefile);
+
+/* Procedure mergeProfile adds the counters of a
+ * run to the profile file, which is rewritten. The
+ * counts in it are discarded if they were made from
+ * other sites.
+ */
+void mergeProfile(const char *profilefile, unsigned int checksum, int sites, const unsigned int *counters);
+
+/* Function profileCount returns the count of the
+ * given counter of t, or -1 without a profile or if
+ * t is not counted
+ */
+long long profileCount(const TreeNode *t, int counter);
+
+/* Function isHotCount returns TRUE if count is among
+ * the largest counts, which together make 99% of the
+ * profile
+ */
+int isHotCount(long long count);
+
+#endif
@@ -0,0 +1,112 @@
+/****************************************************/
+/* File: runtime.c                                  */
+/* Runtime library of native C- programs,           */
+/* linked with the code of --target=x86-64          */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+/* The stack of the program. Its frames also hold
+ * the return address, the saved %rbp and the home
+ * slots of the registered parameters, which MIPS
+ * keeps in registers, with every slot a quadword,
+ * so they take several times the space of those on
+ * MIPS. The stack is eight times the 16MB of the
+ * simulator, for recursion to go as deep natively
+ * as on SPIM. Only the pages touched are allocated */
+enum
+{
+  STACK_SIZE = 0x08000000
+};
+
+/* the main function of the program, under the name
+ * the code generator gives it */
+extern int cmMain(void) __asm__("cm.main");
+
+static ucontext_t caller, program;
+static int status;
+
+/* Function rtInput reads an integer from stdin,
+ * printing the prompt first if prompt is set. Like
+ * the simulator, it returns 0 if none can be read
+ */
+int rtInput(int prompt)
+{
+  int value;
+  if (prompt)
+  {
+    fputs("input: ", stdout);
+    fflush(stdout);
+  }
+  if (scanf("%d", &value) != 1)
+    value = 0;
+  return value;
+}
+
+/* Procedure rtOutput prints an integer. stdout is
+ * buffered by the C library unless rtUnbuffered was
+ * called, and flushed on exit
+ */
+void rtOutput(int value)
+{
+  printf("output: %d\n", value);
+}
+
+/* Procedure rtUnbuffered makes every output go to
+ * stdout at once, for -fno-buffered-io
+ */
+void rtUnbuffered(void)
+{
+  setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+/* Procedure rtBoundsError reports an array index
+ * out of bounds at line lineno and exits with
+ * status 1
+ */
+void rtBoundsError(int lineno)
+{
+  printf("error: array index out of bounds at line %d\n", lineno);
+  exit(1);
+}
+
+/* Procedure runProgram runs the program on its own
+ * stack and returns to main */
+static void runProgram(void)
+{
+  status = cmMain();
+}
+
+/* Function main switches to a stack of STACK_SIZE
+ * bytes, under a guard page, and runs the program
+ * there. Returns its status
+ */
+int main(void)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  char *stack = mmap(NULL, page + STACK_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED || mprotect(stack + page, STACK_SIZE, PROT_READ | PROT_WRITE) != 0)
+  {
+    perror("stack");
+    return 1;
+  }
+  getcontext(&program);
+  program.uc_stack.ss_sp = stack + page;
+  program.uc_stack.ss_size = STACK_SIZE;
+  program.uc_link = &caller;
+  makecontext(&program, runProgram, 0);
+  if (swapcontext(&caller, &program) != 0)
+  {
+    perror("swapcontext");
+    return 1;
+  }
+  return status;
+}
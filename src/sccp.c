@@ -0,0 +1,234 @@
+/****************************************************/
+/* File: sccp.c                                     */
+/* Sparse conditional constant propagation          */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "sccp.h"
+
+/* A control flow edge, given as the block entered
+ * and the index of the predecessor */
+typedef struct
+{
+  IrBlock *block;
+  int pred;
+} Edge;
+
+static Edge *flowList;
+static int flowCount, flowCapacity;
+static IrInstr **ssaList;
+static int ssaCount, ssaCapacity;
+
+static void pushEdge(IrBlock *from, IrBlock *to)
+{
+  for (int p = 0; p < to->predCount; ++p)
+    if (to->preds[p] == from && !to->edgeExecutable[p])
+    {
+      if (flowCount == flowCapacity)
+      {
+        flowCapacity = flowCapacity ? 2 * flowCapacity : 16;
+        flowList = realloc(flowList, sizeof(Edge) * flowCapacity);
+      }
+      flowList[flowCount].block = to;
+      flowList[flowCount].pred = p;
+      ++flowCount;
+    }
+}
+
+static void pushUsers(IrInstr *i)
+{
+  for (int u = 0; u < i->userCount; ++u)
+  {
+    if (ssaCount == ssaCapacity)
+    {
+      ssaCapacity = ssaCapacity ? 2 * ssaCapacity : 16;
+      ssaList = realloc(ssaList, sizeof(IrInstr *) * ssaCapacity);
+    }
+    ssaList[ssaCount++] = i->users[u];
+  }
+}
+
+/* Function fold computes left op right into value.
+ * Returns FALSE if the operation would trap */
+static int fold(TokenType op, int left, int right, int *value)
+{
+  switch (op)
+  {
+  case PLUS:
+    *value = (int)((unsigned int)left + (unsigned int)right);
+    break;
+  case MINUS:
+    *value = (int)((unsigned int)left - (unsigned int)right);
+    break;
+  case TIMES:
+    *value = (int)((unsigned int)left * (unsigned int)right);
+    break;
+  case OVER:
+    if (right == 0 || (right == -1 && left == INT_MIN))
+      return FALSE;
+    *value = left / right;
+    break;
+  case LT:
+    *value = left < right;
+    break;
+  case LTE:
+    *value = left <= right;
+    break;
+  case GT:
+    *value = left > right;
+    break;
+  case GTE:
+    *value = left >= right;
+    break;
+  case EQ:
+    *value = left == right;
+    break;
+  default: /* NEQ */
+    *value = left != right;
+    break;
+  }
+  return TRUE;
+}
+
+static int isZero(IrInstr *i)
+{
+  return i->lattice == LatticeConst && i->constant == 0;
+}
+
+/* Procedure evaluate lowers the lattice value of i
+ * according to its operands */
+static void evaluate(IrInstr *i, LatticeKind *lattice, int *constant)
+{
+  IrInstr *left, *right;
+  *lattice = LatticeBottom;
+  switch (i->opcode)
+  {
+  case IrConst:
+    *lattice = LatticeConst;
+    *constant = i->value;
+    break;
+  case IrPhi:
+    *lattice = LatticeTop;
+    for (int p = 0; p < i->operandCount; ++p)
+    {
+      IrInstr *operand = i->operands[p];
+      if (!i->block->edgeExecutable[p] || operand->lattice == LatticeTop)
+        continue;
+      if (operand->lattice == LatticeBottom ||
+          (*lattice == LatticeConst && *constant != operand->constant))
+      {
+        *lattice = LatticeBottom;
+        break;
+      }
+      *lattice = LatticeConst;
+      *constant = operand->constant;
+    }
+    break;
+  case IrBinary:
+    left = i->operands[0];
+    right = i->operands[1];
+    if (i->op == TIMES && (isZero(left) || isZero(right)))
+    { /* zero whatever the other operand is */
+      *lattice = LatticeConst;
+      *constant = 0;
+    }
+    else if (left->lattice == LatticeBottom || right->lattice == LatticeBottom)
+      *lattice = LatticeBottom;
+    else if (left->lattice == LatticeTop || right->lattice == LatticeTop)
+      *lattice = LatticeTop;
+    else if (fold(i->op, left->constant, right->constant, constant))
+      *lattice = LatticeConst;
+    break;
+  default: /* parameters, memory and calls */
+    break;
+  }
+}
+
+/* Procedure visit evaluates instruction i again
+ * after an operand or an incoming edge changed */
+static void visit(IrInstr *i)
+{
+  LatticeKind lattice;
+  int constant = 0;
+  IrBlock *b = i->block;
+  switch (i->opcode)
+  {
+  case IrJump:
+    pushEdge(b, b->succs[0]);
+    return;
+  case IrBranch:
+    if (i->operands[0]->lattice == LatticeConst)
+      pushEdge(b, b->succs[i->operands[0]->constant ? 0 : 1]);
+    else if (i->operands[0]->lattice == LatticeBottom)
+    {
+      pushEdge(b, b->succs[0]);
+      pushEdge(b, b->succs[1]);
+    }
+    return;
+  case IrReturn:
+  case IrStore:
+    return;
+  default:
+    break;
+  }
+  if (i->lattice == LatticeBottom)
+    return;
+  evaluate(i, &lattice, &constant);
+  if (lattice != i->lattice || (lattice == LatticeConst && constant != i->constant))
+  {
+    i->lattice = lattice;
+    i->constant = constant;
+    pushUsers(i);
+  }
+}
+
+void propagateConstants(IrFunction *f)
+{
+  for (int b = 0; b < f->blockCount; ++b)
+  {
+    IrBlock *block = f->blocks[b];
+    block->executable = FALSE;
+    block->edgeExecutable = calloc(block->predCount + 1, sizeof(int));
+    for (IrInstr *i = block->phis; i; i = i->next)
+      i->lattice = LatticeTop;
+    for (IrInstr *i = block->first; i; i = i->next)
+      i->lattice = LatticeTop;
+  }
+  flowCount = ssaCount = 0;
+  f->blocks[0]->executable = TRUE;
+  for (IrInstr *i = f->blocks[0]->first; i; i = i->next)
+    visit(i);
+  while (flowCount || ssaCount)
+  {
+    while (flowCount)
+    {
+      Edge edge = flowList[--flowCount];
+      IrBlock *b = edge.block;
+      if (b->edgeExecutable[edge.pred])
+        continue;
+      b->edgeExecutable[edge.pred] = TRUE;
+      for (IrInstr *i = b->phis; i; i = i->next)
+        visit(i);
+      if (!b->executable)
+      { /* first time the block is reached */
+        b->executable = TRUE;
+        for (IrInstr *i = b->first; i; i = i->next)
+          visit(i);
+      }
+    }
+    while (ssaCount)
+    {
+      IrInstr *i = ssaList[--ssaCount];
+      if (i->block->executable)
+        visit(i);
+    }
+  }
+  free(flowList);
+  free(ssaList);
+  flowList = NULL;
+  ssaList = NULL;
+  flowCapacity = ssaCapacity = 0;
+}
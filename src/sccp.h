@@ -0,0 +1,21 @@
+/****************************************************/
+/* File: sccp.h                                     */
+/* Sparse conditional constant propagation          */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _SCCP_H_
+#define _SCCP_H_
+
+#include "ssa.h"
+
+/* Procedure propagateConstants finds the values of
+ * the function that are the same constant on every
+ * execution, and the blocks that can never run
+ * because the branches leading to them are decided
+ * by constants (Wegman and Zadeck).
+ */
+void propagateConstants(IrFunction *f);
+
+#endif
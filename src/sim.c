@@ -0,0 +1,2418 @@
+/****************************************************/
+/* File: sim.c                                      */
+/* Built-in MIPS simulator for the C- compiler      */
+/* The code file is assembled into MIPS machine     */
+/* words (expanding SPIM pseudo-instructions),      */
+/* pre-decoded into a compact instruction array     */
+/* and run by a threaded-dispatch interpreter       */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "globals.h"
+#include "profile.h"
+#include "sim.h"
+
+/**************************************************/
+/***********   Assembler                ***********/
+/**************************************************/
+
+enum
+{
+  SYMTAB_SIZE = 1021,
+  MAXOPERANDS = 3,
+  MAXEXPANSION = 4, /* longest pseudo-instruction expansion */
+  LINEBUF_SIZE = 1024
+};
+
+/* register numbers with special meaning */
+enum
+{
+  R_ZERO = 0,
+  R_AT = 1,
+  R_V0 = 2,
+  R_A0 = 4,
+  R_GP = 28,
+  R_SP = 29,
+  R_FP = 30,
+  R_RA = 31
+};
+
+typedef enum
+{
+  OprReg,
+  OprImm,
+  OprSym, /* bare identifier: label or symbol */
+  OprMem  /* [sym][+imm][(reg)] */
+} OperandKind;
+
+typedef struct
+{
+  OperandKind kind;
+  int reg; /* -1 if absent in OprMem */
+  int imm;
+  char *sym;
+  int small; /* sym is small data, declared before the line */
+} Operand;
+
+/* One instruction line kept between the two passes */
+typedef struct AsmLineRec
+{
+  char *mnemonic;
+  int nops;
+  Operand ops[MAXOPERANDS];
+  unsigned int address;
+  int lineno;
+  struct AsmLineRec *next;
+} AsmLine;
+
+typedef struct SymbolRec
+{
+  char *name;
+  unsigned int address;
+  int small; /* in the small data area, reached from $gp */
+  struct SymbolRec *next;
+} * Symbol;
+
+static Symbol symbols[SYMTAB_SIZE];
+
+/* Assembled program */
+static unsigned int *textWords; /* encoded MIPS instructions */
+static int textCount;
+static int textCapacity;
+static unsigned char *dataMemory; /* SIM_DATA_BASE .. +SIM_DATA_SIZE */
+static unsigned int dataEnd;      /* first free address of .data */
+static unsigned int smallDataEnd; /* first free address of the small data */
+static unsigned int entryAddress;
+
+/* Source line table written by cgen as "#.loc line
+ * function" comments, and the code regions starting
+ * at global labels, by index of the first word */
+typedef struct
+{
+  int start;
+  int lineno;
+  char *function;
+} LineEntry;
+
+typedef struct
+{
+  int start;
+  char *name;
+} Region;
+
+static LineEntry *lineTable;
+static int lineCount;
+static Region *regions;
+static int regionCount;
+
+static const char *asmFile;
+static int asmLineno;
+static int asmError;
+static int resolving; /* FALSE during the first pass */
+
+static void assembleError(const char *message, const char *detail)
+{
+  if (!resolving)
+    return;
+  fprintf(stderr, "%s:%d: %s%s%s\n", asmFile, asmLineno, message,
+          detail ? ": " : "", detail ? detail : "");
+  asmError = TRUE;
+}
+
+/* the hash function which returns a number in [0, SYMTAB_SIZE) */
+static int symHash(const char *key)
+{
+  unsigned int temp = 0;
+  while (*key)
+    temp = (temp << 4) + (unsigned char)*key++;
+  return temp % SYMTAB_SIZE;
+}
+
+static Symbol findSymbol(const char *name)
+{
+  Symbol s = symbols[symHash(name)];
+  while (s && strcmp(s->name, name))
+    s = s->next;
+  return s;
+}
+
+static void defineSymbol(const char *name, unsigned int address)
+{
+  int h = symHash(name);
+  Symbol s = findSymbol(name);
+  if (s)
+  {
+    assembleError("label defined twice", name);
+    return;
+  }
+  s = malloc(sizeof(struct SymbolRec));
+  s->name = malloc(strlen(name) + 1);
+  strcpy(s->name, name);
+  s->address = address;
+  s->small = FALSE;
+  s->next = symbols[h];
+  symbols[h] = s;
+}
+
+static unsigned int symbolAddress(const char *name)
+{
+  Symbol s = findSymbol(name);
+  if (!resolving)
+    return 0;
+  if (s == NULL)
+  {
+    assembleError("undefined symbol", name);
+    return 0;
+  }
+  return s->address;
+}
+
+static void destroySymbols(void)
+{
+  for (int i = 0; i < SYMTAB_SIZE; ++i)
+    while (symbols[i])
+    {
+      Symbol s = symbols[i];
+      symbols[i] = s->next;
+      free(s->name);
+      free(s);
+    }
+}
+
+static int parseRegister(const char *s)
+{
+  static const char *const names[] = {
+      "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+      "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+      "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+      "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"};
+  if (*s++ != '$')
+    return -1;
+  if (isdigit((unsigned char)*s))
+  {
+    int n = atoi(s);
+    return (n >= 0 && n < 32) ? n : -1;
+  }
+  for (int i = 0; i < 32; ++i)
+    if (!strcmp(s, names[i]))
+      return i;
+  if (!strcmp(s, "s8"))
+    return R_FP;
+  return -1;
+}
+
+static int isSymbolChar(int c)
+{
+  return isalnum(c) || c == '_' || c == '.' || c == '$';
+}
+
+/* Parses one operand token. Returns FALSE on syntax error. */
+static int parseOperand(char *tok, Operand *op)
+{
+  char *paren = strchr(tok, '(');
+  op->reg = -1;
+  op->imm = 0;
+  op->sym = NULL;
+  op->small = FALSE;
+  if (tok[0] == '$' && !paren)
+  {
+    op->kind = OprReg;
+    op->reg = parseRegister(tok);
+    return op->reg >= 0;
+  }
+  if (paren)
+  {
+    char *close = strchr(paren, ')');
+    if (!close)
+      return FALSE;
+    *close = '\0';
+    op->reg = parseRegister(paren + 1);
+    *paren = '\0';
+    if (op->reg < 0)
+      return FALSE;
+  }
+  op->kind = paren ? OprMem : OprImm;
+  if (isalpha((unsigned char)tok[0]) || tok[0] == '_' || tok[0] == '.')
+  { /* symbol with optional displacement */
+    char *p = tok;
+    while (*p && isSymbolChar((unsigned char)*p))
+      ++p;
+    if (*p == '+' || *p == '-')
+      op->imm = (int)strtol(p, NULL, 0);
+    *p = '\0';
+    op->sym = tok;
+    op->kind = (paren || op->imm) ? OprMem : OprSym;
+  }
+  else if (tok[0])
+  {
+    char *end;
+    op->imm = (int)strtol(tok, &end, 0);
+    if (*end)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Encoding helpers */
+#define ENC_R(rs, rt, rd, sh, fn) \
+  ((unsigned)(rs) << 21 | (unsigned)(rt) << 16 | (unsigned)(rd) << 11 | (unsigned)(sh) << 6 | (unsigned)(fn))
+#define ENC_I(op, rs, rt, imm) \
+  ((unsigned)(op) << 26 | (unsigned)(rs) << 21 | (unsigned)(rt) << 16 | ((unsigned)(imm)&0xffff))
+#define ENC_J(op, target) \
+  ((unsigned)(op) << 26 | (((unsigned)(target) >> 2) & 0x3ffffff))
+
+enum /* primary opcodes */
+{
+  OP_SPECIAL = 0x00,
+  OP_REGIMM = 0x01,
+  OP_J = 0x02,
+  OP_JAL = 0x03,
+  OP_BEQ = 0x04,
+  OP_BNE = 0x05,
+  OP_BLEZ = 0x06,
+  OP_BGTZ = 0x07,
+  OP_ADDI = 0x08,
+  OP_ADDIU = 0x09,
+  OP_SLTI = 0x0a,
+  OP_SLTIU = 0x0b,
+  OP_ANDI = 0x0c,
+  OP_ORI = 0x0d,
+  OP_XORI = 0x0e,
+  OP_LUI = 0x0f,
+  OP_SPECIAL2 = 0x1c,
+  OP_LB = 0x20,
+  OP_LH = 0x21,
+  OP_LW = 0x23,
+  OP_LBU = 0x24,
+  OP_LHU = 0x25,
+  OP_SB = 0x28,
+  OP_SH = 0x29,
+  OP_SW = 0x2b
+};
+
+enum /* SPECIAL function codes */
+{
+  FN_SLL = 0x00,
+  FN_SRL = 0x02,
+  FN_SRA = 0x03,
+  FN_SLLV = 0x04,
+  FN_SRLV = 0x06,
+  FN_SRAV = 0x07,
+  FN_JR = 0x08,
+  FN_JALR = 0x09,
+  FN_SYSCALL = 0x0c,
+  FN_BREAK = 0x0d,
+  FN_MFHI = 0x10,
+  FN_MTHI = 0x11,
+  FN_MFLO = 0x12,
+  FN_MTLO = 0x13,
+  FN_MULT = 0x18,
+  FN_MULTU = 0x19,
+  FN_DIV = 0x1a,
+  FN_DIVU = 0x1b,
+  FN_ADD = 0x20,
+  FN_ADDU = 0x21,
+  FN_SUB = 0x22,
+  FN_SUBU = 0x23,
+  FN_AND = 0x24,
+  FN_OR = 0x25,
+  FN_XOR = 0x26,
+  FN_NOR = 0x27,
+  FN_SLT = 0x2a,
+  FN_SLTU = 0x2b,
+  FN2_MUL = 0x02 /* SPECIAL2 */
+};
+
+static int fitsSigned16(int v)
+{
+  return v >= -32768 && v <= 32767;
+}
+
+static int fitsUnsigned16(int v)
+{
+  return v >= 0 && v <= 65535;
+}
+
+/* Table of three-operand ALU mnemonics */
+typedef struct
+{
+  const char *name;
+  int funct;   /* register form */
+  int immOp;   /* immediate form, -1 if none */
+  int zeroExt; /* immediate is zero-extended */
+} AluOp;
+
+static const AluOp aluOps[] = {
+    {"add", FN_ADD, OP_ADDI, FALSE},
+    {"addu", FN_ADDU, OP_ADDIU, FALSE},
+    {"addi", FN_ADD, OP_ADDI, FALSE},
+    {"addiu", FN_ADDU, OP_ADDIU, FALSE},
+    {"sub", FN_SUB, -1, FALSE},
+    {"subu", FN_SUBU, -1, FALSE},
+    {"and", FN_AND, OP_ANDI, TRUE},
+    {"andi", FN_AND, OP_ANDI, TRUE},
+    {"or", FN_OR, OP_ORI, TRUE},
+    {"ori", FN_OR, OP_ORI, TRUE},
+    {"xor", FN_XOR, OP_XORI, TRUE},
+    {"xori", FN_XOR, OP_XORI, TRUE},
+    {"nor", FN_NOR, -1, FALSE},
+    {"slt", FN_SLT, OP_SLTI, FALSE},
+    {"slti", FN_SLT, OP_SLTI, FALSE},
+    {"sltu", FN_SLTU, OP_SLTIU, FALSE},
+    {"sltiu", FN_SLTU, OP_SLTIU, FALSE},
+    {"sllv", FN_SLLV, -1, FALSE},
+    {"srlv", FN_SRLV, -1, FALSE},
+    {"srav", FN_SRAV, -1, FALSE},
+    {NULL, 0, 0, 0}};
+
+/* Emits li into out. Returns number of words. */
+static int expandLi(unsigned int *out, int rd, int imm)
+{
+  if (fitsSigned16(imm))
+  {
+    out[0] = ENC_I(OP_ADDIU, R_ZERO, rd, imm);
+    return 1;
+  }
+  if (fitsUnsigned16(imm))
+  {
+    out[0] = ENC_I(OP_ORI, R_ZERO, rd, imm);
+    return 1;
+  }
+  out[0] = ENC_I(OP_LUI, 0, R_AT, (unsigned)imm >> 16);
+  out[1] = ENC_I(OP_ORI, R_AT, rd, imm & 0xffff);
+  return 2;
+}
+
+/* Resolves a memory operand into base register and
+ * 16-bit displacement, emitting address arithmetic
+ * into $at if necessary. Returns number of words. */
+static int expandAddress(unsigned int *out, const Operand *op, int *base, int *disp)
+{
+  int n = 0;
+  int offset = op->imm;
+  if (op->kind == OprReg)
+  {
+    *base = op->reg;
+    *disp = 0;
+    return 0;
+  }
+  if (op->sym)
+    offset += (int)symbolAddress(op->sym);
+  if (op->small && op->reg < 0)
+  {
+    *base = R_GP;
+    *disp = offset - SIM_GP_INIT;
+    if (resolving && !fitsSigned16(*disp))
+      assembleError("small data out of reach of $gp", op->sym);
+    return 0;
+  }
+  if (!op->sym && op->reg >= 0 && fitsSigned16(offset))
+  {
+    *base = op->reg;
+    *disp = offset;
+    return 0;
+  }
+  if (!op->sym && op->reg < 0 && fitsSigned16(offset))
+  {
+    *base = R_ZERO;
+    *disp = offset;
+    return 0;
+  }
+  /* lui $at, %hi; [addu $at, $at, reg]; op rt, %lo($at) */
+  out[n++] = ENC_I(OP_LUI, 0, R_AT, ((unsigned)offset + 0x8000) >> 16);
+  if (op->reg >= 0)
+    out[n++] = ENC_R(R_AT, op->reg, R_AT, 0, FN_ADDU);
+  *base = R_AT;
+  *disp = (short)(offset & 0xffff);
+  return n;
+}
+
+/* Branch offset from the word at address pc */
+static int branchOffset(unsigned int pc, const Operand *target)
+{
+  unsigned int dest;
+  if (target->kind != OprSym)
+  {
+    assembleError("branch target must be a label", NULL);
+    return 0;
+  }
+  dest = symbolAddress(target->sym);
+  return ((int)dest - (int)(pc + 4)) >> 2;
+}
+
+/* Emits 'compare into $at then branch' for the
+ * blt/bge/bgt/ble family. */
+static int expandCompareBranch(unsigned int *out, unsigned int pc, const AsmLine *l,
+                               int swap, int branchIfSet, int isUnsigned)
+{
+  int slt = isUnsigned ? FN_SLTU : FN_SLT;
+  int n = 0;
+  int rs = l->ops[0].reg;
+  int rt;
+  if (l->ops[1].kind == OprImm)
+  {
+    if (!swap && fitsSigned16(l->ops[1].imm))
+      out[n++] = ENC_I(isUnsigned ? OP_SLTIU : OP_SLTI, rs, R_AT, l->ops[1].imm);
+    else
+    {
+      n += expandLi(out + n, R_AT, l->ops[1].imm);
+      out[n++] = swap ? ENC_R(R_AT, rs, R_AT, 0, slt) : ENC_R(rs, R_AT, R_AT, 0, slt);
+    }
+  }
+  else
+  {
+    rt = l->ops[1].reg;
+    out[n++] = swap ? ENC_R(rt, rs, R_AT, 0, slt) : ENC_R(rs, rt, R_AT, 0, slt);
+  }
+  out[n] = ENC_I(branchIfSet ? OP_BNE : OP_BEQ, R_AT, R_ZERO,
+                 branchOffset(pc + 4 * n, &l->ops[2]));
+  return n + 1;
+}
+
+/* Expands one instruction line into machine words.
+ * The number of words depends only on the syntax of
+ * the line, so the first pass can call this with
+ * symbols still undefined. */
+static int expand(const AsmLine *l, unsigned int pc, unsigned int *out)
+{
+  const char *m = l->mnemonic;
+  const Operand *o = l->ops;
+  int n = 0;
+  int base, disp;
+
+  /* three-operand ALU forms, also accepting 'op rd, x' for 'op rd, rd, x' */
+  for (const AluOp *a = aluOps; a->name; ++a)
+  {
+    if (strcmp(m, a->name))
+      continue;
+    {
+      int rd = o[0].reg;
+      int rs = (l->nops == 3) ? o[1].reg : rd;
+      const Operand *src = (l->nops == 3) ? &o[2] : &o[1];
+      if (src->kind == OprReg)
+      {
+        out[0] = ENC_R(rs, src->reg, rd, 0, a->funct);
+        return 1;
+      }
+      if (a->funct == FN_SUB || a->funct == FN_SUBU)
+      { /* subtract immediate becomes add of its negation */
+        if (fitsSigned16(-src->imm))
+        {
+          out[0] = ENC_I(a->funct == FN_SUB ? OP_ADDI : OP_ADDIU, rs, rd, -src->imm);
+          return 1;
+        }
+      }
+      else if (a->immOp >= 0 && (a->zeroExt ? fitsUnsigned16(src->imm) : fitsSigned16(src->imm)))
+      {
+        out[0] = ENC_I(a->immOp, rs, rd, src->imm);
+        return 1;
+      }
+      n = expandLi(out, R_AT, src->imm);
+      out[n++] = ENC_R(rs, R_AT, rd, 0, a->funct);
+      return n;
+    }
+  }
+
+  if (!strcmp(m, "li"))
+    return expandLi(out, o[0].reg, o[1].imm);
+  if (!strcmp(m, "la"))
+  {
+    unsigned int addr = (unsigned)o[1].imm;
+    if (o[1].sym)
+      addr += symbolAddress(o[1].sym);
+    if (o[1].kind == OprMem && !o[1].sym && o[1].reg >= 0 && fitsSigned16(o[1].imm))
+    {
+      out[0] = ENC_I(OP_ADDIU, o[1].reg, o[0].reg, o[1].imm);
+      return 1;
+    }
+    if (o[1].small && o[1].reg < 0)
+    {
+      if (resolving && !fitsSigned16((int)(addr - SIM_GP_INIT)))
+        assembleError("small data out of reach of $gp", o[1].sym);
+      out[0] = ENC_I(OP_ADDIU, R_GP, o[0].reg, addr - SIM_GP_INIT);
+      return 1;
+    }
+    out[n++] = ENC_I(OP_LUI, 0, R_AT, addr >> 16);
+    out[n++] = ENC_I(OP_ORI, R_AT, o[0].reg, addr & 0xffff);
+    if (o[1].kind == OprMem && o[1].reg >= 0)
+      out[n++] = ENC_R(o[0].reg, o[1].reg, o[0].reg, 0, FN_ADDU);
+    return n;
+  }
+  if (!strcmp(m, "move"))
+  {
+    out[0] = ENC_R(R_ZERO, o[1].reg, o[0].reg, 0, FN_ADDU);
+    return 1;
+  }
+  if (!strcmp(m, "neg") || !strcmp(m, "negu"))
+  {
+    out[0] = ENC_R(R_ZERO, o[1].reg, o[0].reg, 0, m[3] ? FN_SUBU : FN_SUB);
+    return 1;
+  }
+  if (!strcmp(m, "not"))
+  {
+    out[0] = ENC_R(o[1].reg, R_ZERO, o[0].reg, 0, FN_NOR);
+    return 1;
+  }
+  if (!strcmp(m, "lui"))
+  {
+    out[0] = ENC_I(OP_LUI, 0, o[0].reg, o[1].imm);
+    return 1;
+  }
+
+  /* loads and stores */
+  {
+    static const struct
+    {
+      const char *name;
+      int op;
+    } memOps[] = {{"lw", OP_LW}, {"sw", OP_SW}, {"lb", OP_LB}, {"lbu", OP_LBU}, {"lh", OP_LH}, {"lhu", OP_LHU}, {"sb", OP_SB}, {"sh", OP_SH}, {NULL, 0}};
+    for (int i = 0; memOps[i].name; ++i)
+      if (!strcmp(m, memOps[i].name))
+      {
+        n = expandAddress(out, &o[1], &base, &disp);
+        out[n++] = ENC_I(memOps[i].op, base, o[0].reg, disp);
+        return n;
+      }
+  }
+
+  /* shifts */
+  if (!strcmp(m, "sll") || !strcmp(m, "srl") || !strcmp(m, "sra"))
+  {
+    int fn = (m[2] == 'l') ? (m[1] == 'l' ? FN_SLL : FN_SRL) : FN_SRA;
+    if (o[2].kind == OprReg)
+      out[0] = ENC_R(o[2].reg, o[1].reg, o[0].reg, 0, fn + 4);
+    else
+      out[0] = ENC_R(0, o[1].reg, o[0].reg, o[2].imm & 31, fn);
+    return 1;
+  }
+
+  /* multiplication and division */
+  if (!strcmp(m, "mul"))
+  {
+    int rt = o[2].reg;
+    if (o[2].kind != OprReg)
+    {
+      n = expandLi(out, R_AT, o[2].imm);
+      rt = R_AT;
+    }
+    out[n++] = ENC_I(OP_SPECIAL2, o[1].reg, rt, 0) | (unsigned)(o[0].reg << 11) | FN2_MUL;
+    return n;
+  }
+  if (!strcmp(m, "mult") || !strcmp(m, "multu"))
+  {
+    out[0] = ENC_R(o[0].reg, o[1].reg, 0, 0, m[4] ? FN_MULTU : FN_MULT);
+    return 1;
+  }
+  if (!strcmp(m, "div") || !strcmp(m, "divu") || !strcmp(m, "rem") || !strcmp(m, "remu"))
+  {
+    int fn = (m[3] == 'u') ? FN_DIVU : FN_DIV;
+    if (l->nops == 2)
+    {
+      out[0] = ENC_R(o[0].reg, o[1].reg, 0, 0, fn);
+      return 1;
+    }
+    {
+      int rt = o[2].reg;
+      if (o[2].kind != OprReg)
+      {
+        n = expandLi(out, R_AT, o[2].imm);
+        rt = R_AT;
+      }
+      out[n++] = ENC_R(o[1].reg, rt, 0, 0, fn);
+      out[n++] = ENC_R(0, 0, o[0].reg, 0, m[0] == 'r' ? FN_MFHI : FN_MFLO);
+      return n;
+    }
+  }
+  if (!strcmp(m, "mfhi") || !strcmp(m, "mflo"))
+  {
+    out[0] = ENC_R(0, 0, o[0].reg, 0, m[2] == 'h' ? FN_MFHI : FN_MFLO);
+    return 1;
+  }
+  if (!strcmp(m, "mthi") || !strcmp(m, "mtlo"))
+  {
+    out[0] = ENC_R(o[0].reg, 0, 0, 0, m[2] == 'h' ? FN_MTHI : FN_MTLO);
+    return 1;
+  }
+
+  /* set pseudo-instructions */
+  if (!strcmp(m, "sgt") || !strcmp(m, "sle") || !strcmp(m, "sge") ||
+      !strcmp(m, "seq") || !strcmp(m, "sne") || !strcmp(m, "sgtu"))
+  {
+    int rd = o[0].reg, rs = o[1].reg, rt = o[2].reg;
+    if (o[2].kind != OprReg)
+    {
+      n = expandLi(out, R_AT, o[2].imm);
+      rt = R_AT;
+    }
+    if (!strcmp(m, "sgt"))
+      out[n++] = ENC_R(rt, rs, rd, 0, FN_SLT);
+    else if (!strcmp(m, "sgtu"))
+      out[n++] = ENC_R(rt, rs, rd, 0, FN_SLTU);
+    else if (!strcmp(m, "sle"))
+    {
+      out[n++] = ENC_R(rt, rs, rd, 0, FN_SLT);
+      out[n++] = ENC_I(OP_XORI, rd, rd, 1);
+    }
+    else if (!strcmp(m, "sge"))
+    {
+      out[n++] = ENC_R(rs, rt, rd, 0, FN_SLT);
+      out[n++] = ENC_I(OP_XORI, rd, rd, 1);
+    }
+    else if (!strcmp(m, "seq"))
+    {
+      out[n++] = ENC_R(rs, rt, rd, 0, FN_SUBU);
+      out[n++] = ENC_I(OP_SLTIU, rd, rd, 1);
+    }
+    else
+    {
+      out[n++] = ENC_R(rs, rt, rd, 0, FN_SUBU);
+      out[n++] = ENC_R(R_ZERO, rd, rd, 0, FN_SLTU);
+    }
+    return n;
+  }
+
+  /* branches and jumps */
+  if (!strcmp(m, "b"))
+  {
+    out[0] = ENC_I(OP_BEQ, R_ZERO, R_ZERO, branchOffset(pc, &o[0]));
+    return 1;
+  }
+  if (!strcmp(m, "beqz") || !strcmp(m, "bnez"))
+  {
+    out[0] = ENC_I(m[1] == 'e' ? OP_BEQ : OP_BNE, o[0].reg, R_ZERO, branchOffset(pc, &o[1]));
+    return 1;
+  }
+  if (!strcmp(m, "beq") || !strcmp(m, "bne"))
+  {
+    int rt = o[1].reg;
+    if (o[1].kind != OprReg)
+    {
+      if (o[1].imm == 0)
+        rt = R_ZERO;
+      else
+      {
+        n = expandLi(out, R_AT, o[1].imm);
+        rt = R_AT;
+      }
+    }
+    out[n] = ENC_I(m[1] == 'e' ? OP_BEQ : OP_BNE, o[0].reg, rt, branchOffset(pc + 4 * n, &o[2]));
+    return n + 1;
+  }
+  if (!strcmp(m, "bltz") || !strcmp(m, "bgez"))
+  {
+    out[0] = ENC_I(OP_REGIMM, o[0].reg, m[1] == 'l' ? 0 : 1, branchOffset(pc, &o[1]));
+    return 1;
+  }
+  if (!strcmp(m, "blez") || !strcmp(m, "bgtz"))
+  {
+    out[0] = ENC_I(m[1] == 'l' ? OP_BLEZ : OP_BGTZ, o[0].reg, 0, branchOffset(pc, &o[1]));
+    return 1;
+  }
+  if (!strcmp(m, "blt") || !strcmp(m, "bltu"))
+    return expandCompareBranch(out, pc, l, FALSE, TRUE, m[3] == 'u');
+  if (!strcmp(m, "bge") || !strcmp(m, "bgeu"))
+    return expandCompareBranch(out, pc, l, FALSE, FALSE, m[3] == 'u');
+  if (!strcmp(m, "bgt") || !strcmp(m, "bgtu"))
+    return expandCompareBranch(out, pc, l, TRUE, TRUE, m[3] == 'u');
+  if (!strcmp(m, "ble") || !strcmp(m, "bleu"))
+    return expandCompareBranch(out, pc, l, TRUE, FALSE, m[3] == 'u');
+  if (!strcmp(m, "j") || !strcmp(m, "jal"))
+  {
+    if (o[0].kind == OprReg) /* 'j $ra' is accepted as jr */
+      out[0] = ENC_R(o[0].reg, 0, m[1] ? R_RA : 0, 0, m[1] ? FN_JALR : FN_JR);
+    else
+      out[0] = ENC_J(m[1] ? OP_JAL : OP_J, o[0].sym ? symbolAddress(o[0].sym) : 0);
+    return 1;
+  }
+  if (!strcmp(m, "jr"))
+  {
+    out[0] = ENC_R(o[0].reg, 0, 0, 0, FN_JR);
+    return 1;
+  }
+  if (!strcmp(m, "jalr"))
+  {
+    out[0] = ENC_R(o[0].reg, 0, R_RA, 0, FN_JALR);
+    return 1;
+  }
+  if (!strcmp(m, "syscall"))
+  {
+    out[0] = ENC_R(0, 0, 0, 0, FN_SYSCALL);
+    return 1;
+  }
+  if (!strcmp(m, "break"))
+  {
+    out[0] = ENC_R(0, 0, 0, 0, FN_BREAK);
+    return 1;
+  }
+  if (!strcmp(m, "nop"))
+  {
+    out[0] = 0;
+    return 1;
+  }
+  assembleError("unknown instruction", m);
+  return 0;
+}
+
+static void appendTextWord(unsigned int word)
+{
+  if (textCount == textCapacity)
+  {
+    textCapacity = textCapacity ? textCapacity * 2 : 1024;
+    textWords = realloc(textWords, sizeof(unsigned int) * textCapacity);
+  }
+  textWords[textCount++] = word;
+}
+
+static void appendData(const void *bytes, int length)
+{
+  if (dataEnd + length > SIM_DATA_BASE + SIM_DATA_SIZE)
+  {
+    assembleError("data segment overflow", NULL);
+    return;
+  }
+  if (bytes)
+    memcpy(dataMemory + (dataEnd - SIM_DATA_BASE), bytes, length);
+  dataEnd += length;
+}
+
+/* Parses the string literal at s into buffer.
+ * Returns the length, or -1 on error. */
+static int parseString(const char *s, char *buffer)
+{
+  int n = 0;
+  while (*s && *s != '"')
+    ++s;
+  if (*s++ != '"')
+    return -1;
+  while (*s && *s != '"')
+  {
+    char c = *s++;
+    if (c == '\\')
+    {
+      c = *s++;
+      switch (c)
+      {
+      case 'n':
+        c = '\n';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case '0':
+        c = '\0';
+        break;
+      default:
+        break;
+      }
+    }
+    buffer[n++] = c;
+  }
+  return (*s == '"') ? n : -1;
+}
+
+/* Handles '.extern sym size', which declares sym
+ * as size bytes of zeroed data. Like SPIM, it goes
+ * to the small data area below .data, where every
+ * word is in reach of a 16-bit offset from $gp, so
+ * loads, stores and la of sym take one instruction.
+ * Data that does not fit there goes to .data. */
+static void externDirective(char *rest)
+{
+  char *name = strtok(rest, " \t\r\n");
+  char *size = strtok(NULL, " \t\r\n");
+  unsigned int bytes;
+  if (name == NULL || size == NULL)
+  {
+    assembleError("malformed .extern", NULL);
+    return;
+  }
+  bytes = ((unsigned int)strtoul(size, NULL, 0) + 3) & ~3u;
+  if (bytes <= SIM_USER_DATA - smallDataEnd)
+  {
+    defineSymbol(name, smallDataEnd);
+    findSymbol(name)->small = TRUE;
+    smallDataEnd += bytes;
+    return;
+  }
+  while (dataEnd % 4)
+    appendData("", 1);
+  defineSymbol(name, dataEnd);
+  appendData(NULL, bytes);
+}
+
+/* Handles an assembler directive during the first pass */
+static void directive(char *name, char *rest, int *inText)
+{
+  if (!strcmp(name, ".text"))
+    *inText = TRUE;
+  else if (!strcmp(name, ".data"))
+    *inText = FALSE;
+  else if (!strcmp(name, ".globl"))
+    ;
+  else if (!strcmp(name, ".extern"))
+    externDirective(rest);
+  else if (*inText)
+    assembleError("data directive in text segment", name);
+  else if (!strcmp(name, ".align"))
+  {
+    unsigned int align = 1u << atoi(rest);
+    while (dataEnd % align)
+      appendData("", 1);
+  }
+  else if (!strcmp(name, ".space"))
+    appendData(NULL, atoi(rest));
+  else if (!strcmp(name, ".asciiz") || !strcmp(name, ".ascii"))
+  {
+    char *buffer = malloc(strlen(rest) + 1);
+    int length = parseString(rest, buffer);
+    if (length < 0)
+      assembleError("malformed string", rest);
+    else
+    {
+      appendData(buffer, length);
+      if (name[6] == 'z')
+        appendData("", 1);
+    }
+    free(buffer);
+  }
+  else if (!strcmp(name, ".word") || !strcmp(name, ".byte"))
+  {
+    int size = (name[1] == 'w') ? 4 : 1;
+    for (char *tok = strtok(rest, " \t,"); tok; tok = strtok(NULL, " \t,"))
+    {
+      int value = (int)strtol(tok, NULL, 0);
+      if (size == 4)
+        appendData(&value, 4);
+      else
+      {
+        unsigned char byte = (unsigned char)value;
+        appendData(&byte, 1);
+      }
+    }
+  }
+  else
+    assembleError("unknown directive", name);
+}
+
+/* Procedure addLineEntry records that the words
+ * from address on come from the given source line */
+static void addLineEntry(unsigned int address, char *entry)
+{
+  char *function;
+  int lineno = (int)strtol(entry, &function, 10);
+  while (isspace((unsigned char)*function))
+    ++function;
+  function[strcspn(function, " \t\r\n")] = '\0';
+  lineTable = realloc(lineTable, sizeof(LineEntry) * (lineCount + 1));
+  lineTable[lineCount].start = (int)(address - SIM_TEXT_BASE) / 4;
+  lineTable[lineCount].lineno = lineno;
+  lineTable[lineCount].function = malloc(strlen(function) + 1);
+  strcpy(lineTable[lineCount].function, function);
+  ++lineCount;
+}
+
+/* Procedure addRegion starts a new code region at
+ * a global text label. Local labels L<n> are not
+ * regions. A user symbol loses its leading '_' */
+static void addRegion(unsigned int address, const char *label)
+{
+  const char *p = label;
+  if (p[0] == 'L')
+  {
+    while (isdigit((unsigned char)*++p))
+      ;
+    if (*p == '\0' && p > label + 1)
+      return;
+  }
+  if (label[0] == '_' && !strchr(label + 1, '_'))
+    ++label;
+  regions = realloc(regions, sizeof(Region) * (regionCount + 1));
+  regions[regionCount].start = (int)(address - SIM_TEXT_BASE) / 4;
+  regions[regionCount].name = malloc(strlen(label) + 1);
+  strcpy(regions[regionCount].name, label);
+  ++regionCount;
+}
+
+/* First pass: defines labels, lays out data and
+ * records instruction lines with their addresses */
+static AsmLine *firstPass(FILE *in)
+{
+  char line[LINEBUF_SIZE];
+  AsmLine *head = NULL, **tail = &head;
+  unsigned int textAddress = SIM_TEXT_BASE;
+  unsigned int scratch[MAXEXPANSION];
+  int inText = TRUE;
+
+  asmLineno = 0;
+  while (fgets(line, sizeof(line), in))
+  {
+    char *p = line;
+    char *comment;
+    ++asmLineno;
+    if (!strncmp(p, "#.loc", 5))
+    {
+      if (inText)
+        addLineEntry(textAddress, p + 5);
+      continue;
+    }
+    /* strip comments outside string literals */
+    comment = strchr(p, '#');
+    if (comment && (!strchr(p, '"') || comment < strchr(p, '"')))
+      *comment = '\0';
+    for (;;)
+    { /* labels */
+      char *q;
+      while (isspace((unsigned char)*p))
+        ++p;
+      q = p;
+      while (*q && isSymbolChar((unsigned char)*q))
+        ++q;
+      if (q == p || *q != ':')
+        break;
+      *q = '\0';
+      defineSymbol(p, inText ? textAddress : dataEnd);
+      if (inText)
+        addRegion(textAddress, p);
+      p = q + 1;
+    }
+    if (!*p)
+      continue;
+    {
+      char *name = p;
+      while (*p && !isspace((unsigned char)*p))
+        ++p;
+      if (*p)
+        *p++ = '\0';
+      if (name[0] == '.')
+      {
+        directive(name, p, &inText);
+        continue;
+      }
+      if (!inText)
+      {
+        assembleError("instruction in data segment", name);
+        continue;
+      }
+      {
+        AsmLine *l = calloc(1, sizeof(AsmLine));
+        l->mnemonic = malloc(strlen(name) + 1);
+        strcpy(l->mnemonic, name);
+        l->address = textAddress;
+        l->lineno = asmLineno;
+        for (char *tok = strtok(p, " \t\r\n,"); tok; tok = strtok(NULL, " \t\r\n,"))
+        {
+          if (l->nops == MAXOPERANDS)
+          {
+            assembleError("too many operands", name);
+            break;
+          }
+          l->ops[l->nops].sym = NULL;
+          if (!parseOperand(tok, &l->ops[l->nops]))
+            assembleError("malformed operand", tok);
+          else if (l->ops[l->nops].sym)
+          {
+            char *copy = malloc(strlen(l->ops[l->nops].sym) + 1);
+            Symbol s;
+            strcpy(copy, l->ops[l->nops].sym);
+            l->ops[l->nops].sym = copy;
+            /* decided here, so that both passes agree */
+            s = findSymbol(copy);
+            l->ops[l->nops].small = s && s->small;
+          }
+          ++l->nops;
+        }
+        /* symbols are unknown yet; only the length matters */
+        textAddress += 4 * expand(l, textAddress, scratch);
+        *tail = l;
+        tail = &l->next;
+      }
+    }
+  }
+  return head;
+}
+
+/* Second pass: encodes every instruction line */
+static void secondPass(AsmLine *lines)
+{
+  unsigned int words[MAXEXPANSION];
+  resolving = TRUE;
+  for (AsmLine *l = lines; l; l = l->next)
+  {
+    int n;
+    asmLineno = l->lineno;
+    n = expand(l, l->address, words);
+    for (int i = 0; i < n; ++i)
+      appendTextWord(words[i]);
+  }
+}
+
+static void destroyLines(AsmLine *lines)
+{
+  while (lines)
+  {
+    AsmLine *next = lines->next;
+    for (int i = 0; i < lines->nops; ++i)
+      free(lines->ops[i].sym);
+    free(lines->mnemonic);
+    free(lines);
+    lines = next;
+  }
+}
+
+/* Function assemble translates the code file into
+ * textWords and dataMemory. The symbols are kept
+ * until destroySymbols. Returns FALSE on error. */
+static int assemble(const char *codefile)
+{
+  FILE *in = fopen(codefile, "r");
+  AsmLine *lines;
+  unsigned int startup[MAXEXPANSION];
+  if (in == NULL)
+  {
+    fprintf(stderr, "File %s not found\n", codefile);
+    return FALSE;
+  }
+  asmFile = codefile;
+  asmError = FALSE;
+  resolving = FALSE;
+  textCount = 0;
+  dataEnd = SIM_USER_DATA;
+  smallDataEnd = SIM_DATA_BASE;
+  lines = firstPass(in);
+  fclose(in);
+  secondPass(lines);
+  destroyLines(lines);
+  if (!findSymbol("main"))
+  {
+    fprintf(stderr, "%s: no 'main' label\n", codefile);
+    asmError = TRUE;
+  }
+  else
+  { /* startup code after the program: jal main; li $v0 10; syscall */
+    entryAddress = SIM_TEXT_BASE + 4 * textCount;
+    addRegion(entryAddress, "startup");
+    appendTextWord(ENC_J(OP_JAL, symbolAddress("main")));
+    expandLi(startup, R_V0, 10);
+    appendTextWord(startup[0]);
+    appendTextWord(ENC_R(0, 0, 0, 0, FN_SYSCALL));
+  }
+  return !asmError;
+}
+
+/**************************************************/
+/***********   Binary image             ***********/
+/**************************************************/
+
+/* The tables of the image, after the text words and
+ * the data. Names are offsets into the strings */
+typedef struct
+{
+  unsigned int address;
+  unsigned int name;
+} ImageSymbol;
+
+typedef struct
+{
+  unsigned int start;
+  unsigned int lineno;
+  unsigned int function;
+} ImageLine;
+
+typedef struct
+{
+  unsigned int start;
+  unsigned int name;
+} ImageRegion;
+
+/* The image being run, whose text words are used
+ * where they are mapped. NULL for a code file */
+static unsigned char *imageMapping;
+static size_t imageSize;
+
+static char *imageStrings;
+static unsigned int imageStringBytes;
+
+/* Address of the counters of -fprofile-generate,
+ * or 0 if the program does not count */
+static unsigned int profileAddress;
+
+/* Function imageString adds s to the strings of the
+ * image and returns its offset */
+static unsigned int imageString(const char *s)
+{
+  unsigned int offset = imageStringBytes;
+  size_t length = strlen(s) + 1;
+  imageStrings = realloc(imageStrings, imageStringBytes + length);
+  memcpy(imageStrings + offset, s, length);
+  imageStringBytes += (unsigned int)length;
+  return offset;
+}
+
+static int compareSymbols(const void *a, const void *b)
+{
+  const ImageSymbol *x = a, *y = b;
+  if (x->address != y->address)
+    return x->address < y->address ? -1 : 1;
+  return strcmp(imageStrings + x->name, imageStrings + y->name);
+}
+
+/* Procedure padImage writes zeros up to a word */
+static void padImage(FILE *out, size_t length)
+{
+  static const unsigned char zeros[4];
+  fwrite(zeros, 1, (4 - length % 4) % 4, out);
+}
+
+/* Function writeImage assembles the code file and
+ * writes the program as a binary image, laid out as
+ * sim.h describes. Returns 0 on success, 1 on error.
+ */
+int writeImage(const char *codefile, const char *imagefile)
+{
+  SimImageHeader header;
+  ImageSymbol *symbolTable = NULL;
+  ImageLine *lines;
+  ImageRegion *regionTable;
+  unsigned int symbolCount = 0;
+  int ok;
+  FILE *out;
+  dataMemory = calloc(SIM_DATA_SIZE, 1);
+  ok = assemble(codefile);
+  imageStringBytes = 0;
+  for (int i = 0; ok && i < SYMTAB_SIZE; ++i)
+    for (Symbol sym = symbols[i]; sym; sym = sym->next)
+    {
+      symbolTable = realloc(symbolTable, sizeof(ImageSymbol) * (symbolCount + 1));
+      symbolTable[symbolCount].address = sym->address;
+      symbolTable[symbolCount].name = imageString(sym->name);
+      ++symbolCount;
+    }
+  destroySymbols();
+  out = ok ? fopen(imagefile, "wb") : NULL;
+  if (ok && out == NULL)
+    fprintf(stderr, "Unable to open %s\n", imagefile);
+  if (out)
+  {
+    qsort(symbolTable, symbolCount, sizeof(ImageSymbol), compareSymbols);
+    lines = malloc(sizeof(ImageLine) * lineCount + 1);
+    regionTable = malloc(sizeof(ImageRegion) * regionCount + 1);
+    for (int i = 0; i < lineCount; ++i)
+    {
+      lines[i].start = lineTable[i].start;
+      lines[i].lineno = lineTable[i].lineno;
+      if (i > 0 && !strcmp(lineTable[i].function, lineTable[i - 1].function))
+        lines[i].function = lines[i - 1].function;
+      else
+        lines[i].function = imageString(lineTable[i].function);
+    }
+    for (int i = 0; i < regionCount; ++i)
+    {
+      regionTable[i].start = regions[i].start;
+      regionTable[i].name = imageString(regions[i].name);
+    }
+    memcpy(header.magic, SIM_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = SIM_IMAGE_VERSION;
+    header.entry = entryAddress;
+    header.textWords = textCount;
+    header.dataBytes = dataEnd - SIM_USER_DATA;
+    header.symbols = symbolCount;
+    header.lines = lineCount;
+    header.regions = regionCount;
+    header.stringBytes = imageStringBytes;
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(textWords, sizeof(unsigned int), textCount, out);
+    fwrite(dataMemory + (SIM_USER_DATA - SIM_DATA_BASE), 1, header.dataBytes, out);
+    padImage(out, header.dataBytes);
+    fwrite(symbolTable, sizeof(ImageSymbol), symbolCount, out);
+    fwrite(lines, sizeof(ImageLine), lineCount, out);
+    fwrite(regionTable, sizeof(ImageRegion), regionCount, out);
+    fwrite(imageStrings, 1, imageStringBytes, out);
+    if (fclose(out) != 0)
+    {
+      fprintf(stderr, "Unable to write %s\n", imagefile);
+      ok = FALSE;
+    }
+    free(lines);
+    free(regionTable);
+  }
+  else
+    ok = FALSE;
+  for (int i = 0; i < lineCount; ++i)
+    free(lineTable[i].function);
+  for (int i = 0; i < regionCount; ++i)
+    free(regions[i].name);
+  free(lineTable);
+  free(regions);
+  lineTable = NULL;
+  regions = NULL;
+  lineCount = regionCount = 0;
+  free(textWords);
+  textWords = NULL;
+  textCapacity = 0;
+  free(symbolTable);
+  free(imageStrings);
+  imageStrings = NULL;
+  free(dataMemory);
+  dataMemory = NULL;
+  return ok ? 0 : 1;
+}
+
+/* Function isImage returns TRUE if codefile starts
+ * as a binary image does */
+static int isImage(const char *codefile)
+{
+  char magic[sizeof(SIM_IMAGE_MAGIC) - 1];
+  FILE *in = fopen(codefile, "rb");
+  int image;
+  if (in == NULL)
+    return FALSE;
+  image = fread(magic, 1, sizeof(magic), in) == sizeof(magic) && !memcmp(magic, SIM_IMAGE_MAGIC, sizeof(magic));
+  fclose(in);
+  return image;
+}
+
+/* Function imageName returns the string at offset
+ * in the strings of the image, or NULL if it does
+ * not end inside them */
+static const char *imageName(const char *strings, unsigned int stringBytes, unsigned int offset)
+{
+  if (offset >= stringBytes || memchr(strings + offset, '\0', stringBytes - offset) == NULL)
+    return NULL;
+  return strings + offset;
+}
+
+/* Function loadImage maps the binary image and sets
+ * up the program as assemble does, using the text
+ * words in place. Returns FALSE if it is invalid. */
+static int loadImage(const char *imagefile)
+{
+  SimImageHeader header;
+  const ImageLine *lines;
+  const ImageRegion *regionTable;
+  const char *strings;
+  struct stat st;
+  size_t dataOffset, tablesOffset, size;
+  int fd = open(imagefile, O_RDONLY);
+  asmFile = imagefile;
+  if (fd < 0)
+  {
+    fprintf(stderr, "File %s not found\n", imagefile);
+    return FALSE;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header))
+  {
+    close(fd);
+    fprintf(stderr, "%s: not a valid image\n", imagefile);
+    return FALSE;
+  }
+  imageSize = (size_t)st.st_size;
+  imageMapping = mmap(NULL, imageSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (imageMapping == MAP_FAILED)
+  {
+    imageMapping = NULL;
+    fprintf(stderr, "Unable to map %s\n", imagefile);
+    return FALSE;
+  }
+  memcpy(&header, imageMapping, sizeof(header));
+  if (header.version != SIM_IMAGE_VERSION)
+  {
+    fprintf(stderr, "%s: image of another version\n", imagefile);
+    return FALSE;
+  }
+  /* every count is below 2^32, so the sizes cannot overflow */
+  dataOffset = sizeof(header) + (size_t)header.textWords * sizeof(unsigned int);
+  tablesOffset = dataOffset + ((size_t)header.dataBytes + 3) / 4 * 4;
+  size = tablesOffset + (size_t)header.symbols * sizeof(ImageSymbol) + (size_t)header.lines * sizeof(ImageLine) +
+         (size_t)header.regions * sizeof(ImageRegion) + header.stringBytes;
+  if (size != imageSize || header.textWords == 0 ||
+      header.dataBytes > SIM_DATA_SIZE - (SIM_USER_DATA - SIM_DATA_BASE) ||
+      header.entry - SIM_TEXT_BASE >= 4 * header.textWords || header.entry % 4)
+  {
+    fprintf(stderr, "%s: not a valid image\n", imagefile);
+    return FALSE;
+  }
+  lines = (const ImageLine *)(imageMapping + tablesOffset + (size_t)header.symbols * sizeof(ImageSymbol));
+  regionTable = (const ImageRegion *)(lines + header.lines);
+  strings = (const char *)(regionTable + header.regions);
+  for (unsigned int i = 0; i < header.symbols; ++i)
+  {
+    ImageSymbol symbol;
+    memcpy(&symbol, imageMapping + tablesOffset + i * sizeof(ImageSymbol), sizeof(symbol));
+    if (imageName(strings, header.stringBytes, symbol.name) &&
+        !strcmp(strings + symbol.name, PROFILE_SYMBOL))
+      profileAddress = symbol.address;
+  }
+  textWords = (unsigned int *)(imageMapping + sizeof(header));
+  textCount = (int)header.textWords;
+  memcpy(dataMemory + (SIM_USER_DATA - SIM_DATA_BASE), imageMapping + dataOffset, header.dataBytes);
+  dataEnd = SIM_USER_DATA + header.dataBytes;
+  entryAddress = header.entry;
+  /* the profiler owns its tables */
+  lineTable = malloc(sizeof(LineEntry) * header.lines + 1);
+  regions = malloc(sizeof(Region) * header.regions + 1);
+  for (unsigned int i = 0; i < header.lines; ++i)
+  {
+    const char *function = imageName(strings, header.stringBytes, lines[i].function);
+    if (function == NULL || lines[i].start > header.textWords)
+    {
+      fprintf(stderr, "%s: not a valid image\n", imagefile);
+      return FALSE;
+    }
+    lineTable[i].start = (int)lines[i].start;
+    lineTable[i].lineno = (int)lines[i].lineno;
+    lineTable[i].function = malloc(strlen(function) + 1);
+    strcpy(lineTable[i].function, function);
+    ++lineCount;
+  }
+  for (unsigned int i = 0; i < header.regions; ++i)
+  {
+    const char *name = imageName(strings, header.stringBytes, regionTable[i].name);
+    if (name == NULL || regionTable[i].start > header.textWords)
+    {
+      fprintf(stderr, "%s: not a valid image\n", imagefile);
+      return FALSE;
+    }
+    regions[i].start = (int)regionTable[i].start;
+    regions[i].name = malloc(strlen(name) + 1);
+    strcpy(regions[i].name, name);
+    ++regionCount;
+  }
+  return TRUE;
+}
+
+/**************************************************/
+/***********   Decoder                  ***********/
+/**************************************************/
+
+/* X-macro list of decoded operations.
+ * Order defines SimOp and the dispatch table. */
+#define SIM_OPS(X) \
+  X(NOP)           \
+  X(SLL)           \
+  X(SRL)           \
+  X(SRA)           \
+  X(SLLV)          \
+  X(SRLV)          \
+  X(SRAV)          \
+  X(JR)            \
+  X(JALR)          \
+  X(SYSCALL)       \
+  X(BREAK)         \
+  X(MFHI)          \
+  X(MTHI)          \
+  X(MFLO)          \
+  X(MTLO)          \
+  X(MULT)          \
+  X(MULTU)         \
+  X(DIV)           \
+  X(DIVU)          \
+  X(ADDU)          \
+  X(SUBU)          \
+  X(AND)           \
+  X(OR)            \
+  X(XOR)           \
+  X(NOR)           \
+  X(SLT)           \
+  X(SLTU)          \
+  X(BLTZ)          \
+  X(BGEZ)          \
+  X(J)             \
+  X(JAL)           \
+  X(BEQ)           \
+  X(BNE)           \
+  X(BLEZ)          \
+  X(BGTZ)          \
+  X(ADDIU)         \
+  X(SLTI)          \
+  X(SLTIU)         \
+  X(ANDI)          \
+  X(ORI)           \
+  X(XORI)          \
+  X(LUI)           \
+  X(LB)            \
+  X(LH)            \
+  X(LW)            \
+  X(LBU)           \
+  X(LHU)           \
+  X(SB)            \
+  X(SH)            \
+  X(SW)            \
+  X(MUL)           \
+  X(ILLEGAL)
+
+#define SIM_ENUM(name) S_##name,
+typedef enum
+{
+  SIM_OPS(SIM_ENUM)
+      S_COUNT
+} SimOp;
+#undef SIM_ENUM
+
+/* Pre-decoded instruction */
+typedef struct
+{
+  unsigned char op;
+  unsigned char rd, rs, rt;
+  int imm; /* immediate, shift amount, or target index */
+} SimInst;
+
+static SimInst *program;
+
+/* Returns the decoded form of the word at index */
+static SimInst decode(unsigned int word, int index)
+{
+  SimInst d;
+  int opcode = word >> 26;
+  int rs = (word >> 21) & 31, rt = (word >> 16) & 31, rd = (word >> 11) & 31;
+  int simm = (short)(word & 0xffff);
+  d.rs = rs;
+  d.rt = rt;
+  d.rd = rd;
+  d.imm = simm;
+  d.op = S_ILLEGAL;
+  switch (opcode)
+  {
+  case OP_SPECIAL:
+  {
+    static const unsigned char special[64] = {
+        [FN_SLL] = S_SLL, [FN_SRL] = S_SRL, [FN_SRA] = S_SRA, [FN_SLLV] = S_SLLV, [FN_SRLV] = S_SRLV, [FN_SRAV] = S_SRAV, [FN_JR] = S_JR, [FN_JALR] = S_JALR, [FN_SYSCALL] = S_SYSCALL, [FN_BREAK] = S_BREAK, [FN_MFHI] = S_MFHI, [FN_MTHI] = S_MTHI, [FN_MFLO] = S_MFLO, [FN_MTLO] = S_MTLO, [FN_MULT] = S_MULT, [FN_MULTU] = S_MULTU, [FN_DIV] = S_DIV, [FN_DIVU] = S_DIVU, [FN_ADD] = S_ADDU, [FN_ADDU] = S_ADDU, [FN_SUB] = S_SUBU, [FN_SUBU] = S_SUBU, [FN_AND] = S_AND, [FN_OR] = S_OR, [FN_XOR] = S_XOR, [FN_NOR] = S_NOR, [FN_SLT] = S_SLT, [FN_SLTU] = S_SLTU};
+    int fn = word & 63;
+    d.op = special[fn];
+    if (d.op == S_NOP && fn != FN_SLL)
+      d.op = S_ILLEGAL;
+    d.imm = (word >> 6) & 31;
+    if (word == 0)
+      d.op = S_NOP;
+    break;
+  }
+  case OP_REGIMM:
+    d.op = (rt == 0) ? S_BLTZ : (rt == 1) ? S_BGEZ : S_ILLEGAL;
+    d.imm = index + 1 + simm;
+    break;
+  case OP_J:
+  case OP_JAL:
+    d.op = (opcode == OP_J) ? S_J : S_JAL;
+    d.imm = ((word & 0x3ffffff) << 2) - SIM_TEXT_BASE;
+    d.imm /= 4;
+    break;
+  case OP_BEQ:
+  case OP_BNE:
+  case OP_BLEZ:
+  case OP_BGTZ:
+    d.op = S_BEQ + (opcode - OP_BEQ);
+    d.imm = index + 1 + simm;
+    break;
+  case OP_ADDI:
+  case OP_ADDIU:
+    d.op = S_ADDIU;
+    break;
+  case OP_SLTI:
+    d.op = S_SLTI;
+    break;
+  case OP_SLTIU:
+    d.op = S_SLTIU;
+    break;
+  case OP_ANDI:
+  case OP_ORI:
+  case OP_XORI:
+    d.op = S_ANDI + (opcode - OP_ANDI);
+    d.imm = word & 0xffff;
+    break;
+  case OP_LUI:
+    d.op = S_LUI;
+    d.imm = (int)((word & 0xffff) << 16);
+    break;
+  case OP_SPECIAL2:
+    d.op = ((word & 63) == FN2_MUL) ? S_MUL : S_ILLEGAL;
+    break;
+  case OP_LB:
+    d.op = S_LB;
+    break;
+  case OP_LH:
+    d.op = S_LH;
+    break;
+  case OP_LW:
+    d.op = S_LW;
+    break;
+  case OP_LBU:
+    d.op = S_LBU;
+    break;
+  case OP_LHU:
+    d.op = S_LHU;
+    break;
+  case OP_SB:
+    d.op = S_SB;
+    break;
+  case OP_SH:
+    d.op = S_SH;
+    break;
+  case OP_SW:
+    d.op = S_SW;
+    break;
+  }
+  /* Writes to $zero are dropped at decode time,
+   * so the interpreter never has to restore it. */
+  switch (d.op)
+  {
+  case S_SLL:
+  case S_SRL:
+  case S_SRA:
+  case S_SLLV:
+  case S_SRLV:
+  case S_SRAV:
+  case S_MFHI:
+  case S_MFLO:
+  case S_ADDU:
+  case S_SUBU:
+  case S_AND:
+  case S_OR:
+  case S_XOR:
+  case S_NOR:
+  case S_SLT:
+  case S_SLTU:
+  case S_MUL:
+    if (d.rd == R_ZERO)
+      d.op = S_NOP;
+    break;
+  case S_ADDIU:
+  case S_SLTI:
+  case S_SLTIU:
+  case S_ANDI:
+  case S_ORI:
+  case S_XORI:
+  case S_LUI:
+    if (d.rt == R_ZERO)
+      d.op = S_NOP;
+    break;
+  default:
+    break;
+  }
+  return d;
+}
+
+/**************************************************/
+/***********   Profiler                 ***********/
+/**************************************************/
+
+/* A node of the dynamic call tree: the region
+ * entered, under the node of its caller */
+typedef struct StackNodeRec
+{
+  int region;
+  unsigned long long self; /* instructions run in the region itself */
+  struct StackNodeRec *parent, *child, *sibling;
+} StackNode;
+
+typedef struct
+{
+  unsigned long long instructions, calls, loads, stores;
+} ProfileCounts;
+
+/* Per-source-line counts, one row per line table
+ * entry before rows of the same line are merged */
+typedef struct
+{
+  const char *function;
+  int lineno;
+  ProfileCounts counts;
+} LineProfile;
+
+static unsigned long long *profileCounts; /* executions per word, NULL if off */
+static int *regionOf;                     /* region of every word */
+static ProfileCounts *regionCounts;
+static StackNode *stackRoot, *stackTop;
+static unsigned long long charged; /* instructions already given to a node */
+
+static unsigned long long instructionCount;
+
+static StackNode *newStackNode(int region, StackNode *parent)
+{
+  StackNode *node = calloc(1, sizeof(StackNode));
+  node->region = region;
+  node->parent = parent;
+  if (parent)
+  {
+    node->sibling = parent->child;
+    parent->child = node;
+  }
+  return node;
+}
+
+static void destroyStackNode(StackNode *node)
+{
+  while (node)
+  {
+    StackNode *sibling = node->sibling;
+    destroyStackNode(node->child);
+    free(node);
+    node = sibling;
+  }
+}
+
+/* Procedure profileCharge gives the instructions
+ * run since the last transfer to the current node */
+static void profileCharge(void)
+{
+  stackTop->self += instructionCount - charged;
+  charged = instructionCount;
+}
+
+/* Procedure profileEnter moves to the node of the
+ * region starting at word target under parent */
+static void profileEnter(StackNode *parent, int target)
+{
+  int region = regionOf[target];
+  StackNode *node = parent ? parent->child : NULL;
+  profileCharge();
+  while (node && node->region != region)
+    node = node->sibling;
+  stackTop = node ? node : newStackNode(region, parent);
+  ++regionCounts[region].calls;
+}
+
+/* Procedure profileCall records a jal or jalr */
+static void profileCall(int target)
+{
+  if (target >= 0 && target < textCount)
+    profileEnter(stackTop, target);
+}
+
+/* Procedure profileJump records a j, which is a tail
+ * call if it goes to the start of another region */
+static void profileJump(int target)
+{
+  if (target >= 0 && target < textCount && regions[regionOf[target]].start == target &&
+      regionOf[target] != stackTop->region)
+    profileEnter(stackTop->parent ? stackTop->parent : stackTop, target);
+}
+
+/* Procedure profileReturn records a jr */
+static void profileReturn(void)
+{
+  profileCharge();
+  if (stackTop->parent)
+    stackTop = stackTop->parent;
+}
+
+static void startProfile(void)
+{
+  int r = 0;
+  profileCounts = calloc(textCount, sizeof(unsigned long long));
+  regionOf = malloc(sizeof(int) * textCount);
+  regionCounts = calloc(regionCount, sizeof(ProfileCounts));
+  for (int i = 0; i < textCount; ++i)
+  {
+    while (r + 1 < regionCount && regions[r + 1].start <= i)
+      ++r;
+    regionOf[i] = r;
+  }
+  charged = 0;
+  stackRoot = stackTop = newStackNode(regionOf[(entryAddress - SIM_TEXT_BASE) / 4], NULL);
+  regionCounts[stackRoot->region].calls = 1;
+}
+
+/* Procedure countWord adds the executions of word i
+ * to counts, split into loads and stores */
+static void countWord(ProfileCounts *counts, int i)
+{
+  counts->instructions += profileCounts[i];
+  if (program[i].op >= S_LB && program[i].op <= S_LHU)
+    counts->loads += profileCounts[i];
+  else if (program[i].op >= S_SB && program[i].op <= S_SW)
+    counts->stores += profileCounts[i];
+}
+
+static int compareRegions(const void *a, const void *b)
+{
+  unsigned long long x = regionCounts[*(const int *)a].instructions;
+  unsigned long long y = regionCounts[*(const int *)b].instructions;
+  return x < y ? 1 : x > y ? -1 : *(const int *)a - *(const int *)b;
+}
+
+static int compareLinesBySource(const void *a, const void *b)
+{
+  const LineProfile *x = a, *y = b;
+  int order = strcmp(x->function, y->function);
+  return order ? order : x->lineno - y->lineno;
+}
+
+static int compareLinesByCount(const void *a, const void *b)
+{
+  const LineProfile *x = a, *y = b;
+  if (x->counts.instructions != y->counts.instructions)
+    return x->counts.instructions < y->counts.instructions ? 1 : -1;
+  return compareLinesBySource(a, b);
+}
+
+static double percent(unsigned long long part, unsigned long long total)
+{
+  return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+/* Procedure printFolded writes one line per call
+ * stack: the regions from the root joined by ';'
+ * and the instructions run in the innermost one */
+static void printFolded(FILE *out, StackNode *node, char *path, size_t length)
+{
+  for (; node; node = node->sibling)
+  {
+    const char *name = regions[node->region].name;
+    size_t nameLength = strlen(name);
+    char *extended = malloc(length + nameLength + 2);
+    memcpy(extended, path, length);
+    if (length)
+      extended[length] = ';';
+    memcpy(extended + length + (length ? 1 : 0), name, nameLength + 1);
+    if (node->self)
+      fprintf(out, "%s %llu\n", extended, node->self);
+    printFolded(out, node->child, extended, length + (length ? 1 : 0) + nameLength);
+    free(extended);
+  }
+}
+
+/* Procedure reportProfile prints the flat profile
+ * by function and by source line to stderr, and
+ * writes the folded call stacks to foldedfile */
+static void reportProfile(const char *foldedfile)
+{
+  int *order = malloc(sizeof(int) * regionCount);
+  LineProfile *lines = calloc(lineCount + 1, sizeof(LineProfile));
+  int rows = 0;
+  FILE *folded;
+
+  profileCharge();
+  for (int i = 0; i < textCount; ++i)
+    countWord(&regionCounts[regionOf[i]], i);
+  for (int r = 0; r < regionCount; ++r)
+    order[r] = r;
+  qsort(order, regionCount, sizeof(int), compareRegions);
+  fprintf(stderr, "\nProfile by function:\n");
+  fprintf(stderr, "%14s %7s %10s %12s %12s  %s\n", "instructions", "%", "calls", "loads", "stores", "function");
+  for (int r = 0; r < regionCount; ++r)
+  {
+    ProfileCounts *c = &regionCounts[order[r]];
+    if (c->instructions)
+      fprintf(stderr, "%14llu %6.2f%% %10llu %12llu %12llu  %s\n", c->instructions,
+              percent(c->instructions, instructionCount), c->calls, c->loads, c->stores,
+              regions[order[r]].name);
+  }
+
+  if (lineCount == 0)
+    fprintf(stderr, "\nNo line table in %s: compile with --profile for lines\n", asmFile);
+  else
+  {
+    for (int e = 0; e < lineCount; ++e)
+    {
+      int end = e + 1 < lineCount ? lineTable[e + 1].start : textCount;
+      lines[rows].function = lineTable[e].function;
+      lines[rows].lineno = lineTable[e].lineno;
+      for (int i = lineTable[e].start; i < end && regions[regionOf[i]].start <= lineTable[e].start; ++i)
+        countWord(&lines[rows].counts, i);
+      ++rows;
+    }
+    qsort(lines, rows, sizeof(LineProfile), compareLinesBySource);
+    if (rows)
+    { /* merge the rows of a line generated in pieces */
+      int merged = 0;
+      for (int e = 1; e < rows; ++e)
+        if (!compareLinesBySource(&lines[merged], &lines[e]))
+        {
+          lines[merged].counts.instructions += lines[e].counts.instructions;
+          lines[merged].counts.loads += lines[e].counts.loads;
+          lines[merged].counts.stores += lines[e].counts.stores;
+        }
+        else
+          lines[++merged] = lines[e];
+      rows = merged + 1;
+    }
+    qsort(lines, rows, sizeof(LineProfile), compareLinesByCount);
+    fprintf(stderr, "\nProfile by source line:\n");
+    fprintf(stderr, "%14s %7s %12s %12s  %s\n", "instructions", "%", "loads", "stores", "line");
+    for (int e = 0; e < rows && lines[e].counts.instructions; ++e)
+      fprintf(stderr, "%14llu %6.2f%% %12llu %12llu  %s:%d\n", lines[e].counts.instructions,
+              percent(lines[e].counts.instructions, instructionCount), lines[e].counts.loads,
+              lines[e].counts.stores, lines[e].function, lines[e].lineno);
+  }
+
+  folded = fopen(foldedfile, "w");
+  if (folded == NULL)
+    fprintf(stderr, "Unable to open %s\n", foldedfile);
+  else
+  {
+    printFolded(folded, stackRoot, "", 0);
+    fclose(folded);
+    fprintf(stderr, "\nFolded call stacks written to %s\n", foldedfile);
+  }
+  free(order);
+  free(lines);
+}
+
+static void stopProfile(void)
+{
+  destroyStackNode(stackRoot);
+  free(profileCounts);
+  free(regionOf);
+  free(regionCounts);
+  profileCounts = NULL;
+  regionOf = NULL;
+  regionCounts = NULL;
+  stackRoot = stackTop = NULL;
+}
+
+/**************************************************/
+/***********   Interpreter              ***********/
+/**************************************************/
+
+static unsigned char *stackMemory;
+
+/* Translates a simulated address into host memory.
+ * Returns NULL if the access is out of range or misaligned. */
+static inline unsigned char *translate(unsigned int addr, unsigned int size)
+{
+  if (addr & (size - 1))
+    return NULL;
+  if (addr - SIM_STACK_BASE <= SIM_STACK_SIZE - size)
+    return stackMemory + (addr - SIM_STACK_BASE);
+  if (addr - SIM_DATA_BASE <= SIM_DATA_SIZE - size)
+    return dataMemory + (addr - SIM_DATA_BASE);
+  return NULL;
+}
+
+/* Dynamic statistics of one run */
+static unsigned long long extraCycles;
+static unsigned long long loadCount;
+static unsigned long long storeCount;
+static unsigned long long callCount;
+static unsigned long long syscallCount;
+
+static void runtimeError(const char *message, int index)
+{
+  fflush(stdout);
+  fprintf(stderr, "Exception at PC 0x%08x: %s\n",
+          SIM_TEXT_BASE + 4u * (unsigned)index, message);
+}
+
+/* Performs a syscall. Returns FALSE if the program exits. */
+static int systemCall(int *reg, int *status)
+{
+  switch (reg[R_V0])
+  {
+  case 1: /* print int */
+    printf("%d", reg[R_A0]);
+    return TRUE;
+  case 4: /* print string */
+  {
+    unsigned int addr = (unsigned)reg[R_A0];
+    unsigned char *p;
+    while ((p = translate(addr++, 1)) && *p)
+      putchar(*p);
+    return TRUE;
+  }
+  case 5: /* read int */
+    fflush(stdout);
+    if (scanf("%d", &reg[R_V0]) != 1)
+      reg[R_V0] = 0;
+    return TRUE;
+  case 10: /* exit */
+    *status = 0;
+    return FALSE;
+  case 11: /* print char */
+    putchar(reg[R_A0]);
+    return TRUE;
+  case 17: /* exit2 */
+    *status = reg[R_A0];
+    return FALSE;
+  default:
+    *status = -1;
+    return FALSE;
+  }
+}
+
+/* Runs the decoded program from entryAddress.
+ * Returns the exit status of the program. */
+static int run(void)
+{
+  int reg[32] = {0};
+  int hi = 0, lo = 0;
+  int status = 0;
+  const SimInst *ip;
+  const SimInst *const start = program;
+  const SimInst *const end = program + textCount;
+  unsigned char *mem;
+  const char *fault = NULL;
+
+  reg[R_SP] = SIM_SP_INIT;
+  reg[R_GP] = SIM_GP_INIT;
+  ip = program + (entryAddress - SIM_TEXT_BASE) / 4;
+
+#if defined(__GNUC__)
+/* Threaded dispatch: every handler jumps straight
+ * to the handler of the next instruction. When
+ * profiling, it jumps to L_COUNT first through a
+ * second table, so the plain loop pays nothing */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define SIM_LABEL(name) &&L_##name,
+#define SIM_COUNT_LABEL(name) &&L_COUNT,
+  static const void *const handlers[S_COUNT] = {SIM_OPS(SIM_LABEL)};
+  static const void *const counting[S_COUNT] = {SIM_OPS(SIM_COUNT_LABEL)};
+  const void *const *const dispatch = profileCounts ? counting : handlers;
+#undef SIM_LABEL
+#undef SIM_COUNT_LABEL
+#define CASE(name) L_##name:
+#define NEXT                   \
+  do                           \
+  {                            \
+    ++instructionCount;        \
+    goto *dispatch[ip->op];    \
+  } while (0)
+#define LOOP_BEGIN                 \
+  NEXT;                            \
+  L_COUNT:                         \
+  ++profileCounts[ip - start];     \
+  goto *handlers[ip->op];
+#define LOOP_END
+#else
+#define CASE(name) case S_##name:
+#define NEXT continue
+#define LOOP_BEGIN                 \
+  for (;;)                         \
+  {                                \
+    ++instructionCount;            \
+    if (profileCounts)             \
+      ++profileCounts[ip - start]; \
+    switch (ip->op)                \
+    {
+#define LOOP_END \
+  }              \
+  }
+#endif
+#define JUMP(index)                    \
+  do                                   \
+  {                                    \
+    ip = start + (index);              \
+    if (ip < start || ip >= end)       \
+    {                                  \
+      fault = "jump out of text";      \
+      goto done;                       \
+    }                                  \
+  } while (0)
+#define LOAD(type, size)                                       \
+  do                                                           \
+  {                                                            \
+    type value;                                                \
+    mem = translate((unsigned)reg[ip->rs] + ip->imm, size);    \
+    if (mem == NULL)                                           \
+    {                                                          \
+      fault = "bad address in data/stack read";                \
+      goto done;                                               \
+    }                                                          \
+    memcpy(&value, mem, size);                                 \
+    if (ip->rt)                                                \
+      reg[ip->rt] = value;                                     \
+    ++loadCount;                                               \
+  } while (0)
+#define STORE(type, size)                                      \
+  do                                                           \
+  {                                                            \
+    type value = (type)reg[ip->rt];                            \
+    mem = translate((unsigned)reg[ip->rs] + ip->imm, size);    \
+    if (mem == NULL)                                           \
+    {                                                          \
+      fault = "bad address in data/stack write";               \
+      goto done;                                               \
+    }                                                          \
+    memcpy(mem, &value, size);                                 \
+    ++storeCount;                                              \
+  } while (0)
+#define BRANCH(cond)    \
+  do                    \
+  {                     \
+    if (cond)           \
+      JUMP(ip->imm);    \
+    else                \
+      ++ip;             \
+  } while (0)
+
+  LOOP_BEGIN
+  CASE(NOP)
+  ++ip;
+  NEXT;
+  CASE(SLL)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rt] << ip->imm);
+  ++ip;
+  NEXT;
+  CASE(SRL)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rt] >> ip->imm);
+  ++ip;
+  NEXT;
+  CASE(SRA)
+  reg[ip->rd] = reg[ip->rt] >> ip->imm;
+  ++ip;
+  NEXT;
+  CASE(SLLV)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rt] << (reg[ip->rs] & 31));
+  ++ip;
+  NEXT;
+  CASE(SRLV)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rt] >> (reg[ip->rs] & 31));
+  ++ip;
+  NEXT;
+  CASE(SRAV)
+  reg[ip->rd] = reg[ip->rt] >> (reg[ip->rs] & 31);
+  ++ip;
+  NEXT;
+  CASE(JR)
+  if (profileCounts)
+    profileReturn();
+  JUMP(((unsigned)reg[ip->rs] - SIM_TEXT_BASE) / 4);
+  NEXT;
+  CASE(JALR)
+  {
+    int target = ((unsigned)reg[ip->rs] - SIM_TEXT_BASE) / 4;
+    if (ip->rd)
+      reg[ip->rd] = SIM_TEXT_BASE + 4 * (int)(ip + 1 - start);
+    ++callCount;
+    if (profileCounts)
+      profileCall(target);
+    JUMP(target);
+  }
+  NEXT;
+  CASE(SYSCALL)
+  ++syscallCount;
+  extraCycles += SIM_SYSCALL_CYCLES;
+  if (!systemCall(reg, &status))
+  {
+    if (status < 0)
+    {
+      status = 1;
+      fault = "unknown syscall";
+    }
+    goto done;
+  }
+  ++ip;
+  NEXT;
+  CASE(BREAK)
+  fault = "break";
+  goto done;
+  CASE(MFHI)
+  reg[ip->rd] = hi;
+  ++ip;
+  NEXT;
+  CASE(MTHI)
+  hi = reg[ip->rs];
+  ++ip;
+  NEXT;
+  CASE(MFLO)
+  reg[ip->rd] = lo;
+  ++ip;
+  NEXT;
+  CASE(MTLO)
+  lo = reg[ip->rs];
+  ++ip;
+  NEXT;
+  CASE(MULT)
+  {
+    long long product = (long long)reg[ip->rs] * reg[ip->rt];
+    lo = (int)(unsigned)product;
+    hi = (int)(unsigned)((unsigned long long)product >> 32);
+    extraCycles += SIM_MULT_CYCLES;
+  }
+  ++ip;
+  NEXT;
+  CASE(MULTU)
+  {
+    unsigned long long product = (unsigned long long)(unsigned)reg[ip->rs] * (unsigned)reg[ip->rt];
+    lo = (int)(unsigned)product;
+    hi = (int)(unsigned)(product >> 32);
+    extraCycles += SIM_MULT_CYCLES;
+  }
+  ++ip;
+  NEXT;
+  CASE(DIV)
+  if (reg[ip->rt] == -1)
+  { /* avoid host overflow trap on INT_MIN / -1 */
+    lo = (int)(0u - (unsigned)reg[ip->rs]);
+    hi = 0;
+  }
+  else if (reg[ip->rt])
+  {
+    lo = reg[ip->rs] / reg[ip->rt];
+    hi = reg[ip->rs] % reg[ip->rt];
+  }
+  extraCycles += SIM_DIV_CYCLES;
+  ++ip;
+  NEXT;
+  CASE(DIVU)
+  if (reg[ip->rt])
+  {
+    lo = (int)((unsigned)reg[ip->rs] / (unsigned)reg[ip->rt]);
+    hi = (int)((unsigned)reg[ip->rs] % (unsigned)reg[ip->rt]);
+  }
+  extraCycles += SIM_DIV_CYCLES;
+  ++ip;
+  NEXT;
+  CASE(ADDU)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rs] + (unsigned)reg[ip->rt]);
+  ++ip;
+  NEXT;
+  CASE(SUBU)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rs] - (unsigned)reg[ip->rt]);
+  ++ip;
+  NEXT;
+  CASE(AND)
+  reg[ip->rd] = reg[ip->rs] & reg[ip->rt];
+  ++ip;
+  NEXT;
+  CASE(OR)
+  reg[ip->rd] = reg[ip->rs] | reg[ip->rt];
+  ++ip;
+  NEXT;
+  CASE(XOR)
+  reg[ip->rd] = reg[ip->rs] ^ reg[ip->rt];
+  ++ip;
+  NEXT;
+  CASE(NOR)
+  reg[ip->rd] = ~(reg[ip->rs] | reg[ip->rt]);
+  ++ip;
+  NEXT;
+  CASE(SLT)
+  reg[ip->rd] = reg[ip->rs] < reg[ip->rt];
+  ++ip;
+  NEXT;
+  CASE(SLTU)
+  reg[ip->rd] = (unsigned)reg[ip->rs] < (unsigned)reg[ip->rt];
+  ++ip;
+  NEXT;
+  CASE(BLTZ)
+  BRANCH(reg[ip->rs] < 0);
+  NEXT;
+  CASE(BGEZ)
+  BRANCH(reg[ip->rs] >= 0);
+  NEXT;
+  CASE(J)
+  if (profileCounts)
+    profileJump(ip->imm);
+  JUMP(ip->imm);
+  NEXT;
+  CASE(JAL)
+  reg[R_RA] = SIM_TEXT_BASE + 4 * (int)(ip + 1 - start);
+  ++callCount;
+  if (profileCounts)
+    profileCall(ip->imm);
+  JUMP(ip->imm);
+  NEXT;
+  CASE(BEQ)
+  BRANCH(reg[ip->rs] == reg[ip->rt]);
+  NEXT;
+  CASE(BNE)
+  BRANCH(reg[ip->rs] != reg[ip->rt]);
+  NEXT;
+  CASE(BLEZ)
+  BRANCH(reg[ip->rs] <= 0);
+  NEXT;
+  CASE(BGTZ)
+  BRANCH(reg[ip->rs] > 0);
+  NEXT;
+  CASE(ADDIU)
+  reg[ip->rt] = (int)((unsigned)reg[ip->rs] + (unsigned)ip->imm);
+  ++ip;
+  NEXT;
+  CASE(SLTI)
+  reg[ip->rt] = reg[ip->rs] < ip->imm;
+  ++ip;
+  NEXT;
+  CASE(SLTIU)
+  reg[ip->rt] = (unsigned)reg[ip->rs] < (unsigned)ip->imm;
+  ++ip;
+  NEXT;
+  CASE(ANDI)
+  reg[ip->rt] = reg[ip->rs] & ip->imm;
+  ++ip;
+  NEXT;
+  CASE(ORI)
+  reg[ip->rt] = reg[ip->rs] | ip->imm;
+  ++ip;
+  NEXT;
+  CASE(XORI)
+  reg[ip->rt] = reg[ip->rs] ^ ip->imm;
+  ++ip;
+  NEXT;
+  CASE(LUI)
+  reg[ip->rt] = ip->imm;
+  ++ip;
+  NEXT;
+  CASE(LB)
+  LOAD(signed char, 1);
+  ++ip;
+  NEXT;
+  CASE(LH)
+  LOAD(short, 2);
+  ++ip;
+  NEXT;
+  CASE(LW)
+  LOAD(int, 4);
+  ++ip;
+  NEXT;
+  CASE(LBU)
+  LOAD(unsigned char, 1);
+  ++ip;
+  NEXT;
+  CASE(LHU)
+  LOAD(unsigned short, 2);
+  ++ip;
+  NEXT;
+  CASE(SB)
+  STORE(unsigned char, 1);
+  ++ip;
+  NEXT;
+  CASE(SH)
+  STORE(unsigned short, 2);
+  ++ip;
+  NEXT;
+  CASE(SW)
+  STORE(int, 4);
+  ++ip;
+  NEXT;
+  CASE(MUL)
+  reg[ip->rd] = (int)((unsigned)reg[ip->rs] * (unsigned)reg[ip->rt]);
+  extraCycles += SIM_MULT_CYCLES;
+  ++ip;
+  NEXT;
+  CASE(ILLEGAL)
+  fault = "illegal instruction";
+  goto done;
+  LOOP_END
+
+done:
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+#undef CASE
+#undef NEXT
+#undef LOOP_BEGIN
+#undef LOOP_END
+#undef JUMP
+#undef LOAD
+#undef STORE
+#undef BRANCH
+  if (fault)
+  {
+    runtimeError(fault, (int)(ip - start));
+    status = 1;
+  }
+  return status;
+}
+
+/* Procedure writeCounters adds the counters of
+ * -fprofile-generate to the profile next to the
+ * code file */
+static void writeCounters(const char *codefile)
+{
+  const char *dot = strrchr(codefile, '.');
+  int base = dot && !strchr(dot, '/') ? (int)(dot - codefile) : (int)strlen(codefile);
+  unsigned int header[PROFILE_HEADER_WORDS];
+  unsigned int *counters;
+  char *profilefile;
+  if (profileAddress < SIM_USER_DATA || profileAddress % 4 || profileAddress > dataEnd ||
+      dataEnd - profileAddress < sizeof(header))
+    return;
+  memcpy(header, dataMemory + (profileAddress - SIM_DATA_BASE), sizeof(header));
+  if (header[0] > (dataEnd - profileAddress - sizeof(header)) / 4)
+    return;
+  counters = malloc(4 * header[0] + 1);
+  memcpy(counters, dataMemory + (profileAddress - SIM_DATA_BASE) + sizeof(header), 4 * header[0]);
+  profilefile = malloc(base + 6);
+  memcpy(profilefile, codefile, base);
+  strcpy(profilefile + base, ".prof");
+  mergeProfile(profilefile, header[1], (int)header[0], counters);
+  free(profilefile);
+  free(counters);
+}
+
+/* Function simulate assembles the SPIM code file,
+ * or maps the binary image, and runs it. Program input is read from stdin
+ * and program output written to stdout. With
+ * Profile set, the profile is printed to stderr
+ * and the call stacks written to a .folded file
+ * next to the code file.
+ * Returns 0 on normal exit, 1 on error.
+ */
+int simulate(const char *codefile)
+{
+  int status = 1;
+  int loaded;
+  dataMemory = calloc(SIM_DATA_SIZE, 1);
+  stackMemory = calloc(SIM_STACK_SIZE, 1);
+  if (isImage(codefile))
+    loaded = loadImage(codefile);
+  else
+  {
+    Symbol counters;
+    loaded = assemble(codefile);
+    if ((counters = findSymbol(PROFILE_SYMBOL)) != NULL)
+      profileAddress = counters->address;
+    destroySymbols();
+  }
+  if (loaded)
+  {
+    program = malloc(sizeof(SimInst) * textCount);
+    for (int i = 0; i < textCount; ++i)
+      program[i] = decode(textWords[i], i);
+    instructionCount = extraCycles = loadCount = storeCount = callCount = syscallCount = 0;
+    if (Profile)
+      startProfile();
+    status = run();
+    fflush(stdout);
+    if (SimStats)
+    {
+      fprintf(stderr, "instructions: %llu\n", instructionCount);
+      fprintf(stderr, "cycles:       %llu\n", instructionCount + extraCycles);
+      fprintf(stderr, "loads:        %llu\n", loadCount);
+      fprintf(stderr, "stores:       %llu\n", storeCount);
+      fprintf(stderr, "calls:        %llu\n", callCount);
+      fprintf(stderr, "syscalls:     %llu\n", syscallCount);
+    }
+    if (profileAddress)
+      writeCounters(codefile);
+    if (Profile)
+    {
+      const char *dot = strrchr(codefile, '.');
+      int base = dot && !strchr(dot, '/') ? (int)(dot - codefile) : (int)strlen(codefile);
+      char *foldedfile = malloc(base + 8);
+      memcpy(foldedfile, codefile, base);
+      strcpy(foldedfile + base, ".folded");
+      reportProfile(foldedfile);
+      free(foldedfile);
+      stopProfile();
+    }
+    free(program);
+  }
+  for (int i = 0; i < lineCount; ++i)
+    free(lineTable[i].function);
+  for (int i = 0; i < regionCount; ++i)
+    free(regions[i].name);
+  free(lineTable);
+  free(regions);
+  lineTable = NULL;
+  regions = NULL;
+  lineCount = regionCount = 0;
+  if (imageMapping)
+    munmap(imageMapping, imageSize);
+  else
+    free(textWords);
+  imageMapping = NULL;
+  textWords = NULL;
+  textCapacity = 0;
+  profileAddress = 0;
+  free(dataMemory);
+  free(stackMemory);
+  return status;
+}
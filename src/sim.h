@@ -0,0 +1,85 @@
+/****************************************************/
+/* File: sim.h                                      */
+/* Built-in MIPS simulator for the C- compiler      */
+/* Runs the SPIM assembly dialect written by cgen.c */
+/* without an external SPIM installation            */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+/* Memory layout follows SPIM */
+enum
+{
+  SIM_TEXT_BASE = 0x00400000,
+  SIM_DATA_BASE = 0x10000000,
+  SIM_DATA_SIZE = 0x00400000,
+  SIM_GP_INIT = 0x10008000, /* reaches the .extern data below .data */
+  SIM_USER_DATA = 0x10010000, /* start of .data */
+  SIM_STACK_BASE = 0x7f000000, /* stack occupies [BASE, BASE + SIZE) */
+  SIM_STACK_SIZE = 0x01000000,
+  SIM_SP_INIT = 0x7fffeffc
+};
+
+/* Extra cycles charged on top of the one cycle
+ * every instruction takes. Multiplication and
+ * division occupy the HI/LO unit for much longer
+ * than the integer pipeline, and a syscall costs
+ * far more than either. */
+enum
+{
+  SIM_MULT_CYCLES = 4,
+  SIM_DIV_CYCLES = 34,
+  SIM_SYSCALL_CYCLES = 100 /* trap into the kernel and back */
+};
+
+/* A binary image holds the program assembled, so
+ * that it runs without parsing. It starts with the
+ * header, then, in the byte order of the host:
+ *   the encoded instructions from SIM_TEXT_BASE,
+ *   the data from SIM_USER_DATA, padded to a word,
+ *   the symbols, each its address and name,
+ *   the source lines, each the index of its first
+ *   instruction, the line number and the function,
+ *   the profiler regions, each the index of its
+ *   first instruction and its name,
+ *   the names, each ending in a null character
+ * A name is the offset of its first character */
+#define SIM_IMAGE_MAGIC "CMTB"
+
+enum
+{
+  SIM_IMAGE_VERSION = 1
+};
+
+typedef struct
+{
+  char magic[4];
+  unsigned int version;
+  unsigned int entry; /* address of the startup code */
+  unsigned int textWords;
+  unsigned int dataBytes;
+  unsigned int symbols;
+  unsigned int lines;
+  unsigned int regions;
+  unsigned int stringBytes;
+} SimImageHeader;
+
+/* Function writeImage assembles the SPIM code file
+ * and writes it to imagefile as a binary image.
+ * Returns 0 on success, 1 on error.
+ */
+int writeImage(const char *codefile, const char *imagefile);
+
+/* Function simulate assembles the SPIM code file,
+ * or maps the binary image, and runs it. Program input is read from stdin
+ * and program output written to stdout. With
+ * Profile set, the profile is printed to stderr
+ * and the call stacks written to a .folded file
+ * next to the code file.
+ * Returns 0 on normal exit, 1 on error.
+ */
+int simulate(const char *codefile);
+
+#endif
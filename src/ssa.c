@@ -0,0 +1,971 @@
+/****************************************************/
+/* File: ssa.c                                      */
+/* Static single assignment form of the functions   */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#include <stdint.h>
+#include "globals.h"
+#include "util.h"
+#include "ssa.h"
+
+/* The function being built and the block that
+ * instructions are appended to */
+static IrFunction *fn;
+static IrBlock *current;
+
+/* Scalars of the function, indexed through an
+ * open-addressing hash table */
+static BucketList *varTable;
+static int *varIndex;
+static int varMask;
+
+/* Variables of the temporaries and of memory */
+#define temporaryVar(i) (fn->varCount + (i))
+#define memoryVar (fn->varCount + NUM_TEMPORARIES)
+#define totalVars (fn->varCount + NUM_TEMPORARIES + 1)
+
+/* Exit of an inlined body being built: its return
+ * statements jump there with the returned values */
+typedef struct inlineExit
+{
+  IrBlock *block;
+  IrInstr **values; /* one for each predecessor */
+  int count;
+  struct inlineExit *outer;
+} InlineExit;
+static InlineExit *inlineExit;
+
+static int expressionCount;
+
+/**************************************************/
+/***********   Blocks and instructions  ***********/
+/**************************************************/
+
+static IrBlock *newBlock(void)
+{
+  IrBlock *b = calloc(1, sizeof(IrBlock));
+  b->id = fn->blockCount;
+  b->order = -1;
+  b->executable = TRUE;
+  b->defs = calloc(totalVars, sizeof(IrInstr *));
+  fn->blocks = realloc(fn->blocks, sizeof(IrBlock *) * (fn->blockCount + 1));
+  fn->blocks[fn->blockCount++] = b;
+  return b;
+}
+
+static IrInstr *newInstr(IrOpcode opcode)
+{
+  IrInstr *i = calloc(1, sizeof(IrInstr));
+  i->opcode = opcode;
+  i->var = -1;
+  i->lattice = LatticeBottom;
+  i->number = i;
+  return i;
+}
+
+static void append(IrBlock *b, IrInstr *i)
+{
+  i->block = b;
+  if (b->last)
+    b->last->next = i;
+  else
+    b->first = i;
+  b->last = i;
+}
+
+static void prepend(IrBlock *b, IrInstr *i)
+{
+  i->block = b;
+  i->next = b->first;
+  b->first = i;
+  if (b->last == NULL)
+    b->last = i;
+}
+
+static void addOperand(IrInstr *i, IrInstr *operand)
+{
+  i->operands = realloc(i->operands, sizeof(IrInstr *) * (i->operandCount + 1));
+  i->operands[i->operandCount++] = operand;
+}
+
+static void addEdge(IrBlock *from, IrBlock *to)
+{
+  from->succs[from->succCount++] = to;
+  to->preds = realloc(to->preds, sizeof(IrBlock *) * (to->predCount + 1));
+  to->preds[to->predCount++] = from;
+}
+
+/* Function isDead returns TRUE for the block that
+ * follows a return statement */
+static int isDead(IrBlock *b)
+{
+  return b != fn->blocks[0] && b->sealed && b->predCount == 0;
+}
+
+static void jumpTo(IrBlock *target)
+{
+  if (!isDead(current))
+  {
+    append(current, newInstr(IrJump));
+    addEdge(current, target);
+  }
+}
+
+static void branchTo(IrInstr *condition, IrBlock *ifTrue, IrBlock *ifFalse)
+{
+  IrInstr *branch = newInstr(IrBranch);
+  addOperand(branch, condition);
+  append(current, branch);
+  addEdge(current, ifTrue);
+  addEdge(current, ifFalse);
+}
+
+/**************************************************/
+/***********   Variables                ***********/
+/**************************************************/
+
+static int isScalar(BucketList symbol)
+{
+  return symbol && !symbol->is_array && symbol->symbol_class != Global && symbol->symbol_class != Function;
+}
+
+static int varSlot(BucketList symbol)
+{
+  int slot = (int)(((uintptr_t)symbol >> 4) & varMask);
+  while (varTable[slot] && varTable[slot] != symbol)
+    slot = (slot + 1) & varMask;
+  return slot;
+}
+
+/* Function collectVars enters the scalars of t and
+ * its siblings into the table, or only counts them
+ * if the table is not allocated yet */
+static int collectVars(TreeNode *t)
+{
+  int count = 0;
+  for (; t; t = t->sibling)
+  {
+    if ((t->nodekind == ExpK && t->kind.exp == VarK) ||
+        (t->nodekind == DeclK && t->kind.decl == VarDeclK) ||
+        (t->nodekind == ParamK && t->kind.param == VarParamK))
+    {
+      if (isScalar(t->symbol))
+      {
+        ++count;
+        if (varTable)
+        {
+          int slot = varSlot(t->symbol);
+          if (varTable[slot] == NULL)
+          {
+            varTable[slot] = t->symbol;
+            varIndex[slot] = fn->varCount;
+            fn->vars[fn->varCount++] = t->symbol;
+          }
+        }
+      }
+    }
+    for (int i = 0; i < MAXCHILDREN; ++i)
+      count += collectVars(t->child[i]);
+  }
+  return count;
+}
+
+/* Function varOf returns the variable of a scalar,
+ * or -1 if it lives in memory */
+static int varOf(BucketList symbol)
+{
+  int slot;
+  if (!isScalar(symbol))
+    return -1;
+  slot = varSlot(symbol);
+  return varTable[slot] ? varIndex[slot] : -1;
+}
+
+static IrInstr *newPhi(IrBlock *b, int var)
+{
+  IrInstr *phi = newInstr(IrPhi), **tail = &b->phis;
+  phi->var = var;
+  phi->block = b;
+  while (*tail)
+    tail = &(*tail)->next;
+  *tail = phi;
+  return phi;
+}
+
+static IrInstr *newUndef(IrBlock *b, int var)
+{
+  IrInstr *undef = newInstr(IrUndef);
+  undef->var = var;
+  prepend(b, undef);
+  return undef;
+}
+
+static IrInstr *readVariable(int var, IrBlock *b);
+
+static void addPhiOperands(IrInstr *phi)
+{
+  for (int i = 0; i < phi->block->predCount; ++i)
+    addOperand(phi, readVariable(phi->var, phi->block->preds[i]));
+}
+
+/* Function readVariable returns the value of the
+ * variable at the end of block b, making phis
+ * where definitions from several paths meet */
+static IrInstr *readVariable(int var, IrBlock *b)
+{
+  IrInstr *value = b->defs[var];
+  if (value)
+    return value;
+  if (!b->sealed)
+  { /* predecessors still unknown: complete it when sealing */
+    value = newPhi(b, var);
+    b->incomplete = realloc(b->incomplete, sizeof(IrInstr *) * (b->incompleteCount + 1));
+    b->incomplete[b->incompleteCount++] = value;
+  }
+  else if (b->predCount == 1)
+    value = readVariable(var, b->preds[0]);
+  else if (b->predCount == 0)
+    value = newUndef(b, var);
+  else
+  {
+    value = newPhi(b, var);
+    b->defs[var] = value; /* break cycles through loops */
+    addPhiOperands(value);
+  }
+  b->defs[var] = value;
+  return value;
+}
+
+static void writeVariable(int var, IrInstr *value)
+{
+  current->defs[var] = value;
+}
+
+/* Procedure sealBlock is called once all the
+ * predecessors of block b are known */
+static void sealBlock(IrBlock *b)
+{
+  for (int i = 0; i < b->incompleteCount; ++i)
+    addPhiOperands(b->incomplete[i]);
+  free(b->incomplete);
+  b->incomplete = NULL;
+  b->incompleteCount = 0;
+  b->sealed = TRUE;
+}
+
+/**************************************************/
+/***********   Expression table         ***********/
+/**************************************************/
+
+static int expressionSlot(IrFunction *f, TreeNode *node)
+{
+  int slot = (int)(((uintptr_t)node >> 4) & f->expressionMask);
+  while (f->expressions[slot].node && f->expressions[slot].node != node)
+    slot = (slot + 1) & f->expressionMask;
+  return slot;
+}
+
+/* Procedure record notes that node computes value
+ * in the current block */
+static void record(TreeNode *node, IrInstr *value)
+{
+  IrExpression *e;
+  if (value == NULL)
+    return;
+  if (2 * (expressionCount + 1) > fn->expressionMask + 1)
+  { /* grow the table */
+    IrExpression *old = fn->expressions;
+    int oldSize = fn->expressionMask + 1;
+    fn->expressionMask = 2 * oldSize - 1;
+    fn->expressions = calloc(fn->expressionMask + 1, sizeof(IrExpression));
+    for (int i = 0; i < oldSize; ++i)
+      if (old[i].node)
+        fn->expressions[expressionSlot(fn, old[i].node)] = old[i];
+    free(old);
+  }
+  e = &fn->expressions[expressionSlot(fn, node)];
+  if (e->node == NULL)
+    ++expressionCount;
+  e->node = node;
+  e->value = value;
+  e->block = current;
+}
+
+IrExpression *expressionOf(IrFunction *f, TreeNode *node)
+{
+  IrExpression *e = &f->expressions[expressionSlot(f, node)];
+  return e->node ? e : NULL;
+}
+
+/**************************************************/
+/***********   Lowering the syntax tree ***********/
+/**************************************************/
+
+static IrInstr *lowerExp(TreeNode *t);
+static void lowerList(TreeNode *t);
+
+static int isBuiltin(BucketList function)
+{
+  return !strcmp(function->treeNode->attr.name, "input") || !strcmp(function->treeNode->attr.name, "output");
+}
+
+static IrInstr *load(BucketList symbol, IrInstr *index)
+{
+  IrInstr *i = newInstr(IrLoad);
+  i->symbol = symbol;
+  addOperand(i, readVariable(memoryVar, current));
+  if (index)
+    addOperand(i, index);
+  append(current, i);
+  return i;
+}
+
+static IrInstr *lowerAssign(TreeNode *t)
+{
+  TreeNode *lhs = t->child[0];
+  IrInstr *index = NULL, *value, *store;
+  int var = lhs->kind.exp == VarK ? varOf(lhs->symbol) : -1;
+  if (lhs->kind.exp == ArrK)
+    index = lowerExp(lhs->child[0]);
+  value = lowerExp(t->child[1]);
+  if (var >= 0)
+  {
+    writeVariable(var, value);
+    return value;
+  }
+  store = newInstr(IrStore);
+  store->symbol = lhs->symbol;
+  addOperand(store, readVariable(memoryVar, current));
+  if (index)
+    addOperand(store, index);
+  addOperand(store, value);
+  append(current, store);
+  writeVariable(memoryVar, store);
+  return value;
+}
+
+static IrInstr *lowerCall(TreeNode *t)
+{
+  IrInstr *call = newInstr(IrCall), **args = NULL;
+  int count = 0;
+  for (TreeNode *arg = t->child[0]; arg; arg = arg->sibling)
+  {
+    args = realloc(args, sizeof(IrInstr *) * (count + 1));
+    args[count++] = lowerExp(arg);
+  }
+  call->symbol = t->symbol;
+  if (!isBuiltin(t->symbol)) /* input and output leave memory alone */
+    addOperand(call, readVariable(memoryVar, current));
+  for (int i = 0; i < count; ++i)
+    addOperand(call, args[i]);
+  free(args);
+  append(current, call);
+  if (!isBuiltin(t->symbol))
+    writeVariable(memoryVar, call);
+  return call;
+}
+
+/* Function lowerInline builds the inlined body with
+ * its return statements jumping to a common exit.
+ * The value of the call is the phi of the values
+ * returned on each path */
+static IrInstr *lowerInline(TreeNode *t)
+{
+  InlineExit exit = {NULL, NULL, 0, inlineExit};
+  TreeNode *arg, *param;
+  IrInstr *value = NULL;
+  exit.block = newBlock();
+  for (arg = t->child[0], param = t->child[2]; arg; arg = arg->sibling, param = param->sibling)
+  {
+    IrInstr *v = lowerExp(arg);
+    int var = param->kind.param == VarParamK ? varOf(param->symbol) : -1;
+    if (var >= 0)
+      writeVariable(var, v);
+  }
+  inlineExit = &exit;
+  lowerList(t->child[1]);
+  inlineExit = exit.outer;
+  if (!isDead(current))
+  { /* falls off the end of the body */
+    exit.values = realloc(exit.values, sizeof(IrInstr *) * (exit.count + 1));
+    exit.values[exit.count++] = NULL;
+    jumpTo(exit.block);
+  }
+  sealBlock(exit.block);
+  current = exit.block;
+  for (int i = 0; i < exit.count; ++i)
+    if (exit.values[i])
+    {
+      value = newPhi(exit.block, -1);
+      for (int j = 0; j < exit.count; ++j)
+        addOperand(value, exit.values[j] ? exit.values[j] : newUndef(exit.block->preds[j], -1));
+      break;
+    }
+  free(exit.values);
+  return value;
+}
+
+static IrInstr *lowerExp(TreeNode *t)
+{
+  IrInstr *value = NULL;
+  int var;
+  switch (t->kind.exp)
+  {
+  case ConstK:
+    value = newInstr(IrConst);
+    value->value = t->attr.val;
+    append(current, value);
+    break;
+  case VarK:
+    if ((var = varOf(t->symbol)) >= 0)
+      value = readVariable(var, current);
+    else if (t->symbol->is_array)
+    {
+      value = newInstr(IrAddress);
+      value->symbol = t->symbol;
+      append(current, value);
+    }
+    else
+      value = load(t->symbol, NULL);
+    break;
+  case TempK:
+    if (t->child[0])
+    { /* set in a loop preheader */
+      value = lowerExp(t->child[0]);
+      writeVariable(temporaryVar(t->attr.val), value);
+    }
+    else
+      value = readVariable(temporaryVar(t->attr.val), current);
+    break;
+  case OpK:
+  {
+    IrInstr *left = lowerExp(t->child[0]);
+    IrInstr *right = lowerExp(t->child[1]);
+    value = newInstr(IrBinary);
+    value->op = t->attr.op;
+    addOperand(value, left);
+    addOperand(value, right);
+    append(current, value);
+    break;
+  }
+  case ArrK:
+    value = load(t->symbol, lowerExp(t->child[0]));
+    break;
+  case AssignK:
+    value = lowerAssign(t);
+    break;
+  case CallK:
+    value = lowerCall(t);
+    break;
+  case InlineK:
+    value = lowerInline(t);
+    break;
+  }
+  record(t, value);
+  return value;
+}
+
+static void lowerStmt(TreeNode *t)
+{
+  IrInstr *condition;
+  if (t->nodekind == ExpK)
+  {
+    lowerExp(t);
+    return;
+  }
+  if (t->nodekind != StmtK)
+    return;
+  switch (t->kind.stmt)
+  {
+  case CompoundK:
+    lowerList(t->child[1]);
+    break;
+  case SelectionK:
+  {
+    IrBlock *thenBlock = newBlock(), *elseBlock, *join = newBlock();
+    condition = lowerExp(t->child[0]);
+    elseBlock = t->child[2] ? newBlock() : join;
+    branchTo(condition, thenBlock, elseBlock);
+    sealBlock(thenBlock);
+    if (elseBlock != join)
+      sealBlock(elseBlock);
+    current = thenBlock;
+    lowerList(t->child[1]);
+    jumpTo(join);
+    if (t->child[2])
+    {
+      current = elseBlock;
+      lowerList(t->child[2]);
+      jumpTo(join);
+    }
+    sealBlock(join);
+    current = join;
+    break;
+  }
+  case IterationK:
+  {
+    IrBlock *header = newBlock(), *body = newBlock(), *exit = newBlock();
+    lowerList(t->child[2]); /* preheader */
+    jumpTo(header);
+    current = header;
+    condition = lowerExp(t->child[0]);
+    branchTo(condition, body, exit);
+    sealBlock(body);
+    sealBlock(exit);
+    current = body;
+    lowerList(t->child[1]);
+    jumpTo(header);
+    sealBlock(header);
+    current = exit;
+    break;
+  }
+  case ReturnK:
+  {
+    IrInstr *value = t->child[0] ? lowerExp(t->child[0]) : NULL;
+    if (inlineExit)
+    {
+      if (!isDead(current))
+      {
+        inlineExit->values = realloc(inlineExit->values, sizeof(IrInstr *) * (inlineExit->count + 1));
+        inlineExit->values[inlineExit->count++] = value;
+        jumpTo(inlineExit->block);
+      }
+    }
+    else
+    {
+      IrInstr *ret = newInstr(IrReturn);
+      if (value)
+        addOperand(ret, value);
+      append(current, ret);
+    }
+    current = newBlock(); /* anything after the return is dead */
+    current->sealed = TRUE;
+    break;
+  }
+  }
+}
+
+static void lowerList(TreeNode *t)
+{
+  for (; t; t = t->sibling)
+    lowerStmt(t);
+}
+
+/**************************************************/
+/***********   Finishing the graph      ***********/
+/**************************************************/
+
+static IrInstr *resolve(IrInstr *i)
+{
+  while (i->forward)
+    i = i->forward;
+  return i;
+}
+
+/* Procedure removeTrivialPhis replaces every phi
+ * whose operands are all the same value, or the phi
+ * itself, by that value */
+static void removeTrivialPhis(void)
+{
+  IrInstr **replaced = NULL;
+  int replacedCount = 0, changed = TRUE;
+  while (changed)
+  {
+    changed = FALSE;
+    for (int b = 0; b < fn->blockCount; ++b)
+      for (IrInstr *phi = fn->blocks[b]->phis; phi; phi = phi->next)
+      {
+        IrInstr *same = NULL;
+        int trivial = TRUE;
+        if (phi->forward)
+          continue;
+        for (int i = 0; i < phi->operandCount; ++i)
+        {
+          IrInstr *operand = resolve(phi->operands[i]);
+          if (operand == phi || operand == same)
+            continue;
+          if (same)
+          {
+            trivial = FALSE;
+            break;
+          }
+          same = operand;
+        }
+        if (trivial)
+        {
+          phi->forward = same ? same : newUndef(phi->block, phi->var);
+          changed = TRUE;
+        }
+      }
+  }
+  for (int b = 0; b < fn->blockCount; ++b)
+  {
+    IrBlock *block = fn->blocks[b];
+    IrInstr **link = &block->phis;
+    for (IrInstr *i = block->phis; i; i = i->next)
+      for (int k = 0; k < i->operandCount; ++k)
+        i->operands[k] = resolve(i->operands[k]);
+    for (IrInstr *i = block->first; i; i = i->next)
+      for (int k = 0; k < i->operandCount; ++k)
+        i->operands[k] = resolve(i->operands[k]);
+    while (*link)
+    { /* unlink the replaced phis, freed below */
+      if ((*link)->forward)
+      {
+        replaced = realloc(replaced, sizeof(IrInstr *) * (replacedCount + 1));
+        replaced[replacedCount++] = *link;
+        *link = (*link)->next;
+      }
+      else
+        link = &(*link)->next;
+    }
+  }
+  for (int i = 0; i <= fn->expressionMask; ++i)
+    if (fn->expressions[i].node)
+      fn->expressions[i].value = resolve(fn->expressions[i].value);
+  for (int i = 0; i < replacedCount; ++i)
+  {
+    free(replaced[i]->operands);
+    free(replaced[i]);
+  }
+  free(replaced);
+}
+
+static void postorder(IrBlock *b, IrBlock **list, int *count)
+{
+  b->order = 0; /* visited */
+  for (int i = b->succCount - 1; i >= 0; --i)
+    if (b->succs[i]->order < 0)
+      postorder(b->succs[i], list, count);
+  list[(*count)++] = b;
+}
+
+static IrBlock *intersect(IrBlock *a, IrBlock *b)
+{
+  while (a != b)
+  {
+    while (a->order > b->order)
+      a = a->idom;
+    while (b->order > a->order)
+      b = b->idom;
+  }
+  return a;
+}
+
+/* Procedure computeDominators orders the reachable
+ * blocks and finds their immediate dominators
+ * (Cooper, Harvey and Kennedy) */
+static void computeDominators(void)
+{
+  IrBlock **list = malloc(sizeof(IrBlock *) * fn->blockCount);
+  int count = 0, changed = TRUE;
+  postorder(fn->blocks[0], list, &count);
+  fn->order = malloc(sizeof(IrBlock *) * count);
+  fn->orderCount = count;
+  for (int i = 0; i < count; ++i)
+  {
+    fn->order[i] = list[count - 1 - i];
+    fn->order[i]->order = i;
+  }
+  free(list);
+  fn->order[0]->idom = fn->order[0];
+  while (changed)
+  {
+    changed = FALSE;
+    for (int i = 1; i < count; ++i)
+    {
+      IrBlock *b = fn->order[i], *idom = NULL;
+      for (int p = 0; p < b->predCount; ++p)
+      {
+        IrBlock *pred = b->preds[p];
+        if (pred->order < 0 || pred->idom == NULL)
+          continue;
+        idom = idom ? intersect(pred, idom) : pred;
+      }
+      if (idom != b->idom)
+      {
+        b->idom = idom;
+        changed = TRUE;
+      }
+    }
+  }
+  fn->order[0]->idom = NULL;
+}
+
+static void addUser(IrInstr *operand, IrInstr *user)
+{
+  operand->users = realloc(operand->users, sizeof(IrInstr *) * (operand->userCount + 1));
+  operand->users[operand->userCount++] = user;
+}
+
+/* Procedure finishFunction numbers blocks and
+ * instructions in reverse postorder and links
+ * every value to its users */
+static void finishFunction(void)
+{
+  int id = 0;
+  for (int b = 0; b < fn->blockCount; ++b)
+  {
+    IrBlock *block = fn->blocks[b];
+    free(block->defs);
+    block->defs = NULL;
+    for (IrInstr *i = block->phis; i; i = i->next)
+      for (int k = 0; k < i->operandCount; ++k)
+        addUser(i->operands[k], i);
+    for (IrInstr *i = block->first; i; i = i->next)
+      for (int k = 0; k < i->operandCount; ++k)
+        addUser(i->operands[k], i);
+  }
+  for (int b = 0; b < fn->orderCount; ++b)
+  {
+    IrBlock *block = fn->order[b];
+    block->id = b;
+    for (IrInstr *i = block->phis; i; i = i->next)
+      i->id = id++;
+    for (IrInstr *i = block->first; i; i = i->next)
+      if (i->opcode != IrJump && i->opcode != IrBranch && i->opcode != IrReturn)
+        i->id = id++;
+  }
+  fn->instrCount = id;
+}
+
+IrFunction *buildSSA(TreeNode *function)
+{
+  IrFunction *f = calloc(1, sizeof(IrFunction));
+  IrBlock *entry;
+  IrInstr *memory;
+  int count, size = 4, index = 0;
+
+  fn = f;
+  f->function = function;
+  count = collectVars(function->child[1]) + collectVars(function->child[2]);
+  while (size < 2 * count)
+    size *= 2;
+  varMask = size - 1;
+  varTable = calloc(size, sizeof(BucketList));
+  varIndex = calloc(size, sizeof(int));
+  f->vars = malloc(sizeof(BucketList) * (count + 1));
+  collectVars(function->child[1]);
+  collectVars(function->child[2]);
+  f->expressionMask = 63;
+  f->expressions = calloc(f->expressionMask + 1, sizeof(IrExpression));
+  expressionCount = 0;
+
+  current = entry = newBlock();
+  entry->sealed = TRUE;
+  for (TreeNode *param = function->child[1]; param; param = param->sibling)
+  {
+    int var;
+    if (param->kind.param == VoidParamK)
+      continue;
+    if ((var = varOf(param->symbol)) >= 0)
+    {
+      IrInstr *value = newInstr(IrParam);
+      value->var = var;
+      value->value = index;
+      append(entry, value);
+      writeVariable(var, value);
+    }
+    ++index;
+  }
+  memory = newInstr(IrMemory);
+  append(entry, memory);
+  writeVariable(memoryVar, memory);
+
+  lowerList(function->child[2]);
+  if (!isDead(current))
+    append(current, newInstr(IrReturn));
+
+  removeTrivialPhis();
+  computeDominators();
+  finishFunction();
+  free(varTable);
+  free(varIndex);
+  varTable = NULL;
+  varIndex = NULL;
+  fn = NULL;
+  return f;
+}
+
+void freeSSA(IrFunction *f)
+{
+  for (int b = 0; b < f->blockCount; ++b)
+  {
+    IrBlock *block = f->blocks[b];
+    IrInstr *i, *next;
+    for (i = block->phis; i; i = next)
+    {
+      next = i->next;
+      free(i->operands);
+      free(i->users);
+      free(i);
+    }
+    for (i = block->first; i; i = next)
+    {
+      next = i->next;
+      free(i->operands);
+      free(i->users);
+      free(i);
+    }
+    free(block->preds);
+    free(block->incomplete);
+    free(block->edgeExecutable);
+    free(block);
+  }
+  free(f->blocks);
+  free(f->order);
+  free(f->vars);
+  free(f->expressions);
+  free(f);
+}
+
+int dominates(IrBlock *a, IrBlock *b)
+{
+  if (a->order < 0 || b->order < 0)
+    return a == b;
+  while (b && b != a)
+    b = b->idom;
+  return b == a;
+}
+
+/**************************************************/
+/***********   Printing                 ***********/
+/**************************************************/
+
+static const char *varName(IrFunction *f, int var)
+{
+  static char buff[16];
+  if (var < 0)
+    return "";
+  if (var < f->varCount)
+    return f->vars[var]->treeNode->attr.name;
+  if (var < f->varCount + NUM_TEMPORARIES)
+  {
+    sprintf(buff, "$s%d", var - f->varCount);
+    return buff;
+  }
+  return "memory";
+}
+
+static const char *opName(TokenType op)
+{
+  switch (op)
+  {
+  case PLUS:
+    return "add";
+  case MINUS:
+    return "sub";
+  case TIMES:
+    return "mul";
+  case OVER:
+    return "div";
+  case LT:
+    return "lt";
+  case LTE:
+    return "le";
+  case GT:
+    return "gt";
+  case GTE:
+    return "ge";
+  case EQ:
+    return "eq";
+  default:
+    return "ne";
+  }
+}
+
+static void printInstr(IrFunction *f, IrInstr *i)
+{
+  char line[256];
+  int n = 0, k = 0;
+  if (i->opcode != IrJump && i->opcode != IrBranch && i->opcode != IrReturn && i->opcode != IrStore)
+    n += sprintf(line + n, "%%%d = ", i->id);
+  switch (i->opcode)
+  {
+  case IrParam:
+    n += sprintf(line + n, "param %s", varName(f, i->var));
+    break;
+  case IrUndef:
+    n += sprintf(line + n, "undef %s", varName(f, i->var));
+    break;
+  case IrMemory:
+    n += sprintf(line + n, "memory");
+    break;
+  case IrConst:
+    n += sprintf(line + n, "const %d", i->value);
+    break;
+  case IrAddress:
+    n += sprintf(line + n, "address %s", i->symbol->treeNode->attr.name);
+    break;
+  case IrPhi:
+    n += sprintf(line + n, "phi %s", varName(f, i->var));
+    for (k = 0; k < i->operandCount && n < 200; ++k)
+      n += sprintf(line + n, "%s[%%%d, B%d]", k ? ", " : " ", i->operands[k]->id, i->block->preds[k]->id);
+    break;
+  case IrBinary:
+    n += sprintf(line + n, "%s %%%d, %%%d", opName(i->op), i->operands[0]->id, i->operands[1]->id);
+    break;
+  case IrLoad:
+    n += sprintf(line + n, "load %s", i->symbol->treeNode->attr.name);
+    if (i->operandCount > 1)
+      n += sprintf(line + n, "[%%%d]", i->operands[1]->id);
+    n += sprintf(line + n, " (memory %%%d)", i->operands[0]->id);
+    break;
+  case IrStore:
+    n += sprintf(line + n, "%%%d = store %s", i->id, i->symbol->treeNode->attr.name);
+    if (i->operandCount > 2)
+      n += sprintf(line + n, "[%%%d]", i->operands[1]->id);
+    n += sprintf(line + n, ", %%%d (memory %%%d)", i->operands[i->operandCount - 1]->id, i->operands[0]->id);
+    break;
+  case IrCall:
+    k = isBuiltin(i->symbol) ? 0 : 1;
+    n += sprintf(line + n, "call %s(", i->symbol->treeNode->attr.name);
+    for (int a = k; a < i->operandCount && n < 200; ++a)
+      n += sprintf(line + n, "%s%%%d", a > k ? ", " : "", i->operands[a]->id);
+    n += sprintf(line + n, ")");
+    if (k)
+      n += sprintf(line + n, " (memory %%%d)", i->operands[0]->id);
+    break;
+  case IrJump:
+    n += sprintf(line + n, "jump B%d", i->block->succs[0]->id);
+    break;
+  case IrBranch:
+    n += sprintf(line + n, "branch %%%d, B%d, B%d", i->operands[0]->id, i->block->succs[0]->id, i->block->succs[1]->id);
+    break;
+  case IrReturn:
+    n += sprintf(line + n, "return");
+    if (i->operandCount)
+      n += sprintf(line + n, " %%%d", i->operands[0]->id);
+    break;
+  }
+  if (i->lattice == LatticeConst && i->opcode != IrConst)
+    fprintf(listing, "    %-40s ; constant %d\n", line, i->constant);
+  else if (i->number != i)
+    fprintf(listing, "    %-40s ; same as %%%d\n", line, i->number->id);
+  else
+    fprintf(listing, "    %s\n", line);
+}
+
+void printSSA(IrFunction *f)
+{
+  fprintf(listing, "SSA form of '%s':\n", f->function->attr.name);
+  for (int b = 0; b < f->orderCount; ++b)
+  {
+    IrBlock *block = f->order[b];
+    int shown = 0;
+    fprintf(listing, "  B%d:", block->id);
+    for (int p = 0; p < block->predCount; ++p)
+      if (block->preds[p]->order >= 0)
+        fprintf(listing, "%s B%d", shown++ ? "," : " ; preds", block->preds[p]->id);
+    if (!block->executable)
+      fprintf(listing, " (never executed)");
+    fprintf(listing, "\n");
+    for (IrInstr *i = block->phis; i; i = i->next)
+      printInstr(f, i);
+    for (IrInstr *i = block->first; i; i = i->next)
+      printInstr(f, i);
+  }
+  fprintf(listing, "\n");
+}
@@ -0,0 +1,138 @@
+/****************************************************/
+/* File: ssa.h                                      */
+/* Static single assignment form of the functions   */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _SSA_H_
+#define _SSA_H_
+
+#include "globals.h"
+
+/* Each function is lowered to a control flow graph
+ * of basic blocks. Scalar locals, parameters and the
+ * temporaries $s0-$s7 become SSA values; arrays and
+ * global variables are loads and stores of a single
+ * memory value, which every store and call redefines.
+ */
+typedef enum
+{
+  IrParam,   /* value of a parameter on entry */
+  IrUndef,   /* variable read before it is assigned */
+  IrMemory,  /* memory on entry */
+  IrConst,   /* value */
+  IrAddress, /* address of an array passed as an argument */
+  IrPhi,     /* operands in the order of the predecessors */
+  IrBinary,  /* op: left, right */
+  IrLoad,    /* memory [, index] of symbol */
+  IrStore,   /* memory [, index], value; defines memory */
+  IrCall,    /* memory, arguments; defines memory */
+  IrJump,    /* to the only successor */
+  IrBranch,  /* condition: succs[0] if nonzero, else succs[1] */
+  IrReturn   /* [value] */
+} IrOpcode;
+
+/* Lattice of sparse conditional constant propagation:
+ * Top is not yet known, Bottom is not constant */
+typedef enum
+{
+  LatticeTop,
+  LatticeConst,
+  LatticeBottom
+} LatticeKind;
+
+typedef struct irInstr
+{
+  IrOpcode opcode;
+  int id;            /* number in the dump */
+  TokenType op;      /* IrBinary */
+  int value;         /* IrConst; parameter index of IrParam */
+  int var;           /* variable of IrParam, IrUndef and IrPhi, or -1 */
+  BucketList symbol; /* IrLoad, IrStore, IrAddress, IrCall */
+  struct irInstr **operands;
+  int operandCount;
+  struct irInstr **users;
+  int userCount;
+  struct irBlock *block;
+  struct irInstr *next;
+  struct irInstr *forward; /* trivial phi replaced by this value */
+
+  /* set by propagateConstants */
+  LatticeKind lattice;
+  int constant;
+  /* set by numberValues: first instruction of the
+   * value number, the instruction itself if unique */
+  struct irInstr *number;
+} IrInstr;
+
+typedef struct irBlock
+{
+  int id;
+  IrInstr *phis;
+  IrInstr *first, *last; /* the last one ends the block */
+  struct irBlock **preds;
+  int predCount;
+  struct irBlock *succs[2];
+  int succCount;
+  struct irBlock *idom; /* immediate dominator, NULL for the entry */
+  int order;            /* reverse postorder, -1 if unreachable */
+
+  /* construction */
+  int sealed;            /* all predecessors are known */
+  IrInstr **defs;        /* current value of each variable */
+  IrInstr **incomplete;  /* phis made before sealing */
+  int incompleteCount;
+
+  /* set by propagateConstants */
+  int executable;
+  int *edgeExecutable; /* for each predecessor */
+} IrBlock;
+
+/* An expression of the syntax tree, the value it
+ * computes and the block it is evaluated in */
+typedef struct
+{
+  TreeNode *node;
+  IrInstr *value;
+  IrBlock *block;
+} IrExpression;
+
+typedef struct
+{
+  TreeNode *function;
+  IrBlock **blocks; /* blocks[0] is the entry */
+  int blockCount;
+  IrBlock **order; /* reachable blocks in reverse postorder */
+  int orderCount;
+  BucketList *vars; /* scalars; temporaries and memory follow */
+  int varCount;
+  int instrCount;
+  IrExpression *expressions; /* open-addressing table */
+  int expressionMask;
+} IrFunction;
+
+/* Function buildSSA lowers a function declaration
+ * to SSA form, with trivial phis removed
+ */
+IrFunction *buildSSA(TreeNode *function);
+
+/* Procedure freeSSA releases a function in SSA form */
+void freeSSA(IrFunction *f);
+
+/* Function expressionOf returns the value and block
+ * of an expression node, or NULL if it has none
+ */
+IrExpression *expressionOf(IrFunction *f, TreeNode *node);
+
+/* Function dominates returns TRUE if every path from
+ * the entry to block b passes through block a
+ */
+int dominates(IrBlock *a, IrBlock *b);
+
+/* Procedure printSSA prints the function and the
+ * results of the analyses to the listing file
+ */
+void printSSA(IrFunction *f);
+
+#endif
@@ -15,6 +15,7 @@
 #include "symtab.h"
 #include "parse.h"
 #include "util.h"
+#include "phase.h"
 
 /* the hash function which returns a number in [0, SIZE) */
 static int hash(const char *key)
@@ -29,6 +30,13 @@ static int hash(const char *key)
   return temp;
 }
 
+/* Function symbolBucket returns the hash table
+ * bucket of name, the same in every scope */
+int symbolBucket(const char *name)
+{
+  return hash(name);
+}
+
 static void scopeError(TreeNode *t, const char *message)
 {
   char *kindtype = "";
@@ -48,6 +56,8 @@ static void scopeError(TreeNode *t, const char *message)
     case AssignK:
     case OpK:
     case ConstK:
+    case InlineK:
+    case TempK:
       break;
     }
   }
@@ -107,6 +117,7 @@ static BucketList st_insert(char *name, int lineno, int loc)
     l->lines->next = NULL;
     l->memloc = loc;
     l->size = 0;
+    l->length = NULL;
     l->is_registered_argument = 0;
     l->next = currentScopeSymbolTable->hashTable[h];
     currentScopeSymbolTable->hashTable[h] = l;
@@ -169,6 +180,7 @@ int registerSymbol(TreeNode *t, SymbolClass symbol_class, int is_array, ExpType
   { /* The symbol is not found in current scope. */
     int location = currentScopeSymbolTable->location;
     BucketList symbol = st_insert(t->attr.name, t->lineno, location);
+    countEvent(CountSymbols);
     if (!isGlobalScope())
     {
       if (is_array && symbol_class != Parameter)
@@ -259,6 +271,7 @@ void initSymTab(void)
   currentScopeSymbolTable->prev = NULL;
   for (int i = 0; i < HASHTABLE_SIZE; ++i)
     currentScopeSymbolTable->hashTable[i] = NULL;
+  countEvent(CountScopes);
 }
 
 /* increment current scope */
@@ -272,6 +285,7 @@ void incrementScope(void)
     newSymbolTable->hashTable[i] = NULL;
 
   currentScopeSymbolTable = newSymbolTable;
+  countEvent(CountScopes);
 }
 
 /* decrement scope */
@@ -376,6 +390,7 @@ void addIO(void)
     paramTypeNode->type = Integer;
     paramSymbol->treeNode = paramNode;
     paramSymbol->size = 0;
+    paramSymbol->length = NULL;
     paramSymbol->is_array = FALSE;
     paramSymbol->lines = NULL;
     paramSymbol->memloc = 4;
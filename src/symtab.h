@@ -56,4 +56,8 @@ void addIO(void);
  * and FALSE otherwise. */
 int isGlobalScope(void);
 
+/* Returns the hash table bucket of name, for
+ * benchmarks that control collisions */
+int symbolBucket(const char *name);
+
 #endif
@@ -0,0 +1,163 @@
+/****************************************************/
+/* File: timeline.c                                 */
+/* Timeline of the compilation in the Chrome        */
+/* trace event format                               */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include "globals.h"
+#include "timeline.h"
+
+/* The compiler has a single thread, so a single
+ * ring buffer is enough. Events are only written
+ * out at exit; recording one costs a clock read. */
+#define TIMELINE_EVENTS 65536
+#define MAX_SPAN_DEPTH 64
+
+typedef struct
+{
+  const char *category;
+  const char *name;
+  char phase;          /* 'X' for a span, 'C' for a counter */
+  double start;        /* microseconds */
+  double duration;
+  const char *argName; /* NULL if no value is attached */
+  long arg;
+} TimelineEvent;
+
+typedef struct
+{
+  const char *category;
+  const char *name;
+  double start;
+} OpenSpan;
+
+static TimelineEvent events[TIMELINE_EVENTS];
+static long eventCount; /* events recorded, including those overwritten */
+static OpenSpan openSpans[MAX_SPAN_DEPTH];
+static int openCount;
+static double origin = -1.0;
+
+static double microseconds(void)
+{
+  struct timespec ts;
+  double now;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  now = ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+  if (origin < 0.0)
+    origin = now;
+  return now - origin;
+}
+
+static TimelineEvent *newEvent(void)
+{
+  return &events[eventCount++ % TIMELINE_EVENTS];
+}
+
+void beginSpan(const char *category, const char *name)
+{
+  if (!TimeTrace)
+    return;
+  if (openCount < MAX_SPAN_DEPTH)
+  {
+    openSpans[openCount].category = category;
+    openSpans[openCount].name = name;
+    openSpans[openCount].start = microseconds();
+  }
+  ++openCount; /* spans too deep are dropped, not mismatched */
+}
+
+/* Spans are recorded as complete events when they
+ * end, so an overwritten event never leaves a begin
+ * without its end */
+static void closeSpan(const char *argName, long arg)
+{
+  OpenSpan *span;
+  TimelineEvent *e;
+  if (!TimeTrace || openCount == 0)
+    return;
+  if (--openCount >= MAX_SPAN_DEPTH)
+    return;
+  span = &openSpans[openCount];
+  e = newEvent();
+  e->category = span->category;
+  e->name = span->name;
+  e->phase = 'X';
+  e->start = span->start;
+  e->duration = microseconds() - span->start;
+  e->argName = argName;
+  e->arg = arg;
+  if (argName)
+  {
+    TimelineEvent *c = newEvent();
+    c->category = span->category;
+    c->name = argName;
+    c->phase = 'C';
+    c->start = e->start + e->duration;
+    c->duration = 0.0;
+    c->argName = argName;
+    c->arg = arg;
+  }
+}
+
+void endSpan(void)
+{
+  closeSpan(NULL, 0);
+}
+
+void endSpanWith(const char *counter, long value)
+{
+  closeSpan(counter, value);
+}
+
+static void writeString(FILE *f, const char *s)
+{
+  fputc('"', f);
+  for (; *s; ++s)
+  {
+    if (*s == '"' || *s == '\\')
+      fputc('\\', f);
+    fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+void writeTimeline(const char *filename)
+{
+  FILE *f = fopen(filename, "w");
+  long first = eventCount > TIMELINE_EVENTS ? eventCount - TIMELINE_EVENTS : 0;
+  if (f == NULL)
+  {
+    fprintf(stderr, "Unable to open %s\n", filename);
+    return;
+  }
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"C- compiler\"}}");
+  for (long i = first; i < eventCount; ++i)
+  {
+    TimelineEvent *e = &events[i % TIMELINE_EVENTS];
+    fprintf(f, ",\n{\"name\": ");
+    writeString(f, e->name);
+    fprintf(f, ", \"cat\": ");
+    writeString(f, e->category);
+    fprintf(f, ", \"ph\": \"%c\", \"ts\": %.3f, ", e->phase, e->start);
+    if (e->phase == 'X')
+      fprintf(f, "\"dur\": %.3f, ", e->duration);
+    fprintf(f, "\"pid\": 1, \"tid\": 1");
+    if (e->argName)
+    {
+      fprintf(f, ", \"args\": {");
+      writeString(f, e->argName);
+      fprintf(f, ": %ld}", e->arg);
+    }
+    fputc('}', f);
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  if (first > 0)
+    fprintf(stderr, "Timeline: the first %ld events were dropped\n", first);
+}
@@ -0,0 +1,35 @@
+/****************************************************/
+/* File: timeline.h                                 */
+/* Timeline of the compilation in the Chrome        */
+/* trace event format                               */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _TIMELINE_H_
+#define _TIMELINE_H_
+
+#include "globals.h"
+
+/* Procedure beginSpan opens a span of the timeline,
+ * closed by the matching endSpan. The strings are
+ * not copied, so they must live until the timeline
+ * is written. Both do nothing unless TimeTrace is
+ * set.
+ */
+void beginSpan(const char *category, const char *name);
+void endSpan(void);
+
+/* Procedure endSpanWith closes the span like
+ * endSpan, with one value attached to it, and also
+ * records the value as a counter of that name
+ */
+void endSpanWith(const char *counter, long value);
+
+/* Procedure writeTimeline writes the events kept,
+ * the latest ones if there were too many, to
+ * filename as JSON for chrome://tracing or Perfetto
+ */
+void writeTimeline(const char *filename);
+
+#endif
@@ -205,6 +205,12 @@ void printTree(TreeNode *tree)
       case CallK:
         fprintf(listing, "Calling: %s\n", tree->attr.name);
         break;
+      case InlineK:
+        fprintf(listing, "Inlined call: %s\n", tree->attr.name);
+        break;
+      case TempK:
+        fprintf(listing, "Temporary: $s%d\n", tree->attr.val);
+        break;
       }
     }
     else if (tree->nodekind == DeclK)
@@ -0,0 +1,935 @@
+/****************************************************/
+/* File: x86gen.c                                   */
+/* The x86-64 code generator                        */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "globals.h"
+#include "code.h"
+#include "cgen.h"
+#include "x86gen.h"
+#include "bounds.h"
+#include "phase.h"
+#include "timeline.h"
+
+#define getName(node) (node->symbol->treeNode->attr.name)
+
+/* The frame layout of analyze.c is kept, with every
+ * word slot widened to a quadword so that it can hold
+ * an array address, and without the slot of the
+ * return address, which the call pushes above %rbp:
+ * the slot at memloc on MIPS is at SLOT_SCALE *
+ * memloc + QUAD_SIZE from %rbp. Stacked parameters
+ * are also above the return address. Below the local
+ * slots are the home slots of the registered
+ * parameters, then the saved callee-saved registers,
+ * then the temporaries that do not fit in them, then
+ * the operands spilled while the other one of the
+ * pair is evaluated */
+enum
+{
+  QUAD_SIZE = 8,
+  SLOT_SCALE = QUAD_SIZE / WORD_SIZE,
+  REGISTER_ARGUMENTS = 4,
+  REGISTER_TEMPORARIES = 5,
+  STACK_ALIGNMENT = 16
+};
+
+/* C- functions receive their first four arguments in
+ * the registers of the System V ABI and the rest on
+ * the stack, the first one lowest. Temporaries live
+ * in callee-saved registers */
+static const char *const argumentQuads[REGISTER_ARGUMENTS] = {"%rdi", "%rsi", "%rdx", "%rcx"};
+static const char *const argumentLongs[REGISTER_ARGUMENTS] = {"%edi", "%esi", "%edx", "%ecx"};
+static const char *const temporaryQuads[REGISTER_TEMPORARIES] = {"%rbx", "%r12", "%r13", "%r14", "%r15"};
+static const char *const temporaryLongs[REGISTER_TEMPORARIES] = {"%ebx", "%r12d", "%r13d", "%r14d", "%r15d"};
+
+static TreeNode *currentFunction;
+static int frameLocals;    /* bytes of the widened local slots */
+static int savedBase;      /* offset below %rbp of the saved registers */
+static int spillBase;      /* offset below %rbp of the spilled temporaries */
+static int operandBase;    /* offset below %rbp of the spilled operands */
+static int frameTemporaries;
+static int stackDepth;     /* operands spilled at this point */
+static int spillDepth;     /* most operands spilled at once */
+static int returnLabel;
+static int bodyLabel;
+static int inlineDepth;
+
+/* Failed bounds checks branch to a stub that calls
+ * the runtime with the line number. Stubs are
+ * emitted after the function */
+typedef struct
+{
+  int label;
+  int lineno;
+} BoundsTrap;
+static BoundsTrap *boundsTraps;
+static int boundsTrapCount;
+
+static enum {
+  NONE,
+  TEXT,
+  BSS
+} section = NONE;
+
+static void gen(TreeNode *node);
+static void genExp(TreeNode *node);
+
+/* Procedure emitInstruction prints an instruction */
+static void emitInstruction(const char *format, ...)
+{
+  char line[160];
+  va_list args;
+  line[0] = '\t';
+  va_start(args, format);
+  vsnprintf(line + 1, sizeof(line) - 1, format, args);
+  va_end(args);
+  emitCode(line);
+}
+
+/* Procedure emitDirective prints a directive or label */
+static void emitDirective(const char *format, ...)
+{
+  char line[160];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  emitCode(line);
+}
+
+/* Function getLabel returns a new label number */
+static int getLabel(void)
+{
+  static int labelN = 0;
+  return labelN++;
+}
+
+static void emitLabelX86(int label)
+{
+  emitDirective(".L%d:", label);
+}
+
+static void switchSection(int next, const char *directive)
+{
+  if (section != next)
+  {
+    section = next;
+    emitDirective("%s", directive);
+  }
+}
+
+/* Function frameOffset returns the offset from %rbp
+ * of the slot of a local variable or parameter */
+static int frameOffset(BucketList symbol)
+{
+  if (symbol->symbol_class == Parameter && symbol->is_registered_argument)
+    return -(frameLocals + QUAD_SIZE * (symbol->memloc + 1));
+  return SLOT_SCALE * symbol->memloc + QUAD_SIZE;
+}
+
+/* Procedure variableOperand writes the memory
+ * operand of the slot of symbol to buffer */
+static void variableOperand(BucketList symbol, char *buffer)
+{
+  if (symbol->symbol_class == Global)
+    sprintf(buffer, "cm.%s(%%rip)", symbol->treeNode->attr.name);
+  else
+    sprintf(buffer, "%d(%%rbp)", frameOffset(symbol));
+}
+
+/* Function temporary returns the operand of
+ * temporary t, as a quadword if wide is set. Spilled
+ * temporaries are written to buffer */
+static const char *temporary(int t, int wide, char *buffer)
+{
+  if (t < REGISTER_TEMPORARIES)
+    return wide ? temporaryQuads[t] : temporaryLongs[t];
+  sprintf(buffer, "%d(%%rbp)", -(spillBase + QUAD_SIZE * (t - REGISTER_TEMPORARIES + 1)));
+  return buffer;
+}
+
+/* Function leafOperand returns TRUE if node is a
+ * constant, a scalar variable or a temporary read,
+ * which instructions can take as an operand without
+ * evaluating it first, and writes the operand */
+static int leafOperand(TreeNode *node, char *buffer)
+{
+  if (node->nodekind != ExpK)
+    return FALSE;
+  switch (node->kind.exp)
+  {
+  case ConstK:
+    sprintf(buffer, "$%d", node->attr.val);
+    return TRUE;
+  case VarK:
+    if (node->symbol->is_array)
+      return FALSE;
+    variableOperand(node->symbol, buffer);
+    return TRUE;
+  case TempK:
+  {
+    const char *operand;
+    if (node->child[0])
+      return FALSE;
+    operand = temporary(node->attr.val, FALSE, buffer);
+    if (operand != buffer)
+      strcpy(buffer, operand);
+    return TRUE;
+  }
+  default:
+    return FALSE;
+  }
+}
+
+/* Procedures push and pop spill %rax to the next
+ * operand slot of the frame and reload the last one.
+ * %rsp does not move, so it stays aligned for calls */
+static void push(void)
+{
+  emitInstruction("movq %%rax, %d(%%rbp)", -(operandBase + QUAD_SIZE * ++stackDepth));
+  if (stackDepth > spillDepth)
+    spillDepth = stackDepth;
+}
+
+static void pop(const char *reg)
+{
+  emitInstruction("movq %d(%%rbp), %s", -(operandBase + QUAD_SIZE * stackDepth--), reg);
+}
+
+/* Procedure genArrayAddress computes the address of
+ * the array of node into the quadword register reg.
+ * Array parameters hold the address in their slot */
+static void genArrayAddress(TreeNode *node, const char *reg)
+{
+  char operand[64];
+  variableOperand(node->symbol, operand);
+  if (node->symbol->symbol_class == Parameter)
+    emitInstruction("movq %s, %s", operand, reg);
+  else
+    emitInstruction("leaq %s, %s", operand, reg);
+}
+
+/* Procedure genBoundsCheck branches to a trap stub
+ * if the index in %eax is outside the accessed
+ * array. A negative index compares as a large
+ * unsigned one. An array parameter is checked
+ * against the slot of its length */
+static void genBoundsCheck(TreeNode *access)
+{
+  char operand[64];
+  int label;
+  if (!BoundsCheck || !needsBoundsCheck(access))
+    return;
+  label = getLabel();
+  if (access->symbol->length)
+  {
+    variableOperand(access->symbol->length, operand);
+    emitInstruction("cmpl %s, %%eax", operand);
+  }
+  else
+    emitInstruction("cmpl $%d, %%eax", access->symbol->size);
+  emitInstruction("jae .L%d", label);
+  boundsTraps = realloc(boundsTraps, sizeof(BoundsTrap) * (boundsTrapCount + 1));
+  boundsTraps[boundsTrapCount].label = label;
+  boundsTraps[boundsTrapCount].lineno = access->lineno;
+  ++boundsTrapCount;
+}
+
+/* Procedure genBoundsTraps emits the stubs of the
+ * bounds checks generated since the last call */
+static void genBoundsTraps(void)
+{
+  for (int i = 0; i < boundsTrapCount; ++i)
+  {
+    emitLabelX86(boundsTraps[i].label);
+    emitInstruction("movl $%d, %%edi", boundsTraps[i].lineno);
+    emitInstruction("call rtBoundsError");
+  }
+  boundsTrapCount = 0;
+}
+
+/* Procedure genElementAddress computes the address
+ * of the element accessed by node into %rax */
+static void genElementAddress(TreeNode *node)
+{
+  char operand[64];
+  if (node->child[0] == NULL)
+  { /* element address kept in a temporary */
+    emitInstruction("movq %s, %%rax", temporary(node->child[2]->attr.val, TRUE, operand));
+    return;
+  }
+  genExp(node->child[0]);
+  genBoundsCheck(node);
+  emitInstruction("movslq %%eax, %%rax");
+  if (node->child[1]) /* base hoisted to a temporary */
+    emitInstruction("movq %s, %%rcx", temporary(node->child[1]->attr.val, TRUE, operand));
+  else
+    genArrayAddress(node, "%rcx");
+  emitInstruction("leaq (%%rcx,%%rax,%d), %%rax", WORD_SIZE);
+  if (node->child[2])
+    emitInstruction("movq %%rax, %s", temporary(node->child[2]->attr.val, TRUE, operand));
+}
+
+/* Procedure genOperands evaluates left into %eax and
+ * writes the operand of right: the leaf itself, or
+ * %ecx after evaluating it */
+static void genOperands(TreeNode *left, TreeNode *right, char *operand)
+{
+  genExp(left);
+  if (leafOperand(right, operand))
+    return;
+  push();
+  genExp(right);
+  emitInstruction("movl %%eax, %%ecx");
+  pop("%rax");
+  strcpy(operand, "%ecx");
+}
+
+/* Procedure genDivide divides %eax by %ecx. A zero
+ * or -1 divisor would trap in idiv; they give 0 and
+ * the negated dividend, the product of the two */
+static void genDivide(void)
+{
+  int special = getLabel(), done = getLabel();
+  emitInstruction("leal 1(%%rcx), %%edx");
+  emitInstruction("cmpl $1, %%edx");
+  emitInstruction("jbe .L%d", special);
+  emitInstruction("cltd");
+  emitInstruction("idivl %%ecx");
+  emitInstruction("jmp .L%d", done);
+  emitLabelX86(special);
+  emitInstruction("imull %%ecx, %%eax");
+  emitLabelX86(done);
+}
+
+/* Procedure genDivideConst divides %eax by a nonzero
+ * constant in place, truncating toward zero, with
+ * the same sequences as the MIPS code generator */
+static void genDivideConst(int divisor)
+{
+  unsigned int magnitude = divisor < 0 ? 0u - (unsigned int)divisor : (unsigned int)divisor;
+  if (magnitude == 1)
+    ;
+  else if (!(magnitude & (magnitude - 1)))
+  { /* power of two: add 2^k - 1 to negative dividends before shifting */
+    int k = 0;
+    while ((1u << k) != magnitude)
+      ++k;
+    emitInstruction("movl %%eax, %%edx");
+    if (k > 1)
+      emitInstruction("sarl $31, %%edx");
+    emitInstruction("shrl $%d, %%edx", 32 - k);
+    emitInstruction("addl %%edx, %%eax");
+    emitInstruction("sarl $%d, %%eax", k);
+  }
+  else
+  { /* multiply by magic number, keep the high word */
+    int shift;
+    int magic = magicDivisor(divisor, &shift);
+    emitInstruction("movslq %%eax, %%rdx");
+    emitInstruction("imulq $%d, %%rdx, %%rdx", magic);
+    emitInstruction("sarq $32, %%rdx");
+    if (divisor > 0 && magic < 0)
+      emitInstruction("addl %%eax, %%edx");
+    else if (divisor < 0 && magic > 0)
+      emitInstruction("subl %%eax, %%edx");
+    if (shift)
+      emitInstruction("sarl $%d, %%edx", shift);
+    emitInstruction("movl %%edx, %%eax");
+    emitInstruction("shrl $31, %%eax"); /* round toward zero */
+    emitInstruction("addl %%edx, %%eax");
+    return;
+  }
+  if (divisor < 0)
+    emitInstruction("negl %%eax");
+}
+
+/* Function isConst returns TRUE if node is a constant */
+static int isConst(TreeNode *node)
+{
+  return node->nodekind == ExpK && node->kind.exp == ConstK;
+}
+
+/* Function conditionCode returns the condition code
+ * suffix of a relational operator */
+static const char *conditionCode(TokenType op)
+{
+  switch (op)
+  {
+  case LT:
+    return "l";
+  case LTE:
+    return "le";
+  case GT:
+    return "g";
+  case GTE:
+    return "ge";
+  case EQ:
+    return "e";
+  default: /* NEQ */
+    return "ne";
+  }
+}
+
+/* Procedure genOp generates code for an operator,
+ * leaving the result in %eax */
+static void genOp(TreeNode *node)
+{
+  TreeNode *left = node->child[0], *right = node->child[1];
+  char operand[64];
+  if (node->attr.op == TIMES && (isConst(right) || isConst(left)))
+  {
+    int multiplier = isConst(right) ? right->attr.val : left->attr.val;
+    genExp(isConst(right) ? left : right);
+    if (multiplier > 0 && !(multiplier & (multiplier - 1)))
+    {
+      int k = 0;
+      while ((1 << k) != multiplier)
+        ++k;
+      if (k)
+        emitInstruction("sall $%d, %%eax", k);
+    }
+    else
+      emitInstruction("imull $%d, %%eax, %%eax", multiplier);
+    return;
+  }
+  if (node->attr.op == OVER && isConst(right) && right->attr.val != 0)
+  {
+    genExp(left);
+    genDivideConst(right->attr.val);
+    return;
+  }
+  genOperands(left, right, operand);
+  switch (node->attr.op)
+  {
+  case PLUS:
+    emitInstruction("addl %s, %%eax", operand);
+    break;
+  case MINUS:
+    emitInstruction("subl %s, %%eax", operand);
+    break;
+  case TIMES:
+    emitInstruction("imull %s, %%eax", operand);
+    break;
+  case OVER:
+    if (strcmp(operand, "%ecx"))
+      emitInstruction("movl %s, %%ecx", operand);
+    genDivide();
+    break;
+  default:
+    emitInstruction("cmpl %s, %%eax", operand);
+    emitInstruction("set%s %%al", conditionCode(node->attr.op));
+    emitInstruction("movzbl %%al, %%eax");
+    break;
+  }
+}
+
+/* Procedure genBranchFalse generates code that jumps
+ * to label if the condition node is zero, comparing
+ * the operands of a relational operator directly */
+static void genBranchFalse(TreeNode *node, int label)
+{
+  TreeNode *left = node->child[0], *right = node->child[1];
+  TokenType op = node->attr.op;
+  char operand[64];
+  if (node->kind.exp != OpK || op == PLUS || op == MINUS || op == TIMES || op == OVER)
+  {
+    genExp(node);
+    emitInstruction("testl %%eax, %%eax");
+    emitInstruction("je .L%d", label);
+    return;
+  }
+  if (isConst(left) && !isConst(right))
+  { /* keep the constant on the right: c < x is x > c */
+    TreeNode *temp = left;
+    left = right;
+    right = temp;
+    op = op == LT ? GT : op == GT ? LT : op == LTE ? GTE : op == GTE ? LTE : op;
+  }
+  genOperands(left, right, operand);
+  if (!strcmp(operand, "$0"))
+    emitInstruction("testl %%eax, %%eax");
+  else
+    emitInstruction("cmpl %s, %%eax", operand);
+  /* branches taken when the comparison fails */
+  op = op == LT ? GTE : op == GTE ? LT : op == LTE ? GT : op == GT ? LTE : op == EQ ? NEQ : EQ;
+  emitInstruction("j%s .L%d", conditionCode(op), label);
+}
+
+/* Procedure genAssign generates code to store the
+ * value of the right hand side, which is left in
+ * %eax. An element address is computed first, as
+ * the MIPS code generator does */
+static void genAssign(TreeNode *node)
+{
+  TreeNode *LHS = node->child[0];
+  char operand[64];
+  if (LHS->kind.exp == VarK)
+  {
+    genExp(node->child[1]);
+    variableOperand(LHS->symbol, operand);
+    emitInstruction("movl %%eax, %s", operand);
+    return;
+  }
+  if (LHS->child[0] == NULL)
+  { /* element address kept in a temporary */
+    genExp(node->child[1]);
+    emitInstruction("movq %s, %%rcx", temporary(LHS->child[2]->attr.val, TRUE, operand));
+  }
+  else
+  {
+    genElementAddress(LHS);
+    push();
+    genExp(node->child[1]);
+    pop("%rcx");
+  }
+  emitInstruction("movl %%eax, (%%rcx)");
+}
+
+/* Function isLeafArgument returns TRUE if node can
+ * be loaded straight into an argument register
+ * without disturbing the ones already loaded */
+static int isLeafArgument(TreeNode *node)
+{
+  char operand[64];
+  return leafOperand(node, operand) || (node->kind.exp == VarK && node->symbol->is_array);
+}
+
+/* Procedure genLeafArgument loads a leaf argument
+ * into the quadword register reg */
+static void genLeafArgument(TreeNode *node, const char *reg, const char *longReg)
+{
+  char operand[64];
+  if (node->kind.exp == VarK && node->symbol->is_array)
+    genArrayAddress(node, reg);
+  else if (node->kind.exp == TempK)
+    emitInstruction("movq %s, %s", temporary(node->attr.val, TRUE, operand), reg);
+  else
+  {
+    leafOperand(node, operand);
+    emitInstruction("movl %s, %s", operand, longReg);
+  }
+}
+
+/* Procedure genCall generates a call. Arguments that
+ * are leaves are loaded straight into their
+ * registers; otherwise they are spilled as they are
+ * evaluated and reloaded into the registers at the end,
+ * but for the last one.
+ * Nothing lives in caller-saved registers across a
+ * call, so none is saved */
+static void genCall(TreeNode *node)
+{
+  TreeNode *args;
+  int i, direct = TRUE;
+  int count = node->symbol->size;
+  int registered = count < REGISTER_ARGUMENTS ? count : REGISTER_ARGUMENTS;
+  int stacked = count - registered;
+  int pad;
+  char target[64];
+  if (!strcmp("input", getName(node)))
+  {
+    emitInstruction("movl $%d, %%edi", !BatchInput);
+    emitInstruction("call rtInput");
+    return;
+  }
+  if (!strcmp("output", getName(node)))
+  {
+    genExp(node->child[0]);
+    emitInstruction("movl %%eax, %%edi");
+    emitInstruction("call rtOutput");
+    return;
+  }
+  for (args = node->child[0]; args; args = args->sibling)
+    direct = direct && isLeafArgument(args);
+  /* reserve the stacked arguments, padded so that
+   * they end at an aligned %rsp */
+  pad = stacked % 2;
+  if (pad + stacked)
+    emitInstruction("subq $%d, %%rsp", QUAD_SIZE * (pad + stacked));
+  for (i = 0, args = node->child[0]; args; ++i, args = args->sibling)
+  {
+    if (i < REGISTER_ARGUMENTS && direct)
+      genLeafArgument(args, argumentQuads[i], argumentLongs[i]);
+    else
+    {
+      genExp(args);
+      if (i == count - 1 && i < REGISTER_ARGUMENTS) /* nothing left to evaluate */
+        emitInstruction("movq %%rax, %s", argumentQuads[i]);
+      else if (i < REGISTER_ARGUMENTS)
+        push();
+      else
+        emitInstruction("movq %%rax, %d(%%rsp)", QUAD_SIZE * (i - REGISTER_ARGUMENTS));
+    }
+  }
+  if (!direct)
+    for (i = count > REGISTER_ARGUMENTS ? registered - 1 : registered - 2; i >= 0; --i)
+      pop(argumentQuads[i]);
+  sprintf(target, "cm.%s", getName(node));
+  emitInstruction("call %s", target);
+  if (pad + stacked)
+    emitInstruction("addq $%d, %%rsp", QUAD_SIZE * (pad + stacked));
+}
+
+/* Procedure genEpilogue restores the callee-saved
+ * registers and pops the frame */
+static void genEpilogue(void)
+{
+  for (int i = 0; i < frameTemporaries && i < REGISTER_TEMPORARIES; ++i)
+    emitInstruction("movq %d(%%rbp), %s", -(savedBase + QUAD_SIZE * (i + 1)), temporaryQuads[i]);
+  emitInstruction("leave");
+}
+
+/* Function isTailCall returns TRUE if the returned
+ * expression node is a call that can reuse the frame
+ * of the current function: a call to itself, or one
+ * whose arguments all go in registers */
+static int isTailCall(TreeNode *node)
+{
+  if (!OptimizeTailCalls || inlineDepth || node->kind.exp != CallK ||
+      !strcmp(getName(node), "input") || !strcmp(getName(node), "output") || passesFrameAddress(node))
+    return FALSE;
+  return node->symbol == currentFunction->symbol || node->symbol->size <= REGISTER_ARGUMENTS;
+}
+
+/* Procedure genTailCall generates a call in return
+ * position. All arguments are evaluated before any
+ * parameter is overwritten. A function calling itself
+ * stores them in its parameter slots and jumps back
+ * to the start of its body; other calls pop the
+ * frame and jump to the callee */
+static void genTailCall(TreeNode *node)
+{
+  TreeNode *args;
+  int i, count = node->symbol->size;
+  for (args = node->child[0]; args; args = args->sibling)
+  {
+    genExp(args);
+    push();
+  }
+  if (node->symbol == currentFunction->symbol)
+  {
+    for (i = count - 1; i >= 0; --i)
+    {
+      pop("%rax");
+      if (i < REGISTER_ARGUMENTS)
+        emitInstruction("movq %%rax, %d(%%rbp)", -(frameLocals + QUAD_SIZE * (i + 1)));
+      else
+        emitInstruction("movq %%rax, %d(%%rbp)", 2 * QUAD_SIZE + QUAD_SIZE * (i - REGISTER_ARGUMENTS));
+    }
+    emitInstruction("jmp .L%d", bodyLabel);
+  }
+  else
+  {
+    for (i = count - 1; i >= 0; --i)
+      pop(argumentQuads[i]);
+    genEpilogue();
+    emitInstruction("jmp cm.%s", getName(node));
+  }
+}
+
+/* Procedure genStmt generates code at a statement node */
+static void genStmt(TreeNode *node)
+{
+  switch (node->kind.stmt)
+  {
+  case CompoundK:
+    gen(node->child[1]);
+    break;
+  case SelectionK:
+  {
+    int followingLabel = getLabel();
+    if (node->child[2])
+    {
+      int elseLabel = getLabel();
+      genBranchFalse(node->child[0], elseLabel);
+      gen(node->child[1]);
+      emitInstruction("jmp .L%d", followingLabel);
+      emitLabelX86(elseLabel);
+      gen(node->child[2]);
+    }
+    else
+    {
+      genBranchFalse(node->child[0], followingLabel);
+      gen(node->child[1]);
+    }
+    emitLabelX86(followingLabel);
+    break;
+  }
+  case IterationK:
+  {
+    int conditionLabel = getLabel();
+    int followingLabel = getLabel();
+    gen(node->child[2]); /* preheader */
+    emitLabelX86(conditionLabel);
+    genBranchFalse(node->child[0], followingLabel);
+    gen(node->child[1]);
+    emitInstruction("jmp .L%d", conditionLabel);
+    emitLabelX86(followingLabel);
+    break;
+  }
+  case ReturnK:
+    if (isTailCall(node->child[0]))
+      genTailCall(node->child[0]);
+    else
+    {
+      genExp(node->child[0]);
+      emitInstruction("jmp .L%d", returnLabel);
+    }
+    break;
+  }
+}
+
+/* Procedure genExp generates code at an expression
+ * node. The value is left in %eax, or in %rax if it
+ * is an address */
+static void genExp(TreeNode *node)
+{
+  char operand[64];
+  switch (node->kind.exp)
+  {
+  case AssignK:
+    genAssign(node);
+    break;
+  case OpK:
+    genOp(node);
+    break;
+  case ConstK:
+    emitInstruction("movl $%d, %%eax", node->attr.val);
+    break;
+  case VarK:
+    if (node->symbol->is_array)
+      genArrayAddress(node, "%rax");
+    else
+    {
+      variableOperand(node->symbol, operand);
+      emitInstruction("movl %s, %%eax", operand);
+    }
+    break;
+  case ArrK:
+    genElementAddress(node);
+    emitInstruction("movl (%%rax), %%eax");
+    break;
+  case CallK:
+    genCall(node);
+    break;
+  case InlineK:
+  {
+    /* Store arguments to the parameter slots in this
+     * frame and run the copied body. Its return
+     * statements jump to the end of the body */
+    TreeNode *args, *params;
+    int savedReturnLabel = returnLabel;
+    for (args = node->child[0], params = node->child[2]; args; args = args->sibling, params = params->sibling)
+    {
+      genExp(args);
+      variableOperand(params->symbol, operand);
+      emitInstruction("movq %%rax, %s", operand);
+    }
+    returnLabel = getLabel();
+    ++inlineDepth;
+    gen(node->child[1]);
+    --inlineDepth;
+    emitLabelX86(returnLabel);
+    returnLabel = savedReturnLabel;
+    break;
+  }
+  case TempK:
+    if (node->child[0])
+    {
+      genExp(node->child[0]);
+      emitInstruction("movq %%rax, %s", temporary(node->attr.val, TRUE, operand));
+    }
+    else
+      emitInstruction("movq %s, %%rax", temporary(node->attr.val, TRUE, operand));
+    break;
+  }
+}
+
+/* Procedure gen generates code for node and its siblings */
+static void gen(TreeNode *node)
+{
+  for (; node; node = node->sibling)
+  {
+    if (node->nodekind == StmtK)
+      genStmt(node);
+    else if (node->nodekind == ExpK)
+      genExp(node);
+  }
+}
+
+static void genGlobalVarDecl(const char *name, int size)
+{
+  switchSection(BSS, ".bss");
+  emitDirective(".p2align %d", size > WORD_SIZE ? 4 : 2);
+  emitDirective("cm.%s:", name);
+  emitDirective(".zero %d", size);
+}
+
+/* Procedure genFunDecl generates a function. The
+ * body is generated first, into a buffer, so that the
+ * prologue can reserve the operand slots it spills
+ * to. main is cm.main too: the runtime calls it on a
+ * stack of its own */
+static void genFunDecl(TreeNode *node)
+{
+  long firstInstruction = eventCounts[CountInstructions];
+  int isMain = !strcmp(getName(node), "main");
+  int registered = node->symbol->size < REGISTER_ARGUMENTS ? node->symbol->size : REGISTER_ARGUMENTS;
+  int saved, frameSize, i;
+  char label[64];
+  FILE *output = code;
+  char *body;
+  size_t bodyLength;
+  beginSpan("code generation", getName(node));
+  switchSection(TEXT, ".text");
+  currentFunction = node;
+  frameTemporaries = countTemporaries(node->child[2]);
+  saved = frameTemporaries < REGISTER_TEMPORARIES ? frameTemporaries : REGISTER_TEMPORARIES;
+  frameLocals = -(SLOT_SCALE * node->symbol->memloc + QUAD_SIZE);
+  savedBase = frameLocals + QUAD_SIZE * registered;
+  spillBase = savedBase + QUAD_SIZE * saved;
+  operandBase = spillBase + QUAD_SIZE * (frameTemporaries - saved);
+  stackDepth = spillDepth = 0;
+
+  code = open_memstream(&body, &bodyLength);
+  if (code == NULL)
+  {
+    perror("x86gen: open_memstream");
+    exit(1);
+  }
+  bodyLabel = getLabel();
+  returnLabel = getLabel();
+  emitLabelX86(bodyLabel);
+  gen(node->child[2]->child[1]);
+  emitLabelX86(returnLabel);
+  if (isMain)
+    emitInstruction("xorl %%eax, %%eax");
+  genEpilogue();
+  emitInstruction("ret");
+  genBoundsTraps();
+  fclose(code);
+  code = output;
+
+  frameSize = operandBase + QUAD_SIZE * spillDepth;
+  frameSize = (frameSize + STACK_ALIGNMENT - 1) / STACK_ALIGNMENT * STACK_ALIGNMENT;
+  sprintf(label, "cm.%s", getName(node));
+  if (isMain)
+    emitDirective(".globl %s", label);
+  emitDirective(".type %s, @function", label);
+  emitDirective("%s:", label);
+  emitInstruction("pushq %%rbp");
+  emitInstruction("movq %%rsp, %%rbp");
+  if (frameSize)
+    emitInstruction("subq $%d, %%rsp", frameSize);
+  for (i = 0; i < registered; ++i)
+    emitInstruction("movq %s, %d(%%rbp)", argumentQuads[i], -(frameLocals + QUAD_SIZE * (i + 1)));
+  for (i = 0; i < saved; ++i)
+    emitInstruction("movq %s, %d(%%rbp)", temporaryQuads[i], -(savedBase + QUAD_SIZE * (i + 1)));
+  if (isMain && !BufferOutput)
+    emitInstruction("call rtUnbuffered");
+  fputs(body, code);
+  free(body);
+  emitDirective(".size %s, .-%s", label, label);
+  endSpanWith("instructions", eventCounts[CountInstructions] - firstInstruction);
+}
+
+/**********************************************/
+/* the primary function of the code generator */
+/**********************************************/
+/* Procedure codeGenX86 generates x86-64 assembly
+ * for the GNU assembler to the code file
+ */
+void codeGenX86(TreeNode *syntaxTree, char *codefile)
+{
+  char *s = malloc(strlen(codefile) + 7);
+  TreeNode *node;
+  emitComment("C-Minus Compilation to x86-64 Code");
+  sprintf(s, "File: %s", codefile);
+  emitComment(s);
+  free(s);
+  section = NONE;
+  for (node = syntaxTree; node; node = node->sibling)
+  {
+    if (node->nodekind != DeclK)
+      continue;
+    switch (node->kind.decl)
+    {
+    case VarDeclK:
+      genGlobalVarDecl(getName(node), WORD_SIZE);
+      break;
+    case ArrDeclK:
+      genGlobalVarDecl(getName(node), WORD_SIZE * node->child[1]->attr.val);
+      break;
+    case FunDeclK:
+      genFunDecl(node);
+      break;
+    }
+  }
+  emitDirective(".section .note.GNU-stack,\"\",@progbits");
+  free(boundsTraps);
+  boundsTraps = NULL;
+  boundsTrapCount = 0;
+}
+
+/* Function runtimePath returns the path of the
+ * runtime library object, which is installed next
+ * to the compiler */
+static char *runtimePath(const char *compiler)
+{
+  char self[4096];
+  const char *directory = compiler, *slash;
+  size_t length;
+  char *path;
+  ssize_t selfLength = readlink("/proc/self/exe", self, sizeof(self) - 1);
+  if (selfLength > 0)
+  {
+    self[selfLength] = '\0';
+    directory = self;
+  }
+  slash = strrchr(directory, '/');
+  length = slash ? (size_t)(slash - directory) : 1;
+  path = malloc(length + strlen(RUNTIME_OBJECT) + 2);
+  if (slash)
+    memcpy(path, directory, length);
+  else
+    path[0] = '.';
+  sprintf(path + length, "/%s", RUNTIME_OBJECT);
+  return path;
+}
+
+extern char **environ;
+
+/* Function linkNative assembles asmfile and links it
+ * with the runtime library into the executable
+ * program, with the system C compiler. Returns 0 on
+ * success */
+int linkNative(const char *asmfile, const char *program, const char *compiler)
+{
+  char *runtime = runtimePath(compiler);
+  char *argv[] = {"cc", "-o", (char *)program, (char *)asmfile, runtime, NULL};
+  pid_t pid;
+  int status;
+  if (posix_spawnp(&pid, "cc", NULL, NULL, argv, environ) != 0 || waitpid(pid, &status, 0) < 0)
+  {
+    fprintf(stderr, "Unable to run cc\n");
+    free(runtime);
+    return 1;
+  }
+  free(runtime);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    fprintf(stderr, "Unable to link %s\n", program);
+    return 1;
+  }
+  return 0;
+}
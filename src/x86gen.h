@@ -0,0 +1,31 @@
+/****************************************************/
+/* File: x86gen.h                                   */
+/* The x86-64 code generator                        */
+/* for the C- compiler                              */
+/* Eom Taegyung                                     */
+/****************************************************/
+
+#ifndef _X86GEN_H_
+#define _X86GEN_H_
+
+/* The runtime library object, built with the
+ * compiler and installed next to it */
+#define RUNTIME_OBJECT "runtime.o"
+
+/* Procedure codeGenX86 generates x86-64 assembly
+ * for the GNU assembler to the code file. The
+ * second parameter (codefile) is the file name of
+ * the code file, printed as a comment in it
+ */
+void codeGenX86(TreeNode *syntaxTree, char *codefile);
+
+/* Function linkNative assembles asmfile and links it
+ * with the runtime library into the executable
+ * program, with the system C compiler. compiler is
+ * the path the compiler was run as, used to find the
+ * runtime if /proc is not available. Returns 0 on
+ * success
+ */
+int linkNative(const char *asmfile, const char *program, const char *compiler);
+
+#endif